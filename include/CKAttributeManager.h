@@ -3,6 +3,7 @@
 
 #include "CKDefines.h"
 #include "CKBaseManager.h"
+#include "CKNameIndex.h"
 #include "XObjectArray.h"
 
 /****************************************************************
@@ -16,6 +17,16 @@ See Also:CKAttributeManager::SetAttributeCallbackFunction,Using Attributes
 *****************************************************/
 typedef void (*CKATTRIBUTECALLBACK)(CKAttributeType AttribType, CKBOOL Set, CKBeObject *obj, void *arg);
 
+// Object ID -> position of the object in an attribute list
+typedef XHashTable<int, CK_ID> XAttributeListSlots;
+
+// Objects having an attribute in a scene that is not the active one
+struct CKAttributeSceneList
+{
+    XObjectPointerArray Objects;
+    XAttributeListSlots *Slots;
+};
+
 struct CKAttributeDesc
 {
     char Name[64];
@@ -29,6 +40,13 @@ struct CKAttributeDesc
     char *DefaultValue;
     CKDWORD Flags;
     CKPluginEntry *CreatorDll;
+    // Positions of the objects in GlobalAttributeList and AttributeList
+    XAttributeListSlots GlobalAttributeSlots;
+    XAttributeListSlots *AttributeSlots;
+    // Lists of the scenes that were active before, by scene ID
+    XHashTable<CKAttributeSceneList, CK_ID> SceneLists;
+
+    ~CKAttributeDesc();
 };
 
 struct CKAttributeCategoryDesc
@@ -111,6 +129,11 @@ public:
     DLL_EXPORT const XObjectPointerArray &FillListByAttributes(CKAttributeType *ListAttrib, int AttribCount);
     DLL_EXPORT const XObjectPointerArray &FillListByGlobalAttributes(CKAttributeType *ListAttrib, int AttribCount);
 
+    DLL_EXPORT int QueryObjectsByAttributes(XObjectPointerArray &Result, CKAttributeType *ListAttrib, int AttribCount,
+                                            CK_ATTRIBUT_QUERY Query = CK_ATTRIBUT_QUERY_ALL,
+                                            CKAttributeType *ExcludedAttrib = NULL, int ExcludedCount = 0,
+                                            CK_CLASSID Cid = CKCID_BEOBJECT, CKBOOL Derived = TRUE, CKBOOL Global = FALSE);
+
     //----------------------------------------------------------------
     // Categories...
     DLL_EXPORT int GetCategoriesCount();
@@ -168,10 +191,20 @@ public:
 
     virtual CKERROR SequenceRemovedFromScene(CKScene *scn, CK_ID *objid, int count);
 
+    virtual CKERROR SequenceToBeDeleted(CK_ID *objids, int count);
+
     virtual CKDWORD GetValidFunctionsMask() { return CKMANAGER_FUNC_PreClearAll |
                                                      CKMANAGER_FUNC_PostLoad |
                                                      CKMANAGER_FUNC_OnSequenceAddedToScene |
-                                                     CKMANAGER_FUNC_OnSequenceRemovedFromScene; }
+                                                     CKMANAGER_FUNC_OnSequenceRemovedFromScene |
+                                                     CKMANAGER_FUNC_OnSequenceToBeDeleted; }
+
+    int FindName(CKNameIndex &names, CKSTRING name, CKBOOL categories);
+    void RebuildCategoryNames();
+
+    CKScene *GetListScene();
+    void UpdateAttributeList(CKAttributeDesc *desc, CKBeObject *beo, CKScene *scene);
+    void DropSceneLists(CK_ID scene);
 
     int m_AttributeInfoCount;
     CKAttributeDesc **m_AttributeInfos;
@@ -182,6 +215,12 @@ public:
     XBitArray m_AttributeMask;
     CKBOOL m_Saving;
     XObjectPointerArray m_AttributeList;
+    CKNameIndex m_AttributeNames;
+    CKNameIndex m_CategoryNames;
+    // Scene the AttributeList of every attribute was built for by NewActiveScene
+    CK_ID m_ActiveScene;
+    // Scenes having lists in CKAttributeDesc::SceneLists
+    XArray<CK_ID> m_CachedScenes;
 };
 
 #endif // CKATTRIBUTEMANAGER_H
\ No newline at end of file
@@ -68,6 +68,7 @@ class DLL_EXPORT CKBeObject : public CKSceneObject
     friend class CKMessageManager;
     friend class CKDebugContext;
     friend class CKFile;
+    friend class CKObjectManager;
 
 public:
     //-----------------------------------------------------------
@@ -177,6 +178,7 @@ protected:
     int m_Priority;
     float m_LastExecutionTime;
     XAttributeList m_Attributes;
+    CKDWORD m_MessageFrame; // Last CKMessageManager::PostProcess frame in which the object was given a message
 
     void SortScripts();
     void RemoveFromAllGroups();
@@ -3,6 +3,7 @@
 
 #include "CKSceneObject.h"
 #include "XObjectArray.h"
+#include "XHashTable.h"
 
 struct BehaviorBlockData
 {
@@ -44,11 +45,19 @@ struct BehaviorGraphData
     CKWORD m_BehaviorIteratorCount;
     CKWORD m_BehaviorIteratorIndex;
 
+    // Activation queue: CheckIOsActivation only visits what changed since the last frame.
+    XObjectPointerArray m_PendingIOs;          // Activated IOs whose links belong to this graph
+    XObjectPointerArray m_PendingSubBehaviors; // Sub-behaviors that may be active
+    XObjectPointerArray m_TriggeredLinks;      // Links flagged CKBL_OLD_TRIGGERED_THIS_FRAME
+    XHashTable<int, CK_ID> m_SubBehaviorRanks; // Sub-behavior ID -> position in m_SubBehaviors
+    CKBOOL m_FullScan;                         // Queue is not trusted, the next check scans everything
+
     BehaviorGraphData()
     {
         m_BehaviorIterators = nullptr;
         m_BehaviorIteratorCount = 0;
         m_BehaviorIteratorIndex = 0;
+        m_FullScan = TRUE;
     }
 
     BehaviorGraphData(const BehaviorGraphData &data)
@@ -60,6 +69,7 @@ struct BehaviorGraphData
         m_BehaviorIterators = nullptr;
         m_BehaviorIteratorCount = 0;
         m_BehaviorIteratorIndex = 0;
+        m_FullScan = TRUE;
     }
 
     ~BehaviorGraphData();
@@ -439,6 +449,11 @@ protected:
     int InternalGetShortestDelay(CKBehavior *beh, XObjectPointerArray &behparsed);
     void CheckIOsActivation();
     void CheckBehaviorActivity();
+    void InvalidateActivationQueue();
+    void QueueInParentGraph();
+    void MarkLinkTriggered(CKBehaviorLink *link);
+    CKBehaviorIO *TriggerLink(CKBehaviorLink *link);
+    void BuildBehaviorIterators();
     int ExecuteFunction();
     void FindNextBehaviorsToExecute(CKBehavior *beh);
     void HierarchyPostLoad();
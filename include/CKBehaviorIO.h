@@ -54,10 +54,14 @@ public:
     *************************************************/
     void Activate(CKBOOL Active = TRUE)
     {
-        if (Active)
-            m_ObjectFlags |= CK_BEHAVIORIO_ACTIVE;
-        else
+        if (Active) {
+            if (!(m_ObjectFlags & CK_BEHAVIORIO_ACTIVE)) {
+                m_ObjectFlags |= CK_BEHAVIORIO_ACTIVE;
+                QueueActivation();
+            }
+        } else {
             m_ObjectFlags &= ~CK_BEHAVIORIO_ACTIVE;
+        }
     }
 
     /*************************************************
@@ -118,6 +122,9 @@ public:
     void SetOldFlags(CKDWORD flags);
     CKDWORD GetOldFlags();
 
+    // Tells the graph holding this IO's links that it has been activated
+    void QueueActivation();
+
 protected:
     XSObjectPointerArray m_Links;
     CKBehavior *m_OwnerBehavior;
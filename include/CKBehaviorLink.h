@@ -12,6 +12,9 @@ enum CK_BEHAVIORLINK_OLD_FLAGS : CKDWORD {
     // Link has been triggered/parsed this frame by activation propagation.
     // (The engine toggles this bit while scanning sub-behavior links.)
     CKBL_OLD_TRIGGERED_THIS_FRAME = 0x00000002,
+
+    // Link is in its graph's m_SubBehaviorLinks (set when the graph rescans its links).
+    CKBL_OLD_IN_GRAPH = 0x00000004,
 };
 
 /***********************************************************************
@@ -10,6 +10,21 @@
 typedef XSHashTable<int, CK_ID> BeObjectTable;
 typedef BeObjectTable::Iterator BeObjectTableIt;
 
+class CKBehaviorWorkerPool;
+
+// Execution state private to one thread of a parallel behavior frame
+// (see CKBehaviorManager::SetThreadCount).
+struct CKBehaviorThreadState
+{
+    CKBehaviorContext BehaviorContext;
+    CKStats Stats;
+    CKBehavior *CurrentBehavior;
+    XObjectPointerArray ExecutedBehaviors; // Behaviors that got CKBEHAVIOR_EXECUTEDLASTFRAME
+    XObjectPointerArray IdleObjects;       // Objects that had no active script
+
+    CKBehaviorThreadState() : CurrentBehavior(nullptr) { memset(&Stats, 0, sizeof(CKStats)); }
+};
+
 /************************************************************************
 Name: CKBehaviorManager
 
@@ -27,6 +42,7 @@ See Also: CKBehavior, CKBeObject, CKScene
 class CKBehaviorManager : public CKBaseManager
 {
     friend class CKBehavior;
+    friend class CKBehaviorWorkerPool;
 
 public:
     //----------------------------------------------
@@ -51,6 +67,15 @@ public:
     DLL_EXPORT int AddObjectNextFrame(CKBeObject *beo);
     DLL_EXPORT int RemoveObjectNextFrame(CKBeObject *beo);
 
+    // Number of threads used to execute isolated objects in Execute. An object
+    // is isolated when all its scripts have the CKBEHAVIOR_ISOLATED flag and it
+    // is not a character. Objects still run in priority order: each run of
+    // consecutive isolated objects is executed concurrently on the pool, and
+    // finished before the next object runs on the calling thread. Only the order
+    // inside such a run is not defined. 0 or 1 = serial.
+    DLL_EXPORT void SetThreadCount(int count);
+    DLL_EXPORT int GetThreadCount();
+
     //-------------------------------------------------------------------------
     // Internal functions
     CKBehaviorManager(CKContext *Context);
@@ -64,6 +89,20 @@ public:
     virtual CKERROR PreClearAll();
     virtual CKERROR SequenceDeleted(CK_ID *objids, int count);
     virtual CKERROR SequenceToBeDeleted(CK_ID *objids, int count);
+    CKBOOL IsIsolated(CKBeObject *beo);
+    void UpdateIsolatedCache();
+    void ExecuteObject(CKBeObject *beo, float delta);
+    void MergeThreadState(CKBehaviorThreadState &state);
+
+    // State of the calling thread inside a parallel frame, nullptr elsewhere
+    static CKBehaviorThreadState *GetThreadState();
+    static CKStats &GetThreadStats(CKContext *context);
+    static CKBehaviorContext &GetThreadBehaviorContext(CKContext *context);
+
+    // To be called when the scripts of an object or their CKBEHAVIOR_ISOLATED
+    // flag change (main thread only)
+    static void InvalidateIsolation(CKContext *context);
+
     virtual CKDWORD GetValidFunctionsMask()
     {
         return CKMANAGER_FUNC_PreClearAll |
@@ -79,6 +118,12 @@ public:
     BeObjectTable m_BeObjectNextFrame;
     CKBehavior *m_CurrentBehavior;
     int m_BehaviorMaxIteration;
+    int m_ThreadCount;
+    CKBehaviorWorkerPool *m_WorkerPool;
+    XObjectPointerArray m_IsolatedObjects;
+    XArray<CKBOOL> m_IsolatedCache; // IsIsolated for each object of m_BeObjects
+    int m_IsolationVersion;
+    int m_IsolatedCacheVersion;
 };
 
 #endif // CKBEHAVIORMANAGER_H
@@ -176,6 +176,11 @@ public:
     void SetFileWriteMode(CK_FILE_WRITEMODE mode);
     CK_FILE_WRITEMODE GetFileWriteMode();
 
+    // Number of threads used to serialize objects of save-thread-safe
+    // classes (CK_GENERALOPTIONS_SAVETHREADSAFE) in CKFile::EndSave. 0 or 1 = serial save.
+    void SetSaveThreadCount(int count);
+    int GetSaveThreadCount();
+
     CK_TEXTURE_SAVEOPTIONS GetGlobalImagesSaveOptions();
     void SetGlobalImagesSaveOptions(CK_TEXTURE_SAVEOPTIONS Options);
 
@@ -339,6 +344,7 @@ public:
     CKBOOL m_InDynamicCreationMode;
     XObjectArray m_CopyObjects;
     XObjectPointerArray m_ObjectsUnused;
+    int m_SaveThreadCount;
 };
 
 #endif // CKCONTEXT_H
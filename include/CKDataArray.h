@@ -2,6 +2,7 @@
 #define CKDATAARRAY_H
 
 #include "CKBeObject.h"
+#include "XHashTable.h"
 
 typedef XSArray<CKUINTPTR> CKDataRow;
 
@@ -9,6 +10,38 @@ typedef int (*ArraySortFunction)(CKDataRow *, CKDataRow *);
 
 typedef CKBOOL (*ArrayEqualFunction)(CKDataRow *);
 
+// Lookup index of a data array column (see CKDataArray::SetColumnIndexed).
+// Rows are chained by element hash in row order; the sorted permutation is rebuilt on demand.
+class CKDataColumnIndex
+{
+public:
+    struct Chain
+    {
+        int First;
+        int Last;
+    };
+
+    CKDataColumnIndex() : m_ChainsValid(FALSE), m_SortedValid(FALSE) {}
+
+    XHashTable<Chain, CKDWORD> m_Chains; // Element hash -> first and last row of the chain
+    XArray<int> m_Next;                  // Row -> next row with the same hash, -1 ends the chain
+    XArray<int> m_Previous;              // Row -> previous row with the same hash, -1 starts the chain
+    XArray<int> m_SortedRows;            // Rows in ascending element order, ties in row order
+    CKBOOL m_ChainsValid;
+    CKBOOL m_SortedValid;
+};
+
+// Contiguous copy of an int, float or object column (see CKDataArray::SetColumnPacked).
+// Elements are packed as their low 32 bits, in row order.
+class CKDataColumnStore
+{
+public:
+    CKDataColumnStore() : m_Valid(FALSE) {}
+
+    XArray<CKDWORD> m_Values; // Row -> element
+    CKBOOL m_Valid;
+};
+
 class ColumnFormat
 {
 public:
@@ -19,6 +52,8 @@ public:
         m_ParameterType = CKGUID(0, 0);
         m_SortFunction = NULL;
         m_EqualFunction = NULL;
+        m_Index = NULL;
+        m_Store = NULL;
     }
     ColumnFormat(const ColumnFormat &c)
     {
@@ -27,7 +62,16 @@ public:
         m_ParameterType = c.m_ParameterType;
         m_SortFunction = c.m_SortFunction;
         m_EqualFunction = c.m_EqualFunction;
+        m_Index = c.m_Index ? new CKDataColumnIndex : NULL;
+        m_Store = c.m_Store ? new CKDataColumnStore : NULL;
     }
+    ~ColumnFormat()
+    {
+        delete m_Index;
+        delete m_Store;
+    }
+    // Index and store belong to one column and are rebuilt by its array
+    ColumnFormat &operator=(const ColumnFormat &c) = delete;
 
     // Column name
     char *m_Name;
@@ -39,6 +83,10 @@ public:
     ArraySortFunction m_SortFunction;
     // Equal Function
     ArrayEqualFunction m_EqualFunction;
+    // Lookup index, NULL if the column is not indexed
+    CKDataColumnIndex *m_Index;
+    // Packed copy of the column, NULL if the column is not packed
+    CKDataColumnStore *m_Store;
 };
 
 typedef XArray<CKDataRow *> CKDataMatrix;
@@ -86,6 +134,21 @@ public:
     DLL_EXPORT void SetKeyColumn(int c);
     // Get Column Number
     DLL_EXPORT int GetColumnCount();
+    // Maintain a lookup index on a column : hashed for CKEQUAL/CKNOTEQUAL, sorted for the other operators.
+    // Not available on parameter columns. GetElement and GetRow drop the index, which is rebuilt on the
+    // next lookup: pointers they returned must not be written after that lookup.
+    // Lookups on a column with a custom equal function call it row by row instead.
+    DLL_EXPORT CKBOOL SetColumnIndexed(int c, CKBOOL indexed);
+    // Is a column indexed
+    DLL_EXPORT CKBOOL IsColumnIndexed(int c);
+    // Maintain a contiguous copy of an int, float or object column that column scans (Sum, Product,
+    // GetHighest, GetLowest, GetNearest, GetCount, FindRow...) sweep instead of the rows.
+    // GetElement and GetRow drop the copy, which is rebuilt on the next scan: pointers they returned
+    // must not be written after that scan. Sums and products of packed float columns are computed
+    // on four lanes and may differ from the row order ones in the last bits.
+    DLL_EXPORT CKBOOL SetColumnPacked(int c, CKBOOL packed);
+    // Is a column packed
+    DLL_EXPORT CKBOOL IsColumnPacked(int c);
 
     // Elements Functions
 
@@ -169,6 +232,8 @@ public:
 
     // Sort the array on the column, ascending or descending
     DLL_EXPORT void Sort(int c, CKBOOL ascending);
+    // Sort the array on the column, rows with equal elements keep their order
+    DLL_EXPORT void StableSort(int c, CKBOOL ascending);
     // Remove the elements identical in the array
     DLL_EXPORT void Unique(int c);
     // Shuffle the array
@@ -189,6 +254,27 @@ public:
     //-------------------------------------------------------------------------
     // Internal functions
 
+    // Lookup and sort helpers {Secret}
+    CKUINTPTR *PeekElement(size_t i, size_t c);
+    void WriteElement(int i, int c, CKUINTPTR value);
+    void ColumnDataChanged(int c);
+    void InvalidateColumnIndexes();
+    void IndexLinkRow(int c, int row);
+    void IndexUnlinkRow(int c, int row);
+    void LinkAppendedRow();
+    CKDataColumnStore *GetColumnStore(int c);
+    CKDataColumnStore *ReloadColumnStore(int c);
+    CKDataColumnIndex *GetColumnChains(int c);
+    CKDataColumnIndex *GetColumnSortedRows(int c);
+    CKBOOL IndexedLookup(int c, CK_COMPOPERATOR op, CKUINTPTR key, int startIndex, int *row, int *count);
+    CKBOOL PackedLookup(int c, CK_COMPOPERATOR op, CKUINTPTR key, int startIndex, int *row, int *count);
+    ArrayEqualFunction GetCustomEqualFunction(int c, CK_COMPOPERATOR op, CKUINTPTR key, int size);
+    void SortRows(int c, CKBOOL ascending, CKBOOL stable);
+
+    // Serialization helpers {Secret}
+    void WriteParameterElement(CKStateChunk *chunk, CKFile *file, CKUINTPTR element);
+    CKUINTPTR ReadParameterElement(CKStateChunk *chunk, CKFile *file, ColumnFormat *fmt);
+
     //-------------------------------------------------------
     // Virtual functions	{Secret}
     CKDataArray(CKContext *Context, CKSTRING Name = NULL);
@@ -233,6 +319,8 @@ public:
     CKBOOL m_Order;
     int m_ColumnIndex;
 
+    // State of the Array*Comp and Array*Equal column functions. The array
+    // operations carry their own state and only set these for custom functions.
     static int g_ColumnIndex;
     static CKBOOL g_Order;
     static CK_COMPOPERATOR g_Operator;
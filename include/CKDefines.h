@@ -393,6 +393,7 @@ typedef int (*CKCLASSDEPENDENCIESCOUNTFCT)(int);
 #define CK_GENERALOPTIONS_NODUPLICATENAMECHECK 1 // Classes that don't need to check for duplicate names	when created or loaded
 #define CK_GENERALOPTIONS_CANUSECURRENTOBJECT 2	 // Classes that can use an existing object (Meshes,Materials for example)
 #define CK_GENERALOPTIONS_AUTOMATICUSECURRENT 4	 // Classes that automatically use an existing object (Synchro objects...)
+#define CK_GENERALOPTIONS_SAVETHREADSAFE 8		 // Classes whose Save() only reads shared state and can run on a save worker thread
 
 struct DLL_EXPORT CKClassDesc
 {
@@ -695,6 +695,7 @@ typedef enum CK_STATESAVEFLAGS_DATAARRAY
     CK_STATESAVE_DATAARRAYFORMAT  = 0x00001000,	// Save format
     CK_STATESAVE_DATAARRAYDATA	  = 0x00002000,	// Save array data
     CK_STATESAVE_DATAARRAYMEMBERS = 0x00004000,	// Save members
+    CK_STATESAVE_DATAARRAYCOLUMNS = 0x00008000,	// Save array data column by column
     CK_STATESAVE_DATAARRAYALL 	  = 0x0000FFFF	// Save All data for sub-classes
 } CK_STATESAVEFLAGS_DATAARRAY;
 
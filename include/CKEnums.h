@@ -300,6 +300,11 @@ Remarks:
     + When creating a prototype, you can precise various flags
     about how your behavior will act: whether it will send or receive message,
     does the user may add inputs,outputs or parameters, is it active, etc.
+    + A script flagged CKBEHAVIOR_ISOLATED may run on a behavior worker thread.
+    It must only write its owner's state. It may read parameters linked to other
+    objects: reading a parameter pulls the value of its sources, and these pulls
+    are serialized between worker threads. It must not write such parameters,
+    send messages or create objects.
 
 See also: CKBehaviorPrototype::SetBehaviorFlags,Behavior Prototype Creation
 **********************************************************/
@@ -317,6 +322,7 @@ typedef enum CK_BEHAVIOR_FLAGS
     CKBEHAVIOR_VARIABLEOUTPUTS               = 0x00000100,  // Behavior may have its outputs changed by editing them
     CKBEHAVIOR_VARIABLEPARAMETERINPUTS       = 0x00000200,  // Behavior may have its number of input parameters changed by editing them
     CKBEHAVIOR_VARIABLEPARAMETEROUTPUTS      = 0x00000400,  // Behavior may have its number of output parameters changed by editing them
+    CKBEHAVIOR_ISOLATED                      = 0x00001000,  // Script only touches its owner and may run on a worker thread (CKBehaviorManager::SetThreadCount)
     CKBEHAVIOR_TOPMOST                       = 0x00004000,  // No other Behavior includes this one
     CKBEHAVIOR_BUILDINGBLOCK                 = 0x00008000,  // This behavior is a building block. Automatically set by the engine when coming from a DLL.
     CKBEHAVIOR_MESSAGESENDER                 = 0x00010000,  // Behavior may send messages during its execution.
@@ -719,6 +725,21 @@ typedef enum CK_ATTRIBUT_FLAGS
     CK_ATTRIBUT_DONOTCOPY  = 0x00000040,    // This Attribute type will not be copied when the object that holds it is copied
 } CK_ATTRIBUT_FLAGS;
 
+/*************************************************
+{filename:CK_ATTRIBUT_QUERY}
+Summary: Combination of attribute types in an attribute query
+
+Remarks:
+    + Objects having one of the excluded attribute types are removed from the result
+    whatever the combination.
+See also: CKAttributeManager::QueryObjectsByAttributes
+*************************************************/
+typedef enum CK_ATTRIBUT_QUERY
+{
+    CK_ATTRIBUT_QUERY_ANY = 0,    // Objects having at least one of the attribute types (union)
+    CK_ATTRIBUT_QUERY_ALL = 1,    // Objects having all the attribute types (intersection)
+} CK_ATTRIBUT_QUERY;
+
 //----------------------------------------------------------////
 // Behavior Prototype  Flags								////
 //----------------------------------------------------------////
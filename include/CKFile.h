@@ -133,6 +133,8 @@ public:
     // Create a CKStateChunk from the Size bytes
     // returns NULL if data was not valid
     CKStateChunk *ExtractChunk(int Size, CKFile *f);
+    // Same as ExtractChunk but the chunk points into the parser buffer instead of copying it
+    CKStateChunk *ExtractChunkView(int Size, CKFile *f);
     void ExtractChunk(int Size, CKFile *f, CKFileChunk *chunk);
 
     // Returns the CRC of the next Size bytes
@@ -234,9 +236,16 @@ protected:
     void ClearData();
     CKERROR ReturnWithParserCleanup(CKBufferParser *parser, CKBufferParser **ParserPtr, CKERROR err);
     void FinalizeSaveState();
+    // Saves the chunks of objects whose class is flagged CK_GENERALOPTIONS_SAVETHREADSAFE
+    // on threadCount threads, savedObjects receives the indices of the saved m_FileObjects entries.
+    void SaveObjectChunks(int threadCount, XBitArray &savedObjects);
 
     CKERROR ReadFileHeaders(CKBufferParser **ParserPtr);
     CKERROR ReadFileData(CKBufferParser **ParserPtr);
+    CKERROR ReadPackedFileData(CKBufferParser *Parser);
+    CKERROR ReadIncludedFiles(CKBufferParser *Parser);
+    static CKBOOL IsDecodedOnly(CK_CLASSID cid);
+    void ReleaseFileBuffer();
     void FinishLoading(CKObjectArray *list, CKDWORD flags);
 
     //-----------------------------------------------
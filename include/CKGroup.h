@@ -18,6 +18,8 @@ See also: CKBeObject
 class CKGroup : public CKBeObject
 {
     friend class CKBeObject;
+    friend class CKObjectManager;
+    friend class CKSceneObjectSnapshot;
 
 public:
     //---------------------------------------
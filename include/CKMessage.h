@@ -3,6 +3,8 @@
 
 #include "CKBeObject.h"
 
+class CKMessagePool;
+
 typedef enum CK_MESSAGE_SENDINGTYPE
 {
     CK_MESSAGE_BROADCAST = 1,	// Send message to all objects of a specific class ID
@@ -170,6 +172,8 @@ protected:
         CK_ID m_Recipient;
     };
     CKContext *m_Context;
+    CKMessagePool *m_Pool; // Holds the parameter array, and the message when pooled
+    CKBOOL m_Pooled;       // Taken from the message manager pool
 };
 
 #endif // CKMESSAGE_H
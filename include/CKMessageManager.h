@@ -5,9 +5,14 @@
 #include "CKTypes.h"
 #include "CKMessage.h"
 #include "CKBaseManager.h"
+#include "CKNameIndex.h"
 #include "XClassArray.h"
 #include "XObjectArray.h"
 
+#include <mutex>
+
+typedef XHashTable<int, CK_ID> XWaitingObjectSlots;
+
 struct CKMessageWaitingList;
 
 struct CKMessageDesc;
@@ -22,6 +27,39 @@ typedef XArray<CKWaitingObject> CKWaitingObjectArray;
 
 typedef XClassArray<XString> CKStringArray;
 
+// Storage of pooled messages and message parameter arrays. The message manager
+// and every message hold a reference, so the storage outlives the manager until
+// the last message is released. Can be used from any thread.
+class CKMessagePool
+{
+public:
+    CKMessagePool();
+
+    void AddRef();
+    void Release();
+
+    // Storage for one message. grown is set when a slab had to be allocated.
+    void *AllocateMessage(CKBOOL &grown);
+    // Takes back a destroyed pooled message and drops its reference. A released
+    // message is only reused after RecycleReleasedMessages, so a stale pointer
+    // never refers to a message sent later in the same frame.
+    void FreeMessage(CKMessage *msg);
+    void RecycleReleasedMessages();
+
+    XObjectArray *AllocateParameters(CKBOOL &grown);
+    void RecycleParameters(XObjectArray *parameters);
+
+protected:
+    ~CKMessagePool();
+
+    std::mutex m_Lock;
+    int m_RefCount;
+    XArray<CKBYTE *> m_Slabs;
+    XArray<CKMessage *> m_FreeMessages;
+    XArray<CKMessage *> m_ReleasedMessages;
+    XArray<XObjectArray *> m_FreeParameters;
+};
+
 /****************************************************************************
 Name: CKMessageManager
 
@@ -62,6 +100,7 @@ See also: CKContext::GetMessageManager,CKMessage
 class CKMessageManager : public CKBaseManager
 {
     friend class CKMessage;
+    friend class CKBeObject;
 
 public:
     //---------------------------------------------
@@ -111,15 +150,41 @@ public:
 
 protected:
     void AddMessageToObject(CKObject *obj, CKMessage *msg, CKScene *currentscene, CKBOOL recurse);
+    void AddLastFrameObject(CKBeObject *obj);
+    void StartMessageFrame();
+    void WaitingObjectChanged(CKBeObject *obj);
+    void RebuildWaitingObjectSlots();
+
+    CKMessageType FindMessageType(CKSTRING name);
+    void AddMessageTypeName(CKMessageType type);
+    void RemoveMessageTypeName(CKMessageType type);
 
     CKMessage *CreateMessageSingle(CKMessageType type, CKBeObject *dest, CKBeObject *sender);
     CKMessage *CreateMessageGroup(CKMessageType type, CKGroup *group, CKBeObject *sender);
     CKMessage *CreateMessageBroadcast(CKMessageType type, CK_CLASSID objType, CKBeObject *sender);
 
+    // Message pool
+    CKMessage *AllocateMessage();
+
     CKStringArray m_RegisteredMessageTypes;
     CKWaitingObjectArray **m_MsgWaitingList;
+    // Allocated size of m_MsgWaitingList, grown by doubling
+    int m_MsgWaitingListCapacity;
+    // Message types by name
+    CKNameIndex m_MessageTypeNames;
     XArray<CKMessage *> m_ReceivedMsgThisFrame;
     XObjectPointerArray m_LastFrameObjects;
+    // Objects of m_LastFrameObjects carry this stamp in CKBeObject::m_MessageFrame
+    CKDWORD m_MessageFrame;
+    // Objects waiting for messages (CKBeObject::IsWaitingForMessages) by class id.
+    // Broadcasts only visit these objects.
+    // The lists are unordered: an object is removed by moving the last object of
+    // its list into its place. Object -> position in its list.
+    XClassArray<XObjectPointerArray> m_WaitingObjects;
+    XWaitingObjectSlots m_WaitingObjectSlots;
+
+    // Released messages are recycled at the end of PostProcess and OnCKReset
+    CKMessagePool *m_MessagePool;
 };
 
 #endif // CKMESSAGEMANAGER_H
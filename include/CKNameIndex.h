@@ -0,0 +1,58 @@
+#ifndef CKNAMEINDEX_H
+#define CKNAMEINDEX_H
+
+#include "CKTypes.h"
+#include "XHashTable.h"
+
+// FNV-1a, only used to bucket names and strings: hits are always confirmed with strcmp
+inline CKDWORD CKHashName(CKSTRING name) {
+    CKDWORD hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *) name; *p; ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Indices of named entries (message types, attribute types...) by name hash.
+// The indices of a hash are kept in increasing order, so a name used by several
+// entries resolves to the first one, as a linear search would.
+class CKNameIndex
+{
+public:
+    void Add(CKSTRING name, int index) {
+        const CKDWORD key = CKHashName(name);
+        XArray<int> *indices = m_Indices.FindPtr(key);
+        if (!indices)
+            indices = &(*m_Indices.InsertUnique(key, XArray<int>()));
+        XArray<int>::Iterator it = indices->Begin();
+        while (it != indices->End() && *it < index)
+            ++it;
+        indices->Insert(it, index);
+    }
+
+    void Remove(CKSTRING name, int index) {
+        const CKDWORD key = CKHashName(name);
+        XArray<int> *indices = m_Indices.FindPtr(key);
+        if (!indices)
+            return;
+        indices->Remove(index);
+        if (indices->IsEmpty())
+            m_Indices.Remove(key);
+    }
+
+    // Entries whose name may be name, in increasing order, or NULL. The caller
+    // compares their names.
+    XArray<int> *Find(CKSTRING name) {
+        return m_Indices.FindPtr(CKHashName(name));
+    }
+
+    void Clear() {
+        m_Indices.Clear();
+    }
+
+protected:
+    XHashTable<XArray<int>, CKDWORD> m_Indices;
+};
+
+#endif // CKNAMEINDEX_H
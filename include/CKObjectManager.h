@@ -7,6 +7,7 @@
 #include "XObjectArray.h"
 
 typedef XHashTable<void *, CK_ID> XObjectAppDataTable;
+typedef XHashTable<XObjectArray, CKDWORD> XObjectNameTable;
 
 struct CKDeferredDeletion {
     CKDependencies m_Dependencies;
@@ -34,6 +35,7 @@ public:
     CK_ID *GetObjectsListByClassID(CK_CLASSID cid);
 
     CK_ID RegisterObject(CKObject *iObject);
+    void ReserveObjectIDs(int count);
     void FinishRegisterObject(CKObject *iObject);
     void UnRegisterObject(CK_ID id);
 
@@ -91,6 +93,29 @@ public:
     void AddSingleObjectActivity(CKSceneObject *o, CK_ID id);
     int GetSingleObjectActivity(CKSceneObject *o, CK_ID &id);
 
+    // Name index, kept up to date by CKObject::SetName
+    void AddObjectName(CK_ID id, CKSTRING name);
+    void RemoveObjectName(CK_ID id, CKSTRING name);
+
+protected:
+    // What the objects of a DeleteObjects batch can be referenced from
+    struct DeletionReferences {
+        XBitArray Groups;  // Global indices of the groups holding a deleted object
+        XBitArray Scenes;  // Global indices of the scenes holding a deleted object
+        XBitArray IDs;     // Deleted IDs
+        CKBOOL Parameters; // A parameter is deleted
+
+        DeletionReferences() : Parameters(FALSE) {}
+    };
+
+    void AddDeletionReferences(DeletionReferences &refs, CKObject *obj);
+    CKBOOL NeedsPreDeletionCheck(DeletionReferences &refs, CKObject *obj);
+    CKBOOL NeedsPostDeletionCheck(DeletionReferences &refs, CKObject *obj);
+
+    void GrowObjectTable(int minCount);
+    CKBOOL IsInClassList(CKObject *obj);
+    void SetClassListRank(CK_ID id);
+
 public:
     int m_ObjectCount;
     CKObject **m_Objects;
@@ -107,6 +132,10 @@ public:
     XObjectArray m_DynamicObjects;
     XBitArray m_SceneGlobalIndex;
     XBitArray m_GroupGlobalIndex;
+    XObjectNameTable m_ObjectNames;  // Name hash -> IDs of the objects using this name
+    XArray<int> m_ObjectNameSlots;   // Per ID, position in its m_ObjectNames bucket
+    XArray<CKDWORD> m_ClassListRanks; // Per ID, increasing with the position in m_ClassLists (0 = not listed)
+    CKDWORD m_ClassListCounter;
 };
 
 #endif // CKOBJECTRMANAGER_H
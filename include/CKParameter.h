@@ -22,6 +22,7 @@ See also: CKBehavior, CKParameterIn, CKParameterOperation
 class CKParameter : public CKObject
 {
     friend class CKParameterIn;
+    friend class CKParameterOut;
     friend class CKParameterManager;
 
 public:
@@ -78,6 +79,7 @@ public:
     virtual CKStateChunk *Save(CKFile *file, CKDWORD flags);
     virtual CKERROR Load(CKStateChunk *chunk, CKFile *file);
 
+    virtual void CheckPreDeletion();
     virtual void CheckPostDeletion();
 
     virtual int GetMemoryOccupation();
@@ -107,10 +109,19 @@ public:
     void MessageDeleteAfterUse(CKBOOL act);
     CKParameterTypeDesc *GetParameterType() { return m_ParamType; }
 
+    // Output parameters only mark their value as changed, their destinations
+    // copy it when they are read or written next.
+    void PullSourceValue();
+    void TouchValue();
+    CKParameterVersion GetValueVersion() { return m_Version; }
+    static CKParameterVersion NewValueVersion();
+
 protected:
     CKObject *m_Owner;
     CKParameterTypeDesc *m_ParamType;
     int m_Size;
+    CKParameterVersion m_Version;   // Stamp of the value: a new one on each write, the source one once pulled
+    XSObjectPointerArray m_Sources; // Output parameters having this one as destination
 
     union
     {
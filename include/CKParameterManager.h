@@ -7,6 +7,9 @@
 #include "CKParameterOut.h"
 #include "CKParameterLocal.h"
 
+#include <atomic>
+#include <mutex>
+
 typedef XNHashTable<CKParameterType, CKGUID> XHashGuidToType;
 
 /***********************************************************
@@ -124,8 +127,31 @@ struct OperationCell {
     int CellCount;
     TreeCell *Tree;
     CKBOOL IsActive;
+    CKBOOL IsDeterministic;
 };
 
+// Key of the operation function resolution cache {Secret}
+struct OperationFunctionKey {
+    CKGUID Operation;
+    CKGUID Result;
+    CKGUID Param1;
+    CKGUID Param2;
+
+    bool operator==(const OperationFunctionKey &k) const {
+        return Operation == k.Operation && Result == k.Result && Param1 == k.Param1 && Param2 == k.Param2;
+    }
+};
+
+template <>
+struct XHashFun<OperationFunctionKey>
+{
+    int operator()(const OperationFunctionKey &k) const {
+        return k.Operation.d1 ^ (k.Result.d1 * 31) ^ (k.Param1.d1 * 961) ^ (k.Param2.d1 * 29791);
+    }
+};
+
+typedef XHashTable<CK_PARAMETEROPERATION, OperationFunctionKey> XOperationFunctionCache;
+
 /************************************************************************
 Name: CKParameterManager
 
@@ -210,6 +236,10 @@ public:
     DLL_EXPORT CKOperationType RegisterOperationType(CKGUID OpCode, CKSTRING name);
     DLL_EXPORT CKERROR UnRegisterOperationType(CKGUID opguid);
     DLL_EXPORT CKERROR UnRegisterOperationType(CKOperationType opcode);
+    // An operation type is deterministic when its result only depends on the value of its inputs:
+    // its operations are then not executed again while their inputs are unchanged.
+    DLL_EXPORT CKERROR SetOperationTypeDeterministic(CKGUID opguid, CKBOOL deterministic);
+    DLL_EXPORT CKBOOL IsOperationTypeDeterministic(CKGUID opguid);
 
     //-----------------------------------------------------------------------
     // Operation function access
@@ -288,6 +318,13 @@ protected:
     XHashGuidToType m_ParamGuids;
     XHashGuidToType m_OpGuids;
 
+    // Resolved operation functions, including failed resolutions (NULL). The
+    // published table is read without lock and never modified: a miss publishes
+    // a grown copy. Replaced tables are freed when no worker thread can read them.
+    std::atomic<XOperationFunctionCache *> m_OperationFunctionCache;
+    XArray<XOperationFunctionCache *> m_RetiredOperationFunctionCaches;
+    std::mutex m_OperationFunctionCacheLock; // Serializes misses and flushes
+
     CKBOOL m_DerivationMasksUpToDate;
 
     int m_NbFlagsDefined;
@@ -302,6 +339,9 @@ protected:
 
 private:
     CKBOOL GetParameterGuidParentGuid(CKGUID child, CKGUID &parent);
+    CK_PARAMETEROPERATION ResolveOperationFunction(CKGUID operation, CKGUID type_paramres, CKGUID type_param1, CKGUID type_param2);
+    void FlushOperationFunctionCache();
+    void FreeRetiredOperationFunctionCaches();
     void UpdateDerivationTables();
     void RecurseDeleteParam(TreeCell *cell, CKGUID param);
     int DichotomicSearch(int start, int end, TreeCell *tab, CKGUID key);
@@ -104,6 +104,9 @@ public:
 
     DLL_EXPORT void Update();
 
+    // TRUE when the operation is deterministic and none of its inputs changed since the last execution
+    CKBOOL IsOutputUpToDate();
+
     //-------------------------------------------------------------------
 
     DLL_EXPORT CK_PARAMETEROPERATION GetOperationFunction();
@@ -153,6 +156,10 @@ protected:
     CKGUID m_OperationGuid;
     CK_PARAMETEROPERATION m_OperationFunction;
     CKBOOL m_HasOperationFunction;
+    // Value versions of the inputs and output at the last execution, 0 if not executed
+    CKParameterVersion m_In1Version;
+    CKParameterVersion m_In2Version;
+    CKParameterVersion m_OutVersion;
     static CKSTRING m_In1Name;
     static CKSTRING m_In2Name;
     static CKSTRING m_OutName;
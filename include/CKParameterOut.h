@@ -108,6 +108,8 @@ public:
     void Update();
 
 protected:
+    void UnlinkDestinations();
+
     XSObjectPointerArray m_Destinations;
 };
 
@@ -8,6 +8,9 @@
 typedef XHashTable<CKSceneObjectDesc, CK_ID> CKSODHash;
 typedef CKSODHash::Iterator CKSODHashIt;
 
+class CKSceneObjectSnapshot;
+typedef XHashTable<CKSceneObjectSnapshot *, CK_ID> CKSceneSnapshotHash;
+
 /*************************************************
 Summary: Iterators on objects in a scene.
 
@@ -107,6 +110,7 @@ See also:CKLevel::LaunchScene
 class CKScene : public CKBeObject
 {
     friend class CKSceneObject;
+    friend class CKObjectManager;
 
 public:
     //-----------------------------------------------------------
@@ -244,6 +248,11 @@ public:
     DLL_EXPORT CKSceneObjectDesc *AddObjectDesc(CKSceneObject *o);
 
 protected:
+    // Initial value reset {Secret}
+    void ResetObject(CKObject *obj, CKSceneObjectDesc *desc);
+    void RemoveResetSnapshot(CK_ID id);
+    void ClearResetSnapshots();
+
     int m_SceneGlobalIndex;
     CKSODHash m_SceneObjects;
     CKDWORD m_EnvironmentSettings;
@@ -262,6 +271,7 @@ protected:
     XObjectArray m_AddObjectList;
     XObjectArray m_RemoveObjectList;
     XObjectPointerArray m_ObjectList;
+    CKSceneSnapshotHash m_ResetSnapshots; // Decoded initial values, by object
 };
 
 #endif // CKSCENE_H
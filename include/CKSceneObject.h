@@ -22,6 +22,8 @@ See also: CKBeObject, CKScene
 *************************************************/
 class DLL_EXPORT CKSceneObject : public CKObject
 {
+    friend class CKObjectManager;
+
 public:
     //----------------------------------------------------------
     // Scene Activity
@@ -24,6 +24,7 @@ struct ChunkIteratorData
     int NbEntries;
     CKDependenciesContext *DepContext;
     CKContext *Context;
+    CKBOOL DryRun; // Only count the values that would change, do not write them
 
     ChunkIteratorData() {
         memset(this, 0, sizeof(ChunkIteratorData));
@@ -35,6 +36,7 @@ struct ChunkIteratorData
         NbEntries = it->NbEntries;
         DepContext = it->DepContext;
         Context = it->Context;
+        DryRun = it->DryRun;
     }
 };
 
@@ -208,6 +210,7 @@ public:
     void StartRead();
     void StartWrite();
     void CheckSize(int size);
+    void Reserve(int dwords); // Ensures dwords more DWORDs can be written without reallocation
     void CloseChunk();
 
     void Clear();
@@ -358,6 +361,13 @@ public:
     // Buffer must be allocated by user (call  ConvertToBuffer(NULL) to get the size of the buffer needed
     int ConvertToBuffer(void *buffer);
     CKBOOL ConvertFromBuffer(void *buffer);
+    // With borrow = TRUE the chunk points straight into buffer (CHNK_DONTDELETE_PTR) instead of
+    // copying it. The buffer must outlive the chunk or MakeOwned() must be called before it goes away.
+    CKBOOL ConvertFromBuffer(void *buffer, CKBOOL borrow);
+
+    CKBOOL IsBorrowed() { return (m_Options & CHNK_DONTDELETE_PTR) != 0; }
+    // Copies a borrowed buffer so that the chunk owns its data (copy-on-write)
+    void MakeOwned();
 
     void *LockWriteBuffer(int DwordCount);
     void *LockReadBuffer();
@@ -388,6 +398,8 @@ public:
     static int ParameterRemapper(ChunkIteratorData *it);
 
 private:
+    void Reallocate(int newSize);
+
     int m_ChunkClassID;
     int m_ChunkSize;
     int *m_Data;
@@ -399,6 +411,7 @@ private:
     IntListStruct *m_Managers;
     CKFile *m_File;
     CKBOOL m_Dynamic;
+    CKDWORD m_Options;
 
     static XObjectPointerArray m_TempXOPA;
     static XObjectArray m_TempXOA;
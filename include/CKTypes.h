@@ -56,6 +56,7 @@ typedef int CKOperationType;
 typedef int CKMessageType;
 typedef int CKAttributeType;
 typedef int CKAttributeCategory;
+typedef uint64_t CKParameterVersion; // Stamp of a parameter value change, increasing over all the parameters
 
 //----------------------------------------------------------////
 //		Class  List											////
@@ -198,6 +199,12 @@ typedef struct CKStats
     int BehaviorDelayedLinks;  // Total number of BehaviorLinks that have been stored as active in N frame
 
     float UserProfiles[MAX_USER_PROFILE];
+
+    int OperationCacheHits;   // Parameter operation functions found in the parameter manager resolution cache
+    int OperationCacheMisses; // Parameter operation functions resolved through the operation tree
+
+    int MessagesAllocated;          // Messages taken from the message manager pool
+    int MessagePoolHeapAllocations; // Heap allocations made to grow the message pool (message slabs and parameter arrays)
 } CKStats;
 // Warning : Do not insert new values between existing ones CK_PROFILE_CATEGORY directly refers to this struct by indexes
 
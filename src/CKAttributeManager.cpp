@@ -6,11 +6,60 @@
 #include "CKPathManager.h"
 #include "CKPluginManager.h"
 #include "CKBeObject.h"
+#include "CKScene.h"
 #include "CKParameterManager.h"
 
 extern CKPluginManager g_ThePluginManager;
 extern CKPluginEntry *g_TheCurrentPluginEntry;
 
+// Attribute lists are unordered sets: an object is removed by moving the last
+// object of the list into its place, and slots keeps the position of every object.
+
+static CKBOOL AddToAttributeList(XObjectPointerArray &list, XAttributeListSlots &slots, CKObject *obj) {
+    CK_ID id = obj->GetID();
+    if (slots.FindPtr(id))
+        return FALSE;
+    slots.Insert(id, list.Size(), TRUE);
+    list.PushBack(obj);
+    return TRUE;
+}
+
+static CKBOOL RemoveFromAttributeList(XObjectPointerArray &list, XAttributeListSlots &slots, CKObject *obj) {
+    CK_ID id = obj->GetID();
+    int *slot = slots.FindPtr(id);
+    if (!slot)
+        return FALSE;
+    const int pos = *slot;
+    slots.Remove(id);
+
+    CKObject *last = list.PopBack();
+    if (pos < list.Size()) {
+        list[pos] = last;
+        slots.Insert(last->GetID(), pos, TRUE);
+    }
+    return TRUE;
+}
+
+static void ClearAttributeList(XObjectPointerArray &list, XAttributeListSlots &slots) {
+    list.Clear();
+    slots.Clear();
+}
+
+// TRUE if the object is in the global list of one of the attribute types
+static CKBOOL HasAnyAttribute(const XArray<CKAttributeDesc *> &descs, CK_ID id) {
+    for (int i = 0; i < descs.Size(); ++i) {
+        if (descs[i]->GlobalAttributeSlots.FindPtr(id))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+CKAttributeDesc::~CKAttributeDesc() {
+    delete AttributeSlots;
+    for (XHashTable<CKAttributeSceneList, CK_ID>::Iterator it = SceneLists.Begin(); it != SceneLists.End(); ++it)
+        delete (*it).Slots;
+}
+
 CKAttributeType CKAttributeManager::RegisterNewAttributeType(CKSTRING Name, CKGUID ParameterType,
                                                              CK_CLASSID CompatibleCid, CK_ATTRIBUT_FLAGS flags) {
     if (!Name)
@@ -20,15 +69,15 @@ CKAttributeType CKAttributeManager::RegisterNewAttributeType(CKSTRING Name, CKGU
     strncpy(secureName, Name, 63);
     secureName[63] = '\0';
 
+    CKAttributeType existing = FindName(m_AttributeNames, secureName, FALSE);
+    if (existing >= 0)
+        return existing;
+
     int freeSlot = -1;
     for (CKAttributeType i = 0; i < m_AttributeInfoCount; ++i) {
         if (!m_AttributeInfos[i]) {
-            if (freeSlot == -1) freeSlot = i;
-            continue;
-        }
-
-        if (strcmp(secureName, m_AttributeInfos[i]->Name) == 0) {
-            return i; // Return existing index
+            freeSlot = i;
+            break;
         }
     }
 
@@ -44,7 +93,7 @@ CKAttributeType CKAttributeManager::RegisterNewAttributeType(CKSTRING Name, CKGU
     }
 
     CKAttributeDesc *desc = new CKAttributeDesc();
-    memset(desc, 0, sizeof(CKAttributeDesc));
+    desc->AttributeSlots = new XAttributeListSlots;
 
     strncpy(desc->Name, secureName, sizeof(desc->Name) - 1);
     desc->Name[sizeof(desc->Name) - 1] = '\0';
@@ -67,6 +116,7 @@ CKAttributeType CKAttributeManager::RegisterNewAttributeType(CKSTRING Name, CKGU
     desc->CreatorDll = nullptr;
 
     m_AttributeInfos[freeSlot] = desc;
+    m_AttributeNames.Add(desc->Name, freeSlot);
     return freeSlot;
 }
 
@@ -89,6 +139,7 @@ void CKAttributeManager::UnRegisterAttribute(CKAttributeType AttribType) {
             return;
     }
 
+    m_AttributeNames.Remove(attrDesc->Name, AttribType);
     delete[] attrDesc->DefaultValue;
     attrDesc->DefaultValue = nullptr;
 
@@ -121,16 +172,7 @@ CKAttributeType CKAttributeManager::GetAttributeTypeByName(CKSTRING AttribName)
     strncpy(secureName, AttribName, 63);
     secureName[63] = '\0';
 
-    for (CKAttributeType i = 0; i < m_AttributeInfoCount; ++i) {
-        if (!m_AttributeInfos[i])
-            continue;
-
-        if (strcmp(secureName, m_AttributeInfos[i]->Name) == 0) {
-            return i;
-        }
-    }
-
-    return -1;
+    return FindName(m_AttributeNames, secureName, FALSE);
 }
 
 void CKAttributeManager::SetAttributeNameByType(CKAttributeType AttribType, CKSTRING name) {
@@ -140,8 +182,10 @@ void CKAttributeManager::SetAttributeNameByType(CKAttributeType AttribType, CKST
     if (!desc)
         return;
 
+    m_AttributeNames.Remove(desc->Name, AttribType);
     strncpy(desc->Name, name, sizeof(desc->Name) - 1);
     desc->Name[sizeof(desc->Name) - 1] = '\0';
+    m_AttributeNames.Add(desc->Name, AttribType);
 }
 
 int CKAttributeManager::GetAttributeCount() {
@@ -324,6 +368,102 @@ const XObjectPointerArray &CKAttributeManager::FillListByGlobalAttributes(CKAttr
     return m_AttributeList;
 }
 
+int CKAttributeManager::QueryObjectsByAttributes(XObjectPointerArray &Result, CKAttributeType *ListAttrib, int AttribCount,
+                                                 CK_ATTRIBUT_QUERY Query, CKAttributeType *ExcludedAttrib, int ExcludedCount,
+                                                 CK_CLASSID Cid, CKBOOL Derived, CKBOOL Global) {
+    Result.Resize(0);
+    if (!ListAttrib || AttribCount <= 0 || !m_AttributeInfos)
+        return 0;
+
+    const CKBOOL all = (Query == CK_ATTRIBUT_QUERY_ALL);
+    XArray<CKAttributeDesc *> descs;
+    for (int i = 0; i < AttribCount; ++i) {
+        CKAttributeType attrType = ListAttrib[i];
+        CKAttributeDesc *desc = (attrType >= 0 && attrType < m_AttributeInfoCount) ? m_AttributeInfos[attrType] : nullptr;
+        if (desc)
+            descs.PushBack(desc);
+        else if (all)
+            return 0;
+    }
+    if (descs.Size() == 0)
+        return 0;
+
+    XArray<CKAttributeDesc *> excluded;
+    for (int i = 0; ExcludedAttrib && i < ExcludedCount; ++i) {
+        CKAttributeType attrType = ExcludedAttrib[i];
+        CKAttributeDesc *desc = (attrType >= 0 && attrType < m_AttributeInfoCount) ? m_AttributeInfos[attrType] : nullptr;
+        if (desc)
+            excluded.PushBack(desc);
+    }
+
+    // Objects having all the types are among the ones of the shortest list
+    int first = 0;
+    int last = descs.Size();
+    if (all) {
+        for (int i = 1; i < descs.Size(); ++i) {
+            if (descs[i]->GlobalAttributeList.Size() < descs[first]->GlobalAttributeList.Size())
+                first = i;
+        }
+        last = first + 1;
+    }
+
+    // The candidates are marked in a bitset over the IDs they span, which gives
+    // each object once, in ID order
+    CK_ID maxId = 0;
+    for (int i = first; i < last; ++i) {
+        const XObjectPointerArray &list = descs[i]->GlobalAttributeList;
+        for (int j = 0; j < list.Size(); ++j)
+            maxId = XMax(maxId, list[j]->GetID());
+    }
+    XArray<CKDWORD> bits;
+    bits.Resize((int) (maxId >> 5) + 1);
+    memset(bits.Begin(), 0, bits.Size() * sizeof(CKDWORD));
+    for (int i = first; i < last; ++i) {
+        const XObjectPointerArray &list = descs[i]->GlobalAttributeList;
+        for (int j = 0; j < list.Size(); ++j) {
+            const CK_ID id = list[j]->GetID();
+            if (all) {
+                CKBOOL everyType = TRUE;
+                for (int d = 0; d < descs.Size() && everyType; ++d)
+                    everyType = (d == first) || descs[d]->GlobalAttributeSlots.FindPtr(id) != nullptr;
+                if (!everyType)
+                    continue;
+            }
+            if (HasAnyAttribute(excluded, id))
+                continue;
+            bits[id >> 5] |= 1u << (id & 31);
+        }
+    }
+
+    // As GetAttributeListPtr, only the objects of the active scene unless there is none
+    const CKBOOL sceneLists = !Global && GetListScene();
+    for (int w = 0; w < bits.Size(); ++w) {
+        CKDWORD word = bits[w];
+        for (CK_ID id = (CK_ID) w << 5; word; ++id, word >>= 1) {
+            if (!(word & 1))
+                continue;
+            CKObject *obj = m_Context->GetObject(id);
+            if (!obj)
+                continue;
+            if (Derived ? !CKIsChildClassOf(obj, Cid) : obj->GetClassID() != Cid)
+                continue;
+            if (sceneLists) {
+                // An object of the scene is in the scene list of each of its attribute
+                // types, so with CK_ATTRIBUT_QUERY_ALL the first list is enough
+                CKBOOL inScene = FALSE;
+                const int checked = all ? 1 : descs.Size();
+                for (int d = 0; d < checked && !inScene; ++d)
+                    inScene = descs[d]->AttributeSlots->FindPtr(id) != nullptr;
+                if (!inScene)
+                    continue;
+            }
+            Result.PushBack(obj);
+        }
+    }
+
+    return Result.Size();
+}
+
 int CKAttributeManager::GetCategoriesCount() {
     return m_AttributeCategoryCount;
 }
@@ -343,13 +483,7 @@ CKAttributeCategory CKAttributeManager::GetCategoryByName(CKSTRING Name) {
     if (m_AttributeCategoryCount <= 0)
         return -1;
 
-    for (int i = 0; i < m_AttributeCategoryCount; ++i) {
-        CKAttributeCategoryDesc *desc = m_AttributeCategories[i];
-        if (desc && strcmp(Name, desc->Name) == 0) {
-            return i;
-        }
-    }
-    return -1;
+    return FindName(m_CategoryNames, Name, TRUE);
 }
 
 void CKAttributeManager::SetCategoryName(CKAttributeCategory catType, CKSTRING name) {
@@ -361,10 +495,12 @@ void CKAttributeManager::SetCategoryName(CKAttributeCategory catType, CKSTRING n
         return;
 
     if (desc->Name) {
+        m_CategoryNames.Remove(desc->Name, catType);
         delete[] desc->Name;
     }
     desc->Name = new char[strlen(name) + 1];
     strcpy(desc->Name, name);
+    m_CategoryNames.Add(desc->Name, catType);
 }
 
 CKAttributeCategory CKAttributeManager::AddCategory(CKSTRING Category, CKDWORD flags) {
@@ -388,6 +524,7 @@ CKAttributeCategory CKAttributeManager::AddCategory(CKSTRING Category, CKDWORD f
     newDesc->Flags = flags;
 
     m_AttributeCategories[m_AttributeCategoryCount] = newDesc;
+    m_CategoryNames.Add(newDesc->Name, m_AttributeCategoryCount);
     return m_AttributeCategoryCount++;
 }
 
@@ -434,6 +571,32 @@ void CKAttributeManager::RemoveCategory(CKSTRING Category) {
     delete[] m_AttributeCategories;
     m_AttributeCategories = newCategories;
     m_AttributeCategoryCount = newCount;
+
+    // The following categories moved down by one
+    RebuildCategoryNames();
+}
+
+int CKAttributeManager::FindName(CKNameIndex &names, CKSTRING name, CKBOOL categories) {
+    XArray<int> *indices = names.Find(name);
+    if (!indices)
+        return -1;
+
+    // A name used twice resolves to the first one
+    for (XArray<int>::Iterator it = indices->Begin(); it != indices->End(); ++it) {
+        CKSTRING entryName = categories ? m_AttributeCategories[*it]->Name : m_AttributeInfos[*it]->Name;
+        if (strcmp(name, entryName) == 0)
+            return *it;
+    }
+    return -1;
+}
+
+void CKAttributeManager::RebuildCategoryNames() {
+    m_CategoryNames.Clear();
+    for (int i = 0; i < m_AttributeCategoryCount; ++i) {
+        CKAttributeCategoryDesc *desc = m_AttributeCategories[i];
+        if (desc && desc->Name)
+            m_CategoryNames.Add(desc->Name, i);
+    }
 }
 
 CKDWORD CKAttributeManager::GetCategoryFlags(CKAttributeCategory cat) {
@@ -493,13 +656,18 @@ void CKAttributeManager::AddAttributeToObject(CKAttributeType AttribType, CKBeOb
         return;
 
     CKAttributeDesc *desc = m_AttributeInfos[AttribType];
-    CKScene *currentScene = m_Context->GetCurrentScene();
+    CKScene *listScene = GetListScene();
 
-    if (beo->IsInScene(currentScene) || beo->IsPrivate()) {
-        desc->AttributeList.AddIfNotHere(beo);
+    if (beo->IsInScene(listScene) || beo->IsPrivate()) {
+        AddToAttributeList(desc->AttributeList, *desc->AttributeSlots, beo);
+    }
+    for (int i = 0; i < m_CachedScenes.Size(); ++i) {
+        CKScene *scene = (CKScene *) m_Context->GetObject(m_CachedScenes[i]);
+        if (scene)
+            UpdateAttributeList(desc, beo, scene);
     }
 
-    if (desc->GlobalAttributeList.AddIfNotHere(beo)) {
+    if (AddToAttributeList(desc->GlobalAttributeList, desc->GlobalAttributeSlots, beo)) {
         if (desc->CallbackFct) {
             desc->CallbackFct(AttribType, TRUE, beo, desc->CallbackArg);
         }
@@ -512,8 +680,13 @@ void CKAttributeManager::RemoveAttributeFromObject(CKAttributeType AttribType, C
 
     CKAttributeDesc *desc = m_AttributeInfos[AttribType];
     if (desc) {
-        desc->AttributeList.Remove(beo);
-        if (desc->GlobalAttributeList.Remove(beo)) {
+        RemoveFromAttributeList(desc->AttributeList, *desc->AttributeSlots, beo);
+        for (int i = 0; i < m_CachedScenes.Size(); ++i) {
+            CKAttributeSceneList *sceneList = desc->SceneLists.FindPtr(m_CachedScenes[i]);
+            if (sceneList)
+                RemoveFromAttributeList(sceneList->Objects, *sceneList->Slots, beo);
+        }
+        if (RemoveFromAttributeList(desc->GlobalAttributeList, desc->GlobalAttributeSlots, beo)) {
             if (desc->CallbackFct) {
                 desc->CallbackFct(AttribType, FALSE, beo, desc->CallbackArg);
             }
@@ -525,7 +698,7 @@ void CKAttributeManager::RefreshList(CKObject *obj, CKScene *scene) {
     if (!obj || !scene || !m_AttributeInfos)
         return;
 
-    if (CKIsChildClassOf(obj, CKCID_BEOBJECT) && scene == m_Context->GetCurrentScene()) {
+    if (CKIsChildClassOf(obj, CKCID_BEOBJECT)) {
         CKBeObject *beo = (CKBeObject *) obj;
         const int count = beo->GetAttributeCount();
         for (int i = 0; i < count; ++i) {
@@ -533,7 +706,7 @@ void CKAttributeManager::RefreshList(CKObject *obj, CKScene *scene) {
             if (type >= 0 && type < m_AttributeInfoCount) {
                 CKAttributeDesc *desc = m_AttributeInfos[type];
                 if (desc)
-                    desc->AttributeList.AddIfNotHere(beo);
+                    UpdateAttributeList(desc, beo, scene);
             }
         }
     }
@@ -551,60 +724,103 @@ CKPluginEntry *CKAttributeManager::GetCreatorDll(int pos) {
 }
 
 void CKAttributeManager::NewActiveScene(CKScene *scene) {
+    const CK_ID sceneId = scene ? scene->GetID() : 0;
+    if (m_ActiveScene != 0 && m_ActiveScene == sceneId)
+        return;
+
+    // The lists of the previous scene are kept up to date while it is inactive,
+    // so switching back to it only swaps them in
+    const CK_ID previousScene = m_ActiveScene;
     for (int i = 0; i < m_AttributeInfoCount; ++i) {
         CKAttributeDesc *desc = m_AttributeInfos[i];
         if (!desc)
             continue;
 
-        desc->AttributeList.Clear();
+        if (previousScene != 0) {
+            CKAttributeSceneList &previousList = *desc->SceneLists.InsertUnique(previousScene, CKAttributeSceneList());
+            previousList.Objects.Swap(desc->AttributeList);
+            previousList.Slots = desc->AttributeSlots;
+            desc->AttributeSlots = nullptr;
+        } else {
+            ClearAttributeList(desc->AttributeList, *desc->AttributeSlots);
+        }
+
+        CKAttributeSceneList *sceneList = scene ? desc->SceneLists.FindPtr(sceneId) : nullptr;
+        if (sceneList) {
+            desc->AttributeList.Swap(sceneList->Objects);
+            desc->AttributeSlots = sceneList->Slots;
+            desc->SceneLists.Remove(sceneId);
+            continue;
+        }
+
+        if (!desc->AttributeSlots)
+            desc->AttributeSlots = new XAttributeListSlots;
         if (scene) {
             for (auto it = desc->GlobalAttributeList.Begin(); it != desc->GlobalAttributeList.End(); ++it) {
                 CKBeObject *beo = (CKBeObject *) *it;
                 if (beo && (beo->IsInScene(scene) || beo->IsPrivate())) {
-                    desc->AttributeList.PushBack(beo);
+                    AddToAttributeList(desc->AttributeList, *desc->AttributeSlots, beo);
                 }
             }
         }
     }
+
+    if (previousScene != 0)
+        m_CachedScenes.AddIfNotHere(previousScene);
+    m_CachedScenes.Remove(sceneId);
+    m_ActiveScene = sceneId;
 }
 
 void CKAttributeManager::ObjectAddedToScene(CKBeObject *beo, CKScene *scene) {
     if (!beo || !scene)
         return;
 
-    if (m_Context->GetCurrentScene() == scene) {
-        const int count = beo->GetAttributeCount();
-        for (CKAttributeType i = 0; i < count; ++i) {
-            CKAttributeType type = beo->GetAttributeType(i);
-            if (type != -1) {
-                CKAttributeDesc *desc = m_AttributeInfos[type];
-                if (desc)
-                    desc->AttributeList.AddIfNotHere(beo);
-            }
-        }
-    }
+    RefreshList(beo, scene);
 }
 
 void CKAttributeManager::ObjectRemovedFromScene(CKBeObject *beo, CKScene *scene) {
     if (!beo || !scene)
         return;
 
-    CKScene *currentScene = m_Context->GetCurrentScene();
-    if (currentScene != scene)
-        return;
+    RefreshList(beo, scene);
+}
 
-    const int attributeCount = beo->GetAttributeCount();
-    for (int i = 0; i < attributeCount; ++i) {
-        CKAttributeType attrType = beo->GetAttributeType(i);
-        if (attrType < 0 || attrType >= m_AttributeInfoCount)
-            continue;
+CKScene *CKAttributeManager::GetListScene() {
+    if (m_ActiveScene != 0)
+        return (CKScene *) m_Context->GetObject(m_ActiveScene);
+    return m_Context->GetCurrentScene();
+}
 
-        CKAttributeDesc *attrDesc = m_AttributeInfos[attrType];
-        if (!attrDesc)
-            continue;
+void CKAttributeManager::UpdateAttributeList(CKAttributeDesc *desc, CKBeObject *beo, CKScene *scene) {
+    const CKBOOL inList = beo->IsInScene(scene) || beo->IsPrivate();
+    if (scene == GetListScene()) {
+        if (inList)
+            AddToAttributeList(desc->AttributeList, *desc->AttributeSlots, beo);
+        else
+            RemoveFromAttributeList(desc->AttributeList, *desc->AttributeSlots, beo);
+    }
+
+    CKAttributeSceneList *sceneList = desc->SceneLists.FindPtr(scene->GetID());
+    if (sceneList) {
+        if (inList)
+            AddToAttributeList(sceneList->Objects, *sceneList->Slots, beo);
+        else
+            RemoveFromAttributeList(sceneList->Objects, *sceneList->Slots, beo);
+    }
+}
 
-        attrDesc->AttributeList.Remove(beo);
+void CKAttributeManager::DropSceneLists(CK_ID scene) {
+    for (int i = 0; i < m_AttributeInfoCount; ++i) {
+        CKAttributeDesc *desc = m_AttributeInfos[i];
+        if (!desc)
+            continue;
+        CKAttributeSceneList *sceneList = desc->SceneLists.FindPtr(scene);
+        if (sceneList) {
+            delete sceneList->Slots;
+            desc->SceneLists.Remove(scene);
+        }
     }
+    m_CachedScenes.Remove(scene);
 }
 
 void CKAttributeManager::PatchRemapBeObjectFileChunk(CKStateChunk *chunk) {
@@ -628,6 +844,7 @@ CKAttributeManager::CKAttributeManager(CKContext *Context): CKBaseManager(
     m_ConversionTableCount = 0;
     m_ConversionTable = nullptr;
     m_Saving = FALSE;
+    m_ActiveScene = 0;
     m_Context->RegisterNewManager(this);
 }
 
@@ -661,12 +878,16 @@ CKAttributeManager::~CKAttributeManager() {
 
     m_AttributeList.Clear();
     m_AttributeMask.Clear();
+    m_AttributeNames.Clear();
+    m_CategoryNames.Clear();
 }
 
 CKERROR CKAttributeManager::PreClearAll() {
     delete[] m_ConversionTable;
     m_ConversionTable = nullptr;
     m_ConversionTableCount = 0;
+    m_ActiveScene = 0;
+    m_CachedScenes.Clear();
 
     for (int i = 0; i < m_AttributeInfoCount; ++i) {
         CKAttributeDesc *desc = m_AttributeInfos[i];
@@ -683,10 +904,14 @@ CKERROR CKAttributeManager::PreClearAll() {
             }
         }
 
-        desc->AttributeList.Clear();
-        desc->GlobalAttributeList.Clear();
+        ClearAttributeList(desc->AttributeList, *desc->AttributeSlots);
+        ClearAttributeList(desc->GlobalAttributeList, desc->GlobalAttributeSlots);
+        for (XHashTable<CKAttributeSceneList, CK_ID>::Iterator it = desc->SceneLists.Begin(); it != desc->SceneLists.End(); ++it)
+            delete (*it).Slots;
+        desc->SceneLists.Clear();
 
         if (!(desc->Flags & CK_ATTRIBUT_SYSTEM)) {
+            m_AttributeNames.Remove(desc->Name, i);
             delete[] desc->DefaultValue;
             delete desc;
             m_AttributeInfos[i] = nullptr;
@@ -939,3 +1164,16 @@ CKERROR CKAttributeManager::SequenceRemovedFromScene(CKScene *scn, CK_ID *objid,
     }
     return CK_OK;
 }
+
+CKERROR CKAttributeManager::SequenceToBeDeleted(CK_ID *objids, int count) {
+    if (m_CachedScenes.Size() == 0 && m_ActiveScene == 0)
+        return CK_OK;
+
+    for (int i = 0; i < count; ++i) {
+        if (objids[i] == m_ActiveScene)
+            m_ActiveScene = 0;
+        if (m_CachedScenes.IsHere(objids[i]))
+            DropSceneLists(objids[i]);
+    }
+    return CK_OK;
+}
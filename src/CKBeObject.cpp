@@ -8,6 +8,7 @@
 #include "CKGroup.h"
 #include "CKParameterOut.h"
 #include "CKMessage.h"
+#include "CKMessageManager.h"
 
 extern CKBOOL WarningForOlderVersion;
 
@@ -15,7 +16,7 @@ CK_CLASSID CKBeObject::m_ClassID = CKCID_BEOBJECT;
 
 void CKBeObject::ExecuteBehaviors(float delta) {
     if (m_Context->IsProfilingEnable()) {
-        ++m_Context->m_Stats.ActiveObjectsExecuted;
+        ++CKBehaviorManager::GetThreadStats(m_Context).ActiveObjectsExecuted;
         ResetExecutionTime();
     }
 
@@ -34,7 +35,11 @@ void CKBeObject::ExecuteBehaviors(float delta) {
     }
 
     if (!executed) {
-        if (GetClassID() != CKCID_CHARACTER)
+        // Worker threads leave the manager tables alone, see CKBehaviorManager::MergeThreadState
+        CKBehaviorThreadState *threadState = CKBehaviorManager::GetThreadState();
+        if (threadState)
+            threadState->IdleObjects.PushBack(this);
+        else if (GetClassID() != CKCID_CHARACTER)
             m_Context->GetBehaviorManager()->RemoveObjectNextFrame(this);
     }
 }
@@ -195,6 +200,7 @@ CKERROR CKBeObject::AddScript(CKBehavior *script) {
 
     // Add script to array
     m_ScriptArray->PushBack(script);
+    CKBehaviorManager::InvalidateIsolation(m_Context);
 
     // Maintain script order
     SortScripts();
@@ -238,6 +244,7 @@ CKBehavior *CKBeObject::RemoveScript(int pos) {
         RemoveFromSelfScenes(script);
 
     m_ScriptArray->RemoveAt(pos);
+    CKBehaviorManager::InvalidateIsolation(m_Context);
     if (m_ScriptArray->IsEmpty()) {
         delete m_ScriptArray;
         m_ScriptArray = nullptr;
@@ -286,12 +293,15 @@ CKMessage *CKBeObject::GetLastFrameMessage(int pos) {
 }
 
 void CKBeObject::SetAsWaitingForMessages(CKBOOL wait) {
+    const CKBOOL waiting = IsWaitingForMessages();
     if (wait) {
         ++m_Waiting;
     } else {
         --m_Waiting;
         if (m_Waiting < 0) m_Waiting = 0;
     }
+    if (waiting != IsWaitingForMessages())
+        m_Context->GetMessageManager()->WaitingObjectChanged(this);
 }
 
 CKBOOL CKBeObject::IsWaitingForMessages() {
@@ -322,6 +332,7 @@ void CKBeObject::ApplyPatchForOlderVersion(int NbObject, CKFileObject *FileObjec
         if (script && !(script->GetFlags() & CKBEHAVIOR_SCRIPT)) {
             WarningForOlderVersion = TRUE;
             it = m_ScriptArray->Remove(it);
+            CKBehaviorManager::InvalidateIsolation(m_Context);
         } else {
             ++it;
         }
@@ -334,6 +345,7 @@ CKBeObject::CKBeObject() : CKSceneObject(::GetCKContext(0), nullptr) {
     m_Waiting = 0;
     m_LastExecutionTime = 0.0f;
     m_Priority = 0;
+    m_MessageFrame = 0;
 }
 
 CKBeObject::CKBeObject(CKContext *Context, CKSTRING name) : CKSceneObject(Context, name) {
@@ -342,6 +354,7 @@ CKBeObject::CKBeObject(CKContext *Context, CKSTRING name) : CKSceneObject(Contex
     m_Waiting = 0;
     m_LastExecutionTime = 0.0f;
     m_Priority = 0;
+    m_MessageFrame = 0;
 }
 
 CKBeObject::~CKBeObject() {
@@ -477,6 +490,7 @@ CKERROR CKBeObject::Load(CKStateChunk *chunk, CKFile *file) {
 
     CKContext *context = m_Context;
     CKAttributeManager *am = context->GetAttributeManager();
+    const CKBOOL waiting = IsWaitingForMessages();
 
     if (file) {
         // Cleanup existing scripts
@@ -484,6 +498,7 @@ CKERROR CKBeObject::Load(CKStateChunk *chunk, CKFile *file) {
             delete m_ScriptArray;
             m_ScriptArray = nullptr;
         }
+        CKBehaviorManager::InvalidateIsolation(context);
 
         if (chunk->GetDataVersion() < 5 && chunk->SeekIdentifier(CK_STATESAVE_BEHAVIORS)) {
             if (!m_ScriptArray) {
@@ -514,6 +529,8 @@ CKERROR CKBeObject::Load(CKStateChunk *chunk, CKFile *file) {
                 m_Priority = 0;
                 m_Waiting = FALSE;
             }
+            if (waiting)
+                context->GetMessageManager()->WaitingObjectChanged(this);
         }
     } else {
         if (chunk->SeekIdentifier(CK_STATESAVE_DATAS)) {
@@ -740,6 +757,7 @@ CKERROR CKBeObject::RemapDependencies(CKDependenciesContext &context) {
     CKDWORD classDeps = context.GetClassDependencies(m_ClassID);
     if (classDeps & 1) {
         if (m_ScriptArray) m_ScriptArray->Remap(context);
+        CKBehaviorManager::InvalidateIsolation(m_Context);
     }
     if (classDeps & 2) {
         for (XAttributeList::Iterator it = m_Attributes.Begin(); it != m_Attributes.End(); ++it) {
@@ -767,6 +785,7 @@ CKERROR CKBeObject::Copy(CKObject &o, CKDependenciesContext &context) {
             return removeErr;
 
         // Copy scripts from source
+        CKBehaviorManager::InvalidateIsolation(m_Context);
         if (beo->m_ScriptArray && beo->m_ScriptArray->Size() > 0) {
             m_ScriptArray = new XObjectPointerArray();
             if (!m_ScriptArray)
@@ -4,6 +4,7 @@
 #include "CKBehaviorLink.h"
 #include "CKBehaviorPrototype.h"
 #include "CKBeObject.h"
+#include "CKBehaviorManager.h"
 #include "CKScene.h"
 #include "CKFile.h"
 #include "CKParameter.h"
@@ -20,9 +21,28 @@
 #include <excpt.h>
 #endif
 
-static CKBehaviorIO **g_IosToDeactivate = nullptr;
-static CKBehaviorIO **g_IosToActivate = nullptr;
-static int g_IosBufferCapacity = 0;
+// Scratch buffers of CheckIOsActivation and BuildBehaviorIterators. There is one
+// set per thread as isolated scripts may run on behavior worker threads.
+struct BehaviorScratchBuffers
+{
+    CKBehaviorIO **IosToDeactivate;
+    CKBehaviorIO **IosToActivate;
+    int IosBufferCapacity;
+    int *IteratorRanks;
+    int IteratorRanksCapacity;
+
+    BehaviorScratchBuffers()
+        : IosToDeactivate(nullptr), IosToActivate(nullptr), IosBufferCapacity(0),
+          IteratorRanks(nullptr), IteratorRanksCapacity(0) {}
+
+    ~BehaviorScratchBuffers() {
+        delete[] IosToDeactivate;
+        delete[] IosToActivate;
+        delete[] IteratorRanks;
+    }
+};
+
+static thread_local BehaviorScratchBuffers g_Scratch;
 
 static void AppendErrorText(char *buffer, size_t bufferSize, size_t *used, const char *fmt, ...) {
     if (!buffer || !used || !fmt || *used >= bufferSize - 1)
@@ -48,16 +68,25 @@ static void AppendErrorText(char *buffer, size_t bufferSize, size_t *used, const
     }
 }
 
+static void EnsureRankBuffer(int neededCount) {
+    if (neededCount <= g_Scratch.IteratorRanksCapacity)
+        return;
+
+    delete[] g_Scratch.IteratorRanks;
+    g_Scratch.IteratorRanks = new int[neededCount];
+    g_Scratch.IteratorRanksCapacity = neededCount;
+}
+
 static void EnsureIoBuffers(int neededCount) {
-    if (neededCount <= g_IosBufferCapacity)
+    if (neededCount <= g_Scratch.IosBufferCapacity)
         return;
 
-    delete[] g_IosToDeactivate;
-    delete[] g_IosToActivate;
+    delete[] g_Scratch.IosToDeactivate;
+    delete[] g_Scratch.IosToActivate;
 
-    g_IosToDeactivate = new CKBehaviorIO *[neededCount];
-    g_IosToActivate = new CKBehaviorIO *[neededCount];
-    g_IosBufferCapacity = neededCount;
+    g_Scratch.IosToDeactivate = new CKBehaviorIO *[neededCount];
+    g_Scratch.IosToActivate = new CKBehaviorIO *[neededCount];
+    g_Scratch.IosBufferCapacity = neededCount;
 }
 
 CK_CLASSID CKBehavior::m_ClassID = CKCID_BEHAVIOR;
@@ -92,7 +121,12 @@ void CKBehavior::SetType(CK_BEHAVIOR_TYPE type) {
 }
 
 void CKBehavior::SetFlags(CK_BEHAVIOR_FLAGS flags) {
+    const CKDWORD oldFlags = m_Flags;
     m_Flags = flags;
+    if (m_Flags & ~oldFlags & CKBEHAVIOR_ACTIVE)
+        QueueInParentGraph();
+    if ((m_Flags ^ oldFlags) & (CKBEHAVIOR_ISOLATED | CKBEHAVIOR_SCRIPT))
+        CKBehaviorManager::InvalidateIsolation(m_Context);
 }
 
 CK_BEHAVIOR_FLAGS CKBehavior::GetFlags() {
@@ -100,7 +134,12 @@ CK_BEHAVIOR_FLAGS CKBehavior::GetFlags() {
 }
 
 CK_BEHAVIOR_FLAGS CKBehavior::ModifyFlags(CKDWORD Add, CKDWORD Remove) {
+    const CKDWORD oldFlags = m_Flags;
     m_Flags = (m_Flags | Add) & ~Remove;
+    if (m_Flags & ~oldFlags & CKBEHAVIOR_ACTIVE)
+        QueueInParentGraph();
+    if ((m_Flags ^ oldFlags) & (CKBEHAVIOR_ISOLATED | CKBEHAVIOR_SCRIPT))
+        CKBehaviorManager::InvalidateIsolation(m_Context);
     return (CK_BEHAVIOR_FLAGS) m_Flags;
 }
 
@@ -307,13 +346,13 @@ int CKBehavior::CallCallbackFunction(CKDWORD Message) {
         return CK_OK;
 
     // Prepare context for callback
-    CKContext *context = m_Context;
-    context->m_BehaviorContext.CallbackArg = blockData->m_CallbackArg;
-    context->m_BehaviorContext.CallbackMessage = Message;
-    context->m_BehaviorContext.Behavior = this;
+    CKBehaviorContext &behContext = CKBehaviorManager::GetThreadBehaviorContext(m_Context);
+    behContext.CallbackArg = blockData->m_CallbackArg;
+    behContext.CallbackMessage = Message;
+    behContext.Behavior = this;
 
     // Execute the callback with prepared context
-    return blockData->m_Callback(context->m_BehaviorContext);
+    return blockData->m_Callback(behContext);
 }
 
 int CKBehavior::CallSubBehaviorsCallbackFunction(CKDWORD Message, CKGUID *behguid) {
@@ -346,13 +385,19 @@ int CKBehavior::Execute(float delta) {
 
     VxTimeProfiler profiler;
 
+    // Inside a parallel frame the manager is shared: use this thread's state
     CKBehaviorManager *behaviorManager = m_Context->GetBehaviorManager();
-    behaviorManager->m_CurrentBehavior = this;
-    ++m_Context->m_Stats.BehaviorsExecuted;
+    CKBehaviorThreadState *threadState = CKBehaviorManager::GetThreadState();
+    CKBehavior *&currentBehavior = threadState ? threadState->CurrentBehavior : behaviorManager->m_CurrentBehavior;
+    currentBehavior = this;
+    ++CKBehaviorManager::GetThreadStats(m_Context).BehaviorsExecuted;
 
     if ((m_Flags & CKBEHAVIOR_EXECUTEDLASTFRAME) == 0) {
         m_Flags |= CKBEHAVIOR_EXECUTEDLASTFRAME;
-        behaviorManager->m_Behaviors.PushBack(this);
+        if (threadState)
+            threadState->ExecutedBehaviors.PushBack(this);
+        else
+            behaviorManager->m_Behaviors.PushBack(this);
     }
 
     if ((m_Flags & CKBEHAVIOR_USEFUNCTION) != 0) {
@@ -378,13 +423,13 @@ int CKBehavior::Execute(float delta) {
 
             subBehavior->Execute(delta);
 
-            behaviorManager->m_CurrentBehavior = this;
+            currentBehavior = this;
             FindNextBehaviorsToExecute(subBehavior);
         }
         CheckBehaviorActivity();
     }
 
-    behaviorManager->m_CurrentBehavior = nullptr;
+    currentBehavior = nullptr;
 
     if (m_Context->m_ProfilingEnabled) {
         m_LastExecutionTime += profiler.Current();
@@ -1176,10 +1221,14 @@ CKBOOL CKBehavior::IsLocalParameterSetting(int pos) {
 void CKBehavior::Activate(CKBOOL Active, CKBOOL breset) {
     if (breset || m_Flags == CKBEHAVIOR_NONE)
         Reset();
-    if (Active)
-        m_Flags |= CKBEHAVIOR_ACTIVE;
-    else
+    if (Active) {
+        if (!(m_Flags & CKBEHAVIOR_ACTIVE)) {
+            m_Flags |= CKBEHAVIOR_ACTIVE;
+            QueueInParentGraph();
+        }
+    } else {
         m_Flags &= ~CKBEHAVIOR_ACTIVE;
+    }
 }
 
 CKERROR CKBehavior::AddSubBehavior(CKBehavior *cbk) {
@@ -1215,6 +1264,7 @@ CKERROR CKBehavior::AddSubBehavior(CKBehavior *cbk) {
 
     m_GraphData->m_SubBehaviors.AddIfNotHere(cbk);
     m_GraphData->m_SubBehaviors.Sort(BehaviorPrioritySort);
+    InvalidateActivationQueue();
 
     if (!cbk->m_InputTargetParam && CKIsChildClassOf(cbk->GetCompatibleClassID(), m_CompatibleClassID)) {
         SetCompatibleClassID(cbk->GetCompatibleClassID());
@@ -1242,6 +1292,7 @@ CKBehavior *CKBehavior::RemoveSubBehavior(int pos) {
 
     CKBehavior *removed = (CKBehavior *) subBehaviors[pos];
     subBehaviors.RemoveAt(pos);
+    InvalidateActivationQueue();
     removed->m_Flags |= CKBEHAVIOR_TOPMOST;
     removed->SetParent(nullptr);
 
@@ -1284,8 +1335,11 @@ int CKBehavior::GetSubBehaviorCount() {
 CKERROR CKBehavior::AddSubBehaviorLink(CKBehaviorLink *cbkl) {
     if (!m_GraphData || !cbkl)
         return CKERR_INVALIDPARAMETER;
-    cbkl->SetOldFlags(cbkl->GetOldFlags() & ~CKBL_OLD_IN_DELAYED_LIST);
+    cbkl->SetOldFlags((cbkl->GetOldFlags() & ~CKBL_OLD_IN_DELAYED_LIST) | CKBL_OLD_IN_GRAPH);
     m_GraphData->m_SubBehaviorLinks.AddIfNotHere(cbkl);
+    CKBehaviorIO *inIO = cbkl->GetInBehaviorIO();
+    if (inIO && inIO->IsActive())
+        inIO->QueueActivation();
     return CK_OK;
 }
 
@@ -1295,6 +1349,7 @@ CKBehaviorLink *CKBehavior::RemoveSubBehaviorLink(CKBehaviorLink *cbkl) {
     if (!m_GraphData->m_SubBehaviorLinks.Remove(cbkl))
         return nullptr;
     m_GraphData->m_Links.Remove(cbkl);
+    cbkl->ClearOldFlag(CKBL_OLD_IN_GRAPH);
     return cbkl;
 }
 
@@ -1309,6 +1364,8 @@ CKBehaviorLink *CKBehavior::RemoveSubBehaviorLink(int pos) {
     CKBehaviorLink *plink = (CKBehaviorLink *) subBehaviorLinks[pos];
     subBehaviorLinks.RemoveAt(pos);
     m_GraphData->m_Links.Remove(plink);
+    if (plink)
+        plink->ClearOldFlag(CKBL_OLD_IN_GRAPH);
     return plink;
 }
 
@@ -1735,6 +1792,9 @@ CKERROR CKBehavior::Load(CKStateChunk *chunk, CKFile *file) {
     // Load base object data
     CKObject::Load(chunk, file);
 
+    // The flags are read below without going through SetFlags
+    CKBehaviorManager::InvalidateIsolation(m_Context);
+
     if (!file) {
         // Load sub-behaviors when not in file context
         if (chunk->SeekIdentifier(CK_STATESAVE_BEHAVIORSUBBEHAV)) {
@@ -1934,6 +1994,7 @@ CKERROR CKBehavior::Load(CKStateChunk *chunk, CKFile *file) {
 }
 
 void CKBehavior::PostLoad() {
+    InvalidateActivationQueue();
     if ((m_Flags & (CKBEHAVIOR_SCRIPT | CKBEHAVIOR_TOPMOST)) != 0)
         HierarchyPostLoad();
     CKObject::PostLoad();
@@ -1948,8 +2009,10 @@ void CKBehavior::PreDelete() {
     } else {
         CKBehavior *parent = GetParent();
         if (parent && !parent->IsToBeDeleted()) {
-            if (parent->m_GraphData)
+            if (parent->m_GraphData) {
                 parent->m_GraphData->m_SubBehaviors.Remove(this);
+                parent->InvalidateActivationQueue();
+            }
         }
     }
 }
@@ -1969,6 +2032,9 @@ int CKBehavior::GetMemoryOccupation() {
         size += m_GraphData->m_SubBehaviors.GetMemoryOccupation(FALSE);
         size += m_GraphData->m_SubBehaviorLinks.GetMemoryOccupation(FALSE);
         size += m_GraphData->m_Links.GetMemoryOccupation(FALSE);
+        size += m_GraphData->m_PendingIOs.GetMemoryOccupation(FALSE);
+        size += m_GraphData->m_PendingSubBehaviors.GetMemoryOccupation(FALSE);
+        size += m_GraphData->m_TriggeredLinks.GetMemoryOccupation(FALSE);
         if (m_GraphData->m_BehaviorIterators) {
             size += (int) (m_GraphData->m_BehaviorIteratorCount * sizeof(*m_GraphData->m_BehaviorIterators));
         }
@@ -2104,6 +2170,7 @@ CKERROR CKBehavior::RemapDependencies(CKDependenciesContext &context) {
         m_GraphData->m_SubBehaviors.Remap(context);
         m_GraphData->m_Operations.Remap(context);
         m_GraphData->m_Links.Remap(context);
+        InvalidateActivationQueue();
     }
 
     // Remap interface chunk if needed
@@ -2135,6 +2202,7 @@ CKERROR CKBehavior::Copy(CKObject &o, CKDependenciesContext &context) {
     m_CompatibleClassID = src->m_CompatibleClassID;
     m_Priority = src->m_Priority;
     m_Flags = src->m_Flags & ~(CKBEHAVIOR_RESERVED0 | CKBEHAVIOR_EXECUTEDLASTFRAME);
+    CKBehaviorManager::InvalidateIsolation(m_Context);
 
     // Handle BehaviorBlockData
     delete m_BlockData;
@@ -2362,8 +2430,10 @@ void CKBehavior::SetParent(CKBehavior *parent) {
 }
 
 void CKBehavior::SortSubs() {
-    if (m_GraphData)
+    if (m_GraphData) {
         m_GraphData->m_SubBehaviors.Sort(BehaviorPrioritySort);
+        InvalidateActivationQueue();
+    }
 }
 
 void CKBehavior::ResetExecutionTime() {
@@ -2388,7 +2458,7 @@ void CKBehavior::ExecuteStepStart() {
         behManager->m_Behaviors.PushBack(this);
     }
 
-    ++m_Context->m_Stats.BehaviorsExecuted;
+    ++CKBehaviorManager::GetThreadStats(m_Context).BehaviorsExecuted;
 
     VxTimeProfiler profiler;
 
@@ -2487,51 +2557,87 @@ void CKBehavior::CheckIOsActivation() {
     if (!m_GraphData)
         return;
 
+    BehaviorGraphData *graph = m_GraphData;
+    CKStats &stats = CKBehaviorManager::GetThreadStats(m_Context);
     int deactivateCount = 0;
     int activateCount = 0;
 
-    const int linkCount = m_GraphData->m_SubBehaviorLinks.Size();
-    if (linkCount > 0) {
-        EnsureIoBuffers(linkCount);
+    if (graph->m_FullScan) {
+        // The queue is not trusted (new, loaded or edited graph): visit every link once
+        graph->m_PendingIOs.Resize(0);
+        graph->m_TriggeredLinks.Resize(0);
 
-        for (int idx = 0; idx < linkCount; ++idx) {
-            ++m_Context->m_Stats.BehaviorLinksParsed;
+        const int linkCount = graph->m_SubBehaviorLinks.Size();
+        if (linkCount > 0) {
+            EnsureIoBuffers(linkCount);
 
-            CKBehaviorLink *link = (CKBehaviorLink *)m_GraphData->m_SubBehaviorLinks[idx];
-            CKBehaviorIO *inIO = link ? link->GetInBehaviorIO() : nullptr;
+            for (int idx = 0; idx < linkCount; ++idx) {
+                ++stats.BehaviorLinksParsed;
+
+                CKBehaviorLink *link = (CKBehaviorLink *)graph->m_SubBehaviorLinks[idx];
+                if (!link)
+                    continue;
+
+                link->SetOldFlags((link->GetOldFlags() & ~CKBL_OLD_TRIGGERED_THIS_FRAME) | CKBL_OLD_IN_GRAPH);
+
+                CKBehaviorIO *inIO = link->GetInBehaviorIO();
+                if (inIO && inIO->IsActive()) {
+                    g_Scratch.IosToDeactivate[deactivateCount++] = inIO;
+                    g_Scratch.IosToActivate[activateCount++] = TriggerLink(link);
+                }
+            }
+        }
+    } else {
+        for (XObjectPointerArray::Iterator it = graph->m_TriggeredLinks.Begin(); it != graph->m_TriggeredLinks.End(); ++it) {
+            CKBehaviorLink *link = (CKBehaviorLink *)*it;
             if (link)
-                link->SetOldFlags(link->GetOldFlags() & ~CKBL_OLD_TRIGGERED_THIS_FRAME);
+                link->ClearOldFlag(CKBL_OLD_TRIGGERED_THIS_FRAME);
+        }
+        graph->m_TriggeredLinks.Resize(0);
 
-            if (inIO && inIO->IsActive()) {
-                g_IosToDeactivate[deactivateCount++] = inIO;
+        XObjectPointerArray pendingIOs;
+        pendingIOs.Swap(graph->m_PendingIOs);
 
-                const int initialDelay = link->GetInitialActivationDelay();
-                link->SetOldFlags(link->GetOldFlags() | CKBL_OLD_TRIGGERED_THIS_FRAME);
+        int linkCount = 0;
+        for (XObjectPointerArray::Iterator it = pendingIOs.Begin(); it != pendingIOs.End(); ++it) {
+            CKBehaviorIO *io = (CKBehaviorIO *)*it;
+            if (io && io->IsActive())
+                linkCount += io->m_Links.Size();
+        }
+        if (linkCount > 0)
+            EnsureIoBuffers(linkCount);
 
-                if (initialDelay) {
-                    if (link->GetActivationDelay() == 0)
-                        link->SetActivationDelay(initialDelay);
+        // Sources and destinations of a graph's links never overlap, so an
+        // input can be released as soon as its links have been followed.
+        for (XObjectPointerArray::Iterator it = pendingIOs.Begin(); it != pendingIOs.End(); ++it) {
+            CKBehaviorIO *io = (CKBehaviorIO *)*it;
+            if (!io || !io->IsActive())
+                continue;
 
-                    if ((link->GetOldFlags() & CKBL_OLD_IN_DELAYED_LIST) == 0) {
-                        link->SetOldFlags(link->GetOldFlags() | CKBL_OLD_IN_DELAYED_LIST);
-                        m_GraphData->m_Links.PushBack(link);
-                        ++m_Context->m_Stats.BehaviorDelayedLinks;
-                    }
-                } else {
-                    g_IosToActivate[activateCount++] = link->GetOutBehaviorIO();
-                }
+            CKBOOL linked = FALSE;
+            for (XObjectPointerArray::Iterator linkIt = io->m_Links.Begin(); linkIt != io->m_Links.End(); ++linkIt) {
+                CKBehaviorLink *link = (CKBehaviorLink *)*linkIt;
+                if (!link || !link->HasOldFlag(CKBL_OLD_IN_GRAPH))
+                    continue;
+
+                ++stats.BehaviorLinksParsed;
+                linked = TRUE;
+                g_Scratch.IosToActivate[activateCount++] = TriggerLink(link);
             }
+
+            if (linked)
+                io->Activate(FALSE);
         }
     }
 
     for (int i = 0; i < deactivateCount; ++i) {
-        CKBehaviorIO *io = g_IosToDeactivate[i];
+        CKBehaviorIO *io = g_Scratch.IosToDeactivate[i];
         if (io)
             io->Activate(FALSE);
     }
 
     for (int i = 0; i < activateCount; ++i) {
-        CKBehaviorIO *io = g_IosToActivate[i];
+        CKBehaviorIO *io = g_Scratch.IosToActivate[i];
         if (!io)
             continue;
 
@@ -2543,23 +2649,130 @@ void CKBehavior::CheckIOsActivation() {
         }
     }
 
-    m_GraphData->m_BehaviorIteratorIndex = 0;
-    const int subBehaviorCount = m_GraphData->m_SubBehaviors.Size();
-    if (subBehaviorCount > m_GraphData->m_BehaviorIteratorCount) {
-        delete[] m_GraphData->m_BehaviorIterators;
-        m_GraphData->m_BehaviorIterators = new CKBehavior *[subBehaviorCount];
-        m_GraphData->m_BehaviorIteratorCount = (CKWORD)subBehaviorCount;
+    BuildBehaviorIterators();
+    graph->m_FullScan = FALSE;
+}
+
+// Returns the IO to activate now, or nullptr when the link is delayed
+CKBehaviorIO *CKBehavior::TriggerLink(CKBehaviorLink *link) {
+    MarkLinkTriggered(link);
+
+    const int initialDelay = link->GetInitialActivationDelay();
+    if (!initialDelay)
+        return link->GetOutBehaviorIO();
+
+    if (link->GetActivationDelay() == 0)
+        link->SetActivationDelay(initialDelay);
+
+    if ((link->GetOldFlags() & CKBL_OLD_IN_DELAYED_LIST) == 0) {
+        link->SetOldFlags(link->GetOldFlags() | CKBL_OLD_IN_DELAYED_LIST);
+        m_GraphData->m_Links.PushBack(link);
+        ++CKBehaviorManager::GetThreadStats(m_Context).BehaviorDelayedLinks;
+    }
+    return nullptr;
+}
+
+void CKBehavior::MarkLinkTriggered(CKBehaviorLink *link) {
+    if (!link->HasOldFlag(CKBL_OLD_TRIGGERED_THIS_FRAME)) {
+        link->SetOldFlag(CKBL_OLD_TRIGGERED_THIS_FRAME);
+        m_GraphData->m_TriggeredLinks.PushBack(link);
+    }
+}
+
+// Fills m_BehaviorIterators with the active sub-behaviors, the first one in
+// m_SubBehaviors order on top.
+void CKBehavior::BuildBehaviorIterators() {
+    BehaviorGraphData *graph = m_GraphData;
+
+    // Sub-behaviors left over from an interrupted frame are still candidates
+    XObjectPointerArray &candidates = graph->m_PendingSubBehaviors;
+    for (int i = 0; i < graph->m_BehaviorIteratorIndex; ++i)
+        candidates.PushBack(graph->m_BehaviorIterators[i]);
+    graph->m_BehaviorIteratorIndex = 0;
+
+    const int subBehaviorCount = graph->m_SubBehaviors.Size();
+    if (subBehaviorCount > graph->m_BehaviorIteratorCount) {
+        delete[] graph->m_BehaviorIterators;
+        graph->m_BehaviorIterators = new CKBehavior *[subBehaviorCount];
+        graph->m_BehaviorIteratorCount = (CKWORD)subBehaviorCount;
     }
 
-    for (int k = subBehaviorCount - 1; k >= 0; --k) {
-        CKBehavior *subBeh = (CKBehavior *)m_GraphData->m_SubBehaviors[k];
-        if (subBeh != this) {
-            if (subBeh && subBeh->IsActive()) {
-                subBeh->ModifyFlags(CKBEHAVIOR_RESERVED0, 0);
-                m_GraphData->m_BehaviorIterators[m_GraphData->m_BehaviorIteratorIndex++] = subBeh;
+    if (graph->m_FullScan || candidates.Size() * 4 > subBehaviorCount) {
+        if (graph->m_FullScan) {
+            graph->m_SubBehaviorRanks.Clear();
+            for (int k = 0; k < subBehaviorCount; ++k) {
+                CKBehavior *subBeh = (CKBehavior *)graph->m_SubBehaviors[k];
+                if (subBeh)
+                    graph->m_SubBehaviorRanks.InsertUnique(subBeh->GetID(), k);
             }
         }
+
+        for (int k = subBehaviorCount - 1; k >= 0; --k) {
+            CKBehavior *subBeh = (CKBehavior *)graph->m_SubBehaviors[k];
+            if (subBeh != this) {
+                if (subBeh && subBeh->IsActive()) {
+                    subBeh->ModifyFlags(CKBEHAVIOR_RESERVED0, 0);
+                    graph->m_BehaviorIterators[graph->m_BehaviorIteratorIndex++] = subBeh;
+                }
+            }
+        }
+        candidates.Resize(0);
+        return;
+    }
+
+    // Few candidates: insert them by decreasing rank, which gives the same
+    // order as the scan above without visiting idle sub-behaviors.
+    EnsureRankBuffer(candidates.Size());
+    int count = 0;
+    for (XObjectPointerArray::Iterator it = candidates.Begin(); it != candidates.End(); ++it) {
+        CKBehavior *subBeh = (CKBehavior *)*it;
+        if (!subBeh || subBeh == this || !subBeh->IsActive())
+            continue;
+
+        int *rank = graph->m_SubBehaviorRanks.FindPtr(subBeh->GetID());
+        if (!rank)
+            continue;
+
+        int pos = count;
+        while (pos > 0 && g_Scratch.IteratorRanks[pos - 1] < *rank)
+            --pos;
+        if (pos > 0 && g_Scratch.IteratorRanks[pos - 1] == *rank)
+            continue; // Already queued
+
+        for (int i = count; i > pos; --i) {
+            graph->m_BehaviorIterators[i] = graph->m_BehaviorIterators[i - 1];
+            g_Scratch.IteratorRanks[i] = g_Scratch.IteratorRanks[i - 1];
+        }
+        graph->m_BehaviorIterators[pos] = subBeh;
+        g_Scratch.IteratorRanks[pos] = *rank;
+        ++count;
     }
+    candidates.Resize(0);
+
+    for (int i = 0; i < count; ++i)
+        graph->m_BehaviorIterators[i]->ModifyFlags(CKBEHAVIOR_RESERVED0, 0);
+    graph->m_BehaviorIteratorIndex = (CKWORD)count;
+}
+
+void CKBehavior::InvalidateActivationQueue() {
+    if (!m_GraphData)
+        return;
+
+    m_GraphData->m_FullScan = TRUE;
+    m_GraphData->m_PendingIOs.Clear();
+    m_GraphData->m_PendingSubBehaviors.Clear();
+    m_GraphData->m_TriggeredLinks.Clear();
+}
+
+// Records that this behavior became active so its parent graph picks it up
+// without scanning all of its sub-behaviors.
+void CKBehavior::QueueInParentGraph() {
+    if (!m_BehParent)
+        return;
+
+    CKBehavior *parent = GetParent();
+    if (parent && parent->m_GraphData && !parent->m_GraphData->m_FullScan)
+        parent->m_GraphData->m_PendingSubBehaviors.PushBack(this);
 }
 
 void CKBehavior::CheckBehaviorActivity() {
@@ -2570,7 +2783,7 @@ void CKBehavior::CheckBehaviorActivity() {
         if (!link)
             continue;
 
-        link->SetOldFlags(link->GetOldFlags() | CKBL_OLD_TRIGGERED_THIS_FRAME);
+        MarkLinkTriggered(link);
         link->SetActivationDelay(link->GetActivationDelay() - 1);
 
         if (link->GetActivationDelay() > 0) {
@@ -2624,8 +2837,10 @@ int CKBehavior::ExecuteFunction() {
     if (!m_BlockData || !m_BlockData->m_Function)
         return CKBR_GENERICERROR;
 
-    m_Context->m_Stats.BuildingBlockExecuted++;
-    m_Context->m_BehaviorContext.Behavior = this;
+    CKStats &stats = CKBehaviorManager::GetThreadStats(m_Context);
+    CKBehaviorContext &behContext = CKBehaviorManager::GetThreadBehaviorContext(m_Context);
+    stats.BuildingBlockExecuted++;
+    behContext.Behavior = this;
 
     int result = 0;
 
@@ -2635,7 +2850,7 @@ int CKBehavior::ExecuteFunction() {
         bool callSucceeded = false;
 
         __try {
-            result = m_BlockData->m_Function(m_Context->m_BehaviorContext);
+            result = m_BlockData->m_Function(behContext);
             callSucceeded = true;
         } __except (EXCEPTION_EXECUTE_HANDLER) {
             ErrorMessage("Error", "Execution", 1, 1);
@@ -2643,11 +2858,11 @@ int CKBehavior::ExecuteFunction() {
         }
 
         if (callSucceeded) {
-            m_Context->m_Stats.BehaviorCodeExecution += profiler.Current();
+            stats.BehaviorCodeExecution += profiler.Current();
         }
     } else {
         __try {
-            result = m_BlockData->m_Function(m_Context->m_BehaviorContext);
+            result = m_BlockData->m_Function(behContext);
         } __except (EXCEPTION_EXECUTE_HANDLER) {
             ErrorMessage("Error", "Execution", 1, 1);
             result = CKBR_OK;
@@ -2656,10 +2871,10 @@ int CKBehavior::ExecuteFunction() {
 #else
     if (m_Context->m_ProfilingEnabled) {
         VxTimeProfiler profiler;
-        result = m_BlockData->m_Function(m_Context->m_BehaviorContext);
-        m_Context->m_Stats.BehaviorCodeExecution += profiler.Current();
+        result = m_BlockData->m_Function(behContext);
+        stats.BehaviorCodeExecution += profiler.Current();
     } else {
-        result = m_BlockData->m_Function(m_Context->m_BehaviorContext);
+        result = m_BlockData->m_Function(behContext);
     }
 #endif
 
@@ -2674,6 +2889,10 @@ void CKBehavior::FindNextBehaviorsToExecute(CKBehavior *beh) {
     if (!beh || !m_GraphData)
         return;
 
+    // Still active after executing: it will be a candidate again next frame
+    if (!m_GraphData->m_FullScan && beh->IsActive())
+        m_GraphData->m_PendingSubBehaviors.PushBack(beh);
+
     for (XObjectPointerArray::Iterator outIt = beh->m_OutputArray.Begin(); outIt != beh->m_OutputArray.End(); ++outIt) {
         CKBehaviorIO *outIO = (CKBehaviorIO *)*outIt;
         if (!outIO)
@@ -2689,7 +2908,7 @@ void CKBehavior::FindNextBehaviorsToExecute(CKBehavior *beh) {
             if (!link)
                 continue;
 
-            link->SetOldFlags(link->GetOldFlags() | CKBL_OLD_TRIGGERED_THIS_FRAME);
+            MarkLinkTriggered(link);
 
             const int initialDelay = link->GetInitialActivationDelay();
             const CKDWORD oldFlags = link->GetOldFlags();
@@ -2701,7 +2920,7 @@ void CKBehavior::FindNextBehaviorsToExecute(CKBehavior *beh) {
                 if ((oldFlags & 1u) == 0) {
                     link->SetOldFlags(oldFlags | CKBL_OLD_IN_DELAYED_LIST);
                     m_GraphData->m_Links.PushBack(link);
-                    ++m_Context->m_Stats.BehaviorDelayedLinks;
+                    ++CKBehaviorManager::GetThreadStats(m_Context).BehaviorDelayedLinks;
                 }
             } else {
                 CKBehaviorIO *dstIO = link->GetOutBehaviorIO();
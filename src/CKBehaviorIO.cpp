@@ -61,6 +61,8 @@ void CKBehaviorIO::PreDelete() {
             }
         }
 
+        owner->InvalidateActivationQueue();
+
         BehaviorGraphData *graph = owner->m_GraphData;
         if (graph) {
             for (int i = 0; i < graph->m_SubBehaviorLinks.Size(); ++i) {
@@ -74,6 +76,8 @@ void CKBehaviorIO::PreDelete() {
 
         CKBehavior *parent = owner->GetParent();
         if (parent) {
+            parent->InvalidateActivationQueue();
+
             BehaviorGraphData *parentGraph = parent->m_GraphData;
             if (parentGraph) {
                 for (int i = 0; i < parentGraph->m_SubBehaviorLinks.Size(); ++i) {
@@ -128,7 +132,7 @@ CKSTRING CKBehaviorIO::GetDependencies(int i, int mode) {
 }
 
 void CKBehaviorIO::Register() {
-    CKCLASSDEFAULTOPTIONS(CKBehaviorIO, CK_DEPENDENCIES_COPY);
+    CKCLASSDEFAULTOPTIONS(CKBehaviorIO, CK_DEPENDENCIES_COPY | CK_GENERALOPTIONS_SAVETHREADSAFE);
 }
 
 CKBehaviorIO *CKBehaviorIO::CreateInstance(CKContext *Context) {
@@ -139,7 +143,20 @@ void CKBehaviorIO::SetOldFlags(CKDWORD flags) {
     m_ObjectFlags &= ~CK_OBJECT_IOMASK;
     if (flags & 0x01) m_ObjectFlags |= CK_BEHAVIORIO_IN;
     if (flags & 0x02) m_ObjectFlags |= CK_BEHAVIORIO_OUT;
-    if (flags & 0x100) m_ObjectFlags |= CK_BEHAVIORIO_ACTIVE;
+    if (flags & 0x100) {
+        m_ObjectFlags |= CK_BEHAVIORIO_ACTIVE;
+        QueueActivation();
+    }
+}
+
+void CKBehaviorIO::QueueActivation() {
+    if (!m_OwnerBehavior || m_Links.Size() == 0)
+        return;
+
+    // Links leaving an input are inside its behavior, links leaving an output are in the parent graph
+    CKBehavior *graph = (m_ObjectFlags & CK_BEHAVIORIO_IN) ? m_OwnerBehavior : m_OwnerBehavior->GetParent();
+    if (graph && graph->m_GraphData && !graph->m_GraphData->m_FullScan)
+        graph->m_GraphData->m_PendingIOs.PushBack(this);
 }
 
 CKDWORD CKBehaviorIO::GetOldFlags() {
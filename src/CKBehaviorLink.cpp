@@ -15,6 +15,9 @@ CKERROR CKBehaviorLink::SetInBehaviorIO(CKBehaviorIO *ckbioin) {
     }
     m_InIO = ckbioin;
     m_InIO->m_Links.AddIfNotHere(this);
+    // An input that is already active must still be seen by the graph through this link
+    if (m_InIO->IsActive())
+        m_InIO->QueueActivation();
     return CK_OK;
 }
 
@@ -97,8 +100,11 @@ CKERROR CKBehaviorLink::Load(CKStateChunk *chunk, CKFile *file) {
 }
 
 void CKBehaviorLink::PostLoad() {
-    if (m_InIO)
+    if (m_InIO) {
         m_InIO->m_Links.AddIfNotHere(this);
+        if (m_InIO->IsActive())
+            m_InIO->QueueActivation();
+    }
 
     CKObject::PostLoad();
 }
@@ -115,6 +121,11 @@ void CKBehaviorLink::PreDelete() {
             if (owner->m_GraphData) {
                 owner->m_GraphData->m_SubBehaviorLinks.Remove(this);
             }
+            // Either graph may still hold this link in its activation queue
+            owner->InvalidateActivationQueue();
+            CKBehavior *parent = owner->GetParent();
+            if (parent && !parent->IsToBeDeleted())
+                parent->InvalidateActivationQueue();
         }
     }
 }
@@ -149,7 +160,7 @@ CKERROR CKBehaviorLink::Copy(CKObject &o, CKDependenciesContext &context) {
         return err;
 
     CKBehaviorLink *link = (CKBehaviorLink *)&o;
-    m_OldFlags = link->m_OldFlags & ~CKBL_OLD_IN_DELAYED_LIST;
+    m_OldFlags = link->m_OldFlags & ~(CKBL_OLD_IN_DELAYED_LIST | CKBL_OLD_IN_GRAPH);
     m_ActivationDelay = link->m_ActivationDelay;
     m_InitialActivationDelay = link->m_InitialActivationDelay;
     m_InIO = link->m_InIO;
@@ -170,7 +181,7 @@ CKSTRING CKBehaviorLink::GetDependencies(int i, int mode) {
 }
 
 void CKBehaviorLink::Register() {
-    CKCLASSDEFAULTOPTIONS(CKBehaviorLink, CK_DEPENDENCIES_COPY);
+    CKCLASSDEFAULTOPTIONS(CKBehaviorLink, CK_DEPENDENCIES_COPY | CK_GENERALOPTIONS_SAVETHREADSAFE);
 }
 
 CKBehaviorLink *CKBehaviorLink::CreateInstance(CKContext *Context) {
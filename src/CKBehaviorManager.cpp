@@ -5,9 +5,134 @@
 #include "CKStateChunk.h"
 #include "CKCharacter.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+static thread_local CKBehaviorThreadState *g_ThreadState = nullptr;
+
+// Persistent threads executing the isolated objects of a frame. Each participant
+// (the thread calling Run is participant 0) owns a contiguous slice of the objects
+// and steals from the other slices once its own one is exhausted.
+class CKBehaviorWorkerPool
+{
+public:
+    CKBehaviorWorkerPool(CKBehaviorManager *manager, int threadCount);
+    ~CKBehaviorWorkerPool();
+
+    void Run(XObjectPointerArray &objects, float delta);
+
+private:
+    struct Slice
+    {
+        std::atomic<int> Next;
+        int End;
+        CKBehaviorThreadState State;
+
+        Slice() : Next(0), End(0) {}
+    };
+
+    void WorkerLoop(int index);
+    void Work(int index);
+
+    CKBehaviorManager *m_Manager;
+    int m_ThreadCount;
+    Slice *m_Slices;
+    std::thread *m_Threads;
+    std::mutex m_Mutex;
+    std::condition_variable m_StartCondition;
+    std::condition_variable m_DoneCondition;
+    int m_Generation;
+    int m_Running;
+    bool m_Stop;
+    XObjectPointerArray *m_Objects;
+    float m_Delta;
+};
+
+CKBehaviorWorkerPool::CKBehaviorWorkerPool(CKBehaviorManager *manager, int threadCount)
+    : m_Manager(manager), m_ThreadCount(threadCount), m_Generation(0), m_Running(0), m_Stop(false),
+      m_Objects(nullptr), m_Delta(0.0f) {
+    m_Slices = new Slice[m_ThreadCount];
+    m_Threads = new std::thread[m_ThreadCount - 1];
+    for (int i = 1; i < m_ThreadCount; ++i)
+        m_Threads[i - 1] = std::thread(&CKBehaviorWorkerPool::WorkerLoop, this, i);
+}
+
+CKBehaviorWorkerPool::~CKBehaviorWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_StartCondition.notify_all();
+    for (int i = 0; i < m_ThreadCount - 1; ++i)
+        m_Threads[i].join();
+    delete[] m_Threads;
+    delete[] m_Slices;
+}
+
+void CKBehaviorWorkerPool::Run(XObjectPointerArray &objects, float delta) {
+    const int count = objects.Size();
+    for (int i = 0; i < m_ThreadCount; ++i) {
+        Slice &slice = m_Slices[i];
+        slice.Next.store(count * i / m_ThreadCount, std::memory_order_relaxed);
+        slice.End = count * (i + 1) / m_ThreadCount;
+        slice.State.BehaviorContext = m_Manager->m_Context->m_BehaviorContext;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Objects = &objects;
+        m_Delta = delta;
+        m_Running = m_ThreadCount - 1;
+        ++m_Generation;
+    }
+    m_StartCondition.notify_all();
+
+    Work(0);
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_DoneCondition.wait(lock, [this] { return m_Running == 0; });
+    }
+
+    // Merged in participant order so that the main thread sees the same lists
+    // whatever the interleaving was
+    for (int i = 0; i < m_ThreadCount; ++i)
+        m_Manager->MergeThreadState(m_Slices[i].State);
+}
+
+void CKBehaviorWorkerPool::WorkerLoop(int index) {
+    int generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_StartCondition.wait(lock, [&] { return m_Stop || m_Generation != generation; });
+            if (m_Stop)
+                return;
+            generation = m_Generation;
+        }
+
+        Work(index);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (--m_Running == 0)
+            m_DoneCondition.notify_one();
+    }
+}
+
+void CKBehaviorWorkerPool::Work(int index) {
+    g_ThreadState = &m_Slices[index].State;
+    for (int i = 0; i < m_ThreadCount; ++i) {
+        Slice &slice = m_Slices[(index + i) % m_ThreadCount];
+        for (int pos = slice.Next.fetch_add(1); pos < slice.End; pos = slice.Next.fetch_add(1))
+            m_Manager->ExecuteObject((CKBeObject *) m_Objects->GetObject(pos), m_Delta);
+    }
+    g_ThreadState = nullptr;
+}
+
 CKERROR CKBehaviorManager::Execute(float delta) {
     VxTimeProfiler totalProfiler;
-    VxTimeProfiler behaviorProfiler;
 
     // Setup execution context
     m_Context->m_DeferDestroyObjects = TRUE;
@@ -37,36 +162,32 @@ CKERROR CKBehaviorManager::Execute(float delta) {
         }
     }
 
-    // Main execution loop
-    for (XObjectPointerArray::Iterator it = m_BeObjects.Begin(); it != m_BeObjects.End(); ++it) {
-        CKBeObject *obj = (CKBeObject *)*it;
-        if (!obj) continue;
-
-        if (m_Context->m_ProfilingEnabled) {
-            behaviorProfiler.Reset();
-        }
-
-        // Special handling for characters
-        if (obj->GetClassID() == CKCID_CHARACTER) {
-            CKCharacter *character = (CKCharacter *) obj;
-            if (character->IsAutomaticProcess()) {
-                character->ProcessAnimation(delta);
+    // Main execution loop, in priority order. With a worker pool, each run of
+    // consecutive isolated objects is spread over the pool and finished before
+    // the next object starts. Running objects may change scripts, so the cache
+    // is checked again before each object.
+    for (int i = 0; i < m_BeObjects.Size();) {
+        if (m_WorkerPool) {
+            UpdateIsolatedCache();
+            if (m_IsolatedCache[i]) {
+                m_IsolatedObjects.Resize(0);
+                for (; i < m_BeObjects.Size() && m_IsolatedCache[i]; ++i)
+                    m_IsolatedObjects.PushBack(m_BeObjects[i]);
+
+                if (m_IsolatedObjects.Size() > 1)
+                    m_WorkerPool->Run(m_IsolatedObjects, delta);
+                else
+                    ExecuteObject((CKBeObject *) m_IsolatedObjects[0], delta);
+                continue;
             }
         }
 
-        // Execute object behaviors
-        float start = 0.0f;
-        if (m_Context->m_ProfilingEnabled)
-            start = behaviorProfiler.Current();
-
-        obj->ExecuteBehaviors(delta);
+        CKBeObject *obj = (CKBeObject *) m_BeObjects[i++];
+        if (!obj) continue;
 
-        if (m_Context->m_ProfilingEnabled) {
-            float elapsed = behaviorProfiler.Current() - start;
-            obj->m_LastExecutionTime += elapsed;
-            m_Context->m_Stats.BehaviorCodeExecution += elapsed;
-        }
+        ExecuteObject(obj, delta);
     }
+    m_IsolatedObjects.Resize(0);
 
     m_Context->m_Stats.TotalBehaviorExecution = totalProfiler.Current();
     m_Context->m_DeferDestroyObjects = FALSE;
@@ -97,6 +218,7 @@ void CKBehaviorManager::ManageObjectsActivity() {
         if (*it < 0) {
             beo->ResetExecutionTime();
             m_BeObjects.Remove(beo);
+            ++m_IsolationVersion;
         } else if (*it > 0 && m_BeObjects.AddIfNotHere(beo)) {
             changed = TRUE;
         }
@@ -108,6 +230,103 @@ void CKBehaviorManager::ManageObjectsActivity() {
     }
 }
 
+void CKBehaviorManager::InvalidateIsolation(CKContext *context) {
+    CKBehaviorManager *manager = context->m_BehaviorManager;
+    if (manager)
+        ++manager->m_IsolationVersion;
+}
+
+void CKBehaviorManager::UpdateIsolatedCache() {
+    if (m_IsolatedCacheVersion == m_IsolationVersion && m_IsolatedCache.Size() == m_BeObjects.Size())
+        return;
+
+    const int count = m_BeObjects.Size();
+    m_IsolatedCache.Resize(count);
+    for (int i = 0; i < count; ++i) {
+        CKBeObject *obj = (CKBeObject *) m_BeObjects[i];
+        m_IsolatedCache[i] = obj && IsIsolated(obj);
+    }
+    m_IsolatedCacheVersion = m_IsolationVersion;
+}
+
+CKBOOL CKBehaviorManager::IsIsolated(CKBeObject *beo) {
+    if (beo->GetClassID() == CKCID_CHARACTER)
+        return FALSE;
+
+    const int count = beo->GetScriptCount();
+    if (count == 0)
+        return FALSE;
+
+    for (int i = 0; i < count; ++i) {
+        CKBehavior *beh = beo->GetScript(i);
+        if (beh && !(beh->GetFlags() & CKBEHAVIOR_ISOLATED))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void CKBehaviorManager::ExecuteObject(CKBeObject *obj, float delta) {
+    VxTimeProfiler behaviorProfiler;
+
+    // Special handling for characters
+    if (obj->GetClassID() == CKCID_CHARACTER) {
+        CKCharacter *character = (CKCharacter *) obj;
+        if (character->IsAutomaticProcess()) {
+            character->ProcessAnimation(delta);
+        }
+    }
+
+    // Execute object behaviors
+    float start = 0.0f;
+    if (m_Context->m_ProfilingEnabled)
+        start = behaviorProfiler.Current();
+
+    obj->ExecuteBehaviors(delta);
+
+    if (m_Context->m_ProfilingEnabled) {
+        float elapsed = behaviorProfiler.Current() - start;
+        obj->m_LastExecutionTime += elapsed;
+        GetThreadStats(m_Context).BehaviorCodeExecution += elapsed;
+    }
+}
+
+void CKBehaviorManager::MergeThreadState(CKBehaviorThreadState &state) {
+    CKStats &stats = m_Context->m_Stats;
+    stats.ParametricOperations += state.Stats.ParametricOperations;
+    stats.BehaviorCodeExecution += state.Stats.BehaviorCodeExecution;
+    stats.ActiveObjectsExecuted += state.Stats.ActiveObjectsExecuted;
+    stats.BehaviorsExecuted += state.Stats.BehaviorsExecuted;
+    stats.BuildingBlockExecuted += state.Stats.BuildingBlockExecuted;
+    stats.BehaviorLinksParsed += state.Stats.BehaviorLinksParsed;
+    stats.BehaviorDelayedLinks += state.Stats.BehaviorDelayedLinks;
+    stats.OperationCacheHits += state.Stats.OperationCacheHits;
+    stats.OperationCacheMisses += state.Stats.OperationCacheMisses;
+    stats.MessagesAllocated += state.Stats.MessagesAllocated;
+    stats.MessagePoolHeapAllocations += state.Stats.MessagePoolHeapAllocations;
+    memset(&state.Stats, 0, sizeof(CKStats));
+
+    for (XObjectPointerArray::Iterator it = state.ExecutedBehaviors.Begin(); it != state.ExecutedBehaviors.End(); ++it)
+        m_Behaviors.PushBack(*it);
+    state.ExecutedBehaviors.Resize(0);
+
+    for (XObjectPointerArray::Iterator it = state.IdleObjects.Begin(); it != state.IdleObjects.End(); ++it)
+        RemoveObjectNextFrame((CKBeObject *) *it);
+    state.IdleObjects.Resize(0);
+    state.CurrentBehavior = nullptr;
+}
+
+CKBehaviorThreadState *CKBehaviorManager::GetThreadState() {
+    return g_ThreadState;
+}
+
+CKStats &CKBehaviorManager::GetThreadStats(CKContext *context) {
+    return g_ThreadState ? g_ThreadState->Stats : context->m_Stats;
+}
+
+CKBehaviorContext &CKBehaviorManager::GetThreadBehaviorContext(CKContext *context) {
+    return g_ThreadState ? g_ThreadState->BehaviorContext : context->m_BehaviorContext;
+}
+
 int CKBehaviorManager::GetObjectsCount() {
     return m_BeObjects.Size();
 }
@@ -130,10 +349,12 @@ CKERROR CKBehaviorManager::AddObject(CKBeObject *beo) {
 
 void CKBehaviorManager::SortObjects() {
     m_BeObjects.Sort(CKBeObject::BeObjectPrioritySort);
+    ++m_IsolationVersion;
 }
 
 int CKBehaviorManager::RemoveAllObjects() {
     m_BeObjects.Clear();
+    ++m_IsolationVersion;
     m_BeObjectNextFrame.Clear();
 
     for (XObjectPointerArray::Iterator it = m_Behaviors.Begin(); it != m_Behaviors.End(); ++it) {
@@ -153,6 +374,20 @@ void CKBehaviorManager::SetBehaviorMaxIteration(int n) {
     m_BehaviorMaxIteration = n;
 }
 
+void CKBehaviorManager::SetThreadCount(int count) {
+    count = (count > 1) ? count : 0;
+    if (count == m_ThreadCount)
+        return;
+
+    delete m_WorkerPool;
+    m_WorkerPool = (count > 1) ? new CKBehaviorWorkerPool(this, count) : nullptr;
+    m_ThreadCount = count;
+}
+
+int CKBehaviorManager::GetThreadCount() {
+    return m_ThreadCount;
+}
+
 int CKBehaviorManager::AddObjectNextFrame(CKBeObject *beo) {
     if (!beo)
         return CKERR_INVALIDOBJECT;
@@ -234,11 +469,14 @@ CKERROR CKBehaviorManager::SequenceDeleted(CK_ID *objids, int count) {
             it = m_BeObjectNextFrame.Remove(it);
         }
     }
+    // Deleted scripts were removed from their owners
+    ++m_IsolationVersion;
     return CK_OK;
 }
 
 CKERROR CKBehaviorManager::SequenceToBeDeleted(CK_ID *objids, int count) {
-    m_BeObjects.Check();
+    if (m_BeObjects.Check())
+        ++m_IsolationVersion;
     m_Behaviors.Check();
     return CK_OK;
 }
@@ -246,7 +484,13 @@ CKERROR CKBehaviorManager::SequenceToBeDeleted(CK_ID *objids, int count) {
 CKBehaviorManager::CKBehaviorManager(CKContext *Context) : CKBaseManager(Context, BEHAVIOR_MANAGER_GUID, "Behavior Manager") {
     m_CurrentBehavior = nullptr;
     m_BehaviorMaxIteration = 8000;
+    m_ThreadCount = 0;
+    m_WorkerPool = nullptr;
+    m_IsolationVersion = 0;
+    m_IsolatedCacheVersion = -1;
     m_Context->RegisterNewManager(this);
 }
 
-CKBehaviorManager::~CKBehaviorManager() {}
+CKBehaviorManager::~CKBehaviorManager() {
+    delete m_WorkerPool;
+}
@@ -920,6 +920,17 @@ CKBOOL CKBitmapData::DumpToChunk(CKStateChunk *chnk, CKContext *ctx, CKFile *f,
 
     // Fallback or direct save as RAWDATA (also used for EXTERNAL/INCLUDE)
     if (!savedViaImageFormat) {
+        // Reserve room for the raw planes (header + 4 sized byte planes per slot)
+        const int planeDwords = 1 + (imageDescForSaving.Width * imageDescForSaving.Height + 3) / 4;
+        int rawDwords = 4;
+        for (int i = 0; i < slotCount; ++i) {
+            if (!externalOrIncludedSlots.IsSet(i))
+                rawDwords += 8 + 4 * planeDwords;
+            else
+                rawDwords += 1;
+        }
+        chnk->Reserve(rawDwords);
+
         chnk->WriteIdentifier(Identifiers[2]); // RAWDATA_CHUNK_ID
         chnk->WriteInt(slotCount);
 
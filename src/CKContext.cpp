@@ -847,6 +847,14 @@ CK_FILE_WRITEMODE CKContext::GetFileWriteMode() {
     return m_FileWriteMode;
 }
 
+void CKContext::SetSaveThreadCount(int count) {
+    m_SaveThreadCount = (count > 1) ? count : 0;
+}
+
+int CKContext::GetSaveThreadCount() {
+    return m_SaveThreadCount;
+}
+
 CK_TEXTURE_SAVEOPTIONS CKContext::GetGlobalImagesSaveOptions() {
     return m_GlobalImagesSaveOptions;
 }
@@ -1773,6 +1781,7 @@ CKContext::CKContext(WIN_HANDLE iWin, int iRenderEngine, CKDWORD Flags) : m_Depe
 
     m_CurrentLevel = 0;
     m_CompressionLevel = 5;
+    m_SaveThreadCount = 0;
     m_CurrentManager = nullptr;
 
     m_ObjectManager = new CKObjectManager(this);
@@ -5,6 +5,11 @@
 #include "CKParameter.h"
 #include "CKParameterOut.h"
 #include "CKParameterManager.h"
+#include "CKDataArrayKernels.h"
+#include "CKNameIndex.h"
+
+#include <algorithm>
+#include <thread>
 
 template <class T>
 CKBOOL OpCompare(CK_COMPOPERATOR op, T a, T b) {
@@ -19,12 +24,6 @@ CKBOOL OpCompare(CK_COMPOPERATOR op, T a, T b) {
     }
 }
 
-int DataRowCompare(const void *elem1, const void *elem2) {
-    CKDataRow *row1 = *(CKDataRow **) elem1;
-    CKDataRow *row2 = *(CKDataRow **) elem2;
-    return CKDataArray::g_SortFunction(row1, row2);
-}
-
 static float ScalarToFloat(CKUINTPTR value) {
     float result = 0.0f;
     const CKDWORD bits = static_cast<CKDWORD>(value);
@@ -64,71 +63,420 @@ static int CopyStringToBuffer(const char *src, char *dst, int dstSize) {
     return required;
 }
 
+// State of a sort or a search on a column. Each call carries its own so that
+// sorts and searches on several arrays (or threads) do not share anything.
+struct ColumnQuery
+{
+    int Column;
+    CK_ARRAYTYPE Type;
+    CKBOOL Order;
+    CK_COMPOPERATOR Operator;
+    CKUINTPTR Value;
+    CKUINTPTR ValueSize;
+};
+
+static ColumnQuery MakeColumnQuery(int c, CK_ARRAYTYPE type, CKBOOL order = TRUE, CK_COMPOPERATOR op = CKEQUAL,
+                                   CKUINTPTR value = 0, CKUINTPTR valueSize = 0) {
+    ColumnQuery query = {c, type, order, op, value, valueSize};
+    return query;
+}
+
+// Orders two rows on the query column, descending when the query order is FALSE.
+// The order is a strict weak one, as std::sort and std::stable_sort need.
+static int CompareRows(const ColumnQuery &query, CKDataRow *row1, CKDataRow *row2) {
+    const CKUINTPTR e1 = (*row1)[query.Column];
+    const CKUINTPTR e2 = (*row2)[query.Column];
+    switch (query.Type) {
+    case CKARRAYTYPE_FLOAT: {
+        const float val1 = ScalarToFloat(e1);
+        const float val2 = ScalarToFloat(e2);
+        // NaN comes after every number
+        const bool nan1 = (val1 != val1);
+        const bool nan2 = (val2 != val2);
+        if (nan1 || nan2) {
+            if (nan1 == nan2) return 0;
+            return (nan1 == (query.Order != FALSE)) ? 1 : -1;
+        }
+        if (val1 < val2) return query.Order ? -1 : 1;
+        if (val1 > val2) return query.Order ? 1 : -1;
+        return 0;
+    }
+    case CKARRAYTYPE_STRING: {
+        const char *s1 = (const char *) e1;
+        const char *s2 = (const char *) e2;
+        if (!s1) s1 = "";
+        if (!s2) s2 = "";
+        const int diff = strcmp(s1, s2);
+        return query.Order ? diff : -diff;
+    }
+    case CKARRAYTYPE_PARAMETER: {
+        CKParameter *p1 = (CKParameter *) e1;
+        CKParameter *p2 = (CKParameter *) e2;
+        if (p1 == p2) return 0;
+        if (!p1 || !p2) return p1 ? 1 : -1;
+
+        // A value that is a prefix of the other comes first
+        const int size1 = p1->GetDataSize();
+        const int size2 = p2->GetDataSize();
+        const int size = XMin(size1, size2);
+        int result = (size > 0) ? memcmp(p1->GetReadDataPtr(), p2->GetReadDataPtr(), size) : 0;
+        if (result == 0)
+            result = size1 - size2;
+        return query.Order ? result : -result;
+    }
+    default: {
+        // CKARRAYTYPE_INT, CKARRAYTYPE_OBJECT
+        const int val1 = (int) e1;
+        const int val2 = (int) e2;
+        if (val1 < val2) return query.Order ? -1 : 1;
+        if (val1 > val2) return query.Order ? 1 : -1;
+        return 0;
+    }
+    }
+}
+
+// Compares the row element on the query column with the query value
+static CKBOOL TestRowElement(const ColumnQuery &query, CKDataRow *row) {
+    const CKUINTPTR element = (*row)[query.Column];
+    switch (query.Type) {
+    case CKARRAYTYPE_FLOAT:
+        return OpCompare(query.Operator, ScalarToFloat(element), ScalarToFloat(query.Value));
+    case CKARRAYTYPE_STRING: {
+        const char *s1 = (const char *) element;
+        const char *s2 = (const char *) query.Value;
+        if (!s1) s1 = "";
+        if (!s2) s2 = "";
+        return OpCompare(query.Operator, strcmp(s1, s2), 0);
+    }
+    case CKARRAYTYPE_PARAMETER: {
+        CKParameter *p = (CKParameter *) element;
+        if (!p) return FALSE;
+        const int size = XMin(p->GetDataSize(), (int) query.ValueSize);
+        if (size == 0) return FALSE;
+        const void *ptr = p->GetReadDataPtr();
+        return OpCompare(query.Operator, memcmp(ptr, (void *) query.Value, size), 0);
+    }
+    default:
+        return OpCompare(query.Operator, (int) element, (int) query.Value);
+    }
+}
+
+struct RowLess
+{
+    const ColumnQuery *Query;
+
+    bool operator()(CKDataRow *row1, CKDataRow *row2) const {
+        return CompareRows(*Query, row1, row2) < 0;
+    }
+};
+
+// Arrays with fewer rows are sorted on the calling thread
+static const int g_ParallelSortThreshold = 32768;
+static const int g_MinSortSliceSize = 8192;
+static const int g_MaxSortThreads = 8;
+
+static void SortRowSlice(CKDataRow **first, CKDataRow **last, RowLess less, CKBOOL stable) {
+    if (stable)
+        std::stable_sort(first, last, less);
+    else
+        std::sort(first, last, less);
+}
+
+// Merges the sorted runs [first, mid) and [mid, last) of src into dst.
+// Rows of the left run come first on ties.
+static void MergeRowRuns(CKDataRow **src, CKDataRow **dst, int first, int mid, int last, RowLess less) {
+    std::merge(src + first, src + mid, src + mid, src + last, dst + first, less);
+}
+
+// Sorts slices of the rows concurrently, then merges the runs pairwise. The
+// merges are stable, so the whole sort is stable when the slices are.
+static void ParallelSortRows(CKDataRow **rows, int rowCount, const RowLess &less, CKBOOL stable, int threadCount) {
+    XArray<int> bounds;
+    bounds.Resize(threadCount + 1);
+    for (int i = 0; i <= threadCount; ++i)
+        bounds[i] = (int) (((long long) rowCount * i) / threadCount);
+
+    // The calling thread takes part in each pass
+    std::thread *workers = new std::thread[threadCount - 1];
+    for (int i = 1; i < threadCount; ++i)
+        workers[i - 1] = std::thread(SortRowSlice, rows + bounds[i], rows + bounds[i + 1], less, stable);
+    SortRowSlice(rows + bounds[0], rows + bounds[1], less, stable);
+    for (int i = 1; i < threadCount; ++i)
+        workers[i - 1].join();
+
+    XArray<CKDataRow *> buffer;
+    buffer.Resize(rowCount);
+    CKDataRow **src = rows;
+    CKDataRow **dst = buffer.Begin();
+    int runCount = threadCount;
+    while (runCount > 1) {
+        const int mergeCount = runCount / 2;
+        for (int m = 1; m < mergeCount; ++m)
+            workers[m - 1] = std::thread(MergeRowRuns, src, dst, bounds[2 * m], bounds[2 * m + 1], bounds[2 * m + 2], less);
+        MergeRowRuns(src, dst, bounds[0], bounds[1], bounds[2], less);
+        if (runCount & 1) {
+            const int first = bounds[runCount - 1];
+            memcpy(dst + first, src + first, (bounds[runCount] - first) * sizeof(CKDataRow *));
+        }
+        for (int m = 1; m < mergeCount; ++m)
+            workers[m - 1].join();
+
+        int n = 0;
+        for (int r = 0; r < runCount; r += 2)
+            bounds[n++] = bounds[r];
+        bounds[n] = bounds[runCount];
+        runCount = n;
+
+        CKDataRow **swap = src;
+        src = dst;
+        dst = swap;
+    }
+    delete[] workers;
+
+    if (src != rows)
+        memcpy(rows, src, rowCount * sizeof(CKDataRow *));
+}
+
+// The column functions of the SDK read their state from the CKDataArray statics
+static ColumnQuery GetStaticQuery(CK_ARRAYTYPE type) {
+    return MakeColumnQuery(CKDataArray::g_ColumnIndex, type, CKDataArray::g_Order, CKDataArray::g_Operator,
+                           CKDataArray::g_Value, CKDataArray::g_ValueSize);
+}
+
 int ArrayIntComp(CKDataRow *row1, CKDataRow *row2) {
-    int val1 = (int)(*row1)[CKDataArray::g_ColumnIndex];
-    int val2 = (int)(*row2)[CKDataArray::g_ColumnIndex];
-    if (val1 < val2) return CKDataArray::g_Order ? -1 : 1;
-    if (val1 > val2) return CKDataArray::g_Order ? 1 : -1;
-    return 0;
+    return CompareRows(GetStaticQuery(CKARRAYTYPE_INT), row1, row2);
 }
 
 int ArrayFloatComp(CKDataRow *row1, CKDataRow *row2) {
-    float val1 = ScalarToFloat((*row1)[CKDataArray::g_ColumnIndex]);
-    float val2 = ScalarToFloat((*row2)[CKDataArray::g_ColumnIndex]);
-    if (val1 < val2) return CKDataArray::g_Order ? -1 : 1;
-    if (val1 > val2) return CKDataArray::g_Order ? 1 : -1;
-    return 0;
+    return CompareRows(GetStaticQuery(CKARRAYTYPE_FLOAT), row1, row2);
 }
 
 int ArrayStringComp(CKDataRow *row1, CKDataRow *row2) {
-    const char *s1 = (const char *) (*row1)[CKDataArray::g_ColumnIndex];
-    const char *s2 = (const char *) (*row2)[CKDataArray::g_ColumnIndex];
-    if (!s1) s1 = "";
-    if (!s2) s2 = "";
-    int diff = strcmp(s1, s2);
-    return CKDataArray::g_Order ? diff : -diff;
+    return CompareRows(GetStaticQuery(CKARRAYTYPE_STRING), row1, row2);
 }
 
 int ArrayParameterComp(CKDataRow *row1, CKDataRow *row2) {
-    CKParameter *p1 = (CKParameter *) (*row1)[CKDataArray::g_ColumnIndex];
-    CKParameter *p2 = (CKParameter *) (*row2)[CKDataArray::g_ColumnIndex];
-    if (p1 == p2) return 0;
-    if (!p1 || !p2) return p1 ? 1 : -1;
-
-    int size = XMin(p1->GetDataSize(), p2->GetDataSize());
-    if (size == 0) return 0;
-
-    int result = memcmp(p1->GetReadDataPtr(), p2->GetReadDataPtr(), size);
-    return CKDataArray::g_Order ? result : -result;
+    return CompareRows(GetStaticQuery(CKARRAYTYPE_PARAMETER), row1, row2);
 }
 
 CKBOOL ArrayIntEqual(CKDataRow *row) {
-    int v1 = (int)(*row)[CKDataArray::g_ColumnIndex];
-    int v2 = (int) CKDataArray::g_Value;
-    return OpCompare(CKDataArray::g_Operator, v1, v2);
+    return TestRowElement(GetStaticQuery(CKARRAYTYPE_INT), row);
 }
 
 CKBOOL ArrayFloatEqual(CKDataRow *row) {
-    float v1 = ScalarToFloat((*row)[CKDataArray::g_ColumnIndex]);
-    float v2 = ScalarToFloat(CKDataArray::g_Value);
-    return OpCompare(CKDataArray::g_Operator, v1, v2);
+    return TestRowElement(GetStaticQuery(CKARRAYTYPE_FLOAT), row);
 }
 
 CKBOOL ArrayStringEqual(CKDataRow *row) {
-    const char *s1 = (const char *) (*row)[CKDataArray::g_ColumnIndex];
-    const char *s2 = (const char *) CKDataArray::g_Value;
-    if (!s1) s1 = "";
-    if (!s2) s2 = "";
-    return OpCompare(CKDataArray::g_Operator, strcmp(s1, s2), 0);
+    return TestRowElement(GetStaticQuery(CKARRAYTYPE_STRING), row);
 }
 
 CKBOOL ArrayParameterEqual(CKDataRow *row) {
-    CKParameter *p = (CKParameter *) (*row)[CKDataArray::g_ColumnIndex];
-    if (!p) return FALSE;
-    const int size = XMin(p->GetDataSize(), (int) CKDataArray::g_ValueSize);
-    if (size == 0) return FALSE;
-    const void *ptr = p->GetReadDataPtr();
-    return OpCompare(CKDataArray::g_Operator, memcmp(ptr, (void *) CKDataArray::g_Value, size), 0);
+    return TestRowElement(GetStaticQuery(CKARRAYTYPE_PARAMETER), row);
+}
+
+// Sort function a column of this type is created with
+static ArraySortFunction DefaultSortFunction(CK_ARRAYTYPE type) {
+    switch (type) {
+    case CKARRAYTYPE_FLOAT: return ArrayFloatComp;
+    case CKARRAYTYPE_STRING: return ArrayStringComp;
+    case CKARRAYTYPE_PARAMETER: return ArrayParameterComp;
+    default: return ArrayIntComp;
+    }
+}
+
+// Equal function a column of this type is created with
+static ArrayEqualFunction DefaultEqualFunction(CK_ARRAYTYPE type) {
+    switch (type) {
+    case CKARRAYTYPE_FLOAT: return ArrayFloatEqual;
+    case CKARRAYTYPE_STRING: return ArrayStringEqual;
+    case CKARRAYTYPE_PARAMETER: return ArrayParameterEqual;
+    default: return ArrayIntEqual;
+    }
+}
+
+// Orders rows with a column sort function, which reads the CKDataArray statics
+struct SortFunctionLess
+{
+    ArraySortFunction Function;
+
+    bool operator()(CKDataRow *row1, CKDataRow *row2) const {
+        return Function(row1, row2) < 0;
+    }
+};
+
+// Column types whose elements can be hashed and ordered without a parameter type
+static CKBOOL IsIndexableType(CK_ARRAYTYPE type) {
+    return type == CKARRAYTYPE_INT || type == CKARRAYTYPE_FLOAT ||
+           type == CKARRAYTYPE_STRING || type == CKARRAYTYPE_OBJECT;
+}
+
+// Column types whose elements fit in 32 bits
+static CKBOOL IsPackableType(CK_ARRAYTYPE type) {
+    return type == CKARRAYTYPE_INT || type == CKARRAYTYPE_FLOAT || type == CKARRAYTYPE_OBJECT;
+}
+
+static void LoadPacked(CKDWORD element, int &value) {
+    value = (int) element;
+}
+
+static void LoadPacked(CKDWORD element, float &value) {
+    value = DwordToFloat(element);
+}
+
+static int Distance(int a, int b) {
+    return abs(a - b);
+}
+
+static float Distance(float a, float b) {
+    return (float) fabs(a - b);
+}
+
+// Matches of packed elements against a key, compared the way the column equal function does.
+// row receives the first match at or after start (-1 if none), count the number of matches; either may be NULL.
+template <class T>
+static void ScanPacked(const CKDWORD *values, int rowCount, CK_COMPOPERATOR op, T key, int start, int *row, int *count) {
+    T value;
+    if (row) {
+        *row = -1;
+        for (int i = start; i < rowCount; ++i) {
+            LoadPacked(values[i], value);
+            if (OpCompare(op, value, key)) {
+                *row = i;
+                break;
+            }
+        }
+    }
+    if (count) {
+        int matches = 0;
+        for (int i = 0; i < rowCount; ++i) {
+            LoadPacked(values[i], value);
+            if (OpCompare(op, value, key))
+                ++matches;
+        }
+        *count = matches;
+    }
+}
+
+template <class T>
+static int FindPackedNearest(const CKDWORD *values, int rowCount, T target) {
+    int nearest = 0;
+    T currentMin = (T) 100000000;
+    T value;
+    for (int i = 0; i < rowCount; ++i) {
+        LoadPacked(values[i], value);
+        const T diff = Distance(target, value);
+        if (diff < currentMin) {
+            currentMin = diff;
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+static CKBOOL IsNaNElement(CK_ARRAYTYPE type, CKUINTPTR element) {
+    if (type != CKARRAYTYPE_FLOAT)
+        return FALSE;
+    const float f = ScalarToFloat(element);
+    return f != f;
+}
+
+// Equal elements (as seen by the column equal function) get equal hashes
+static CKDWORD HashElement(CK_ARRAYTYPE type, CKUINTPTR element) {
+    CKDWORD hash;
+    if (type == CKARRAYTYPE_STRING) {
+        const char *str = (const char *) element;
+        return CKHashName(str ? str : "");
+    }
+
+    hash = (CKDWORD) element;
+    if (type == CKARRAYTYPE_FLOAT && ScalarToFloat(element) == 0.0f)
+        hash = 0; // -0.0f == 0.0f
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    return hash;
+}
+
+// Orders two elements the way the column sort and equal functions do. A NaN
+// element is neither lower nor greater than anything, as with ArrayFloatComp.
+static int CompareElements(CK_ARRAYTYPE type, CKUINTPTR a, CKUINTPTR b) {
+    switch (type) {
+    case CKARRAYTYPE_FLOAT: {
+        const float fa = ScalarToFloat(a);
+        const float fb = ScalarToFloat(b);
+        return (fa < fb) ? -1 : (fa > fb) ? 1 : 0;
+    }
+    case CKARRAYTYPE_STRING: {
+        const char *sa = (const char *) a;
+        const char *sb = (const char *) b;
+        return strcmp(sa ? sa : "", sb ? sb : "");
+    }
+    default: {
+        const int ia = (int) a;
+        const int ib = (int) b;
+        return (ia < ib) ? -1 : (ia > ib) ? 1 : 0;
+    }
+    }
+}
+
+struct SortedRowLess
+{
+    CKDataMatrix *Matrix;
+    int Column;
+    CK_ARRAYTYPE Type;
+
+    bool operator()(int r1, int r2) const {
+        const int cmp = CompareElements(Type, (*(*Matrix)[r1])[Column], (*(*Matrix)[r2])[Column]);
+        return cmp < 0 || (cmp == 0 && r1 < r2);
+    }
+};
+
+// Positions [first, last) of the elements matching op among count elements in
+// ascending order; rows maps positions to rows, NULL when the rows themselves are sorted.
+// Returns FALSE for CKNOTEQUAL which does not select a single range.
+static CKBOOL GetOperatorRange(CKDataMatrix &matrix, const int *rows, int count, int c, CK_ARRAYTYPE type,
+                               CK_COMPOPERATOR op, CKUINTPTR key, int &first, int &last) {
+    if (op == CKNOTEQUAL || op < CKEQUAL || op > CKGREATEREQUAL)
+        return FALSE;
+
+    if (IsNaNElement(type, key)) {
+        // Nothing compares with NaN
+        first = last = 0;
+        return TRUE;
+    }
+
+    // lower: first element >= key, upper: first element > key
+    int lo = 0;
+    int hi = count;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (CompareElements(type, (*matrix[rows ? rows[mid] : mid])[c], key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const int lower = lo;
+
+    hi = count;
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (CompareElements(type, (*matrix[rows ? rows[mid] : mid])[c], key) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const int upper = lo;
+
+    switch (op) {
+    case CKEQUAL:        first = lower; last = upper; break;
+    case CKLESSER:       first = 0;     last = lower; break;
+    case CKLESSEREQUAL:  first = 0;     last = upper; break;
+    case CKGREATER:      first = upper; last = count; break;
+    case CKGREATEREQUAL: first = lower; last = count; break;
+    default:             return FALSE;
+    }
+    return TRUE;
 }
 
 CK_CLASSID CKDataArray::m_ClassID = CKCID_DATAARRAY;
@@ -176,6 +524,8 @@ void CKDataArray::InsertColumn(int cdest, CK_ARRAYTYPE type, CKSTRING name, CKGU
         m_FormatArray.PushBack(fmt);
     } else {
         m_FormatArray.Insert(cdest, fmt);
+        if (m_Order && m_ColumnIndex >= cdest)
+            m_ColumnIndex++;
     }
 
     for (int i = 0; i < m_DataMatrix.Size(); ++i) {
@@ -212,9 +562,14 @@ void CKDataArray::MoveColumn(int csrc, int cdest) {
 
     ColumnFormat **srcFormat = m_FormatArray.Begin() + csrc;
     ColumnFormat **dstFormat = (cdest == -1) ? m_FormatArray.End() : (m_FormatArray.Begin() + cdest);
+    ColumnFormat *sortedFormat = m_Order ? m_FormatArray[m_ColumnIndex] : nullptr;
 
     m_FormatArray.Move(dstFormat, srcFormat);
 
+    // Follow the sorted column to its new position
+    if (sortedFormat)
+        m_ColumnIndex = m_FormatArray.GetPosition(sortedFormat);
+
     for (int i = 0; i < m_DataMatrix.Size(); ++i) {
         CKDataRow *row = m_DataMatrix[i];
         CKUINTPTR *srcData = row->Begin() + csrc;
@@ -293,6 +648,16 @@ void CKDataArray::SetColumnType(int c, CK_ARRAYTYPE newType, CKGUID paramGuid) {
     CK_ARRAYTYPE oldType = format->m_Type;
     if (oldType == newType && (oldType != CKARRAYTYPE_PARAMETER || format->m_ParameterType == paramGuid)) return;
 
+    ColumnDataChanged(c);
+    if (!IsIndexableType(newType)) {
+        delete format->m_Index;
+        format->m_Index = nullptr;
+    }
+    if (!IsPackableType(newType)) {
+        delete format->m_Store;
+        format->m_Store = nullptr;
+    }
+
     format->m_Type = newType;
     switch (newType) {
     case CKARRAYTYPE_INT:
@@ -493,8 +858,68 @@ int CKDataArray::GetColumnCount() {
     return m_FormatArray.Size();
 }
 
+CKBOOL CKDataArray::SetColumnIndexed(int c, CKBOOL indexed) {
+    if (c < 0 || c >= m_FormatArray.Size())
+        return FALSE;
+
+    ColumnFormat *fmt = m_FormatArray[c];
+    if (!indexed) {
+        delete fmt->m_Index;
+        fmt->m_Index = nullptr;
+        return TRUE;
+    }
+
+    if (!IsIndexableType(fmt->m_Type))
+        return FALSE;
+    // Built on the first lookup
+    if (!fmt->m_Index)
+        fmt->m_Index = new CKDataColumnIndex;
+    return TRUE;
+}
+
+CKBOOL CKDataArray::IsColumnIndexed(int c) {
+    if (c < 0 || c >= m_FormatArray.Size())
+        return FALSE;
+    return m_FormatArray[c]->m_Index != nullptr;
+}
+
+CKBOOL CKDataArray::SetColumnPacked(int c, CKBOOL packed) {
+    if (c < 0 || c >= m_FormatArray.Size())
+        return FALSE;
+
+    ColumnFormat *fmt = m_FormatArray[c];
+    if (!packed) {
+        delete fmt->m_Store;
+        fmt->m_Store = nullptr;
+        return TRUE;
+    }
+
+    if (!IsPackableType(fmt->m_Type))
+        return FALSE;
+    // Filled on the first scan
+    if (!fmt->m_Store)
+        fmt->m_Store = new CKDataColumnStore;
+    return TRUE;
+}
+
+CKBOOL CKDataArray::IsColumnPacked(int c) {
+    if (c < 0 || c >= m_FormatArray.Size())
+        return FALSE;
+    return m_FormatArray[c]->m_Store != nullptr;
+}
+
+// The caller may write through the element: the column is no longer known to be
+// sorted, and its index and packed copy are rebuilt on the next lookup
 CKUINTPTR *CKDataArray::GetElement(size_t i, size_t c) {
-    if (i >= (size_t)m_DataMatrix.Size())
+    CKUINTPTR *element = PeekElement(i, c);
+    if (element)
+        ColumnDataChanged((int)c);
+    return element;
+}
+
+// GetElement for reads, which keeps the packed copy
+CKUINTPTR *CKDataArray::PeekElement(size_t i, size_t c) {
+    if (i >= (size_t)m_DataMatrix.Size() || c >= (size_t)m_FormatArray.Size())
         return nullptr;
     CKDataRow *row = m_DataMatrix[(int)i];
     if (!row)
@@ -505,7 +930,7 @@ CKUINTPTR *CKDataArray::GetElement(size_t i, size_t c) {
 }
 
 CKBOOL CKDataArray::GetElementValue(int i, int c, void *value) {
-    CKUINTPTR *element = GetElement(i, c);
+    CKUINTPTR *element = PeekElement(i, c);
     if (!element || !value) return FALSE;
 
     switch (GetColumnType(c)) {
@@ -535,7 +960,7 @@ CKBOOL CKDataArray::GetElementValue(int i, int c, void *value) {
 }
 
 CKObject *CKDataArray::GetElementObject(int i, int c) {
-    CKUINTPTR *element = GetElement(i, c);
+    CKUINTPTR *element = PeekElement(i, c);
     if (!element) return nullptr;
     return m_Context->GetObject((CK_ID)(*element));
 }
@@ -552,14 +977,10 @@ CKBOOL CKDataArray::SetElementValue(int i, int c, void *value, int size) {
 
     switch (format->m_Type) {
     case CKARRAYTYPE_STRING: {
-        CKUINTPTR *element = &(*dataRow)[c];
-        char *oldStr = reinterpret_cast<char *>(*element);
-        delete[] oldStr;
-
         if (value) {
-            *element = reinterpret_cast<CKUINTPTR>(CKStrdup(static_cast<char *>(value)));
+            WriteElement(i, c, reinterpret_cast<CKUINTPTR>(CKStrdup(static_cast<char *>(value))));
         } else {
-            *element = 0;
+            WriteElement(i, c, 0);
         }
         break;
     }
@@ -575,12 +996,11 @@ CKBOOL CKDataArray::SetElementValue(int i, int c, void *value, int size) {
     default: {
         // CKARRAYTYPE_INT, CKARRAYTYPE_FLOAT, CKARRAYTYPE_OBJECT
         // The API expects callers to pass pointers to 32-bit scalars.
-        CKUINTPTR *element = &(*dataRow)[c];
         CKDWORD d = 0;
         if (value) {
             memcpy(&d, value, sizeof(CKDWORD));
         }
-        *element = (CKUINTPTR)d;
+        WriteElement(i, c, (CKUINTPTR)d);
         break;
     }
     }
@@ -605,12 +1025,9 @@ CKBOOL CKDataArray::SetElementValueFromParameter(int i, int c, CKParameter *pout
         if (strLen > 0) {
             char *newStr = new char[strLen];
             pout->GetStringValue(newStr, strLen);
-
-            delete[] reinterpret_cast<char *>(element);
-            element = reinterpret_cast<CKUINTPTR>(newStr);
+            WriteElement(i, c, reinterpret_cast<CKUINTPTR>(newStr));
         } else {
-            delete[] reinterpret_cast<char *>(element);
-            element = 0;
+            WriteElement(i, c, 0);
         }
         break;
     }
@@ -628,7 +1045,7 @@ CKBOOL CKDataArray::SetElementValueFromParameter(int i, int c, CKParameter *pout
         if (srcData) {
             CKDWORD d = 0;
             memcpy(&d, srcData, sizeof(CKDWORD));
-            element = static_cast<CKUINTPTR>(d);
+            WriteElement(i, c, static_cast<CKUINTPTR>(d));
         }
         break;
     }
@@ -707,7 +1124,7 @@ CKBOOL CKDataArray::SetElementStringValue(int i, int c, CKSTRING svalue) {
                 return FALSE;
             }
         }
-        (*dataRow)[c] = static_cast<CKUINTPTR>(intValue);
+        WriteElement(i, c, static_cast<CKUINTPTR>(intValue));
         return TRUE;
     }
 
@@ -724,7 +1141,7 @@ CKBOOL CKDataArray::SetElementStringValue(int i, int c, CKSTRING svalue) {
                 return FALSE;
             }
         }
-        (*dataRow)[c] = floatBits;
+        WriteElement(i, c, floatBits);
         return TRUE;
     }
 
@@ -739,14 +1156,13 @@ CKBOOL CKDataArray::SetElementStringValue(int i, int c, CKSTRING svalue) {
                 return FALSE;
             }
         }
-        delete[] reinterpret_cast<char *>((*dataRow)[c]);
-        (*dataRow)[c] = reinterpret_cast<CKUINTPTR>(CKStrdup(svalue));
+        WriteElement(i, c, reinterpret_cast<CKUINTPTR>(CKStrdup(svalue)));
         return TRUE;
     }
 
     case CKARRAYTYPE_OBJECT: {
         CKObject *obj = m_Context->GetObjectByName(svalue, nullptr);
-        (*dataRow)[c] = obj ? obj->GetID() : 0;
+        WriteElement(i, c, obj ? obj->GetID() : 0);
         return FALSE;
     }
 
@@ -845,114 +1261,414 @@ int CKDataArray::GetStringValue(CKUINTPTR key, int c, char *svalue, int svalueSi
 }
 
 int CKDataArray::GetElementStringValue(int i, int c, char *svalue, int svalueSize) {
-    CKUINTPTR *element = GetElement(i, c);
+    CKUINTPTR *element = PeekElement(i, c);
     if (!element) return 0;
     return GetStringValue(*element, c, svalue, svalueSize);
 }
 
-CKBOOL CKDataArray::LoadElements(CKSTRING filename, CKBOOL append, int column) {
-    if (!filename)
-        return FALSE;
+// Text import and export
 
-    FILE *file = fopen(filename, "rb");
-    if (!file)
-        return FALSE;
+// LoadElements reads lines of at most g_MaxElementLineLength characters and drops
+// the last character of every line but the last one (the '\r' of the text files
+// written by WriteElements on Windows).
+static const int g_MaxElementLineLength = 2047;
 
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
+// Files with fewer lines are parsed on the calling thread
+static const int g_ParallelLoadThreshold = 16384;
+static const int g_MinLoadSliceSize = 4096;
+static const int g_MaxLoadThreads = 8;
 
-    if (fileSize < 0) {
-        fclose(file);
-        return FALSE;
-    }
+static const double g_PowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
 
-    char *buffer = new char[(size_t)fileSize + 1];
-    const size_t readSize = fread(buffer, 1, (size_t)fileSize, file);
-    buffer[readSize] = '\0';
-    fclose(file);
+struct ElementLine {
+    const char *Text;
+    int Length;
+};
 
+struct ElementLoad {
+    const ElementLine *Lines;
+    CKDataRow **Rows;
+    int Column;
+    const CK_ARRAYTYPE *Types;
+    int ColumnCount;
+    CKContext *Context;
+    CKDWORD TypeMask; // Bit (1 << type) set for the column types to fill
+};
+
+static void CollectElementLines(const char *data, size_t size, XArray<ElementLine> &lines) {
     size_t offset = 0;
-    int rowIndex = 0;
-    while (offset < readSize) {
-        size_t lineLen = 0;
-        while (offset + lineLen < readSize && buffer[offset + lineLen] != '\n') {
-            ++lineLen;
-        }
-
-        char line[2048];
-        const size_t copyLen = XMin(lineLen, sizeof(line) - 1);
-        memcpy(line, buffer + offset, copyLen);
-        if (offset + lineLen == readSize) {
-            line[copyLen] = '\0';
-        } else if (copyLen > 0) {
-            line[copyLen - 1] = '\0';
-        } else {
-            line[0] = '\0';
+    while (offset < size) {
+        const char *text = data + offset;
+        const char *eol = (const char *) memchr(text, '\n', size - offset);
+        const size_t lineLen = eol ? (size_t) (eol - text) : size - offset;
+
+        size_t length = XMin(lineLen, (size_t) g_MaxElementLineLength);
+        if (eol && length > 0)
+            --length;
+        // Lines are C strings
+        const char *nul = (const char *) memchr(text, '\0', length);
+        if (nul)
+            length = nul - text;
+
+        if (length > 0) {
+            ElementLine line = {text, (int) length};
+            lines.PushBack(line);
         }
+        offset += lineLen + 1;
+    }
+}
 
-        if (line[0]) {
-            CKDataRow *row = nullptr;
-            if (append) {
-                row = InsertRow(-1);
-            } else {
-                row = GetRow(rowIndex++);
-                if (!row) {
-                    break;
-                }
+static void CopyElementText(const char *text, const char *end, char *buffer) {
+    memcpy(buffer, text, end - text);
+    buffer[end - text] = '\0';
+}
+
+// atoi, with a shortcut for plain numbers of up to 9 digits
+static int ParseElementInt(const char *text, const char *end) {
+    const char *p = text;
+    const CKBOOL negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+        ++p;
+
+    int value = 0;
+    int digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        value = value * 10 + (*p - '0');
+        ++digits;
+    }
+    if (digits > 0 && digits <= 9)
+        return negative ? -value : value;
+
+    char buffer[g_MaxElementLineLength + 1];
+    CopyElementText(text, end, buffer);
+    return atoi(buffer);
+}
+
+// (float) atof, with a shortcut for decimal numbers whose mantissa and power of
+// ten are both exact doubles: a single multiplication or division then gives the
+// correctly rounded double, as strtod does.
+static float ParseElementFloat(const char *text, const char *end) {
+    const char *p = text;
+    const CKBOOL negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+        ++p;
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    CKBOOL valid = FALSE;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa)
+            ++digits;
+        valid = TRUE;
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa)
+                ++digits;
+            --exponent;
+            valid = TRUE;
+        }
+    }
+    // Hexadecimal numbers are left to atof
+    if (p < end && (*p == 'x' || *p == 'X'))
+        valid = FALSE;
+    if (valid && p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        const CKBOOL negativeExponent = (q < end && *q == '-');
+        if (q < end && (*q == '-' || *q == '+'))
+            ++q;
+        if (q < end && *q >= '0' && *q <= '9') {
+            int value = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+                if (value < 10000)
+                    value = value * 10 + (*q - '0');
             }
+            exponent += negativeExponent ? -value : value;
+        }
+    }
 
-            char *token = line;
-            int col = column;
-            while (token && *token) {
-                char *tab = strchr(token, '\t');
-                if (tab) {
-                    *tab = '\0';
-                }
+    if (valid && digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double) mantissa;
+        if (exponent < 0)
+            value /= g_PowersOfTen[-exponent];
+        else
+            value *= g_PowersOfTen[exponent];
+        return (float) (negative ? -value : value);
+    }
 
-                if (col < 0 || col >= m_FormatArray.Size()) {
-                    break;
-                }
+    char buffer[g_MaxElementLineLength + 1];
+    CopyElementText(text, end, buffer);
+    return (float) atof(buffer);
+}
 
-                ColumnFormat *fmt = m_FormatArray[col];
+// Fills the cells of lines [first, last) whose column type is in load.TypeMask
+static void LoadElementLines(const ElementLoad *load, int first, int last) {
+    char buffer[g_MaxElementLineLength + 1];
+    for (int l = first; l < last; ++l) {
+        const ElementLine &line = load->Lines[l];
+        CKDataRow *row = load->Rows[l];
+        const char *token = line.Text;
+        const char *end = line.Text + line.Length;
+        int col = load->Column;
+        // A tab ending the line does not start an empty cell
+        while (token < end) {
+            if (col < 0 || col >= load->ColumnCount)
+                break;
+
+            const char *tab = (const char *) memchr(token, '\t', end - token);
+            const char *tokenEnd = tab ? tab : end;
+            const CK_ARRAYTYPE type = load->Types[col];
+            if (load->TypeMask & (1 << type)) {
                 CKUINTPTR &element = (*row)[col];
-                switch (fmt->m_Type) {
+                switch (type) {
                 case CKARRAYTYPE_INT:
-                    element = static_cast<CKUINTPTR>(atoi(token));
+                    element = static_cast<CKUINTPTR>(ParseElementInt(token, tokenEnd));
                     break;
                 case CKARRAYTYPE_FLOAT:
-                    element = FloatToScalar(static_cast<float>(atof(token)));
+                    element = FloatToScalar(ParseElementFloat(token, tokenEnd));
                     break;
-                case CKARRAYTYPE_STRING:
+                case CKARRAYTYPE_STRING: {
                     delete[] reinterpret_cast<char *>(element);
-                    element = reinterpret_cast<CKUINTPTR>(CKStrdup(token));
+                    char *str = new char[tokenEnd - token + 1];
+                    CopyElementText(token, tokenEnd, str);
+                    element = reinterpret_cast<CKUINTPTR>(str);
                     break;
+                }
                 case CKARRAYTYPE_OBJECT: {
-                    CKObject *obj = m_Context->GetObjectByNameAndParentClass(token, CKCID_OBJECT, nullptr);
+                    CopyElementText(token, tokenEnd, buffer);
+                    CKObject *obj = load->Context->GetObjectByNameAndParentClass(buffer, CKCID_OBJECT, nullptr);
                     element = obj ? obj->GetID() : 0;
                     break;
                 }
                 case CKARRAYTYPE_PARAMETER: {
                     CKParameterOut *param = reinterpret_cast<CKParameterOut *>(element);
                     if (param) {
-                        param->SetStringValue(token);
+                        CopyElementText(token, tokenEnd, buffer);
+                        param->SetStringValue(buffer);
                     }
                     break;
                 }
+                default:
+                    break;
                 }
+            }
 
-                if (tab) {
-                    token = tab + 1;
-                } else {
-                    token = nullptr;
+            token = tab ? tab + 1 : end;
+            ++col;
+        }
+    }
+}
+
+static int FormatElementInt(int value, char *text) {
+    char digits[16];
+    int count = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int) value : (unsigned int) value;
+    do {
+        digits[count++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+
+    char *out = text;
+    if (value < 0)
+        *out++ = '-';
+    while (count > 0)
+        *out++ = digits[--count];
+    *out = '\0';
+    return (int) (out - text);
+}
+
+// Same text as sprintf("%g"), with a shortcut for the values printed without
+// exponent: their 6 significant digits are rounded from an exact product.
+static int FormatElementFloat(float value, char *text) {
+    const double magnitude = fabs((double) value);
+    if (magnitude == 0.0) {
+        char *out = text;
+        if (FloatToScalar(value) & 0x80000000)
+            *out++ = '-';
+        *out++ = '0';
+        *out = '\0';
+        return (int) (out - text);
+    }
+
+    if (magnitude < 1e6) {
+        // A float has 24 significant bits and 10^9 = 2^9 * 5^9 has 21 bits
+        // besides its power of two, so the products are exact
+        for (int decimals = 0; decimals <= 9; ++decimals) {
+            const double scaled = magnitude * g_PowersOfTen[decimals];
+            if (scaled < 100000.0)
+                continue;
+
+            double rounded = floor(scaled);
+            const double fraction = scaled - rounded;
+            // Ties are left to the C runtime rounding
+            if (fraction == 0.5)
+                break;
+            if (fraction > 0.5)
+                rounded += 1.0;
+            int places = decimals;
+            if (rounded == 1000000.0) {
+                if (places == 0)
+                    break;
+                rounded = 100000.0;
+                --places;
+            }
+
+            char digits[8];
+            FormatElementInt((int) rounded, digits);
+            int lastDigit = 5;
+            while (lastDigit >= 6 - places && digits[lastDigit] == '0')
+                --lastDigit;
+
+            char *out = text;
+            if (value < 0)
+                *out++ = '-';
+            if (places <= 5) {
+                memcpy(out, digits, 6 - places);
+                out += 6 - places;
+                if (lastDigit >= 6 - places) {
+                    *out++ = '.';
+                    memcpy(out, digits + 6 - places, lastDigit - (6 - places) + 1);
+                    out += lastDigit - (6 - places) + 1;
                 }
-                ++col;
+            } else {
+                *out++ = '0';
+                *out++ = '.';
+                for (int z = 6; z < places; ++z)
+                    *out++ = '0';
+                memcpy(out, digits, lastDigit + 1);
+                out += lastDigit + 1;
             }
+            *out = '\0';
+            return (int) (out - text);
         }
+    }
 
-        offset += lineLen + 1;
+    return sprintf(text, "%g", value);
+}
+
+// Collects the text written by WriteElements and hands it to the file in large blocks
+class ElementTextWriter {
+public:
+    explicit ElementTextWriter(FILE *file) : m_File(file), m_Size(0) {}
+    ~ElementTextWriter() { Flush(); }
+
+    void Write(const char *text, size_t length) {
+        if (m_Size + length > sizeof(m_Buffer)) {
+            Flush();
+            if (length > sizeof(m_Buffer)) {
+                fwrite(text, 1, length, m_File);
+                return;
+            }
+        }
+        memcpy(m_Buffer + m_Size, text, length);
+        m_Size += length;
     }
 
+    void Write(const char *text) { Write(text, strlen(text)); }
+
+    void Flush() {
+        if (m_Size > 0)
+            fwrite(m_Buffer, 1, m_Size, m_File);
+        m_Size = 0;
+    }
+
+private:
+    FILE *m_File;
+    size_t m_Size;
+    char m_Buffer[32768];
+};
+
+CKBOOL CKDataArray::LoadElements(CKSTRING filename, CKBOOL append, int column) {
+    if (!filename)
+        return FALSE;
+
+    const char *data = nullptr;
+    size_t size = 0;
+    char *buffer = nullptr;
+    VxMemoryMappedFile mappedFile(filename);
+    if (mappedFile.IsValid()) {
+        data = (const char *) mappedFile.GetBase();
+        size = mappedFile.GetFileSize();
+    } else {
+        // Empty files cannot be mapped
+        FILE *file = fopen(filename, "rb");
+        if (!file)
+            return FALSE;
+
+        fseek(file, 0, SEEK_END);
+        long fileSize = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        if (fileSize < 0) {
+            fclose(file);
+            return FALSE;
+        }
+
+        buffer = new char[(size_t)fileSize + 1];
+        size = fread(buffer, 1, (size_t)fileSize, file);
+        fclose(file);
+        data = buffer;
+    }
+
+    XArray<ElementLine> lines;
+    CollectElementLines(data, size, lines);
+
+    // Every line fills a row, until the rows run out
+    int lineCount = lines.Size();
+    int firstRow = 0;
+    if (append) {
+        firstRow = m_DataMatrix.Size();
+        for (int l = 0; l < lineCount; ++l)
+            InsertRow(-1);
+    } else {
+        lineCount = XMin(lineCount, m_DataMatrix.Size());
+    }
+
+    const int columnCount = m_FormatArray.Size();
+    XArray<CK_ARRAYTYPE> types;
+    types.Resize(columnCount);
+    for (int c = 0; c < columnCount; ++c)
+        types[c] = m_FormatArray[c]->m_Type;
+
+    ElementLoad load = {lines.Begin(), m_DataMatrix.Begin() + firstRow, column, types.Begin(), columnCount, m_Context, 0};
+
+    int threadCount = 1;
+    if (lineCount >= g_ParallelLoadThreshold) {
+        threadCount = XMin((int) std::thread::hardware_concurrency(), g_MaxLoadThreads);
+        threadCount = XMin(threadCount, lineCount / g_MinLoadSliceSize);
+    }
+
+    if (threadCount > 1) {
+        // Numbers and strings are parsed concurrently. Finding objects and
+        // setting parameters is not thread safe and happens afterwards.
+        load.TypeMask = (1 << CKARRAYTYPE_INT) | (1 << CKARRAYTYPE_FLOAT) | (1 << CKARRAYTYPE_STRING);
+        std::thread *workers = new std::thread[threadCount - 1];
+        for (int i = 1; i < threadCount; ++i) {
+            const int first = (int) (((long long) lineCount * i) / threadCount);
+            const int last = (int) (((long long) lineCount * (i + 1)) / threadCount);
+            workers[i - 1] = std::thread(LoadElementLines, &load, first, last);
+        }
+        LoadElementLines(&load, 0, (int) ((long long) lineCount / threadCount));
+        for (int i = 1; i < threadCount; ++i)
+            workers[i - 1].join();
+        delete[] workers;
+
+        load.TypeMask = (1 << CKARRAYTYPE_OBJECT) | (1 << CKARRAYTYPE_PARAMETER);
+    } else {
+        load.TypeMask = 0xFFFFFFFF;
+    }
+    LoadElementLines(&load, 0, lineCount);
+
+    // Elements were written in place
+    m_Order = FALSE;
+    InvalidateColumnIndexes();
+
     delete[] buffer;
     return TRUE;
 }
@@ -965,61 +1681,64 @@ CKBOOL CKDataArray::WriteElements(CKSTRING filename, int column, int number, CKB
     if (!file)
         return FALSE;
 
-    for (CKDataMatrix::Iterator it = m_DataMatrix.Begin(); it != m_DataMatrix.End(); ++it) {
-        CKDataRow *row = *it;
-        if (!row)
-            continue;
+    {
+        ElementTextWriter writer(file);
+        char text[256];
+        for (CKDataMatrix::Iterator it = m_DataMatrix.Begin(); it != m_DataMatrix.End(); ++it) {
+            CKDataRow *row = *it;
+            if (!row)
+                continue;
 
-        for (int c = column; c < column + number; ++c) {
-            if (c > column)
-                fprintf(file, "\t");
+            for (int c = column; c < column + number; ++c) {
+                if (c > column)
+                    writer.Write("\t", 1);
 
-            if (c < 0 || c >= m_FormatArray.Size()) {
-                continue;
-            }
+                if (c < 0 || c >= m_FormatArray.Size()) {
+                    continue;
+                }
 
-            CKUINTPTR element = (*row)[c];
-            ColumnFormat *fmt = m_FormatArray[c];
+                CKUINTPTR element = (*row)[c];
+                ColumnFormat *fmt = m_FormatArray[c];
 
-            switch (fmt->m_Type) {
-            case CKARRAYTYPE_INT:
-                fprintf(file, "%d", static_cast<int>(element));
-                break;
+                switch (fmt->m_Type) {
+                case CKARRAYTYPE_INT:
+                    writer.Write(text, FormatElementInt(static_cast<int>(element), text));
+                    break;
 
-            case CKARRAYTYPE_FLOAT:
-                fprintf(file, "%g", ScalarToFloat(element));
-                break;
+                case CKARRAYTYPE_FLOAT:
+                    writer.Write(text, FormatElementFloat(ScalarToFloat(element), text));
+                    break;
 
-            case CKARRAYTYPE_STRING: {
-                const char *str = reinterpret_cast<const char *>(element);
-                if (str) {
-                    fprintf(file, "%s", str);
+                case CKARRAYTYPE_STRING: {
+                    const char *str = reinterpret_cast<const char *>(element);
+                    if (str) {
+                        writer.Write(str);
+                    }
+                    break;
                 }
-                break;
-            }
 
-            case CKARRAYTYPE_OBJECT: {
-                CKObject *obj = m_Context->GetObject((CK_ID)element);
-                if (obj && obj->GetName()) {
-                    fprintf(file, "%s", obj->GetName());
+                case CKARRAYTYPE_OBJECT: {
+                    CKObject *obj = m_Context->GetObject((CK_ID)element);
+                    if (obj && obj->GetName()) {
+                        writer.Write(obj->GetName());
+                    }
+                    break;
                 }
-                break;
-            }
 
-            case CKARRAYTYPE_PARAMETER: {
-                CKParameter *param = reinterpret_cast<CKParameter *>(element);
-                if (param) {
-                    char text[256];
-                    text[0] = '\0';
-                    param->GetStringValue(text, TRUE);
-                    fprintf(file, "%s", text);
+                case CKARRAYTYPE_PARAMETER: {
+                    CKParameter *param = reinterpret_cast<CKParameter *>(element);
+                    if (param) {
+                        text[0] = '\0';
+                        param->GetStringValue(text, TRUE);
+                        writer.Write(text);
+                    }
+                    break;
+                }
                 }
-                break;
-            }
             }
-        }
 
-        fprintf(file, "\n");
+            writer.Write("\n", 1);
+        }
     }
 
     fclose(file);
@@ -1030,9 +1749,13 @@ int CKDataArray::GetRowCount() {
     return m_DataMatrix.Size();
 }
 
+// The caller may write through the row: the array is no longer known to be
+// sorted, and indexes and packed copies are rebuilt on the next lookup
 CKDataRow *CKDataArray::GetRow(int n) {
     if (n < 0 || n >= m_DataMatrix.Size())
         return nullptr;
+    m_Order = FALSE;
+    InvalidateColumnIndexes();
     return m_DataMatrix[n];
 }
 
@@ -1060,102 +1783,429 @@ void CKDataArray::AddRow() {
     }
 
     m_DataMatrix.PushBack(newRow);
+    LinkAppendedRow();
+}
+
+CKDataRow *CKDataArray::InsertRow(int n) {
+    if (m_Order) {
+        m_Order = FALSE;
+    }
+
+    if (n < -1 || n > m_DataMatrix.Size()) {
+        return nullptr;
+    }
+
+    CKDataRow *newRow = new CKDataRow();
+    newRow->Resize(m_FormatArray.Size());
+
+    for (int i = 0; i < m_FormatArray.Size(); ++i) {
+        ColumnFormat *fmt = m_FormatArray[i];
+
+        if (fmt->m_Type == CKARRAYTYPE_PARAMETER) {
+            CKParameterOut *param = m_Context->CreateCKParameterOut(nullptr, fmt->m_ParameterType, IsDynamic());
+            if (param) {
+                param->SetOwner(this);
+                (*newRow)[i] = reinterpret_cast<CKUINTPTR>(param);
+            } else {
+                (*newRow)[i] = 0;
+            }
+        } else {
+            (*newRow)[i] = 0;
+        }
+    }
+
+    if (n == -1 || n == m_DataMatrix.Size()) {
+        m_DataMatrix.PushBack(newRow);
+        LinkAppendedRow();
+    } else {
+        // The following rows move down
+        m_DataMatrix.Insert(n, newRow);
+        InvalidateColumnIndexes();
+    }
+
+    return newRow;
+}
+
+CKBOOL CKDataArray::TestRow(int row, int c, CK_COMPOPERATOR op, CKUINTPTR key, int size) {
+    if (c < 0 || c >= m_FormatArray.Size() || row < 0 || row >= m_DataMatrix.Size()) {
+        return FALSE;
+    }
+
+    ArrayEqualFunction equalFunction = GetCustomEqualFunction(c, op, key, size);
+    if (equalFunction)
+        return equalFunction(m_DataMatrix[row]);
+
+    const ColumnQuery query = MakeColumnQuery(c, m_FormatArray[c]->m_Type, TRUE, op, key, size);
+    return TestRowElement(query, m_DataMatrix[row]);
+}
+
+// Returns the equal function of a column set to a custom one, with the query
+// stored in the statics it reads, or NULL when the typed test applies.
+// Indexes and packed copies follow the typed test and are not used then.
+ArrayEqualFunction CKDataArray::GetCustomEqualFunction(int c, CK_COMPOPERATOR op, CKUINTPTR key, int size) {
+    ColumnFormat *fmt = m_FormatArray[c];
+    ArrayEqualFunction equalFunction = fmt->m_EqualFunction;
+    if (!equalFunction || equalFunction == DefaultEqualFunction(fmt->m_Type))
+        return nullptr;
+
+    g_ColumnIndex = c;
+    g_Operator = op;
+    g_Value = key;
+    g_ValueSize = size;
+    return equalFunction;
+}
+
+ptrdiff_t CKDataArray::FindRowIndex(size_t c, CK_COMPOPERATOR op, CKUINTPTR key, size_t size, size_t startIndex) {
+    if (c >= (size_t)m_FormatArray.Size() || startIndex >= (size_t)m_DataMatrix.Size()) {
+        return -1;
+    }
+
+    ArrayEqualFunction equalFunction = GetCustomEqualFunction((int)c, op, key, (int)size);
+    if (equalFunction) {
+        for (int i = (int)startIndex; i < m_DataMatrix.Size(); ++i) {
+            if (equalFunction(m_DataMatrix[i]))
+                return i;
+        }
+        return -1;
+    }
+
+    int found = -1;
+    if (IndexedLookup((int)c, op, key, (int)startIndex, &found, nullptr))
+        return found;
+    if (PackedLookup((int)c, op, key, (int)startIndex, &found, nullptr))
+        return found;
+
+    const ColumnQuery query = MakeColumnQuery((int)c, m_FormatArray[(int)c]->m_Type, TRUE, op, key, size);
+
+    for (int i = (int)startIndex; i < m_DataMatrix.Size(); ++i) {
+        if (TestRowElement(query, m_DataMatrix[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+CKDataRow *CKDataArray::FindRow(int c, CK_COMPOPERATOR op, CKUINTPTR key, int size, int startIndex) {
+    if (c < 0 || c >= m_FormatArray.Size() || startIndex < 0 || startIndex >= m_DataMatrix.Size()) {
+        return nullptr;
+    }
+
+    const ptrdiff_t found = FindRowIndex(c, op, key, size, startIndex);
+    return (found >= 0) ? m_DataMatrix[(int)found] : nullptr;
 }
 
-CKDataRow *CKDataArray::InsertRow(int n) {
-    if (m_Order) {
-        m_Order = FALSE;
+// Writes a raw element (freeing the previous string of string columns) and keeps
+// the sort state and the column index up to date
+void CKDataArray::WriteElement(int i, int c, CKUINTPTR value) {
+    if (m_Order && c == m_ColumnIndex)
+        m_Order = FALSE;
+
+    ColumnFormat *fmt = m_FormatArray[c];
+    CKDataColumnIndex *index = fmt->m_Index;
+    if (index) {
+        IndexUnlinkRow(c, i);
+        index->m_SortedValid = FALSE;
+    }
+
+    CKUINTPTR &element = (*m_DataMatrix[i])[c];
+    if (fmt->m_Type == CKARRAYTYPE_STRING)
+        delete[] reinterpret_cast<char *>(element);
+    element = value;
+
+    CKDataColumnStore *store = fmt->m_Store;
+    if (store && store->m_Valid)
+        store->m_Values[i] = (CKDWORD) value;
+
+    if (index)
+        IndexLinkRow(c, i);
+}
+
+// The whole column was rewritten in place
+void CKDataArray::ColumnDataChanged(int c) {
+    if (m_Order && c == m_ColumnIndex)
+        m_Order = FALSE;
+
+    ColumnFormat *fmt = m_FormatArray[c];
+    CKDataColumnIndex *index = fmt->m_Index;
+    if (index) {
+        index->m_ChainsValid = FALSE;
+        index->m_SortedValid = FALSE;
+    }
+    if (fmt->m_Store)
+        fmt->m_Store->m_Valid = FALSE;
+}
+
+// Rows were moved, inserted or removed: indexes and packed columns are rebuilt on the next lookup
+void CKDataArray::InvalidateColumnIndexes() {
+    for (int c = 0; c < m_FormatArray.Size(); ++c) {
+        ColumnFormat *fmt = m_FormatArray[c];
+        CKDataColumnIndex *index = fmt->m_Index;
+        if (index) {
+            index->m_ChainsValid = FALSE;
+            index->m_SortedValid = FALSE;
+        }
+        if (fmt->m_Store)
+            fmt->m_Store->m_Valid = FALSE;
+    }
+}
+
+// A row was pushed at the end of the matrix
+void CKDataArray::LinkAppendedRow() {
+    const int row = m_DataMatrix.Size() - 1;
+    for (int c = 0; c < m_FormatArray.Size(); ++c) {
+        IndexLinkRow(c, row);
+        CKDataColumnStore *store = m_FormatArray[c]->m_Store;
+        if (store && store->m_Valid)
+            store->m_Values.PushBack((CKDWORD) (*m_DataMatrix[row])[c]);
+    }
+}
+
+void CKDataArray::IndexLinkRow(int c, int row) {
+    ColumnFormat *fmt = m_FormatArray[c];
+    CKDataColumnIndex *index = fmt->m_Index;
+    if (!index)
+        return;
+    index->m_SortedValid = FALSE;
+    if (!index->m_ChainsValid)
+        return;
+
+    if (row >= index->m_Next.Size()) {
+        index->m_Next.Resize(row + 1);
+        index->m_Previous.Resize(row + 1);
     }
 
-    if (n < -1 || n > m_DataMatrix.Size()) {
-        return nullptr;
+    const CKDWORD hash = HashElement(fmt->m_Type, (*m_DataMatrix[row])[c]);
+    CKDataColumnIndex::Chain *chain = index->m_Chains.FindPtr(hash);
+    if (!chain) {
+        CKDataColumnIndex::Chain newChain = {row, row};
+        index->m_Chains.InsertUnique(hash, newChain);
+        index->m_Next[row] = -1;
+        index->m_Previous[row] = -1;
+        return;
     }
 
-    CKDataRow *newRow = new CKDataRow();
-    newRow->Resize(m_FormatArray.Size());
+    // Rows are mostly appended or rewritten in order: look for the place from the end
+    int after = chain->Last;
+    while (after != -1 && after > row)
+        after = index->m_Previous[after];
+    const int before = (after == -1) ? chain->First : index->m_Next[after];
 
-    for (int i = 0; i < m_FormatArray.Size(); ++i) {
-        ColumnFormat *fmt = m_FormatArray[i];
+    index->m_Previous[row] = after;
+    index->m_Next[row] = before;
+    if (after == -1)
+        chain->First = row;
+    else
+        index->m_Next[after] = row;
+    if (before == -1)
+        chain->Last = row;
+    else
+        index->m_Previous[before] = row;
+}
 
-        if (fmt->m_Type == CKARRAYTYPE_PARAMETER) {
-            CKParameterOut *param = m_Context->CreateCKParameterOut(nullptr, fmt->m_ParameterType, IsDynamic());
-            if (param) {
-                param->SetOwner(this);
-                (*newRow)[i] = reinterpret_cast<CKUINTPTR>(param);
-            } else {
-                (*newRow)[i] = 0;
-            }
-        } else {
-            (*newRow)[i] = 0;
-        }
-    }
+void CKDataArray::IndexUnlinkRow(int c, int row) {
+    ColumnFormat *fmt = m_FormatArray[c];
+    CKDataColumnIndex *index = fmt->m_Index;
+    if (!index)
+        return;
+    index->m_SortedValid = FALSE;
+    if (!index->m_ChainsValid)
+        return;
 
-    if (n == -1 || n == m_DataMatrix.Size()) {
-        m_DataMatrix.PushBack(newRow);
-    } else {
-        m_DataMatrix.Insert(n, newRow);
-    }
+    const CKDWORD hash = HashElement(fmt->m_Type, (*m_DataMatrix[row])[c]);
+    CKDataColumnIndex::Chain *chain = index->m_Chains.FindPtr(hash);
+    if (!chain)
+        return;
 
-    return newRow;
+    const int previous = index->m_Previous[row];
+    const int next = index->m_Next[row];
+    if (previous == -1)
+        chain->First = next;
+    else
+        index->m_Next[previous] = next;
+    if (next == -1)
+        chain->Last = previous;
+    else
+        index->m_Previous[next] = previous;
+
+    if (chain->First == -1)
+        index->m_Chains.Remove(hash);
 }
 
-CKBOOL CKDataArray::TestRow(int row, int c, CK_COMPOPERATOR op, CKUINTPTR key, int size) {
-    if (c < 0 || c >= m_FormatArray.Size() || row < 0 || row >= m_DataMatrix.Size()) {
-        return FALSE;
-    }
+CKDataColumnIndex *CKDataArray::GetColumnChains(int c) {
+    CKDataColumnIndex *index = m_FormatArray[c]->m_Index;
+    if (!index || index->m_ChainsValid)
+        return index;
 
-    g_ColumnIndex = c;
-    g_Value = key;
-    g_Operator = op;
-    g_ValueSize = size;
+    const int rowCount = m_DataMatrix.Size();
+    index->m_Chains.Clear();
+    index->m_Next.Resize(rowCount);
+    index->m_Previous.Resize(rowCount);
+    index->m_ChainsValid = TRUE;
+    for (int i = 0; i < rowCount; ++i)
+        IndexLinkRow(c, i);
+    return index;
+}
 
-    CKDataRow *dataRow = m_DataMatrix[row];
-    ArrayEqualFunction equalFunc = m_FormatArray[c]->m_EqualFunction;
+CKDataColumnStore *CKDataArray::GetColumnStore(int c) {
+    CKDataColumnStore *store = m_FormatArray[c]->m_Store;
+    if (!store || store->m_Valid)
+        return store;
 
-    return equalFunc(dataRow);
+    const int rowCount = m_DataMatrix.Size();
+    store->m_Values.Resize(rowCount);
+    CKDWORD *values = store->m_Values.Begin();
+    for (int i = 0; i < rowCount; ++i)
+        values[i] = (CKDWORD) (*m_DataMatrix[i])[c];
+    store->m_Valid = TRUE;
+    return store;
 }
 
-ptrdiff_t CKDataArray::FindRowIndex(size_t c, CK_COMPOPERATOR op, CKUINTPTR key, size_t size, size_t startIndex) {
-    if (c >= (size_t)m_FormatArray.Size() || startIndex >= (size_t)m_DataMatrix.Size()) {
-        return -1;
+// Rebuilds the packed copy from the rows, for kernels that write it back to them
+CKDataColumnStore *CKDataArray::ReloadColumnStore(int c) {
+    CKDataColumnStore *store = m_FormatArray[c]->m_Store;
+    if (store)
+        store->m_Valid = FALSE;
+    return GetColumnStore(c);
+}
+
+CKDataColumnIndex *CKDataArray::GetColumnSortedRows(int c) {
+    ColumnFormat *fmt = m_FormatArray[c];
+    CKDataColumnIndex *index = fmt->m_Index;
+    if (!index || index->m_SortedValid)
+        return index;
+
+    // NaN elements never satisfy a comparison: they are left out of the order
+    const int rowCount = m_DataMatrix.Size();
+    index->m_SortedRows.Resize(0);
+    for (int i = 0; i < rowCount; ++i) {
+        if (!IsNaNElement(fmt->m_Type, (*m_DataMatrix[i])[c]))
+            index->m_SortedRows.PushBack(i);
     }
 
-    g_ColumnIndex = (int)c;
-    g_Value = key;
-    g_Operator = op;
-    g_ValueSize = size;
+    SortedRowLess less = {&m_DataMatrix, c, fmt->m_Type};
+    std::sort(index->m_SortedRows.Begin(), index->m_SortedRows.End(), less);
+    index->m_SortedValid = TRUE;
+    return index;
+}
 
-    ArrayEqualFunction equalFunc = m_FormatArray[(int)c]->m_EqualFunction;
+// Answers a lookup without scanning the rows when the array is sorted on the
+// column or the column is indexed. row receives the first match at or after
+// startIndex (-1 if none), count the number of matches; either may be NULL.
+CKBOOL CKDataArray::IndexedLookup(int c, CK_COMPOPERATOR op, CKUINTPTR key, int startIndex, int *row, int *count) {
+    ColumnFormat *fmt = m_FormatArray[c];
+    const CK_ARRAYTYPE type = fmt->m_Type;
+    if (!IsIndexableType(type))
+        return FALSE;
 
-    for (int i = (int)startIndex; i < m_DataMatrix.Size(); ++i) {
-        if (equalFunc(m_DataMatrix[i])) {
-            return i;
+    const int rowCount = m_DataMatrix.Size();
+    int first = 0;
+    int last = 0;
+
+    // Sorted on this column: matches are contiguous. Float columns are left out
+    // since NaN elements have no place in the order.
+    if (m_Order && m_ColumnIndex == c && type != CKARRAYTYPE_FLOAT) {
+        const CK_COMPOPERATOR rangeOp = (op == CKNOTEQUAL) ? CKEQUAL : op;
+        if (!GetOperatorRange(m_DataMatrix, nullptr, rowCount, c, type, rangeOp, key, first, last))
+            return FALSE;
+
+        if (op == CKNOTEQUAL) {
+            if (row) {
+                int r = startIndex;
+                if (r >= first && r < last)
+                    r = last;
+                *row = (r < rowCount) ? r : -1;
+            }
+            if (count)
+                *count = rowCount - (last - first);
+        } else {
+            if (row) {
+                const int r = XMax(first, startIndex);
+                *row = (r < last) ? r : -1;
+            }
+            if (count)
+                *count = last - first;
         }
+        return TRUE;
     }
 
-    return -1;
-}
+    if (op == CKEQUAL || op == CKNOTEQUAL) {
+        CKDataColumnIndex *index = GetColumnChains(c);
+        if (!index)
+            return FALSE;
+
+        // Chains group equal hashes: confirm each candidate with an equal test
+        const ColumnQuery query = MakeColumnQuery(c, type, TRUE, CKEQUAL, key);
+
+        const CKDWORD hash = HashElement(type, key);
+        CKDataColumnIndex::Chain *chain = index->m_Chains.FindPtr(hash);
+        int r = chain ? chain->First : -1;
+        // Resume after the previous match when iterating over the matches
+        if (chain && startIndex > 0 && HashElement(type, (*m_DataMatrix[startIndex - 1])[c]) == hash)
+            r = index->m_Next[startIndex - 1];
+        while (r != -1 && r < startIndex)
+            r = index->m_Next[r];
+
+        if (row) {
+            if (op == CKEQUAL) {
+                while (r != -1 && !TestRowElement(query, m_DataMatrix[r]))
+                    r = index->m_Next[r];
+                *row = r;
+            } else {
+                // First row from startIndex that is not an equal chain member
+                int candidate = startIndex;
+                for (; r != -1 && r == candidate && TestRowElement(query, m_DataMatrix[r]); r = index->m_Next[r])
+                    ++candidate;
+                *row = (candidate < rowCount) ? candidate : -1;
+            }
+        }
 
-CKDataRow *CKDataArray::FindRow(int c, CK_COMPOPERATOR op, CKUINTPTR key, int size, int startIndex) {
-    if (c < 0 || c >= m_FormatArray.Size() || startIndex < 0 || startIndex >= m_DataMatrix.Size()) {
-        return nullptr;
+        if (count) {
+            int equalCount = 0;
+            for (int e = chain ? chain->First : -1; e != -1; e = index->m_Next[e]) {
+                if (TestRowElement(query, m_DataMatrix[e]))
+                    ++equalCount;
+            }
+            *count = (op == CKEQUAL) ? equalCount : rowCount - equalCount;
+        }
+        return TRUE;
     }
 
-    g_ColumnIndex = c;
-    g_Value = key;
-    g_Operator = op;
-    g_ValueSize = size;
-
-    ArrayEqualFunction equalFunc = m_FormatArray[c]->m_EqualFunction;
+    CKDataColumnIndex *index = GetColumnSortedRows(c);
+    if (!index)
+        return FALSE;
+    const int *sortedRows = index->m_SortedRows.Begin();
+    if (!GetOperatorRange(m_DataMatrix, sortedRows, index->m_SortedRows.Size(), c, type, op, key, first, last))
+        return FALSE;
 
-    for (int i = startIndex; i < m_DataMatrix.Size(); ++i) {
-        CKDataRow *currentRow = m_DataMatrix[i];
-        if (equalFunc(currentRow)) {
-            return currentRow;
+    if (row) {
+        int best = -1;
+        for (int p = first; p < last; ++p) {
+            const int r = sortedRows[p];
+            if (r >= startIndex && (best == -1 || r < best))
+                best = r;
         }
+        *row = best;
     }
+    if (count)
+        *count = last - first;
+    return TRUE;
+}
 
-    return nullptr;
+// Answers a lookup by sweeping the packed copy of the column instead of the rows.
+// Same outputs as IndexedLookup.
+CKBOOL CKDataArray::PackedLookup(int c, CK_COMPOPERATOR op, CKUINTPTR key, int startIndex, int *row, int *count) {
+    CKDataColumnStore *store = GetColumnStore(c);
+    if (!store)
+        return FALSE;
+
+    const CKDWORD *values = store->m_Values.Begin();
+    const int rowCount = store->m_Values.Size();
+    if (m_FormatArray[c]->m_Type == CKARRAYTYPE_FLOAT)
+        ScanPacked(values, rowCount, op, ScalarToFloat(key), startIndex, row, count);
+    else
+        ScanPacked(values, rowCount, op, (int) key, startIndex, row, count);
+    return TRUE;
 }
 
 void CKDataArray::RemoveRow(int n) {
@@ -1164,6 +2214,17 @@ void CKDataArray::RemoveRow(int n) {
 
     CKDataRow *row = m_DataMatrix[n];
 
+    // Removing the last row keeps the other row indices
+    const CKBOOL lastRow = (n == m_DataMatrix.Size() - 1);
+    if (lastRow) {
+        for (int c = 0; c < m_FormatArray.Size(); ++c) {
+            IndexUnlinkRow(c, n);
+            CKDataColumnStore *store = m_FormatArray[c]->m_Store;
+            if (store && store->m_Valid)
+                store->m_Values.Resize(n);
+        }
+    }
+
     for (int col = 0; col < m_FormatArray.Size(); ++col) {
         ColumnFormat *fmt = m_FormatArray[col];
         CKUINTPTR &element = (*row)[col];
@@ -1190,6 +2251,9 @@ void CKDataArray::RemoveRow(int n) {
 
     m_DataMatrix.RemoveAt(n);
     delete row;
+
+    if (!lastRow)
+        InvalidateColumnIndexes();
 }
 
 void CKDataArray::MoveRow(int rsrc, int rdst) {
@@ -1215,6 +2279,8 @@ void CKDataArray::MoveRow(int rsrc, int rdst) {
         srcPtr = m_DataMatrix.End();
 
     m_DataMatrix.Move(dstPtr, srcPtr);
+    m_Order = FALSE;
+    InvalidateColumnIndexes();
 }
 
 void CKDataArray::SwapRows(int i1, int i2) {
@@ -1229,6 +2295,8 @@ void CKDataArray::SwapRows(int i1, int i2) {
     CKDataRow *temp = m_DataMatrix[i1];
     m_DataMatrix[i1] = m_DataMatrix[i2];
     m_DataMatrix[i2] = temp;
+    m_Order = FALSE;
+    InvalidateColumnIndexes();
 }
 
 void CKDataArray::Clear(CKBOOL Params) {
@@ -1272,6 +2340,7 @@ void CKDataArray::Clear(CKBOOL Params) {
         m_DataMatrix.RemoveAt(i);
     }
     m_DataMatrix.Clear();
+    InvalidateColumnIndexes();
 
     if (Params && !paramsToDestroy.IsEmpty()) {
         m_Context->DestroyObjects(paramsToDestroy.Begin(), paramsToDestroy.Size());
@@ -1295,22 +2364,35 @@ CKBOOL CKDataArray::GetHighest(int c, int &row) {
         return FALSE;
     }
 
-    if (m_Order && m_ColumnIndex == c) {
+    // Sorts put NaN last, where it is not the highest element
+    const CK_ARRAYTYPE type = m_FormatArray[c]->m_Type;
+    if (m_Order && m_ColumnIndex == c && !IsNaNElement(type, (*m_DataMatrix[m_DataMatrix.Size() - 1])[c])) {
         row = m_Order ? m_DataMatrix.Size() - 1 : 0;
         return TRUE;
     }
 
-    g_ColumnIndex = c;
-    g_Order = TRUE;
+    CKDataColumnStore *store = GetColumnStore(c);
+    if (store) {
+        const CKDWORD *values = store->m_Values.Begin();
+        if (type == CKARRAYTYPE_FLOAT)
+            row = CKColumnFindFloatExtremum(values, store->m_Values.Size(), TRUE);
+        else
+            row = CKColumnFindIntExtremum(values, store->m_Values.Size(), TRUE);
+        return TRUE;
+    }
+
+    // NaN compares with nothing here, as in the packed scan (sorts put it last)
+    const ColumnQuery query = MakeColumnQuery(c, type);
 
     int maxIndex = 0;
     CKDataRow *maxRow = m_DataMatrix[0];
-    ArraySortFunction comparator = m_FormatArray[c]->m_SortFunction;
 
     for (int i = 1; i < m_DataMatrix.Size(); ++i) {
         CKDataRow *currentRow = m_DataMatrix[i];
 
-        if (comparator(currentRow, maxRow) > 0) {
+        const int cmp = (type == CKARRAYTYPE_PARAMETER) ? CompareRows(query, currentRow, maxRow)
+                                                        : CompareElements(type, (*currentRow)[c], (*maxRow)[c]);
+        if (cmp > 0) {
             maxRow = currentRow;
             maxIndex = i;
         }
@@ -1325,22 +2407,34 @@ CKBOOL CKDataArray::GetLowest(int c, int &row) {
         return FALSE;
     }
 
+    const CK_ARRAYTYPE type = m_FormatArray[c]->m_Type;
     if (m_Order && m_ColumnIndex == c) {
         row = m_Order ? 0 : m_DataMatrix.Size() - 1;
         return TRUE;
     }
 
-    g_ColumnIndex = c;
-    g_Order = TRUE;
+    CKDataColumnStore *store = GetColumnStore(c);
+    if (store) {
+        const CKDWORD *values = store->m_Values.Begin();
+        if (type == CKARRAYTYPE_FLOAT)
+            row = CKColumnFindFloatExtremum(values, store->m_Values.Size(), FALSE);
+        else
+            row = CKColumnFindIntExtremum(values, store->m_Values.Size(), FALSE);
+        return TRUE;
+    }
+
+    // NaN compares with nothing here, as in the packed scan (sorts put it last)
+    const ColumnQuery query = MakeColumnQuery(c, type);
 
     int minIndex = 0;
     CKDataRow *minRow = m_DataMatrix[0];
-    ArraySortFunction comparator = m_FormatArray[c]->m_SortFunction;
 
     for (int i = 1; i < m_DataMatrix.Size(); ++i) {
         CKDataRow *currentRow = m_DataMatrix[i];
 
-        if (comparator(currentRow, minRow) < 0) {
+        const int cmp = (type == CKARRAYTYPE_PARAMETER) ? CompareRows(query, currentRow, minRow)
+                                                        : CompareElements(type, (*currentRow)[c], (*minRow)[c]);
+        if (cmp < 0) {
             minRow = currentRow;
             minIndex = i;
         }
@@ -1359,6 +2453,16 @@ CKBOOL CKDataArray::GetNearest(int c, void *value, int &row) {
     ColumnFormat *fmt = m_FormatArray[c];
     row = 0;
 
+    CKDataColumnStore *store = (fmt->m_Type != CKARRAYTYPE_OBJECT) ? GetColumnStore(c) : nullptr;
+    if (store) {
+        const CKDWORD *values = store->m_Values.Begin();
+        if (fmt->m_Type == CKARRAYTYPE_FLOAT)
+            row = FindPackedNearest(values, store->m_Values.Size(), *static_cast<float *>(value));
+        else
+            row = FindPackedNearest(values, store->m_Values.Size(), *static_cast<int *>(value));
+        return TRUE;
+    }
+
     switch (fmt->m_Type) {
     case CKARRAYTYPE_INT: {
         const int targetValue = *static_cast<int *>(value);
@@ -1447,6 +2551,22 @@ void CKDataArray::ColumnTransform(int c, CK_BINARYOPERATOR op, CKDWORD value) {
     const bool isFloat = (fmt->m_Type == CKARRAYTYPE_FLOAT);
     const float floatValue = DwordToFloat(value);
 
+    CKDataColumnStore *store = ReloadColumnStore(c);
+    ColumnDataChanged(c);
+    if (store) {
+        // Operate on the packed copy, then write it back to the rows
+        CKDWORD *values = store->m_Values.Begin();
+        const int rowCount = store->m_Values.Size();
+        if (isFloat)
+            CKColumnTransformFloats(values, rowCount, op, floatValue);
+        else
+            CKColumnTransformInts(values, rowCount, op, static_cast<int>(value));
+        for (int i = 0; i < rowCount; ++i)
+            (*m_DataMatrix[i])[c] = values[i];
+        store->m_Valid = TRUE;
+        return;
+    }
+
     for (int i = 0; i < m_DataMatrix.Size(); ++i) {
         CKDataRow *row = m_DataMatrix[i];
         CKUINTPTR &element = (*row)[c];
@@ -1499,6 +2619,27 @@ void CKDataArray::ColumnsOperate(int c1, CK_BINARYOPERATOR op, int c2, int cr) {
 
     const bool isFloat = (fmt1->m_Type == CKARRAYTYPE_FLOAT);
 
+    CKDataColumnStore *store1 = ReloadColumnStore(c1);
+    CKDataColumnStore *store2 = (c2 != c1) ? ReloadColumnStore(c2) : store1;
+    ColumnDataChanged(cr);
+    if (store1 && store2) {
+        // Operate on the packed copies, then write the result back to the rows
+        CKDataColumnStore *storeResult = fmtResult->m_Store;
+        XArray<CKDWORD> scratch;
+        XArray<CKDWORD> &result = storeResult ? storeResult->m_Values : scratch;
+        const int rowCount = m_DataMatrix.Size();
+        result.Resize(rowCount);
+        if (isFloat)
+            CKColumnOperateFloats(store1->m_Values.Begin(), store2->m_Values.Begin(), result.Begin(), rowCount, op);
+        else
+            CKColumnOperateInts(store1->m_Values.Begin(), store2->m_Values.Begin(), result.Begin(), rowCount, op);
+        for (int i = 0; i < rowCount; ++i)
+            (*m_DataMatrix[i])[cr] = result[i];
+        if (storeResult)
+            storeResult->m_Valid = TRUE;
+        return;
+    }
+
     for (int i = 0; i < m_DataMatrix.Size(); ++i) {
         CKDataRow *row = m_DataMatrix[i];
 
@@ -1547,20 +2688,57 @@ void CKDataArray::ColumnsOperate(int c1, CK_BINARYOPERATOR op, int c2, int cr) {
 }
 
 void CKDataArray::Sort(int c, CKBOOL ascending) {
+    SortRows(c, ascending, FALSE);
+}
+
+void CKDataArray::StableSort(int c, CKBOOL ascending) {
+    SortRows(c, ascending, TRUE);
+}
+
+void CKDataArray::SortRows(int c, CKBOOL ascending, CKBOOL stable) {
     if (c < 0 || c >= m_FormatArray.Size())
         return;
 
+    // Rows sorted on the column stay in place with a stable sort too
     bool needsSort = !m_Order || (m_ColumnIndex != c) || (m_Order != ascending);
     if (!needsSort)
         return;
 
-    g_ColumnIndex = c;
-    g_Order = ascending;
-    g_SortFunction = m_FormatArray[c]->m_SortFunction;
+    const CK_ARRAYTYPE type = m_FormatArray[c]->m_Type;
+    const ArraySortFunction sortFunction = m_FormatArray[c]->m_SortFunction;
+    const CKBOOL customSort = sortFunction && sortFunction != DefaultSortFunction(type);
+    if (customSort) {
+        // A custom sort function reads its column and order from the statics:
+        // the rows are sorted on the calling thread
+        g_ColumnIndex = c;
+        g_Order = ascending;
+        g_SortFunction = sortFunction;
+        const SortFunctionLess less = {sortFunction};
+        if (stable)
+            std::stable_sort(m_DataMatrix.Begin(), m_DataMatrix.End(), less);
+        else
+            std::sort(m_DataMatrix.Begin(), m_DataMatrix.End(), less);
+    } else {
+        const ColumnQuery query = MakeColumnQuery(c, type, ascending);
+        const RowLess less = {&query};
 
-    m_DataMatrix.Sort(DataRowCompare);
+        const int rowCount = m_DataMatrix.Size();
+        int threadCount = 1;
+        // Reading parameters pulls their sources, which is not thread safe
+        if (rowCount >= g_ParallelSortThreshold && type != CKARRAYTYPE_PARAMETER) {
+            threadCount = XMin((int) std::thread::hardware_concurrency(), g_MaxSortThreads);
+            threadCount = XMin(threadCount, rowCount / g_MinSortSliceSize);
+        }
+
+        if (threadCount > 1)
+            ParallelSortRows(m_DataMatrix.Begin(), rowCount, less, stable, threadCount);
+        else
+            SortRowSlice(m_DataMatrix.Begin(), m_DataMatrix.End(), less, stable);
+    }
+    InvalidateColumnIndexes();
 
-    m_Order = ascending;
+    // Sorted lookups search the typed order, which a custom sort function may not follow
+    m_Order = customSort ? FALSE : ascending;
     m_ColumnIndex = c;
 }
 
@@ -1568,20 +2746,15 @@ void CKDataArray::Unique(int c) {
     if (c < 0 || c >= m_FormatArray.Size())
         return;
 
-    g_ColumnIndex = c;
-    g_Operator = CKEQUAL;
-    g_Order = TRUE;
-
     Sort(c, TRUE);
 
-    ColumnFormat *fmt = m_FormatArray[c];
-    ArraySortFunction comparator = fmt->m_SortFunction;
+    const ColumnQuery query = MakeColumnQuery(c, m_FormatArray[c]->m_Type);
 
     for (int i = m_DataMatrix.Size() - 1; i > 0; --i) {
         CKDataRow *current = m_DataMatrix[i];
         CKDataRow *previous = m_DataMatrix[i - 1];
 
-        if (comparator(current, previous) == 0) {
+        if (CompareRows(query, current, previous) == 0) {
             RemoveRow(i);
         }
     }
@@ -1613,6 +2786,17 @@ CKDWORD CKDataArray::Sum(int c) {
         return 0;
 
     ColumnFormat *fmt = m_FormatArray[c];
+    if (fmt->m_Type != CKARRAYTYPE_INT && fmt->m_Type != CKARRAYTYPE_FLOAT)
+        return 0;
+
+    CKDataColumnStore *store = GetColumnStore(c);
+    if (store) {
+        const CKDWORD *values = store->m_Values.Begin();
+        const int rowCount = store->m_Values.Size();
+        if (fmt->m_Type == CKARRAYTYPE_INT)
+            return CKColumnSumInts(values, rowCount);
+        return static_cast<CKDWORD>(FloatToScalar(CKColumnSumFloats(values, rowCount)));
+    }
 
     if (fmt->m_Type == CKARRAYTYPE_INT) {
         CKUINTPTR sum = 0;
@@ -1644,7 +2828,17 @@ CKDWORD CKDataArray::Product(int c) {
         return 0;
 
     ColumnFormat *fmt = m_FormatArray[c];
-    g_ColumnIndex = c;
+    if (fmt->m_Type != CKARRAYTYPE_INT && fmt->m_Type != CKARRAYTYPE_FLOAT)
+        return 0;
+
+    CKDataColumnStore *store = GetColumnStore(c);
+    if (store) {
+        const CKDWORD *values = store->m_Values.Begin();
+        const int rowCount = store->m_Values.Size();
+        if (fmt->m_Type == CKARRAYTYPE_INT)
+            return CKColumnMultiplyInts(values, rowCount);
+        return static_cast<CKDWORD>(FloatToScalar(CKColumnMultiplyFloats(values, rowCount)));
+    }
 
     if (fmt->m_Type == CKARRAYTYPE_INT) {
         CKUINTPTR product = 1;
@@ -1675,19 +2869,22 @@ int CKDataArray::GetCount(int c, CK_COMPOPERATOR op, CKUINTPTR key, int size) {
     if (c < 0 || c >= m_FormatArray.Size())
         return 0;
 
-    g_ColumnIndex = c;
-    g_Operator = op;
-    g_Value = key;
-    g_ValueSize = size;
-
-    ArrayEqualFunction equalFunc = m_FormatArray[c]->m_EqualFunction;
     int count = 0;
+    ArrayEqualFunction equalFunction = GetCustomEqualFunction(c, op, key, size);
+    if (!equalFunction) {
+        if (IndexedLookup(c, op, key, 0, nullptr, &count))
+            return count;
+        if (PackedLookup(c, op, key, 0, nullptr, &count))
+            return count;
+    }
+
+    const ColumnQuery query = MakeColumnQuery(c, m_FormatArray[c]->m_Type, TRUE, op, key, size);
 
     CKDataRow **current = m_DataMatrix.Begin();
     CKDataRow **end = m_DataMatrix.End();
 
     while (current != end) {
-        if (equalFunc(*current)) {
+        if (equalFunction ? equalFunction(*current) : TestRowElement(query, *current)) {
             count++;
         }
         ++current;
@@ -1711,17 +2908,13 @@ void CKDataArray::CreateGroup(int mc, CK_COMPOPERATOR op, CKUINTPTR key, int siz
     if (elementFormat->m_Type != CKARRAYTYPE_OBJECT)
         return;
 
-    g_ColumnIndex = mc;
-    g_Operator = op;
-    g_Value = key;
-    g_ValueSize = size;
-
-    ArrayEqualFunction equalFunc = m_FormatArray[mc]->m_EqualFunction;
+    ArrayEqualFunction equalFunction = GetCustomEqualFunction(mc, op, key, size);
+    const ColumnQuery query = MakeColumnQuery(mc, m_FormatArray[mc]->m_Type, TRUE, op, key, size);
 
     for (CKDataMatrix::Iterator it = m_DataMatrix.Begin(); it != m_DataMatrix.End(); ++it) {
         CKDataRow *row = *it;
 
-        if (equalFunc(row)) {
+        if (equalFunction ? equalFunction(row) : TestRowElement(query, row)) {
             CKUINTPTR objID = (*row)[ec];
             CKObject *obj = m_Context->GetObject((CK_ID)objID);
             if (obj && CKIsChildClassOf(obj, CKCID_BEOBJECT)) {
@@ -1770,6 +2963,55 @@ void CKDataArray::PreSave(CKFile *file, CKDWORD flags) {
     }
 }
 
+void CKDataArray::WriteParameterElement(CKStateChunk *chunk, CKFile *file, CKUINTPTR element) {
+    CKParameterOut *param = (CKParameterOut *) element;
+    if (file) {
+        chunk->WriteObject(param);
+        return;
+    }
+    if (!param) {
+        chunk->WriteSubChunk(nullptr);
+        return;
+    }
+
+    CKBOOL owned = (param->GetOwner() == this);
+    if (owned)
+        param->SetOwner(nullptr);
+
+    CKStateChunk *paramChunk = param->Save(nullptr, CK_STATESAVE_PARAMETEROUT_ALL);
+    chunk->WriteSubChunk(paramChunk);
+
+    if (paramChunk) {
+        delete paramChunk;
+    }
+    if (owned)
+        param->SetOwner(this);
+}
+
+CKUINTPTR CKDataArray::ReadParameterElement(CKStateChunk *chunk, CKFile *file, ColumnFormat *fmt) {
+    if (file) {
+        // Load parameter reference
+        CK_ID paramId = chunk->ReadObjectID();
+        return (CKUINTPTR) m_Context->GetObject(paramId);
+    }
+
+    // Load parameter data
+    CKUINTPTR element = 0;
+    CKStateChunk *paramChunk = chunk->ReadSubChunk();
+    if (paramChunk) {
+        CKParameterOut *param = m_Context->CreateCKParameterOut(nullptr, fmt->m_ParameterType, IsDynamic());
+        if (param) {
+            param->Load(paramChunk, nullptr);
+            if (param->GetOwner() == nullptr)
+                param->SetOwner(this);
+            element = (CKUINTPTR) param;
+        }
+    }
+
+    delete paramChunk;
+    return element;
+}
+
 CKStateChunk *CKDataArray::Save(CKFile *file, CKDWORD flags) {
     CKStateChunk *baseChunk = CKBeObject::Save(file, flags);
 
@@ -1790,63 +3032,80 @@ CKStateChunk *CKDataArray::Save(CKFile *file, CKDWORD flags) {
         }
     }
 
-    chunk->WriteIdentifier(CK_STATESAVE_DATAARRAYDATA);
-    chunk->WriteInt(m_DataMatrix.Size());
-
-    for (int rowIdx = 0; rowIdx < m_DataMatrix.Size(); ++rowIdx) {
-        CKDataRow *row = m_DataMatrix[rowIdx];
-
-        for (int colIdx = 0; colIdx < m_FormatArray.Size(); ++colIdx) {
-            ColumnFormat *fmt = m_FormatArray[colIdx];
-            CKUINTPTR element = (*row)[colIdx];
-
-            switch (fmt->m_Type) {
-            case CKARRAYTYPE_INT:
-                chunk->WriteInt((int) element);
-                break;
-
-            case CKARRAYTYPE_FLOAT:
-                chunk->WriteFloat(ScalarToFloat(element));
-                break;
-
-            case CKARRAYTYPE_STRING: {
-                char *str = (char *) element;
-                chunk->WriteString(str ? str : (char *) "");
-                break;
-            }
-
-            case CKARRAYTYPE_OBJECT: {
-                CKObject *obj = m_Context->GetObject((CK_ID)element);
-                chunk->WriteObject(obj);
-                break;
+    // Pre-size the chunk for the cell data so large arrays are written
+    // without any intermediate reallocation. String sizes (0 for a null
+    // string, else the length + 1) are kept for the string blocks.
+    const int rowCount = m_DataMatrix.Size();
+    XArray<CKDWORD> stringSizes;
+    int cellDwords = 0;
+    for (int colIdx = 0; colIdx < m_FormatArray.Size(); ++colIdx) {
+        ColumnFormat *fmt = m_FormatArray[colIdx];
+        cellDwords += rowCount + 1;
+        if (fmt->m_Type == CKARRAYTYPE_STRING) {
+            for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx) {
+                char *str = (char *) (*m_DataMatrix[rowIdx])[colIdx];
+                const CKDWORD size = str ? (CKDWORD) strlen(str) + 1 : 0;
+                stringSizes.PushBack(size);
+                cellDwords += ((int) size + (int) sizeof(int) - 1) / (int) sizeof(int);
             }
+        }
+    }
+    chunk->Reserve(cellDwords + 8);
 
-            case CKARRAYTYPE_PARAMETER: {
-                CKParameterOut *param = (CKParameterOut *) element;
-                if (file) {
-                    chunk->WriteObject(param);
-                } else {
-                    if (!param) {
-                        chunk->WriteSubChunk(nullptr);
-                        break;
-                    }
+    // Each column is written as one block:
+    // - int and float columns as an array of dwords
+    // - string columns as the size of their text, an array of string sizes
+    //   (0 for a null string, else the length + 1) and the text of all strings
+    // - object columns as an object ID sequence
+    // - parameter columns element by element, as in CK_STATESAVE_DATAARRAYDATA
+    chunk->WriteIdentifier(CK_STATESAVE_DATAARRAYCOLUMNS);
+    chunk->WriteInt(rowCount);
 
-                    CKBOOL owned = (param->GetOwner() == this);
-                    if (owned)
-                        param->SetOwner(nullptr);
+    XArray<CKDWORD> values;
+    values.Resize(rowCount);
+    XArray<char> text;
+    CKDWORD *sizes = stringSizes.Begin();
+    for (int colIdx = 0; colIdx < m_FormatArray.Size(); ++colIdx) {
+        ColumnFormat *fmt = m_FormatArray[colIdx];
 
-                    CKStateChunk *paramChunk = param->Save(nullptr, CK_STATESAVE_PARAMETEROUT_ALL);
-                    chunk->WriteSubChunk(paramChunk);
+        switch (fmt->m_Type) {
+        case CKARRAYTYPE_INT:
+        case CKARRAYTYPE_FLOAT:
+            // Always from the rows, which the packed copy may lag behind
+            for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                values[rowIdx] = (CKDWORD) (*m_DataMatrix[rowIdx])[colIdx];
+            chunk->WriteBufferNoSize_LEndian(rowCount * sizeof(CKDWORD), values.Begin());
+            break;
 
-                    if (paramChunk) {
-                        delete paramChunk;
-                    }
-                    if (owned)
-                        param->SetOwner(this);
+        case CKARRAYTYPE_STRING: {
+            int textSize = 0;
+            for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                textSize += (int) sizes[rowIdx];
+            text.Resize(textSize);
+            char *dst = text.Begin();
+            for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx) {
+                if (sizes[rowIdx]) {
+                    memcpy(dst, (char *) (*m_DataMatrix[rowIdx])[colIdx], sizes[rowIdx]);
+                    dst += sizes[rowIdx];
                 }
-                break;
-            }
             }
+            chunk->WriteInt(textSize);
+            chunk->WriteBufferNoSize_LEndian(rowCount * sizeof(CKDWORD), sizes);
+            chunk->WriteBufferNoSize(textSize, text.Begin());
+            sizes += rowCount;
+            break;
+        }
+
+        case CKARRAYTYPE_OBJECT:
+            chunk->StartObjectIDSequence(rowCount);
+            for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                chunk->WriteObjectSequence(m_Context->GetObject((CK_ID) (*m_DataMatrix[rowIdx])[colIdx]));
+            break;
+
+        case CKARRAYTYPE_PARAMETER:
+            for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                WriteParameterElement(chunk, file, (*m_DataMatrix[rowIdx])[colIdx]);
+            break;
         }
     }
 
@@ -1918,7 +3177,78 @@ CKERROR CKDataArray::Load(CKStateChunk *chunk, CKFile *file) {
     }
 
     // Load data rows
-    if (chunk->SeekIdentifier(CK_STATESAVE_DATAARRAYDATA)) {
+    const int columnsSize = chunk->SeekIdentifierAndReturnSize(CK_STATESAVE_DATAARRAYCOLUMNS);
+    if (columnsSize >= (int) sizeof(int)) {
+        const int rowCount = chunk->ReadInt();
+        const int columnCount = m_FormatArray.Size();
+        // Every column holds at least a DWORD per row
+        if (rowCount < 0 ||
+            (columnCount > 0 && rowCount > (columnsSize - (int) sizeof(int)) / (int) sizeof(CKDWORD)))
+            return CKERR_INVALIDFILE;
+        const int firstRow = m_DataMatrix.Size();
+        m_DataMatrix.Reserve(firstRow + rowCount);
+        for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx) {
+            CKDataRow *newRow = new CKDataRow();
+            newRow->Resize(columnCount);
+            m_DataMatrix.PushBack(newRow);
+        }
+        CKDataRow **rows = m_DataMatrix.Begin() + firstRow;
+
+        XArray<CKDWORD> values;
+        values.Resize(rowCount);
+        XArray<char> text;
+        for (int colIdx = 0; colIdx < columnCount; ++colIdx) {
+            ColumnFormat *fmt = m_FormatArray[colIdx];
+
+            switch (fmt->m_Type) {
+            case CKARRAYTYPE_INT:
+            case CKARRAYTYPE_FLOAT:
+                chunk->ReadAndFillBuffer_LEndian(rowCount * sizeof(CKDWORD), values.Begin());
+                for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                    (*rows[rowIdx])[colIdx] = values[rowIdx];
+                break;
+
+            case CKARRAYTYPE_STRING: {
+                const int textSize = chunk->ReadInt();
+                chunk->ReadAndFillBuffer_LEndian(rowCount * sizeof(CKDWORD), values.Begin());
+                text.Resize(textSize > 0 ? textSize : 0);
+                chunk->ReadAndFillBuffer(text.Size(), text.Begin());
+                int offset = 0;
+                for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx) {
+                    const int size = (int) values[rowIdx];
+                    char *str = nullptr;
+                    if (size > 0 && size <= text.Size() - offset) {
+                        str = new char[size];
+                        memcpy(str, text.Begin() + offset, size);
+                        str[size - 1] = '\0';
+                        offset += size;
+                    }
+                    (*rows[rowIdx])[colIdx] = (CKUINTPTR) str;
+                }
+                break;
+            }
+
+            case CKARRAYTYPE_OBJECT: {
+                const XObjectArray &ids = chunk->ReadXObjectArray();
+                for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                    (*rows[rowIdx])[colIdx] = (rowIdx < ids.Size()) ? ids[rowIdx] : 0;
+                break;
+            }
+
+            case CKARRAYTYPE_PARAMETER:
+                for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                    (*rows[rowIdx])[colIdx] = ReadParameterElement(chunk, file, fmt);
+                break;
+
+            default:
+                for (int rowIdx = 0; rowIdx < rowCount; ++rowIdx)
+                    (*rows[rowIdx])[colIdx] = 0;
+                break;
+            }
+        }
+        InvalidateColumnIndexes();
+    } else if (chunk->SeekIdentifier(CK_STATESAVE_DATAARRAYDATA)) {
+        // Row by row layout of the files saved before CK_STATESAVE_DATAARRAYCOLUMNS
         int rowCount = chunk->ReadInt();
         m_DataMatrix.Reserve(rowCount);
 
@@ -1952,36 +3282,14 @@ CKERROR CKDataArray::Load(CKStateChunk *chunk, CKFile *file) {
                     element = chunk->ReadObjectID();
                     break;
 
-                case CKARRAYTYPE_PARAMETER: {
-                    if (file) {
-                        // Load parameter reference
-                        CK_ID paramId = chunk->ReadObjectID();
-                        element = (CKUINTPTR) m_Context->GetObject(paramId);
-                    } else {
-                        // Load parameter data
-                        CKStateChunk *paramChunk = chunk->ReadSubChunk();
-                        if (paramChunk) {
-                            CKParameterOut *param = m_Context->CreateCKParameterOut(nullptr, fmt->m_ParameterType, IsDynamic());
-                            if (param) {
-                                param->Load(paramChunk, nullptr);
-                                if (param->GetOwner() == nullptr)
-                                    param->SetOwner(this);
-                                element = (CKUINTPTR) param;
-                            } else {
-                                element = 0;
-                            }
-                        } else {
-                            element = 0;
-                        }
-
-                        delete paramChunk;
-                    }
+                case CKARRAYTYPE_PARAMETER:
+                    element = ReadParameterElement(chunk, file, fmt);
                     break;
                 }
-                }
             }
             m_DataMatrix.PushBack(newRow);
         }
+        InvalidateColumnIndexes();
     }
 
     // Load additional properties
@@ -2083,6 +3391,7 @@ void CKDataArray::CheckPostDeletion() {
 
             if (!m_Context->GetObject((CK_ID)objectId)) {
                 objectId = 0; // Clear invalid reference
+                ColumnDataChanged(objectCol);
             }
         }
     }
@@ -2100,6 +3409,18 @@ int CKDataArray::GetMemoryOccupation() {
         if (fmt->m_Name) {
             size += (int) ((int)strlen(fmt->m_Name) + 1);
         }
+        if (fmt->m_Index) {
+            CKDataColumnIndex *index = fmt->m_Index;
+            size += (int) sizeof(*index);
+            size += index->m_Chains.GetMemoryOccupation(FALSE);
+            size += index->m_Next.GetMemoryOccupation(FALSE);
+            size += index->m_Previous.GetMemoryOccupation(FALSE);
+            size += index->m_SortedRows.GetMemoryOccupation(FALSE);
+        }
+        if (fmt->m_Store) {
+            size += (int) sizeof(*fmt->m_Store);
+            size += fmt->m_Store->m_Values.GetMemoryOccupation(FALSE);
+        }
     }
 
     size += m_DataMatrix.GetMemoryOccupation(FALSE);
@@ -2269,6 +3590,11 @@ CKERROR CKDataArray::RemapDependencies(CKDependenciesContext &context) {
                 }
             }
         }
+
+        for (int colIdx = 0; colIdx < m_FormatArray.Size(); ++colIdx) {
+            if (m_FormatArray[colIdx]->m_Type == CKARRAYTYPE_OBJECT)
+                ColumnDataChanged(colIdx);
+        }
     }
 
     return CK_OK;
@@ -2306,7 +3632,7 @@ CKERROR CKDataArray::Copy(CKObject &o, CKDependenciesContext &context) {
     int columnCount = m_FormatArray.Size();
 
     for (int rowIdx = 0; rowIdx < srcRowCount; ++rowIdx) {
-        CKDataRow *srcRow = src->GetRow(rowIdx);
+        CKDataRow *srcRow = src->m_DataMatrix[rowIdx];
         CKUINTPTR *srcData = srcRow->Begin();
 
         CKDataRow *newRow = new CKDataRow();
@@ -2355,6 +3681,7 @@ void CKDataArray::Register() {
     CKClassNeedNotificationFrom(m_ClassID, CKObject::m_ClassID);
     CKClassRegisterAssociatedParameter(m_ClassID, CKPGUID_DATAARRAY);
     CKClassRegisterDefaultDependencies(m_ClassID, 2, 1);
+    CKClassRegisterDefaultOptions(m_ClassID, CK_GENERALOPTIONS_SAVETHREADSAFE);
 }
 
 CKDataArray *CKDataArray::CreateInstance(CKContext *Context) {
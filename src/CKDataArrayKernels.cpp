@@ -0,0 +1,442 @@
+#include "CKDataArrayKernels.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CK_COLUMN_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CK_COLUMN_NEON
+#endif
+
+static inline float ToFloat(CKDWORD value) {
+    float result;
+    memcpy(&result, &value, sizeof(float));
+    return result;
+}
+
+static inline CKDWORD ToDword(float value) {
+    CKDWORD result;
+    memcpy(&result, &value, sizeof(float));
+    return result;
+}
+
+#if defined(CK_COLUMN_SSE2)
+#define CK_COLUMN_SIMD
+typedef __m128i IntVector;
+typedef __m128 FloatVector;
+
+static inline IntVector LoadInts(const CKDWORD *values) { return _mm_loadu_si128((const __m128i *) values); }
+static inline void StoreInts(CKDWORD *values, IntVector v) { _mm_storeu_si128((__m128i *) values, v); }
+static inline IntVector SplatInt(CKDWORD value) { return _mm_set1_epi32((int) value); }
+static inline FloatVector LoadFloats(const CKDWORD *values) { return _mm_castsi128_ps(LoadInts(values)); }
+static inline void StoreFloats(CKDWORD *values, FloatVector v) { StoreInts(values, _mm_castps_si128(v)); }
+static inline FloatVector SplatFloat(float value) { return _mm_set1_ps(value); }
+
+// SSE2 has no 32 bit multiply: multiply the even and odd lanes as 64 bits and keep the low halves
+static inline IntVector MulLo32(IntVector a, IntVector b) {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline IntVector SelectInts(IntVector mask, IntVector a, IntVector b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#elif defined(CK_COLUMN_NEON)
+#define CK_COLUMN_SIMD
+typedef uint32x4_t IntVector;
+typedef float32x4_t FloatVector;
+
+static inline IntVector LoadInts(const CKDWORD *values) { return vld1q_u32(values); }
+static inline void StoreInts(CKDWORD *values, IntVector v) { vst1q_u32(values, v); }
+static inline IntVector SplatInt(CKDWORD value) { return vdupq_n_u32(value); }
+static inline FloatVector LoadFloats(const CKDWORD *values) { return vreinterpretq_f32_u32(vld1q_u32(values)); }
+static inline void StoreFloats(CKDWORD *values, FloatVector v) { vst1q_u32(values, vreinterpretq_u32_f32(v)); }
+static inline FloatVector SplatFloat(float value) { return vdupq_n_f32(value); }
+#endif
+
+// Element operations, on four lanes and on one element. Integer operations are
+// done on unsigned values, which wrap the way the int operations do.
+struct IntAdd
+{
+#if defined(CK_COLUMN_SSE2)
+    static IntVector Vector(IntVector x, IntVector y) { return _mm_add_epi32(x, y); }
+#elif defined(CK_COLUMN_NEON)
+    static IntVector Vector(IntVector x, IntVector y) { return vaddq_u32(x, y); }
+#endif
+    static CKDWORD Scalar(CKDWORD x, CKDWORD y) { return x + y; }
+};
+
+struct IntSub
+{
+#if defined(CK_COLUMN_SSE2)
+    static IntVector Vector(IntVector x, IntVector y) { return _mm_sub_epi32(x, y); }
+#elif defined(CK_COLUMN_NEON)
+    static IntVector Vector(IntVector x, IntVector y) { return vsubq_u32(x, y); }
+#endif
+    static CKDWORD Scalar(CKDWORD x, CKDWORD y) { return x - y; }
+};
+
+struct IntMul
+{
+#if defined(CK_COLUMN_SSE2)
+    static IntVector Vector(IntVector x, IntVector y) { return MulLo32(x, y); }
+#elif defined(CK_COLUMN_NEON)
+    static IntVector Vector(IntVector x, IntVector y) { return vmulq_u32(x, y); }
+#endif
+    static CKDWORD Scalar(CKDWORD x, CKDWORD y) { return x * y; }
+};
+
+struct FloatAdd
+{
+#if defined(CK_COLUMN_SSE2)
+    static FloatVector Vector(FloatVector x, FloatVector y) { return _mm_add_ps(x, y); }
+#elif defined(CK_COLUMN_NEON)
+    static FloatVector Vector(FloatVector x, FloatVector y) { return vaddq_f32(x, y); }
+#endif
+    static float Scalar(float x, float y) { return x + y; }
+};
+
+struct FloatSub
+{
+#if defined(CK_COLUMN_SSE2)
+    static FloatVector Vector(FloatVector x, FloatVector y) { return _mm_sub_ps(x, y); }
+#elif defined(CK_COLUMN_NEON)
+    static FloatVector Vector(FloatVector x, FloatVector y) { return vsubq_f32(x, y); }
+#endif
+    static float Scalar(float x, float y) { return x - y; }
+};
+
+struct FloatMul
+{
+#if defined(CK_COLUMN_SSE2)
+    static FloatVector Vector(FloatVector x, FloatVector y) { return _mm_mul_ps(x, y); }
+#elif defined(CK_COLUMN_NEON)
+    static FloatVector Vector(FloatVector x, FloatVector y) { return vmulq_f32(x, y); }
+#endif
+    static float Scalar(float x, float y) { return x * y; }
+};
+
+// A division by 0 gives 0, NaN divisors divide
+struct FloatDiv
+{
+#if defined(CK_COLUMN_SSE2)
+    static FloatVector Vector(FloatVector x, FloatVector y) {
+        return _mm_and_ps(_mm_cmpneq_ps(y, _mm_setzero_ps()), _mm_div_ps(x, y));
+    }
+#elif defined(CK_COLUMN_NEON)
+    static FloatVector Vector(FloatVector x, FloatVector y) {
+        const uint32x4_t isZero = vceqq_f32(y, vdupq_n_f32(0.0f));
+        return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(vdivq_f32(x, y)), isZero));
+    }
+#endif
+    static float Scalar(float x, float y) { return (y != 0.0f) ? x / y : 0.0f; }
+};
+
+template <class Op>
+static void OperateIntLoop(const CKDWORD *a, const CKDWORD *b, CKDWORD *result, int count) {
+    int i = 0;
+#if defined(CK_COLUMN_SIMD)
+    for (; i + 4 <= count; i += 4)
+        StoreInts(result + i, Op::Vector(LoadInts(a + i), LoadInts(b + i)));
+#endif
+    for (; i < count; ++i)
+        result[i] = Op::Scalar(a[i], b[i]);
+}
+
+template <class Op>
+static void TransformIntLoop(CKDWORD *values, int count, CKDWORD operand) {
+    int i = 0;
+#if defined(CK_COLUMN_SIMD)
+    const IntVector k = SplatInt(operand);
+    for (; i + 4 <= count; i += 4)
+        StoreInts(values + i, Op::Vector(LoadInts(values + i), k));
+#endif
+    for (; i < count; ++i)
+        values[i] = Op::Scalar(values[i], operand);
+}
+
+template <class Op>
+static void OperateFloatLoop(const CKDWORD *a, const CKDWORD *b, CKDWORD *result, int count) {
+    int i = 0;
+#if defined(CK_COLUMN_SIMD)
+    for (; i + 4 <= count; i += 4)
+        StoreFloats(result + i, Op::Vector(LoadFloats(a + i), LoadFloats(b + i)));
+#endif
+    for (; i < count; ++i)
+        result[i] = ToDword(Op::Scalar(ToFloat(a[i]), ToFloat(b[i])));
+}
+
+template <class Op>
+static void TransformFloatLoop(CKDWORD *values, int count, float operand) {
+    int i = 0;
+#if defined(CK_COLUMN_SIMD)
+    const FloatVector k = SplatFloat(operand);
+    for (; i + 4 <= count; i += 4)
+        StoreFloats(values + i, Op::Vector(LoadFloats(values + i), k));
+#endif
+    for (; i < count; ++i)
+        values[i] = ToDword(Op::Scalar(ToFloat(values[i]), operand));
+}
+
+// First element equal to value, the extremum having been found beforehand
+static int FindFirstInt(const CKDWORD *values, int count, int value) {
+    for (int i = 0; i < count; ++i) {
+        if ((int) values[i] == value)
+            return i;
+    }
+    return 0;
+}
+
+static int FindFirstFloat(const CKDWORD *values, int count, float value) {
+    for (int i = 0; i < count; ++i) {
+        if (ToFloat(values[i]) == value)
+            return i;
+    }
+    return 0;
+}
+
+CKDWORD CKColumnSumInts(const CKDWORD *values, int count) {
+    CKDWORD sum = 0;
+    int i = 0;
+#if defined(CK_COLUMN_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4)
+        acc = _mm_add_epi32(acc, LoadInts(values + i));
+    CKDWORD lanes[4];
+    StoreInts(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(CK_COLUMN_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 4 <= count; i += 4)
+        acc = vaddq_u32(acc, vld1q_u32(values + i));
+    sum = vaddvq_u32(acc);
+#endif
+    // Integer sums wrap, their order does not matter
+    for (; i < count; ++i)
+        sum += values[i];
+    return sum;
+}
+
+CKDWORD CKColumnMultiplyInts(const CKDWORD *values, int count) {
+    CKDWORD product = 1;
+    int i = 0;
+#if defined(CK_COLUMN_SSE2)
+    __m128i acc = _mm_set1_epi32(1);
+    for (; i + 4 <= count; i += 4)
+        acc = MulLo32(acc, LoadInts(values + i));
+    CKDWORD lanes[4];
+    StoreInts(lanes, acc);
+    product = lanes[0] * lanes[1] * lanes[2] * lanes[3];
+#elif defined(CK_COLUMN_NEON)
+    uint32x4_t acc = vdupq_n_u32(1);
+    for (; i + 4 <= count; i += 4)
+        acc = vmulq_u32(acc, vld1q_u32(values + i));
+    product = vgetq_lane_u32(acc, 0) * vgetq_lane_u32(acc, 1) * vgetq_lane_u32(acc, 2) * vgetq_lane_u32(acc, 3);
+#endif
+    for (; i < count; ++i)
+        product *= values[i];
+    return product;
+}
+
+float CKColumnSumFloats(const CKDWORD *values, int count) {
+    int i = 0;
+    float sum;
+#if defined(CK_COLUMN_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+        acc = _mm_add_ps(acc, LoadFloats(values + i));
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+#elif defined(CK_COLUMN_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4)
+        acc = vaddq_f32(acc, LoadFloats(values + i));
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+#else
+    float lanes[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (; i + 4 <= count; i += 4) {
+        for (int l = 0; l < 4; ++l)
+            lanes[l] += ToFloat(values[i + l]);
+    }
+#endif
+    sum = (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+    for (; i < count; ++i)
+        sum += ToFloat(values[i]);
+    return sum;
+}
+
+float CKColumnMultiplyFloats(const CKDWORD *values, int count) {
+    int i = 0;
+    float product;
+#if defined(CK_COLUMN_SSE2)
+    __m128 acc = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4)
+        acc = _mm_mul_ps(acc, LoadFloats(values + i));
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+#elif defined(CK_COLUMN_NEON)
+    float32x4_t acc = vdupq_n_f32(1.0f);
+    for (; i + 4 <= count; i += 4)
+        acc = vmulq_f32(acc, LoadFloats(values + i));
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+#else
+    float lanes[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (; i + 4 <= count; i += 4) {
+        for (int l = 0; l < 4; ++l)
+            lanes[l] *= ToFloat(values[i + l]);
+    }
+#endif
+    product = (lanes[0] * lanes[2]) * (lanes[1] * lanes[3]);
+    for (; i < count; ++i)
+        product *= ToFloat(values[i]);
+    return product;
+}
+
+int CKColumnFindIntExtremum(const CKDWORD *values, int count, CKBOOL highest) {
+    if (count <= 0)
+        return 0;
+
+    int best = (int) values[0];
+    int i = 0;
+#if defined(CK_COLUMN_SSE2)
+    __m128i acc = _mm_set1_epi32(best);
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = LoadInts(values + i);
+        const __m128i better = highest ? _mm_cmpgt_epi32(v, acc) : _mm_cmplt_epi32(v, acc);
+        acc = SelectInts(better, v, acc);
+    }
+    int lanes[4];
+    StoreInts((CKDWORD *) lanes, acc);
+    for (int l = 0; l < 4; ++l) {
+        if (highest ? (lanes[l] > best) : (lanes[l] < best))
+            best = lanes[l];
+    }
+#elif defined(CK_COLUMN_NEON)
+    int32x4_t acc = vdupq_n_s32(best);
+    for (; i + 4 <= count; i += 4) {
+        const int32x4_t v = vreinterpretq_s32_u32(vld1q_u32(values + i));
+        acc = highest ? vmaxq_s32(acc, v) : vminq_s32(acc, v);
+    }
+    best = highest ? vmaxvq_s32(acc) : vminvq_s32(acc);
+#endif
+    for (; i < count; ++i) {
+        const int value = (int) values[i];
+        if (highest ? (value > best) : (value < best))
+            best = value;
+    }
+    return FindFirstInt(values, count, best);
+}
+
+int CKColumnFindFloatExtremum(const CKDWORD *values, int count, CKBOOL highest) {
+    if (count <= 0)
+        return 0;
+
+    // Nothing compares with a NaN first element
+    float best = ToFloat(values[0]);
+    if (best != best)
+        return 0;
+
+    int i = 0;
+#if defined(CK_COLUMN_SSE2)
+    // NaN elements are replaced by the first element, which takes part anyway
+    const __m128 first = _mm_set1_ps(best);
+    __m128 acc = first;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = LoadFloats(values + i);
+        const __m128 ordered = _mm_cmpord_ps(v, v);
+        const __m128 x = _mm_or_ps(_mm_and_ps(ordered, v), _mm_andnot_ps(ordered, first));
+        acc = highest ? _mm_max_ps(acc, x) : _mm_min_ps(acc, x);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    for (int l = 0; l < 4; ++l) {
+        if (highest ? (lanes[l] > best) : (lanes[l] < best))
+            best = lanes[l];
+    }
+#elif defined(CK_COLUMN_NEON)
+    const float32x4_t first = vdupq_n_f32(best);
+    float32x4_t acc = first;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t v = LoadFloats(values + i);
+        const float32x4_t x = vbslq_f32(vceqq_f32(v, v), v, first);
+        acc = highest ? vmaxq_f32(acc, x) : vminq_f32(acc, x);
+    }
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    for (int l = 0; l < 4; ++l) {
+        if (highest ? (lanes[l] > best) : (lanes[l] < best))
+            best = lanes[l];
+    }
+#endif
+    for (; i < count; ++i) {
+        const float value = ToFloat(values[i]);
+        if (highest ? (value > best) : (value < best))
+            best = value;
+    }
+    // -0 and 0 are equal: the first of them is the one the scalar loop keeps
+    return FindFirstFloat(values, count, best);
+}
+
+void CKColumnTransformInts(CKDWORD *values, int count, CK_BINARYOPERATOR op, int operand) {
+    switch (op) {
+    case CKADD: TransformIntLoop<IntAdd>(values, count, (CKDWORD) operand); break;
+    case CKSUB: TransformIntLoop<IntSub>(values, count, (CKDWORD) operand); break;
+    case CKMUL: TransformIntLoop<IntMul>(values, count, (CKDWORD) operand); break;
+    case CKDIV:
+        // No vector integer division
+        if (operand != 0) {
+            for (int i = 0; i < count; ++i)
+                values[i] = (CKDWORD) ((int) values[i] / operand);
+        }
+        break;
+    default: break;
+    }
+}
+
+void CKColumnTransformFloats(CKDWORD *values, int count, CK_BINARYOPERATOR op, float operand) {
+    switch (op) {
+    case CKADD: TransformFloatLoop<FloatAdd>(values, count, operand); break;
+    case CKSUB: TransformFloatLoop<FloatSub>(values, count, operand); break;
+    case CKMUL: TransformFloatLoop<FloatMul>(values, count, operand); break;
+    case CKDIV:
+        if (operand != 0.0f)
+            TransformFloatLoop<FloatDiv>(values, count, operand);
+        break;
+    default: break;
+    }
+}
+
+void CKColumnOperateInts(const CKDWORD *a, const CKDWORD *b, CKDWORD *result, int count, CK_BINARYOPERATOR op) {
+    switch (op) {
+    case CKADD: OperateIntLoop<IntAdd>(a, b, result, count); break;
+    case CKSUB: OperateIntLoop<IntSub>(a, b, result, count); break;
+    case CKMUL: OperateIntLoop<IntMul>(a, b, result, count); break;
+    case CKDIV:
+        for (int i = 0; i < count; ++i) {
+            const int divisor = (int) b[i];
+            result[i] = (divisor != 0) ? (CKDWORD) ((int) a[i] / divisor) : 0;
+        }
+        break;
+    default:
+        memset(result, 0, count * sizeof(CKDWORD));
+        break;
+    }
+}
+
+void CKColumnOperateFloats(const CKDWORD *a, const CKDWORD *b, CKDWORD *result, int count, CK_BINARYOPERATOR op) {
+    switch (op) {
+    case CKADD: OperateFloatLoop<FloatAdd>(a, b, result, count); break;
+    case CKSUB: OperateFloatLoop<FloatSub>(a, b, result, count); break;
+    case CKMUL: OperateFloatLoop<FloatMul>(a, b, result, count); break;
+    case CKDIV: OperateFloatLoop<FloatDiv>(a, b, result, count); break;
+    default:
+        memset(result, 0, count * sizeof(CKDWORD));
+        break;
+    }
+}
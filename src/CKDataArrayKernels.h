@@ -0,0 +1,33 @@
+#ifndef CKDATAARRAYKERNELS_H
+#define CKDATAARRAYKERNELS_H
+
+#include "CKDefines.h"
+
+// Loops over packed data array columns (see CKDataColumnStore), on four elements
+// at a time with SSE2 or NEON when available.
+//
+// Every kernel gives the result of the scalar loop bit for bit, on all platforms,
+// except the float sum and product: these accumulate four lanes (elements i, i+4,
+// i+8...) separately and combine them as (l0 + l2) + (l1 + l3) before the last
+// count % 4 elements, so their rounding can differ from a sum in row order. The
+// lane order is the same without SIMD, so the result does not depend on the platform.
+
+CKDWORD CKColumnSumInts(const CKDWORD *values, int count);
+CKDWORD CKColumnMultiplyInts(const CKDWORD *values, int count);
+float CKColumnSumFloats(const CKDWORD *values, int count);
+float CKColumnMultiplyFloats(const CKDWORD *values, int count);
+
+// First element holding the highest (or lowest) value. NaN elements are skipped,
+// unless the first element is NaN in which case it is returned.
+int CKColumnFindIntExtremum(const CKDWORD *values, int count, CKBOOL highest);
+int CKColumnFindFloatExtremum(const CKDWORD *values, int count, CKBOOL highest);
+
+// values[i] = values[i] op operand. A division by 0 leaves the values unchanged.
+void CKColumnTransformInts(CKDWORD *values, int count, CK_BINARYOPERATOR op, int operand);
+void CKColumnTransformFloats(CKDWORD *values, int count, CK_BINARYOPERATOR op, float operand);
+
+// result[i] = a[i] op b[i]. A division by 0 gives 0. result may be a or b.
+void CKColumnOperateInts(const CKDWORD *a, const CKDWORD *b, CKDWORD *result, int count, CK_BINARYOPERATOR op);
+void CKColumnOperateFloats(const CKDWORD *a, const CKDWORD *b, CKDWORD *result, int count, CK_BINARYOPERATOR op);
+
+#endif // CKDATAARRAYKERNELS_H
@@ -9,7 +9,10 @@
 #include "CKBeObject.h"
 #include "CKInterfaceObjectManager.h"
 
+#include <miniz.h>
 #include <climits>
+#include <atomic>
+#include <thread>
 
 struct CKFileHeaderPart0 {
     char Signature[8];
@@ -40,6 +43,24 @@ struct CKFileHeader {
 extern XClassInfoArray g_CKClassInfo;
 extern CK_CLASSID g_MaxClassID;
 
+struct CKFileSaveJob {
+    CKObject *Object;
+    CKFileObject *FileObject;
+};
+
+// Worker loop for CKFile::SaveObjectChunks: jobs are picked in order from a
+// shared counter, each job only touches its own CKFileObject entry.
+static void SaveObjectChunksWorker(CKFile *file, XArray<CKFileSaveJob> *jobs, std::atomic<int> *next) {
+    const int jobCount = jobs->Size();
+    for (int i = (*next)++; i < jobCount; i = (*next)++) {
+        CKFileSaveJob &job = (*jobs)[i];
+        CKStateChunk *chunk = job.Object->Save(file, job.FileObject->SaveFlags);
+        if (chunk)
+            chunk->CloseChunk();
+        job.FileObject->Data = chunk;
+    }
+}
+
 static CKBOOL WarningForOlderVersion = FALSE;
 static CKDWORD CurrentFileVersion = 0;
 static CKDWORD CurrentFileWriteMode = CKFILE_UNCOMPRESSED;
@@ -166,6 +187,16 @@ CKStateChunk *CKBufferParser::ExtractChunk(int Size, CKFile *f) {
     return chunk;
 }
 
+CKStateChunk *CKBufferParser::ExtractChunkView(int Size, CKFile *f) {
+    auto *chunk = CreateCKStateChunk(0, f);
+    if (!chunk->ConvertFromBuffer(&m_Buffer[m_CursorPos], TRUE)) {
+        delete chunk;
+        chunk = nullptr;
+    }
+    m_CursorPos += Size;
+    return chunk;
+}
+
 void CKBufferParser::ExtractChunk(int Size, CKFile *f, CKFileChunk *chunk) {
 }
 
@@ -241,6 +272,191 @@ CKBufferParser *CKBufferParser::Pack(int Size, int CompressionLevel) {
 void CKBufferParser::Encode(int Size, CKDWORD *Key) {
 }
 
+// Size of the window used to inflate / deflate whole-compressed file data
+#define CK_STREAM_WINDOW_SIZE (1 << 20)
+
+/*********************************************************
+Read-only parser over a deflated buffer: data is inflated
+on demand into a bounded window instead of being unpacked
+in one piece, so chunks can be extracted while the rest of
+the data is still compressed.
+*********************************************************/
+class CKInflateParser
+{
+public:
+    CKInflateParser(const char *PackedData, int PackSize, int UnpackSize)
+        : m_Window(nullptr), m_WindowSize(0), m_CursorPos(0), m_End(0), m_Valid(FALSE) {
+        memset(&m_Stream, 0, sizeof(z_stream));
+        if (!PackedData || PackSize <= 0 || UnpackSize < 0)
+            return;
+        m_Stream.next_in = (const unsigned char *) PackedData;
+        m_Stream.avail_in = (unsigned int) PackSize;
+        if (inflateInit(&m_Stream) != Z_OK)
+            return;
+        m_WindowSize = (UnpackSize < CK_STREAM_WINDOW_SIZE) ? UnpackSize : CK_STREAM_WINDOW_SIZE;
+        m_Window = new char[m_WindowSize > 0 ? m_WindowSize : 1];
+        m_Valid = TRUE;
+    }
+
+    ~CKInflateParser() {
+        if (m_Window) {
+            inflateEnd(&m_Stream);
+            delete[] m_Window;
+        }
+    }
+
+    CKBOOL IsValid() { return m_Valid; }
+
+    CKBOOL Read(void *x, int size) {
+        if (size < 0 || !Fill(size))
+            return FALSE;
+        memcpy(x, &m_Window[m_CursorPos], size);
+        m_CursorPos += size;
+        return TRUE;
+    }
+
+    int ReadInt() {
+        int val = 0;
+        Read(&val, sizeof(int));
+        return val;
+    }
+
+    void Skip(int size) {
+        while (size > 0) {
+            if (m_CursorPos == m_End && !Fill(1))
+                return;
+            int count = m_End - m_CursorPos;
+            if (count > size)
+                count = size;
+            m_CursorPos += count;
+            size -= count;
+        }
+    }
+
+    CKStateChunk *ExtractChunk(int Size, CKFile *f) {
+        if (Size < 0 || !Fill(Size))
+            return nullptr;
+        CKStateChunk *chunk = CreateCKStateChunk(0, f);
+        if (!chunk->ConvertFromBuffer(&m_Window[m_CursorPos])) {
+            delete chunk;
+            chunk = nullptr;
+        }
+        m_CursorPos += Size;
+        return chunk;
+    }
+
+protected:
+    // Makes sure Size contiguous bytes are available at the cursor,
+    // the window only grows when a single chunk is larger than it.
+    CKBOOL Fill(int Size) {
+        if (!m_Valid)
+            return FALSE;
+        if (m_End - m_CursorPos >= Size)
+            return TRUE;
+
+        const int remaining = m_End - m_CursorPos;
+        if (Size > m_WindowSize) {
+            char *window = new char[Size];
+            memcpy(window, &m_Window[m_CursorPos], remaining);
+            delete[] m_Window;
+            m_Window = window;
+            m_WindowSize = Size;
+        } else if (remaining > 0) {
+            memmove(m_Window, &m_Window[m_CursorPos], remaining);
+        }
+        m_CursorPos = 0;
+        m_End = remaining;
+
+        while (m_End < Size) {
+            m_Stream.next_out = (unsigned char *) &m_Window[m_End];
+            m_Stream.avail_out = (unsigned int) (m_WindowSize - m_End);
+            int ret = inflate(&m_Stream, Z_NO_FLUSH);
+            m_End = m_WindowSize - (int) m_Stream.avail_out;
+            if (ret == Z_STREAM_END)
+                break;
+            if (ret != Z_OK) {
+                m_Valid = FALSE;
+                return FALSE;
+            }
+        }
+
+        if (m_End < Size) {
+            m_Valid = FALSE;
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    z_stream m_Stream;
+    char *m_Window;
+    int m_WindowSize;
+    int m_CursorPos;
+    int m_End;
+    CKBOOL m_Valid;
+};
+
+// Deflates Size bytes of Data straight into fp through a bounded output window.
+// Returns the packed size, or 0 if packing failed or did not make the data smaller.
+// PackedCRC receives the adler32 (seeded with 1) of the written bytes.
+static int WritePackedData(FILE *fp, const char *Data, int Size, int CompressionLevel, CKDWORD &PackedCRC) {
+    PackedCRC = 1;
+    if (!Data || Size <= 0)
+        return 0;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    if (deflateInit(&stream, CompressionLevel) != Z_OK)
+        return 0;
+
+    char *window = new char[CK_STREAM_WINDOW_SIZE];
+    stream.next_in = (const unsigned char *) Data;
+    stream.avail_in = (unsigned int) Size;
+
+    int packSize = 0;
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        stream.next_out = (unsigned char *) window;
+        stream.avail_out = CK_STREAM_WINDOW_SIZE;
+        ret = deflate(&stream, Z_FINISH);
+        if (ret != Z_OK && ret != Z_STREAM_END)
+            break;
+
+        const int count = CK_STREAM_WINDOW_SIZE - (int) stream.avail_out;
+        if (count > 0) {
+            packSize += count;
+            if (packSize >= Size || fwrite(window, count, 1, fp) != 1) {
+                ret = Z_ERRNO;
+                break;
+            }
+            PackedCRC = CKComputeDataCRC(window, count, PackedCRC);
+        }
+    }
+
+    deflateEnd(&stream);
+    delete[] window;
+    return (ret == Z_STREAM_END) ? packSize : 0;
+}
+
+// Checksum of A followed by B given the running adler32 of A and the
+// adler32 of B seeded with 1 (same as zlib adler32_combine).
+static CKDWORD CombineAdler32(CKDWORD adler1, CKDWORD adler2, CKDWORD len2) {
+    const CKDWORD base = 65521;
+    const CKDWORD rem = len2 % base;
+    CKDWORD sum1 = adler1 & 0xFFFF;
+    CKDWORD sum2 = (rem * sum1) % base;
+    sum1 += (adler2 & 0xFFFF) + base - 1;
+    sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + base - rem;
+    if (sum1 >= base)
+        sum1 -= base;
+    if (sum1 >= base)
+        sum1 -= base;
+    if (sum2 >= (base << 1))
+        sum2 -= (base << 1);
+    if (sum2 >= base)
+        sum2 -= base;
+    return sum1 | (sum2 << 16);
+}
+
 CKDWORD GetCurrentFileLoadOption() {
     return CurrentFileWriteMode;
 }
@@ -326,18 +542,10 @@ CKERROR CKFile::LoadFileData(CKObjectArray *liste) {
         if (WarningForOlderVersion)
             m_Context->OutputToConsole("Obsolete File Format,Please Re-Save...");
     } else {
+        // Chunks read from an uncompressed file may still point into the mapped
+        // file: FinishLoading releases it once they are decoded.
         err = ReadFileData(&m_Parser);
         if (err == CK_OK) {
-            if (m_Parser) {
-                delete m_Parser;
-                m_Parser = nullptr;
-            }
-
-            if (m_MappedFile) {
-                delete m_MappedFile;
-                m_MappedFile = nullptr;
-            }
-
             FinishLoading(liste, m_Flags);
             if (WarningForOlderVersion)
                 m_Context->OutputToConsole("Obsolete File Format,Please Re-Save...");
@@ -347,15 +555,7 @@ CKERROR CKFile::LoadFileData(CKObjectArray *liste) {
     m_Context->SetAutomaticLoadMode(CKLOAD_INVALID, CKLOAD_INVALID, CKLOAD_INVALID, CKLOAD_INVALID);
     m_Context->SetUserLoadCallback(nullptr, nullptr);
 
-    if (m_Parser) {
-        delete m_Parser;
-        m_Parser = nullptr;
-    }
-
-    if (m_MappedFile) {
-        delete m_MappedFile;
-        m_MappedFile = nullptr;
-    }
+    ReleaseFileBuffer();
 
     m_Context->ExecuteManagersPostLoad();
     m_Context->m_InLoad = FALSE;
@@ -595,15 +795,7 @@ CKERROR CKFile::ReadFileHeaders(CKBufferParser **ParserPtr) {
         m_ReadFileDataDone = TRUE;
         CKERROR ret = ReadFileData(ParserPtr);
 
-        if (m_Parser) {
-            delete m_Parser;
-            m_Parser = nullptr;
-        }
-
-        if (m_MappedFile) {
-            delete m_MappedFile;
-            m_MappedFile = nullptr;
-        }
+        ReleaseFileBuffer();
 
         if (ret != CK_OK) {
             m_Context->SetAutomaticLoadMode(CKLOAD_INVALID, CKLOAD_INVALID, CKLOAD_INVALID, CKLOAD_INVALID);
@@ -655,7 +847,10 @@ CKERROR CKFile::ReadFileHeaders(CKBufferParser **ParserPtr) {
 CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
     CKBufferParser *parser = *ParserPtr;
 
-    if ((m_FileInfo.FileWriteMode & (CKFILE_CHUNKCOMPRESSED_OLD | CKFILE_WHOLECOMPRESSED)) != 0) {
+    if (m_FileInfo.FileVersion >= 8 && (m_FileInfo.FileWriteMode & (CKFILE_CHUNKCOMPRESSED_OLD | CKFILE_WHOLECOMPRESSED)) != 0) {
+        if (m_FileInfo.DataPackSize != m_FileInfo.DataUnPackSize)
+            return ReadPackedFileData(parser);
+    } else if ((m_FileInfo.FileWriteMode & (CKFILE_CHUNKCOMPRESSED_OLD | CKFILE_WHOLECOMPRESSED)) != 0) {
         CKBufferParser *unpacked = parser->UnPack(m_FileInfo.DataUnPackSize, m_FileInfo.DataPackSize);
         if (!unpacked) {
             m_Context->OutputToConsole("Error unpacking data chunk.");
@@ -665,6 +860,11 @@ CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
         (*ParserPtr)->Skip(m_FileInfo.DataPackSize);
     }
 
+    // Uncompressed data stays in the file buffer until FinishLoading has decoded
+    // the chunks: those it deletes right after decoding can be views on it
+    // instead of copies. Chunks kept after loading are copied as before.
+    const CKBOOL borrowChunks = (!m_ReadFileDataDone && parser == *ParserPtr && m_FileInfo.FileVersion >= 7);
+
     if (m_FileInfo.FileVersion < 8) {
         if (m_FileInfo.FileVersion >= 2) {
             if (m_FileInfo.Crc != parser->ComputeCRC(parser->Size() - parser->CursorPos())) {
@@ -697,7 +897,8 @@ CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
                 parser->Read(mit->Manager.d, sizeof(CKGUID));
                 const int managerDataSize = parser->ReadInt();
                 if (managerDataSize > 0) {
-                    mit->data = parser->ExtractChunk(managerDataSize, this);
+                    mit->data = borrowChunks ? parser->ExtractChunkView(managerDataSize, this)
+                                             : parser->ExtractChunk(managerDataSize, this);
                 } else {
                     mit->data = nullptr;
                 }
@@ -715,7 +916,9 @@ CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
                 const int fileObjectSize = parser->ReadInt();
                 if (fileObjectSize > 0) {
                     if (m_FileInfo.FileVersion < 7 || !(m_Flags & CK_LOAD_ONLYBEHAVIORS) || oit->ObjectCid == CKCID_BEHAVIOR) {
-                        CKStateChunk *chunk = parser->ExtractChunk(fileObjectSize, this);
+                        CKStateChunk *chunk = (borrowChunks && IsDecodedOnly(oit->ObjectCid))
+                                                  ? parser->ExtractChunkView(fileObjectSize, this)
+                                                  : parser->ExtractChunk(fileObjectSize, this);
                         if (chunk) {
                             oit->Data = chunk;
                             oit->PostPackSize = chunk->GetDataSize();
@@ -788,14 +991,99 @@ CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
         }
     }
 
+    CKERROR err = ReadIncludedFiles(parser);
+
+    if (parser && parser != *ParserPtr) {
+        delete parser;
+    }
+
+    return err;
+}
+
+CKERROR CKFile::ReadPackedFileData(CKBufferParser *Parser) {
+    CKInflateParser parser(&Parser->m_Buffer[Parser->CursorPos()], m_FileInfo.DataPackSize, m_FileInfo.DataUnPackSize);
+    if (!parser.IsValid()) {
+        m_Context->OutputToConsole("Error unpacking data chunk.");
+        return CKERR_INVALIDFILE;
+    }
+    Parser->Skip(m_FileInfo.DataPackSize);
+
+    if (m_FileInfo.ManagerCount > 0) {
+        m_ManagersData.Resize(m_FileInfo.ManagerCount);
+        for (XArray<CKFileManagerData>::Iterator mit = m_ManagersData.Begin(); mit != m_ManagersData.End(); ++mit) {
+            parser.Read(mit->Manager.d, sizeof(CKGUID));
+            const int managerDataSize = parser.ReadInt();
+            if (managerDataSize > 0) {
+                mit->data = parser.ExtractChunk(managerDataSize, this);
+            } else {
+                mit->data = nullptr;
+            }
+        }
+    }
+
+    for (XArray<CKFileObject>::Iterator oit = m_FileObjects.Begin(); oit != m_FileObjects.End(); ++oit) {
+        oit->Data = nullptr;
+        const int fileObjectSize = parser.ReadInt();
+        if (fileObjectSize > 0) {
+            if (!(m_Flags & CK_LOAD_ONLYBEHAVIORS) || oit->ObjectCid == CKCID_BEHAVIOR) {
+                CKStateChunk *chunk = parser.ExtractChunk(fileObjectSize, this);
+                if (chunk) {
+                    oit->Data = chunk;
+                    oit->PostPackSize = chunk->GetDataSize();
+                    oit->PrePackSize = chunk->GetDataSize();
+                }
+            } else {
+                parser.Skip(fileObjectSize);
+            }
+        }
+    }
+
+    if (!parser.IsValid()) {
+        m_Context->OutputToConsole("Error unpacking data chunk.");
+        return CKERR_INVALIDFILE;
+    }
+
+    // Included files are stored uncompressed after the packed data.
+    return ReadIncludedFiles(Parser);
+}
+
+// Classes whose chunk FinishLoading deletes as soon as the object is loaded
+CKBOOL CKFile::IsDecodedOnly(CK_CLASSID cid) {
+    return cid == CKCID_PARAMETER ||
+           cid == CKCID_PARAMETEROUT ||
+           cid == CKCID_PARAMETERLOCAL ||
+           cid == CKCID_BEHAVIOR;
+}
+
+void CKFile::ReleaseFileBuffer() {
+    // Chunks still borrowed (object not loaded, manager not found) are copied
+    for (XArray<CKFileObject>::Iterator it = m_FileObjects.Begin(); it != m_FileObjects.End(); ++it) {
+        if (it->Data)
+            it->Data->MakeOwned();
+    }
+    for (XArray<CKFileManagerData>::Iterator it = m_ManagersData.Begin(); it != m_ManagersData.End(); ++it) {
+        if (it->data)
+            it->data->MakeOwned();
+    }
+
+    if (m_Parser) {
+        delete m_Parser;
+        m_Parser = nullptr;
+    }
+
+    if (m_MappedFile) {
+        delete m_MappedFile;
+        m_MappedFile = nullptr;
+    }
+}
+
+CKERROR CKFile::ReadIncludedFiles(CKBufferParser *parser) {
     if (m_IncludedFiles.Size() > 0) {
         for (XClassArray<XString>::Iterator iit = m_IncludedFiles.Begin();
              iit != m_IncludedFiles.End(); ++iit) {
             const int fileNameLength = parser->ReadInt();
             char fileName[CKMAX_PATH] = {0};
             if (fileNameLength < 0) {
-                if (parser && parser != *ParserPtr)
-                    delete parser;
                 return CKERR_INVALIDFILE;
             }
             if (fileNameLength > 0 && fileNameLength < CKMAX_PATH) {
@@ -807,8 +1095,6 @@ CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
 
             const int fileSize = parser->ReadInt();
             if (fileSize < 0) {
-                if (parser && parser != *ParserPtr)
-                    delete parser;
                 return CKERR_INVALIDFILE;
             }
             if (fileSize > 0) {
@@ -820,10 +1106,6 @@ CKERROR CKFile::ReadFileData(CKBufferParser **ParserPtr) {
         }
     }
 
-    if (parser && parser != *ParserPtr) {
-        delete parser;
-    }
-
     return CK_OK;
 }
 
@@ -1006,16 +1288,22 @@ CKERROR CKFile::EndSave() {
         m_Context->m_UICallBackFct(cbs, m_Context->m_InterfaceModeData);
     }
 
+    XBitArray savedObjects;
+    if (m_Context->GetSaveThreadCount() > 1)
+        SaveObjectChunks(m_Context->GetSaveThreadCount(), savedObjects);
+
     int interfaceDataSize = 0;
     for (int i = 0; i < fileObjectCount; ++i) {
         CKFileObject &fileObject = m_FileObjects[i];
         CKObject *obj = m_Context->GetObject(fileObject.Object);
         if (obj) {
-            CKStateChunk *chunk = obj->Save(this, fileObject.SaveFlags);
-            if (chunk) {
-                chunk->CloseChunk();
+            if (!savedObjects.IsSet(i)) {
+                CKStateChunk *chunk = obj->Save(this, fileObject.SaveFlags);
+                if (chunk) {
+                    chunk->CloseChunk();
+                }
+                fileObject.Data = chunk;
             }
-            fileObject.Data = chunk;
 
             if (CKIsChildClassOf(fileObject.ObjectCid, CKCID_BEHAVIOR)) {
                 CKBehavior *beh = (CKBehavior *) fileObject.ObjPtr;
@@ -1220,41 +1508,17 @@ CKERROR CKFile::EndSave() {
         }
     }
 
-    parser->Seek(0);
-    if ((header.Part0.FileWriteMode & (CKFILE_WHOLECOMPRESSED | CKFILE_CHUNKCOMPRESSED_OLD)) != 0) {
-        parser = parser->Pack((int) header.Part1.DataUnPackSize, m_Context->GetCompressionLevel());
-        if (parser && (CKDWORD) parser->Size() < header.Part1.DataUnPackSize) {
-            header.Part1.DataPackSize = parser->Size();
-            delete dataBufferParser;
-            dataBufferParser = parser;
-        } else {
-            delete parser;
-            parser = dataBufferParser;
-            header.Part1.DataPackSize = header.Part1.DataUnPackSize;
-        }
-    }
-
-    CKDWORD crc = CKComputeDataCRC((char *) &header.Part0, sizeof(CKFileHeaderPart0));
-    crc = CKComputeDataCRC((char *) &header.Part1, sizeof(CKFileHeaderPart1), crc);
-    crc = hdr1BufferParser->ComputeCRC(hdr1BufferParser->Size(), crc);
-    crc = dataBufferParser->ComputeCRC(dataBufferParser->Size(), crc);
-    header.Part0.Crc = crc;
-
     m_FileInfo.ProductVersion = header.Part1.ProductVersion;
     m_FileInfo.ProductBuild = header.Part1.ProductBuild;
     m_FileInfo.FileWriteMode = header.Part0.FileWriteMode;
     m_FileInfo.CKVersion = header.Part0.CKVersion;
     m_FileInfo.FileVersion = header.Part0.FileVersion;
     m_FileInfo.Hdr1PackSize = header.Part0.Hdr1PackSize;
-    m_FileInfo.FileSize = sizeof(CKFileHeader) + header.Part0.Hdr1PackSize + header.Part1.DataPackSize;
     m_FileInfo.Hdr1UnPackSize = header.Part1.Hdr1UnPackSize;
     m_FileInfo.ManagerCount = header.Part1.ManagerCount;
-    m_FileInfo.DataPackSize = header.Part1.DataPackSize;
     m_FileInfo.ObjectCount = header.Part1.ObjectCount;
     m_FileInfo.DataUnPackSize = header.Part1.DataUnPackSize;
     m_FileInfo.MaxIDSaved = header.Part1.MaxIDSaved;
-    m_FileInfo.Crc = crc;
-    WriteStats(interfaceDataSize);
 
     FILE *fp = fopen(m_FileName, "wb");
     if (!fp) {
@@ -1266,12 +1530,53 @@ CKERROR CKFile::EndSave() {
 
     CKERROR err = CK_OK;
 
+    // The data section is deflated straight into the file, the header is
+    // written first with a null CRC and rewritten once the packed size is known.
+    CKBOOL packData = (header.Part0.FileWriteMode & (CKFILE_WHOLECOMPRESSED | CKFILE_CHUNKCOMPRESSED_OLD)) != 0;
+    CKDWORD dataCrc = 1;
     hdr1BufferParser->Seek(0);
     dataBufferParser->Seek(0);
-    if (fwrite(&header.Part0, sizeof(CKFileHeaderPart0), 1, fp) == 1 &&
-        fwrite(&header.Part1, sizeof(CKFileHeaderPart1), 1, fp) == 1 &&
-        fwrite(&hdr1BufferParser->m_Buffer[hdr1BufferParser->CursorPos()], hdr1BufferParser->Size(), 1, fp) == 1 &&
-        fwrite(&dataBufferParser->m_Buffer[dataBufferParser->CursorPos()], dataBufferParser->Size(), 1, fp) == 1) {
+    CKBOOL written = fwrite(&header.Part0, sizeof(CKFileHeaderPart0), 1, fp) == 1 &&
+                     fwrite(&header.Part1, sizeof(CKFileHeaderPart1), 1, fp) == 1 &&
+                     fwrite(hdr1BufferParser->m_Buffer, hdr1BufferParser->Size(), 1, fp) == 1;
+    if (written && packData) {
+        int packSize = WritePackedData(fp, dataBufferParser->m_Buffer, dataBufferParser->Size(), m_Context->GetCompressionLevel(), dataCrc);
+        if (packSize > 0) {
+            header.Part1.DataPackSize = packSize;
+        } else {
+            // Packing does not reduce the size: start over with raw data
+            packData = FALSE;
+            fp = freopen(m_FileName, "wb", fp);
+            written = fp &&
+                      fwrite(&header.Part0, sizeof(CKFileHeaderPart0), 1, fp) == 1 &&
+                      fwrite(&header.Part1, sizeof(CKFileHeaderPart1), 1, fp) == 1 &&
+                      fwrite(hdr1BufferParser->m_Buffer, hdr1BufferParser->Size(), 1, fp) == 1;
+        }
+    }
+    if (written && !packData) {
+        dataCrc = CKComputeDataCRC(dataBufferParser->m_Buffer, dataBufferParser->Size(), 1);
+        written = dataBufferParser->Size() == 0 || fwrite(dataBufferParser->m_Buffer, dataBufferParser->Size(), 1, fp) == 1;
+    }
+
+    if (written) {
+        CKDWORD crc = CKComputeDataCRC((char *) &header.Part0, sizeof(CKFileHeaderPart0));
+        crc = CKComputeDataCRC((char *) &header.Part1, sizeof(CKFileHeaderPart1), crc);
+        crc = hdr1BufferParser->ComputeCRC(hdr1BufferParser->Size(), crc);
+        crc = CombineAdler32(crc, dataCrc, header.Part1.DataPackSize);
+        header.Part0.Crc = crc;
+
+        written = fseek(fp, 0, SEEK_SET) == 0 &&
+                  fwrite(&header.Part0, sizeof(CKFileHeaderPart0), 1, fp) == 1 &&
+                  fwrite(&header.Part1, sizeof(CKFileHeaderPart1), 1, fp) == 1 &&
+                  fseek(fp, 0, SEEK_END) == 0;
+    }
+
+    m_FileInfo.FileSize = sizeof(CKFileHeader) + header.Part0.Hdr1PackSize + header.Part1.DataPackSize;
+    m_FileInfo.DataPackSize = header.Part1.DataPackSize;
+    m_FileInfo.Crc = header.Part0.Crc;
+    WriteStats(interfaceDataSize);
+
+    if (written) {
         int includeFileCount = m_IncludedFiles.Size();
         for (int i = 0; i < includeFileCount; ++i) {
             XString &filename = m_IncludedFiles[i];
@@ -1301,13 +1606,51 @@ CKERROR CKFile::EndSave() {
     delete hdr1BufferParser;
     delete dataBufferParser;
 
-    fclose(fp);
+    if (fp)
+        fclose(fp);
 
     FinalizeSaveState();
 
     return err;
 }
 
+void CKFile::SaveObjectChunks(int threadCount, XBitArray &savedObjects) {
+    XArray<CKFileSaveJob> jobs;
+    const int fileObjectCount = m_FileObjects.Size();
+    for (int i = 0; i < fileObjectCount; ++i) {
+        CKFileObject &fileObject = m_FileObjects[i];
+        if (!(g_CKClassInfo[fileObject.ObjectCid].DefaultOptions & CK_GENERALOPTIONS_SAVETHREADSAFE))
+            continue;
+        CKObject *obj = m_Context->GetObject(fileObject.Object);
+        if (!obj)
+            continue;
+
+        CKFileSaveJob job;
+        job.Object = obj;
+        job.FileObject = &fileObject;
+        jobs.PushBack(job);
+        savedObjects.Set(i);
+    }
+
+    if (jobs.Size() == 0)
+        return;
+
+    // The calling thread takes part in the work, and chunk contents do not
+    // depend on which thread saved them so the file stays byte-identical.
+    int workerCount = threadCount - 1;
+    if (workerCount > jobs.Size() - 1)
+        workerCount = jobs.Size() - 1;
+
+    std::atomic<int> next(0);
+    std::thread *workers = (workerCount > 0) ? new std::thread[workerCount] : nullptr;
+    for (int i = 0; i < workerCount; ++i)
+        workers[i] = std::thread(SaveObjectChunksWorker, this, &jobs, &next);
+    SaveObjectChunksWorker(this, &jobs, &next);
+    for (int i = 0; i < workerCount; ++i)
+        workers[i].join();
+    delete[] workers;
+}
+
 CKBOOL CKFile::IncludeFile(CKSTRING FileName, int SearchPathCategory) {
     if (!FileName || strlen(FileName) == 0)
         return FALSE;
@@ -1392,6 +1735,7 @@ void CKFile::FinishLoading(CKObjectArray *list, CKDWORD flags) {
 
     CKObjectManager *objectManager = m_Context->m_ObjectManager;
     objectManager->StartLoadSession(m_SaveIDMax + 1);
+    objectManager->ReserveObjectIDs(m_FileObjects.Size());
 
     int options = CK_OBJECTCREATION_NONAMECHECK;
     if (flags & (CK_LOAD_DODIALOG | CK_LOAD_AUTOMATICMODE | CK_LOAD_CHECKDUPLICATES)) {
@@ -1651,6 +1995,9 @@ void CKFile::FinishLoading(CKObjectArray *list, CKDWORD flags) {
         }
     }
 
+    // Every chunk is decoded: the file buffer is no longer needed
+    ReleaseFileBuffer();
+
     if (!(m_Flags & CK_LOAD_ONLYBEHAVIORS)) {
         for (XArray<int>::Iterator iit = m_IndexByClassId[CKCID_INTERFACEOBJECTMANAGER].Begin();
              iit != m_IndexByClassId[CKCID_INTERFACEOBJECTMANAGER].End(); ++iit) {
@@ -342,6 +342,7 @@ CKSTRING CKGroup::GetDependencies(int i, int mode) {
 void CKGroup::Register() {
     CKCLASSNOTIFYFROM(CKGroup, CKBeObject);
     CKPARAMETERFROMCLASS(CKGroup, CKPGUID_GROUP);
+    CKCLASSDEFAULTOPTIONS(CKGroup, CK_GENERALOPTIONS_SAVETHREADSAFE);
 }
 
 CKGroup *CKGroup::CreateInstance(CKContext *Context) {
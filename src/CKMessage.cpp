@@ -1,5 +1,7 @@
 #include "CKMessage.h"
 
+#include "CKMessageManager.h"
+#include "CKBehaviorManager.h"
 #include "CKParameter.h"
 
 CKERROR CKMessage::SetBroadcastObjectType(CK_CLASSID type) {
@@ -13,8 +15,16 @@ CKERROR CKMessage::AddParameter(CKParameter *param, CKBOOL DeleteParameterWithMe
     if (!param)
         return CKERR_INVALIDPARAMETER;
 
-    if (!m_Parameters)
-        m_Parameters = new XObjectArray();
+    if (!m_Parameters) {
+        if (m_Pool) {
+            CKBOOL grown = FALSE;
+            m_Parameters = m_Pool->AllocateParameters(grown);
+            if (grown)
+                ++CKBehaviorManager::GetThreadStats(m_Context).MessagePoolHeapAllocations;
+        } else {
+            m_Parameters = new XObjectArray();
+        }
+    }
 
     param->MessageDeleteAfterUse(DeleteParameterWithMessage);
     m_Parameters->PushBack(param->GetID());
@@ -27,7 +37,10 @@ CKERROR CKMessage::RemoveParameter(CKParameter *param) {
 
     m_Parameters->RemoveObject(param);
     if (m_Parameters->Size() == 0) {
-        delete m_Parameters;
+        if (m_Pool)
+            m_Pool->RecycleParameters(m_Parameters);
+        else
+            delete m_Parameters;
         m_Parameters = nullptr;
     }
 
@@ -52,6 +65,13 @@ CKMessage::CKMessage(CKContext *context) {
     m_RefCount = 1;
     m_Context = context;
     m_BroadcastCid = 0;
+    m_Pooled = FALSE;
+
+    // The pool is kept until the message is gone, even if the manager is not
+    CKMessageManager *manager = context ? context->GetMessageManager() : nullptr;
+    m_Pool = manager ? manager->m_MessagePool : nullptr;
+    if (m_Pool)
+        m_Pool->AddRef();
 }
 
 CKMessage::~CKMessage() {
@@ -62,8 +82,14 @@ CKMessage::~CKMessage() {
                 CKDestroyObject(obj, CK_DESTROY_TEMPOBJECT);
             }
         }
-        delete m_Parameters;
+        if (m_Pool)
+            m_Pool->RecycleParameters(m_Parameters);
+        else
+            delete m_Parameters;
     }
+    // A pooled message drops its reference once its storage is back in the pool
+    if (m_Pool && !m_Pooled)
+        m_Pool->Release();
 }
 
 int CKMessage::AddRef() {
@@ -73,7 +99,13 @@ int CKMessage::AddRef() {
 int CKMessage::Release() {
     --m_RefCount;
     if (m_RefCount <= 0) {
-        delete this;
+        if (m_Pooled) {
+            CKMessagePool *pool = m_Pool;
+            this->~CKMessage();
+            pool->FreeMessage(this);
+        } else {
+            delete this;
+        }
         return 0;
     }
     return m_RefCount;
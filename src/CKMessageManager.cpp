@@ -9,28 +9,36 @@
 #include "CKCharacter.h"
 #include "CKDebugContext.h"
 #include "CKParameterManager.h"
+#include "CKBehaviorManager.h"
 
-extern CK_CLASSID g_MaxClassID;
+#include <new>
+
+// Number of messages allocated at once when the message pool is empty
+static const int g_MessageSlabSize = 256;
 
 CKMessageType CKMessageManager::AddMessageType(CKSTRING MsgName) {
     if (!MsgName || MsgName[0] == '\0') return -1;
 
-    XString name(MsgName);
-    int i = m_RegisteredMessageTypes.GetPosition(name);
-    if (i >= 0) {
-        return i;
+    CKMessageType type = FindMessageType(MsgName);
+    if (type >= 0) {
+        return type;
     }
 
     int newIndex = m_RegisteredMessageTypes.Size();
-    m_RegisteredMessageTypes.PushBack(name);
-
-    CKWaitingObjectArray **newList = new CKWaitingObjectArray *[m_RegisteredMessageTypes.Size()];
-    if (m_MsgWaitingList) {
-        memcpy(newList, m_MsgWaitingList, (m_RegisteredMessageTypes.Size() - 1) * sizeof(CKWaitingObjectArray *));
-        delete[] m_MsgWaitingList;
+    m_RegisteredMessageTypes.PushBack(XString(MsgName));
+
+    if (newIndex >= m_MsgWaitingListCapacity) {
+        int capacity = (m_MsgWaitingListCapacity > 0) ? m_MsgWaitingListCapacity * 2 : 32;
+        CKWaitingObjectArray **newList = new CKWaitingObjectArray *[capacity];
+        if (m_MsgWaitingList) {
+            memcpy(newList, m_MsgWaitingList, newIndex * sizeof(CKWaitingObjectArray *));
+            delete[] m_MsgWaitingList;
+        }
+        m_MsgWaitingList = newList;
+        m_MsgWaitingListCapacity = capacity;
     }
-    newList[newIndex] = nullptr;
-    m_MsgWaitingList = newList;
+    m_MsgWaitingList[newIndex] = nullptr;
+    AddMessageTypeName(newIndex);
 
     return newIndex;
 }
@@ -46,8 +54,11 @@ int CKMessageManager::GetMessageTypeCount() {
 }
 
 void CKMessageManager::RenameMessageType(CKMessageType MsgType, CKSTRING NewName) {
-    if (MsgType >= 0 && MsgType < m_RegisteredMessageTypes.Size())
+    if (MsgType >= 0 && MsgType < m_RegisteredMessageTypes.Size()) {
+        RemoveMessageTypeName(MsgType);
         m_RegisteredMessageTypes[MsgType] = NewName ? NewName : "";
+        AddMessageTypeName(MsgType);
+    }
 }
 
 void CKMessageManager::RenameMessageType(CKSTRING OldName, CKSTRING NewName) {
@@ -55,6 +66,33 @@ void CKMessageManager::RenameMessageType(CKSTRING OldName, CKSTRING NewName) {
         RenameMessageType(AddMessageType(OldName), NewName);
 }
 
+CKMessageType CKMessageManager::FindMessageType(CKSTRING name) {
+    XArray<int> *types = m_MessageTypeNames.Find(name);
+    if (!types) return -1;
+
+    // A name given to several types (see RenameMessageType) resolves to the first one
+    for (XArray<int>::Iterator it = types->Begin(); it != types->End(); ++it) {
+        CKSTRING typeName = m_RegisteredMessageTypes[*it].Str();
+        if (typeName && strcmp(typeName, name) == 0)
+            return *it;
+    }
+    return -1;
+}
+
+void CKMessageManager::AddMessageTypeName(CKMessageType type) {
+    CKSTRING name = m_RegisteredMessageTypes[type].Str();
+    if (!name || name[0] == '\0')
+        return;
+    m_MessageTypeNames.Add(name, type);
+}
+
+void CKMessageManager::RemoveMessageTypeName(CKMessageType type) {
+    CKSTRING name = m_RegisteredMessageTypes[type].Str();
+    if (!name || name[0] == '\0')
+        return;
+    m_MessageTypeNames.Remove(name, type);
+}
+
 CKERROR CKMessageManager::SendMessage(CKMessage *msg) {
     if (!msg || msg->m_MessageType < 0) return CKERR_INVALIDPARAMETER;
 
@@ -262,8 +300,10 @@ CKERROR CKMessageManager::PreClearAll() {
         }
         delete[] m_MsgWaitingList;
         m_MsgWaitingList = nullptr;
+        m_MsgWaitingListCapacity = 0;
     }
     m_RegisteredMessageTypes.Clear();
+    m_MessageTypeNames.Clear();
     for (int i = 0; i < m_ReceivedMsgThisFrame.Size(); ++i) {
         CKMessage *msg = m_ReceivedMsgThisFrame[i];
         if (msg) {
@@ -274,6 +314,9 @@ CKERROR CKMessageManager::PreClearAll() {
 
     m_ReceivedMsgThisFrame.Resize(0);
     m_LastFrameObjects.Resize(0);
+    m_WaitingObjects.Clear();
+    m_WaitingObjectSlots.Clear();
+    StartMessageFrame();
     return RegisterDefaultMessages();
 }
 
@@ -288,10 +331,10 @@ CKERROR CKMessageManager::PostProcess() {
 
     // Clear the list of objects that received messages last frame (keep allocation)
     m_LastFrameObjects.Resize(0);
+    StartMessageFrame();
 
     // Get current scene for message processing
     CKScene *currentScene = m_Context->GetCurrentScene();
-    CKObjectManager *objectManager = m_Context->m_ObjectManager;
 
     // Process all messages received this frame
     for (int msgIndex = 0; msgIndex < m_ReceivedMsgThisFrame.Size(); ++msgIndex) {
@@ -305,23 +348,14 @@ CKERROR CKMessageManager::PostProcess() {
 
         // Handle different sending types
         if (sendingType == CK_MESSAGE_BROADCAST) {
-            // Broadcast message to all objects of specified class hierarchy
+            // Broadcast message to the waiting objects of specified class hierarchy
             CK_CLASSID broadcastClassId = message->m_BroadcastCid;
 
-            // Iterate through all registered class IDs
-            for (CK_CLASSID classId = CKCID_OBJECT; classId < g_MaxClassID; ++classId) {
-                if (CKIsChildClassOf(classId, broadcastClassId)) {
-                    int objectCount = objectManager->GetObjectsCountByClassID(classId);
-                    if (objectCount > 0) {
-                        CK_ID *objectsList = objectManager->GetObjectsListByClassID(classId);
-                        if (objectsList) {
-                            for (int i = 0; i < objectCount; ++i) {
-                                CKObject *obj = m_Context->GetObject(objectsList[i]);
-                                if (obj) {
-                                    AddMessageToObject(obj, message, currentScene, FALSE);
-                                }
-                            }
-                        }
+            for (CK_CLASSID classId = CKCID_OBJECT; classId < m_WaitingObjects.Size(); ++classId) {
+                XObjectPointerArray &waitingObjects = m_WaitingObjects[classId];
+                if (waitingObjects.Size() > 0 && CKIsChildClassOf(classId, broadcastClassId)) {
+                    for (int i = 0; i < waitingObjects.Size(); ++i) {
+                        AddMessageToObject(waitingObjects[i], message, currentScene, FALSE);
                     }
                 }
             }
@@ -380,7 +414,7 @@ CKERROR CKMessageManager::PostProcess() {
                     if (shouldActivate) {
                         // Add message to the waiting object
                         waitingBeObject->AddLastFrameMessage(message);
-                        m_LastFrameObjects.AddIfNotHere(waitingBeObject);
+                        AddLastFrameObject(waitingBeObject);
 
                         // Activate the behavior output if specified
                         if (it->m_Output) {
@@ -414,6 +448,7 @@ CKERROR CKMessageManager::PostProcess() {
     }
 
     m_ReceivedMsgThisFrame.Resize(0);
+    m_MessagePool->RecycleReleasedMessages();
 
     return CK_OK;
 }
@@ -442,6 +477,8 @@ CKERROR CKMessageManager::OnCKReset() {
         }
     }
     m_LastFrameObjects.Clear();
+    StartMessageFrame();
+    m_MessagePool->RecycleReleasedMessages();
 
     return CK_OK;
 }
@@ -469,6 +506,13 @@ CKERROR CKMessageManager::SequenceToBeDeleted(CK_ID *objids, int count) {
     }
 
     m_LastFrameObjects.Check();
+    CKBOOL waitingChanged = FALSE;
+    for (int i = 0; i < m_WaitingObjects.Size(); ++i) {
+        if (m_WaitingObjects[i].Check())
+            waitingChanged = TRUE;
+    }
+    if (waitingChanged)
+        RebuildWaitingObjectSlots();
     return CK_OK;
 }
 
@@ -494,13 +538,23 @@ CKMessageManager::~CKMessageManager() {
     }
     m_ReceivedMsgThisFrame.Clear();
     m_LastFrameObjects.Clear();
+    m_WaitingObjects.Clear();
+    m_WaitingObjectSlots.Clear();
     m_RegisteredMessageTypes.Clear();
+    m_MessageTypeNames.Clear();
+
+    // Messages still held elsewhere keep the pool alive
+    m_MessagePool->Release();
+    m_MessagePool = nullptr;
 }
 
 CKMessageManager::CKMessageManager(CKContext *Context)
     : CKBaseManager(Context, MESSAGE_MANAGER_GUID, "Message Manager"),
       m_ReceivedMsgThisFrame(100) {
     m_MsgWaitingList = nullptr;
+    m_MsgWaitingListCapacity = 0;
+    m_MessageFrame = 1;
+    m_MessagePool = new CKMessagePool();
     RegisterDefaultMessages();
     Context->RegisterNewManager(this);
 }
@@ -512,7 +566,7 @@ void CKMessageManager::AddMessageToObject(CKObject *obj, CKMessage *msg, CKScene
         CKBeObject *beo = (CKBeObject *) obj;
         if (beo->IsWaitingForMessages() && (!currentscene || currentscene->IsObjectActive(beo))) {
             beo->AddLastFrameMessage(msg);
-            m_LastFrameObjects.AddIfNotHere(beo);
+            AddLastFrameObject(beo);
         }
 
         if (recurse) {
@@ -533,8 +587,57 @@ void CKMessageManager::AddMessageToObject(CKObject *obj, CKMessage *msg, CKScene
     }
 }
 
+// Objects are marked with the current frame stamp instead of being looked up in m_LastFrameObjects
+void CKMessageManager::AddLastFrameObject(CKBeObject *obj) {
+    if (obj->m_MessageFrame != m_MessageFrame) {
+        obj->m_MessageFrame = m_MessageFrame;
+        m_LastFrameObjects.PushBack(obj);
+    }
+}
+
+// Called whenever m_LastFrameObjects is emptied
+void CKMessageManager::StartMessageFrame() {
+    // 0 is the stamp of objects that never received a message
+    if (++m_MessageFrame == 0)
+        m_MessageFrame = 1;
+}
+
+void CKMessageManager::WaitingObjectChanged(CKBeObject *obj) {
+    const CK_CLASSID cid = obj->GetClassID();
+    if (cid >= m_WaitingObjects.Size())
+        m_WaitingObjects.Resize(cid + 1);
+
+    XObjectPointerArray &waitingObjects = m_WaitingObjects[cid];
+    const CK_ID id = obj->GetID();
+    int *slot = m_WaitingObjectSlots.FindPtr(id);
+    if (obj->IsWaitingForMessages()) {
+        if (!slot) {
+            m_WaitingObjectSlots.Insert(id, waitingObjects.Size(), TRUE);
+            waitingObjects.PushBack(obj);
+        }
+    } else if (slot) {
+        const int pos = *slot;
+        m_WaitingObjectSlots.Remove(id);
+        CKObject *last = waitingObjects.PopBack();
+        if (pos < waitingObjects.Size()) {
+            waitingObjects[pos] = last;
+            m_WaitingObjectSlots.Insert(last->GetID(), pos, TRUE);
+        }
+    }
+}
+
+// Deleted objects were dropped from the lists, moving the others
+void CKMessageManager::RebuildWaitingObjectSlots() {
+    m_WaitingObjectSlots.Clear();
+    for (int c = 0; c < m_WaitingObjects.Size(); ++c) {
+        XObjectPointerArray &waitingObjects = m_WaitingObjects[c];
+        for (int i = 0; i < waitingObjects.Size(); ++i)
+            m_WaitingObjectSlots.Insert(waitingObjects[i]->GetID(), i, TRUE);
+    }
+}
+
 CKMessage *CKMessageManager::CreateMessageSingle(CKMessageType type, CKBeObject *dest, CKBeObject *sender) {
-    CKMessage *msg = new CKMessage(m_Context);
+    CKMessage *msg = AllocateMessage();
     if (msg) {
         msg->m_MessageType = type;
         msg->m_Sender = sender ? sender->GetID() : 0;
@@ -545,7 +648,7 @@ CKMessage *CKMessageManager::CreateMessageSingle(CKMessageType type, CKBeObject
 }
 
 CKMessage *CKMessageManager::CreateMessageGroup(CKMessageType type, CKGroup *group, CKBeObject *sender) {
-    CKMessage *msg = new CKMessage(m_Context);
+    CKMessage *msg = AllocateMessage();
     if (msg) {
         msg->m_MessageType = type;
         msg->m_Sender = sender ? sender->GetID() : 0;
@@ -556,7 +659,7 @@ CKMessage *CKMessageManager::CreateMessageGroup(CKMessageType type, CKGroup *gro
 }
 
 CKMessage *CKMessageManager::CreateMessageBroadcast(CKMessageType type, CK_CLASSID objType, CKBeObject *sender) {
-    CKMessage *msg = new CKMessage(m_Context);
+    CKMessage *msg = AllocateMessage();
     if (msg) {
         msg->m_MessageType = type;
         msg->m_Sender = sender ? sender->GetID() : 0;
@@ -565,3 +668,86 @@ CKMessage *CKMessageManager::CreateMessageBroadcast(CKMessageType type, CK_CLASS
     }
     return msg;
 }
+
+CKMessage *CKMessageManager::AllocateMessage() {
+    CKStats &stats = CKBehaviorManager::GetThreadStats(m_Context);
+    CKBOOL grown = FALSE;
+    CKMessage *msg = new (m_MessagePool->AllocateMessage(grown)) CKMessage(m_Context);
+    msg->m_Pooled = TRUE;
+    if (grown)
+        ++stats.MessagePoolHeapAllocations;
+    ++stats.MessagesAllocated;
+    return msg;
+}
+
+CKMessagePool::CKMessagePool() {
+    m_RefCount = 1;
+}
+
+CKMessagePool::~CKMessagePool() {
+    for (int i = 0; i < m_Slabs.Size(); ++i)
+        delete[] m_Slabs[i];
+    for (int i = 0; i < m_FreeParameters.Size(); ++i)
+        delete m_FreeParameters[i];
+}
+
+void CKMessagePool::AddRef() {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    ++m_RefCount;
+}
+
+void CKMessagePool::Release() {
+    int refCount;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        refCount = --m_RefCount;
+    }
+    if (refCount == 0)
+        delete this;
+}
+
+void *CKMessagePool::AllocateMessage(CKBOOL &grown) {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    if (m_FreeMessages.Size() == 0) {
+        CKBYTE *slab = new CKBYTE[g_MessageSlabSize * sizeof(CKMessage)];
+        m_Slabs.PushBack(slab);
+        // Handed out in address order
+        m_FreeMessages.Reserve(g_MessageSlabSize);
+        for (int i = g_MessageSlabSize - 1; i >= 0; --i)
+            m_FreeMessages.PushBack((CKMessage *) (slab + i * sizeof(CKMessage)));
+        grown = TRUE;
+    }
+    return m_FreeMessages.PopBack();
+}
+
+void CKMessagePool::FreeMessage(CKMessage *msg) {
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_ReleasedMessages.PushBack(msg);
+    }
+    Release();
+}
+
+void CKMessagePool::RecycleReleasedMessages() {
+    std::lock_guard<std::mutex> lock(m_Lock);
+    for (int i = 0; i < m_ReleasedMessages.Size(); ++i)
+        m_FreeMessages.PushBack(m_ReleasedMessages[i]);
+    m_ReleasedMessages.Resize(0);
+}
+
+XObjectArray *CKMessagePool::AllocateParameters(CKBOOL &grown) {
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        if (m_FreeParameters.Size() > 0)
+            return m_FreeParameters.PopBack();
+    }
+    grown = TRUE;
+    return new XObjectArray();
+}
+
+void CKMessagePool::RecycleParameters(XObjectArray *parameters) {
+    // The array keeps its allocation for the next message
+    parameters->Resize(0);
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_FreeParameters.PushBack(parameters);
+}
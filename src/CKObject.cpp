@@ -22,6 +22,10 @@ void CKObject::SetName(CKSTRING Name, CKBOOL shared) {
         }
     }
 
+    CKObjectManager *objectManager = (m_Context && m_ID != 0) ? m_Context->m_ObjectManager : nullptr;
+    if (objectManager)
+        objectManager->RemoveObjectName(m_ID, m_Name);
+
     if ((m_ObjectFlags & CK_OBJECT_NAMESHARED) == 0)
         delete[] m_Name;
 
@@ -31,6 +35,9 @@ void CKObject::SetName(CKSTRING Name, CKBOOL shared) {
     } else {
         m_ObjectFlags &= ~CK_OBJECT_NAMESHARED;
     }
+
+    if (objectManager)
+        objectManager->AddObjectName(m_ID, m_Name);
 }
 
 void *CKObject::GetAppData() {
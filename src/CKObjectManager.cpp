@@ -2,6 +2,9 @@
 
 #include "CKContext.h"
 #include "CKSceneObject.h"
+#include "CKScene.h"
+#include "CKGroup.h"
+#include "CKParameter.h"
 #include "CKRenderManager.h"
 #include "CKRenderContext.h"
 #include "CKMaterial.h"
@@ -9,6 +12,7 @@
 #include "CK3dEntity.h"
 #include "CKBehavior.h"
 #include "CKGlobals.h"
+#include "CKNameIndex.h"
 
 #include <limits>
 #include <new>
@@ -77,6 +81,10 @@ CKERROR CKObjectManager::DeleteAllObjects() {
     m_ObjectCount = 0;
     m_FreeObjectIDs.Clear();
     m_ObjectAppData.Clear();
+    m_ObjectNames.Clear();
+    m_ObjectNameSlots.Clear();
+    m_ClassListRanks.Clear();
+    m_ClassListCounter = 0;
 
     return CK_OK;
 }
@@ -194,6 +202,7 @@ CKERROR CKObjectManager::ClearAllObjects() {
 
         // Re-add to class lists
         m_ClassLists[cid].PushBack(id);
+        SetClassListRank(id);
     }
 
     // Cleanup auxiliary data
@@ -228,6 +237,7 @@ CKERROR CKObjectManager::DeleteObjects(CK_ID *obj_ids, int Count, CK_CLASSID cid
         flags |= CK_OBJECT_FREEID;
 
     XBitArray notifiedClasses;
+    DeletionReferences refs;
     for (int i = 0; i < Count; ++i) {
         CK_ID id = obj_ids[i];
         if (id == 0 || id > static_cast<CK_ID>(m_ObjectCount))
@@ -237,6 +247,7 @@ CKERROR CKObjectManager::DeleteObjects(CK_ID *obj_ids, int Count, CK_CLASSID cid
         if (obj) {
             notifiedClasses.Set(obj->GetClassID());
             obj->ModifyObjectFlags(flags, 0);
+            AddDeletionReferences(refs, obj);
         }
     }
 
@@ -257,7 +268,7 @@ CKERROR CKObjectManager::DeleteObjects(CK_ID *obj_ids, int Count, CK_CLASSID cid
                     XObjectArray &classList = m_ClassLists[classId];
                     for (int i = 0; i < classList.Size(); ++i) {
                         CKObject *obj = m_Objects[classList[i]];
-                        if (obj) {
+                        if (obj && NeedsPreDeletionCheck(refs, obj)) {
                             obj->CheckPreDeletion();
                         }
                     }
@@ -300,7 +311,7 @@ CKERROR CKObjectManager::DeleteObjects(CK_ID *obj_ids, int Count, CK_CLASSID cid
                             continue;
                         }
                         CKObject *obj = m_Objects[id];
-                        if (obj) {
+                        if (obj && NeedsPostDeletionCheck(refs, obj)) {
                             obj->CheckPostDeletion();
                         }
                     }
@@ -314,6 +325,56 @@ CKERROR CKObjectManager::DeleteObjects(CK_ID *obj_ids, int Count, CK_CLASSID cid
     return CK_OK;
 }
 
+static CKBOOL IsBitSet(XBitArray &bits, int index) {
+    return index >= 0 && index < bits.Size() && bits.IsSet(index);
+}
+
+// The membership bit arrays of the deleted objects already tell which groups and
+// scenes hold them, so those are the only ones that need to check their lists.
+void CKObjectManager::AddDeletionReferences(DeletionReferences &refs, CKObject *obj) {
+    refs.IDs.Set(obj->GetID());
+    if (CKIsChildClassOf(obj, CKCID_SCENEOBJECT))
+        refs.Scenes.Or(((CKSceneObject *) obj)->m_Scenes);
+    if (CKIsChildClassOf(obj, CKCID_BEOBJECT))
+        refs.Groups.Or(((CKBeObject *) obj)->m_Groups);
+    if (CKIsChildClassOf(obj, CKCID_PARAMETER))
+        refs.Parameters = TRUE;
+}
+
+// Only exact class ids are filtered: a derived class may override the check.
+CKBOOL CKObjectManager::NeedsPreDeletionCheck(DeletionReferences &refs, CKObject *obj) {
+    switch (obj->GetClassID()) {
+    case CKCID_GROUP:
+        return IsBitSet(refs.Groups, ((CKGroup *) obj)->m_GroupIndex);
+    case CKCID_PARAMETER:
+    case CKCID_PARAMETEROUT:
+    case CKCID_PARAMETERLOCAL:
+        // Destinations and their sources are parameters
+        return refs.Parameters;
+    default:
+        return TRUE;
+    }
+}
+
+CKBOOL CKObjectManager::NeedsPostDeletionCheck(DeletionReferences &refs, CKObject *obj) {
+    switch (obj->GetClassID()) {
+    case CKCID_SCENE: {
+        CKScene *scene = (CKScene *) obj;
+        return IsBitSet(refs.Scenes, scene->m_SceneGlobalIndex) ||
+               IsBitSet(refs.IDs, scene->m_BackgroundTexture) ||
+               IsBitSet(refs.IDs, scene->m_StartingCamera);
+    }
+    case CKCID_PARAMETER:
+    case CKCID_PARAMETEROUT:
+    case CKCID_PARAMETERLOCAL: {
+        CKParameterTypeDesc *type = ((CKParameter *) obj)->GetParameterType();
+        return type && type->CheckFunction;
+    }
+    default:
+        return TRUE;
+    }
+}
+
 CKERROR CKObjectManager::GetRootEntities(XObjectPointerArray &array) {
     if (g_MaxClassID == 0)
         return CK_OK;
@@ -348,28 +409,47 @@ CK_ID CKObjectManager::RegisterObject(CKObject *iObject) {
         id = m_FreeObjectIDs.PopBack();
     } else {
         ++m_ObjectCount;
-        if (m_ObjectCount >= m_AllocatedObjectCount) {
-            int newCount = m_AllocatedObjectCount + 100;
-            CKObject **newObjs = new CKObject *[newCount];
-            memset(newObjs, 0, newCount * sizeof(CKObject *));
-            if (m_Objects) {
-                memcpy(newObjs, m_Objects, m_AllocatedObjectCount * sizeof(CKObject *));
-                delete[] m_Objects;
-            }
-            m_Objects = newObjs;
-            m_AllocatedObjectCount = newCount;
-        }
+        if (m_ObjectCount >= m_AllocatedObjectCount)
+            GrowObjectTable(m_ObjectCount + 1);
         id = m_ObjectCount;
     }
     m_Objects[id] = iObject;
+    if (iObject->GetName())
+        AddObjectName(id, iObject->GetName());
     return id;
 }
 
+// Makes room for count more objects so that creating them does not reallocate m_Objects
+void CKObjectManager::ReserveObjectIDs(int count) {
+    if (count <= 0)
+        return;
+    int needed = m_ObjectCount + count + 1;
+    if (needed > m_AllocatedObjectCount)
+        GrowObjectTable(needed);
+}
+
+void CKObjectManager::GrowObjectTable(int minCount) {
+    // Geometric growth: creating N objects costs O(N) copies in total
+    int newCount = m_AllocatedObjectCount + (m_AllocatedObjectCount >> 1);
+    if (newCount < minCount)
+        newCount = minCount;
+
+    CKObject **newObjs = new CKObject *[newCount];
+    memset(newObjs, 0, newCount * sizeof(CKObject *));
+    if (m_Objects) {
+        memcpy(newObjs, m_Objects, m_AllocatedObjectCount * sizeof(CKObject *));
+        delete[] m_Objects;
+    }
+    m_Objects = newObjs;
+    m_AllocatedObjectCount = newCount;
+}
+
 void CKObjectManager::FinishRegisterObject(CKObject *iObject) {
     CK_ID id = iObject->GetID();
     if (iObject->IsDynamic())
         m_DynamicObjects.PushBack(id);
     m_ClassLists[iObject->GetClassID()].PushBack(id);
+    SetClassListRank(id);
 }
 
 void CKObjectManager::UnRegisterObject(CK_ID id) {
@@ -386,6 +466,11 @@ void CKObjectManager::UnRegisterObject(CK_ID id) {
         m_FreeObjectIDs.PushBack(id);
     }
 
+    if (obj && obj->GetName())
+        RemoveObjectName(id, obj->GetName());
+    if (id < static_cast<CK_ID>(m_ClassListRanks.Size()))
+        m_ClassListRanks[id] = 0;
+
     // CK2.dll nulls the object pointer
     m_Objects[id] = nullptr;
 
@@ -396,59 +481,91 @@ void CKObjectManager::UnRegisterObject(CK_ID id) {
         m_SingleObjectActivities.Remove(id);
 }
 
+// The name lookups below only visit the objects sharing the name hash, but
+// return the same object a linear scan would: lowest ID after previous for
+// GetObjectByName, class list order (m_ClassListRanks) for the class variants.
 CKObject *CKObjectManager::GetObjectByName(CKSTRING name, CKObject *previous) {
     if (!name) return nullptr;
     CK_ID startId = previous ? previous->GetID() + 1 : 1;
 
-    for (CK_ID id = startId; id <= static_cast<CK_ID>(m_ObjectCount); ++id) {
+    XObjectArray *ids = m_ObjectNames.FindPtr(CKHashName(name));
+    if (!ids) return nullptr;
+
+    CKObject *found = nullptr;
+    for (XObjectArray::Iterator it = ids->Begin(); it != ids->End(); ++it) {
+        CK_ID id = *it;
+        if (id < startId || id > static_cast<CK_ID>(m_ObjectCount))
+            continue;
+        if (found && id > found->GetID())
+            continue;
         CKObject *obj = m_Objects[id];
         if (obj && obj->GetName() && strcmp(obj->GetName(), name) == 0) {
-            return obj;
+            found = obj;
         }
     }
-    return nullptr;
+    return found;
 }
 
 CKObject *CKObjectManager::GetObjectByName(CKSTRING name, CK_CLASSID cid, CKObject *previous) {
     if (!name || cid < 0 || cid >= g_MaxClassID) return nullptr;
 
-    XObjectArray &classList = m_ClassLists[cid];
-    int startIndex = 0;
-    if (previous) {
-        int pos = classList.GetPosition(previous->GetID());
-        if (pos != -1) startIndex = pos + 1;
-    }
+    CKDWORD startRank = 0;
+    if (previous && previous->GetClassID() == cid && IsInClassList(previous))
+        startRank = m_ClassListRanks[previous->GetID()];
 
-    for (int i = startIndex; i < classList.Size(); ++i) {
-        CKObject *obj = GetObject(classList[i]);
-        if (obj && obj->GetName() && strcmp(obj->GetName(), name) == 0) {
-            return obj;
+    XObjectArray *ids = m_ObjectNames.FindPtr(CKHashName(name));
+    if (!ids) return nullptr;
+
+    CKObject *found = nullptr;
+    CKDWORD foundRank = 0;
+    for (XObjectArray::Iterator it = ids->Begin(); it != ids->End(); ++it) {
+        CKObject *obj = GetObject(*it);
+        if (!obj || obj->GetClassID() != cid || !IsInClassList(obj))
+            continue;
+        CKDWORD rank = m_ClassListRanks[*it];
+        if (rank <= startRank || (found && rank >= foundRank))
+            continue;
+        if (obj->GetName() && strcmp(obj->GetName(), name) == 0) {
+            found = obj;
+            foundRank = rank;
         }
     }
-    return nullptr;
+    return found;
 }
 
 CKObject *CKObjectManager::GetObjectByNameAndParentClass(CKSTRING name, CK_CLASSID pcid, CKObject *previous) {
     if (!name || pcid < 0 || pcid >= g_MaxClassID) return nullptr;
 
     CK_CLASSID startCid = previous ? previous->GetClassID() : 0;
-    int startIndex = 0;
-    if (previous) {
-        startIndex = m_ClassLists[startCid].GetPosition(previous->GetID()) + 1;
-    }
-
-    for (CK_CLASSID cid = startCid; cid < g_MaxClassID; ++cid) {
-        if (!CKIsChildClassOf(cid, pcid)) continue;
-
-        XObjectArray &classList = m_ClassLists[cid];
-        for (int i = (cid == startCid) ? startIndex : 0; i < classList.Size(); ++i) {
-            CKObject *obj = GetObject(classList[i]);
-            if (obj && obj->GetName() && strcmp(obj->GetName(), name) == 0) {
-                return obj;
-            }
+    CKDWORD startRank = 0;
+    if (previous && IsInClassList(previous))
+        startRank = m_ClassListRanks[previous->GetID()];
+
+    XObjectArray *ids = m_ObjectNames.FindPtr(CKHashName(name));
+    if (!ids) return nullptr;
+
+    CKObject *found = nullptr;
+    CK_CLASSID foundCid = 0;
+    CKDWORD foundRank = 0;
+    for (XObjectArray::Iterator it = ids->Begin(); it != ids->End(); ++it) {
+        CKObject *obj = GetObject(*it);
+        if (!obj || !IsInClassList(obj))
+            continue;
+        CK_CLASSID cid = obj->GetClassID();
+        CKDWORD rank = m_ClassListRanks[*it];
+        if (cid < startCid || (cid == startCid && rank <= startRank))
+            continue;
+        if (found && (cid > foundCid || (cid == foundCid && rank >= foundRank)))
+            continue;
+        if (!CKIsChildClassOf(cid, pcid))
+            continue;
+        if (obj->GetName() && strcmp(obj->GetName(), name) == 0) {
+            found = obj;
+            foundCid = cid;
+            foundRank = rank;
         }
     }
-    return nullptr;
+    return found;
 }
 
 CKERROR CKObjectManager::GetObjectListByType(CK_CLASSID cid, XObjectPointerArray &array, CKBOOL derived) {
@@ -706,10 +823,66 @@ CKObjectManager::CKObjectManager(CKContext *Context) : CKBaseManager(Context, OB
     m_LoadSession = nullptr;
     m_InLoadSession = FALSE;
     m_NeedDeleteAllDynamicObjects = FALSE;
+    m_ClassListCounter = 0;
     m_ClassLists.Resize(g_MaxClassID);
     m_Context->RegisterNewManager(this);
 }
 
+void CKObjectManager::AddObjectName(CK_ID id, CKSTRING name) {
+    if (!name)
+        return;
+    CKDWORD key = CKHashName(name);
+    XObjectArray *ids = m_ObjectNames.FindPtr(key);
+    if (!ids)
+        ids = &(*m_ObjectNames.InsertUnique(key, XObjectArray()));
+
+    if (id >= static_cast<CK_ID>(m_ObjectNameSlots.Size())) {
+        int newSize = (m_AllocatedObjectCount > static_cast<int>(id)) ? m_AllocatedObjectCount : static_cast<int>(id) + 1;
+        m_ObjectNameSlots.Resize(newSize);
+    }
+    m_ObjectNameSlots[id] = ids->Size();
+    ids->PushBack(id);
+}
+
+// The name lookups do not depend on the order of a bucket: the last ID takes
+// the place of the removed one
+void CKObjectManager::RemoveObjectName(CK_ID id, CKSTRING name) {
+    if (!name || id >= static_cast<CK_ID>(m_ObjectNameSlots.Size()))
+        return;
+    CKDWORD key = CKHashName(name);
+    XObjectArray *ids = m_ObjectNames.FindPtr(key);
+    if (!ids)
+        return;
+    const int slot = m_ObjectNameSlots[id];
+    if (slot < 0 || slot >= ids->Size() || (*ids)[slot] != id)
+        return;
+
+    const CK_ID last = ids->PopBack();
+    if (slot < ids->Size()) {
+        (*ids)[slot] = last;
+        m_ObjectNameSlots[last] = slot;
+    }
+    if (ids->IsEmpty())
+        m_ObjectNames.Remove(key);
+}
+
+CKBOOL CKObjectManager::IsInClassList(CKObject *obj) {
+    // Objects flagged to be deleted have already been removed from the class lists
+    CK_ID id = obj->GetID();
+    return id < static_cast<CK_ID>(m_ClassListRanks.Size()) && m_ClassListRanks[id] != 0 &&
+           !(obj->GetObjectFlags() & CK_OBJECT_TOBEDELETED);
+}
+
+void CKObjectManager::SetClassListRank(CK_ID id) {
+    const int size = m_ClassListRanks.Size();
+    if (id >= static_cast<CK_ID>(size)) {
+        int newSize = (m_AllocatedObjectCount > static_cast<int>(id)) ? m_AllocatedObjectCount : static_cast<int>(id) + 1;
+        m_ClassListRanks.Resize(newSize);
+        memset(&m_ClassListRanks[size], 0, (newSize - size) * sizeof(CKDWORD));
+    }
+    m_ClassListRanks[id] = ++m_ClassListCounter;
+}
+
 CKDWORD CKObjectManager::GetGroupGlobalIndex() {
     int index = m_GroupGlobalIndex.GetUnsetBitPosition(0);
     m_GroupGlobalIndex.Set(index);
@@ -1,13 +1,24 @@
 #include "CKParameter.h"
 
 #include "CKAttributeManager.h"
+#include "CKBehaviorManager.h"
 #include "CKMessageManager.h"
 #include "CKParameterManager.h"
 #include "CKParameterOut.h"
 #include "CKFile.h"
 
+#include <atomic>
+#include <mutex>
+
 CK_CLASSID CKParameter::m_ClassID = CKCID_PARAMETER;
 
+static std::atomic<CKParameterVersion> g_ParameterVersion(0);
+
+// Reads pull source values, so they write the parameter: inside a parallel
+// behavior frame the pulls are serialized (see CKBEHAVIOR_ISOLATED).
+static std::mutex g_PullLock;
+static thread_local int g_PullDepth = 0;
+
 CKObject *CKParameter::GetValueObject(CKBOOL update) {
     void *readPtr = GetReadDataPtr(update);
     if (!readPtr || m_Size < (int)sizeof(CK_ID)) {
@@ -20,6 +31,7 @@ CKObject *CKParameter::GetValueObject(CKBOOL update) {
 
 CKERROR CKParameter::GetValue(void *buf, CKBOOL update) {
     if (!buf) return CKERR_INVALIDPARAMETER;
+    PullSourceValue();
     if (!m_Buffer || m_Size == 0) return CKERR_NOTINITIALIZED;
 
     memcpy(buf, m_Buffer, m_Size);
@@ -27,6 +39,11 @@ CKERROR CKParameter::GetValue(void *buf, CKBOOL update) {
 }
 
 CKERROR CKParameter::SetValue(const void *buf, int size) {
+    // Without data the buffer keeps its content
+    if (!buf)
+        PullSourceValue();
+    TouchValue();
+
     if (size > 0 && size != m_Size) {
         CKBYTE *oldBuffer = m_Buffer;
         m_Size = size;
@@ -55,7 +72,9 @@ CKERROR CKParameter::CopyValue(CKParameter *param, CKBOOL UpdateParam) {
             ((CKParameterOut *)param)->Update();
         }
     }
+    param->PullSourceValue();
 
+    TouchValue();
     m_ParamType->CopyFunction(this, param);
     return CK_OK;
 }
@@ -71,15 +90,20 @@ int CKParameter::GetDataSize() {
 }
 
 void *CKParameter::GetReadDataPtr(CKBOOL update) {
+    PullSourceValue();
     return m_Buffer;
 }
 
 void *CKParameter::GetWriteDataPtr() {
+    PullSourceValue();
+    TouchValue();
     return m_Buffer;
 }
 
 CKERROR CKParameter::SetStringValue(CKSTRING Value) {
     if (m_ParamType && m_ParamType->Valid && m_ParamType->StringFunction) {
+        PullSourceValue();
+        TouchValue();
         if (!Value) {
             return m_ParamType->StringFunction(this, nullptr, TRUE);
         }
@@ -94,6 +118,7 @@ CKERROR CKParameter::SetStringValue(CKSTRING Value) {
 
 int CKParameter::GetStringValue(char *Value, CKBOOL update) {
     if (m_ParamType && m_ParamType->Valid && m_ParamType->StringFunction) {
+        PullSourceValue();
         return m_ParamType->StringFunction(this, Value, FALSE);
     }
     if (Value) *Value = '\0';
@@ -112,6 +137,8 @@ void CKParameter::SetType(CKParameterType type) {
     CKParameterTypeDesc *oldType = m_ParamType;
     if (oldType == newType) return; // Already this type
 
+    TouchValue();
+
     // Fast compatible path: old type has no custom life-cycle
     if (oldType && !newType->CreateDefaultFunction && !oldType->DeleteFunction) {
         // Ensure derivation tables are current
@@ -193,6 +220,7 @@ CKParameter::CKParameter(CKContext *Context, CKSTRING name, int type): CKObject(
     m_ParamType = pm->GetParameterTypeDescription(type);
     m_Owner = nullptr;
     m_Buffer = nullptr;
+    m_Version = NewValueVersion();
 
     if (m_ParamType) {
         // Get the default size of the parameter
@@ -243,6 +271,7 @@ void CKParameter::PreSave(CKFile *file, CKDWORD flags) {
 }
 
 CKStateChunk *CKParameter::Save(CKFile *file, CKDWORD flags) {
+    PullSourceValue();
     CKStateChunk *baseChunk = CKObject::Save(file, flags);
 
     CKStateChunk *chunk = CreateCKStateChunk(CKCID_PARAMETER, file);
@@ -306,6 +335,7 @@ CKERROR CKParameter::Load(CKStateChunk *chunk, CKFile *file) {
         return CKERR_INVALIDPARAMETER;
 
     CKObject::Load(chunk, file);
+    TouchValue();
 
     m_ObjectFlags &= ~(CK_PARAMETEROUT_SETTINGS |
         CK_PARAMETERIN_DISABLED |
@@ -461,8 +491,18 @@ CKERROR CKParameter::Load(CKStateChunk *chunk, CKFile *file) {
     return CK_OK;
 }
 
+void CKParameter::CheckPreDeletion() {
+    CKObject::CheckPreDeletion();
+    if (m_Sources.Size() > 0) {
+        // Keep the last value of sources about to be deleted
+        PullSourceValue();
+        m_Sources.Check();
+    }
+}
+
 void CKParameter::CheckPostDeletion() {
     if (m_ParamType && m_ParamType->CheckFunction) {
+        PullSourceValue();
         m_ParamType->CheckFunction(this);
     }
 }
@@ -486,6 +526,7 @@ CKERROR CKParameter::PrepareDependencies(CKDependenciesContext &context) {
         m_ParamType->DeleteFunction(this);
         m_ParamType = nullptr;
     } else if (context.IsInMode(CK_DEPENDENCIES_BUILD)) {
+        PullSourceValue();
         if (GetParameterClassID()) {
             if (m_Buffer) {
                 CKObject *object = m_Context->GetObject(*reinterpret_cast<CK_ID *>(m_Buffer));
@@ -518,6 +559,8 @@ CKERROR CKParameter::RemapDependencies(CKDependenciesContext &context) {
     m_Owner = context.Remap(m_Owner);
 
     if (m_ParamType) {
+        PullSourceValue();
+        TouchValue();
         // If the parameter type has a class ID, remap buffer
         if (m_ParamType->Cid) {
             if (m_Buffer) {
@@ -580,6 +623,48 @@ CKParameter *CKParameter::CreateInstance(CKContext *Context) {
     return new CKParameter(Context);
 }
 
+// Brings the value up to date with the most recent change of the output
+// parameters having this one as destination, as if it had been pushed.
+void CKParameter::PullSourceValue() {
+    if (m_Sources.Size() == 0)
+        return;
+
+    // Nested pulls (sources, copy functions) already hold the lock
+    std::unique_lock<std::mutex> lock;
+    if (g_PullDepth == 0 && CKBehaviorManager::GetThreadState())
+        lock = std::unique_lock<std::mutex>(g_PullLock);
+    ++g_PullDepth;
+
+    CKParameterOut *latest = nullptr;
+    CKParameterVersion version = m_Version;
+    for (CKObject **it = m_Sources.Begin(); it != m_Sources.End(); ++it) {
+        CKParameterOut *source = (CKParameterOut *) *it;
+        if (!source)
+            continue;
+        source->PullSourceValue();
+        if (source->m_Version > version) {
+            version = source->m_Version;
+            latest = source;
+        }
+    }
+
+    if (latest) {
+        // Stamped first: the copy may read or write this parameter again
+        m_Version = version;
+        CopyValue(latest, FALSE);
+        m_Version = version;
+    }
+    --g_PullDepth;
+}
+
+void CKParameter::TouchValue() {
+    m_Version = NewValueVersion();
+}
+
+CKParameterVersion CKParameter::NewValueVersion() {
+    return ++g_ParameterVersion;
+}
+
 void CKParameter::MessageDeleteAfterUse(CKBOOL act) {
     if (act) {
         m_ObjectFlags |= CK_PARAMETEROUT_DELETEAFTERUSE;
@@ -4,6 +4,7 @@
 #include "CKInterfaceManager.h"
 #include "CKStateChunk.h"
 #include "CKCallbackFunctions.h"
+#include "CKBehaviorManager.h"
 
 extern CKPluginManager g_ThePluginManager;
 extern CKPluginEntry *g_TheCurrentPluginEntry;
@@ -14,6 +15,8 @@ CKERROR CKParameterManager::RegisterParameterType(CKParameterTypeDesc *paramType
         return CKERR_INVALIDPARAMETERTYPE;
 
     m_DerivationMasksUpToDate = FALSE;
+    // Parent types take part in operation function resolution
+    FlushOperationFunctionCache();
 
     int freeSlot = -1;
     XArray<CKParameterTypeDesc *> &regTypes = m_RegisteredTypes;
@@ -69,6 +72,7 @@ CKERROR CKParameterManager::RegisterParameterType(CKParameterTypeDesc *paramType
 
 CKERROR CKParameterManager::UnRegisterParameterType(CKGUID guid) {
     m_DerivationMasksUpToDate = FALSE;
+    FlushOperationFunctionCache();
 
     CKParameterTypeDesc *foundDesc = nullptr;
     for (XArray<CKParameterTypeDesc *>::Iterator it = m_RegisteredTypes.Begin(); it != m_RegisteredTypes.End(); ++it) {
@@ -857,6 +861,7 @@ CKOperationType CKParameterManager::RegisterOperationType(CKGUID OpCode, CKSTRIN
     cell.OperationGuid = OpCode;
     cell.CellCount = 0;
     cell.Tree = nullptr;
+    cell.IsDeterministic = FALSE;
 
     m_OpGuids.InsertUnique(OpCode, opType);
     return opType;
@@ -889,9 +894,27 @@ CKERROR CKParameterManager::UnRegisterOperationType(CKOperationType opcode) {
 
     memset(cell.Name, 0, sizeof(cell.Name));
     cell.OperationGuid = CKGUID();
+    FlushOperationFunctionCache();
     return CK_OK;
 }
 
+CKERROR CKParameterManager::SetOperationTypeDeterministic(CKGUID opguid, CKBOOL deterministic) {
+    CKOperationType type = OperationGuidToCode(opguid);
+    if (type < 0 || type >= m_NbOperations || !m_OperationTree)
+        return CKERR_INVALIDOPERATION;
+
+    m_OperationTree[type].IsDeterministic = deterministic;
+    return CK_OK;
+}
+
+CKBOOL CKParameterManager::IsOperationTypeDeterministic(CKGUID opguid) {
+    CKOperationType type = OperationGuidToCode(opguid);
+    if (type < 0 || type >= m_NbOperations || !m_OperationTree)
+        return FALSE;
+
+    return m_OperationTree[type].IsDeterministic;
+}
+
 CKERROR CKParameterManager::RegisterOperationFunction(CKGUID operation, CKGUID type_paramres, CKGUID type_param1, CKGUID type_param2, CK_PARAMETEROPERATION op) {
     if (!m_OperationTree)
         return CKERR_INVALIDOPERATION;
@@ -910,10 +933,45 @@ CKERROR CKParameterManager::RegisterOperationFunction(CKGUID operation, CKGUID t
     if (!resultCell) return CKERR_OUTOFMEMORY;
 
     resultCell->Operation = op;
+    FlushOperationFunctionCache();
     return CK_OK;
 }
 
 CK_PARAMETEROPERATION CKParameterManager::GetOperationFunction(CKGUID operation, CKGUID type_paramres, CKGUID type_param1, CKGUID type_param2) {
+    CKStats &stats = CKBehaviorManager::GetThreadStats(m_Context);
+    OperationFunctionKey key = {operation, type_paramres, type_param1, type_param2};
+
+    // The published table is never modified: no lock is needed to read it
+    XOperationFunctionCache *cache = m_OperationFunctionCache.load(std::memory_order_acquire);
+    CK_PARAMETEROPERATION *cached = cache ? cache->FindPtr(key) : nullptr;
+    if (cached) {
+        ++stats.OperationCacheHits;
+        return *cached;
+    }
+
+    ++stats.OperationCacheMisses;
+    std::lock_guard<std::mutex> lock(m_OperationFunctionCacheLock);
+
+    // Another thread may have resolved it meanwhile
+    cache = m_OperationFunctionCache.load(std::memory_order_relaxed);
+    cached = cache ? cache->FindPtr(key) : nullptr;
+    if (cached)
+        return *cached;
+
+    // Publish a grown copy. Inside a parallel behavior frame other threads may
+    // still read the old table, so it is only freed outside of one.
+    CK_PARAMETEROPERATION op = ResolveOperationFunction(operation, type_paramres, type_param1, type_param2);
+    XOperationFunctionCache *grown = cache ? new XOperationFunctionCache(*cache) : new XOperationFunctionCache();
+    grown->InsertUnique(key, op);
+    m_OperationFunctionCache.store(grown, std::memory_order_release);
+    if (cache)
+        m_RetiredOperationFunctionCaches.PushBack(cache);
+    if (!CKBehaviorManager::GetThreadState())
+        FreeRetiredOperationFunctionCaches();
+    return op;
+}
+
+CK_PARAMETEROPERATION CKParameterManager::ResolveOperationFunction(CKGUID operation, CKGUID type_paramres, CKGUID type_param1, CKGUID type_param2) {
     CKOperationType type = OperationGuidToCode(operation);
     if (type < 0 || type >= m_NbOperations || !m_OperationTree)
         return nullptr;
@@ -945,48 +1003,63 @@ CK_PARAMETEROPERATION CKParameterManager::GetOperationFunction(CKGUID operation,
 
     // Combination 1: All parents
     if (hasParentP1 && hasParentP2 && hasParentRes) {
-        CK_PARAMETEROPERATION result = GetOperationFunction(operation, parentRes, parentP1, parentP2);
+        CK_PARAMETEROPERATION result = ResolveOperationFunction(operation, parentRes, parentP1, parentP2);
         if (result) return result;
     }
 
     // Combination 2: Parent param1 and param2
     if (hasParentP1 && hasParentP2) {
-        CK_PARAMETEROPERATION result = GetOperationFunction(operation, type_paramres, parentP1, parentP2);
+        CK_PARAMETEROPERATION result = ResolveOperationFunction(operation, type_paramres, parentP1, parentP2);
         if (result) return result;
     }
 
     // Combination 3: Parent param1 and result
     if (hasParentP1 && hasParentRes) {
-        CK_PARAMETEROPERATION result = GetOperationFunction(operation, parentRes, parentP1, type_param2);
+        CK_PARAMETEROPERATION result = ResolveOperationFunction(operation, parentRes, parentP1, type_param2);
         if (result) return result;
     }
 
     // Combination 4: Parent param1
     if (hasParentP1) {
-        CK_PARAMETEROPERATION result = GetOperationFunction(operation, type_paramres, parentP1, type_param2);
+        CK_PARAMETEROPERATION result = ResolveOperationFunction(operation, type_paramres, parentP1, type_param2);
         if (result) return result;
     }
 
     // Combination 5: Parent param2 and result
     if (hasParentP2 && hasParentRes) {
-        CK_PARAMETEROPERATION result = GetOperationFunction(operation, parentRes, type_param1, parentP2);
+        CK_PARAMETEROPERATION result = ResolveOperationFunction(operation, parentRes, type_param1, parentP2);
         if (result) return result;
     }
 
     // Combination 6: Parent param2
     if (hasParentP2) {
-        CK_PARAMETEROPERATION result = GetOperationFunction(operation, type_paramres, type_param1, parentP2);
+        CK_PARAMETEROPERATION result = ResolveOperationFunction(operation, type_paramres, type_param1, parentP2);
         if (result) return result;
     }
 
     // Combination 7: Parent result
     if (hasParentRes) {
-        return GetOperationFunction(operation, parentRes, type_param1, type_param2);
+        return ResolveOperationFunction(operation, parentRes, type_param1, type_param2);
     }
 
     return nullptr;
 }
 
+// Called when operations or parameter types are registered, on the main thread
+void CKParameterManager::FlushOperationFunctionCache() {
+    std::lock_guard<std::mutex> lock(m_OperationFunctionCacheLock);
+    XOperationFunctionCache *cache = m_OperationFunctionCache.exchange(nullptr, std::memory_order_acq_rel);
+    if (cache)
+        m_RetiredOperationFunctionCaches.PushBack(cache);
+    FreeRetiredOperationFunctionCaches();
+}
+
+void CKParameterManager::FreeRetiredOperationFunctionCaches() {
+    for (int i = 0; i < m_RetiredOperationFunctionCaches.Size(); ++i)
+        delete m_RetiredOperationFunctionCaches[i];
+    m_RetiredOperationFunctionCaches.Clear();
+}
+
 CKERROR CKParameterManager::UnRegisterOperationFunction(CKGUID operation, CKGUID type_paramres, CKGUID type_param1, CKGUID type_param2) {
     if (!m_OperationTree)
         return CKERR_INVALIDOPERATION;
@@ -1006,6 +1079,7 @@ CKERROR CKParameterManager::UnRegisterOperationFunction(CKGUID operation, CKGUID
     if (posRes < 0) return CKERR_OPERATIONNOTIMPLEMENTED;
     TreeCell &resultCell = param2Cell.Children[posRes];
     resultCell.Operation = nullptr;
+    FlushOperationFunctionCache();
 
     return CK_OK;
 }
@@ -1232,6 +1306,7 @@ CKParameterManager::CKParameterManager(CKContext *Context) : CKBaseManager(Conte
     m_NbOperations = 0;
     m_NbAllocatedOperations = 0;
     m_OperationTree = nullptr;
+    m_OperationFunctionCache = nullptr;
     m_DerivationMasksUpToDate = FALSE;
     m_NbFlagsDefined = 0;
     m_Flags = nullptr;
@@ -1344,6 +1419,7 @@ CKBOOL CKParameterManager::IsDerivedFromIntern(int childIdx, int parentIdx) {
 
 CKBOOL CKParameterManager::RemoveAllParameterTypes() {
     m_ParamGuids.Clear();
+    FlushOperationFunctionCache();
 
     if (m_Enums) {
         for (int i = 0; i < m_NbEnumsDefined; ++i) {
@@ -1393,6 +1469,7 @@ CKBOOL CKParameterManager::RemoveAllOperations() {
     m_NbOperations = 0;
     m_NbAllocatedOperations = 0;
     m_OpGuids.Clear();
+    FlushOperationFunctionCache();
     return TRUE;
 }
 
@@ -1,6 +1,7 @@
 #include "CKParameterOperation.h"
 
 #include "CKBehavior.h"
+#include "CKBehaviorManager.h"
 #include "CKFile.h"
 #include "CKParameterIn.h"
 #include "CKParameterOut.h"
@@ -12,7 +13,41 @@ CKSTRING CKParameterOperation::m_In1Name = "Pin 0";
 CKSTRING CKParameterOperation::m_In2Name = "Pin 1";
 CKSTRING CKParameterOperation::m_OutName = "Pout 0";
 
+// Version of the value read by an input, 0 if it has no source
+static CKParameterVersion GetInputVersion(CKParameterIn *in) {
+    CKParameter *src = in ? in->GetRealSource() : nullptr;
+    if (!src)
+        return 0;
+    src->PullSourceValue();
+    return src->GetValueVersion();
+}
+
+static CKBOOL IsInputUpToDate(CKParameterIn *in, CKParameterVersion version) {
+    CKParameter *src = in ? in->GetRealSource() : nullptr;
+    if (src && (src->GetObjectFlags() & CK_PARAMETEROUT_PARAMOP)) {
+        // An operation output that will be recomputed on read has changed
+        CKObject *owner = src->GetOwner();
+        if (owner && CKIsChildClassOf(owner, CKCID_PARAMETEROPERATION) &&
+            !((CKParameterOperation *) owner)->IsOutputUpToDate())
+            return FALSE;
+    }
+    return GetInputVersion(in) == version;
+}
+
+CKBOOL CKParameterOperation::IsOutputUpToDate() {
+    if (!m_Out || !m_OperationFunction || m_OutVersion == 0 || m_Out->GetValueVersion() != m_OutVersion)
+        return FALSE;
+
+    CKParameterManager *pm = m_Context->GetParameterManager();
+    if (!pm->IsOperationTypeDeterministic(m_OperationGuid))
+        return FALSE;
+
+    return IsInputUpToDate(m_In1, m_In1Version) && IsInputUpToDate(m_In2, m_In2Version);
+}
+
 CKERROR CKParameterOperation::DoOperation() {
+    m_OutVersion = 0;
+
     if (!m_OperationFunction) {
         if (m_In1 && m_Out) {
             CKParameter *src = m_In1->GetRealSource();
@@ -35,17 +70,20 @@ CKERROR CKParameterOperation::DoOperation() {
 
     VxTimeProfiler profiler;
 
+    // Stamped before the call: functions may write through GetReadDataPtr
+    m_Out->DataChanged();
     if (m_HasOperationFunction) {
         m_OperationFunction(m_Context, m_Out, m_In2, m_In1);
     } else {
         m_OperationFunction(m_Context, m_Out, m_In1, m_In2);
     }
 
-    if (m_Out)
-        m_Out->DataChanged();
+    m_In1Version = GetInputVersion(m_In1);
+    m_In2Version = GetInputVersion(m_In2);
+    m_OutVersion = m_Out->GetValueVersion();
 
     if (m_Context && m_Context->m_ProfilingEnabled) {
-        m_Context->m_Stats.ParametricOperations += profiler.Current();
+        CKBehaviorManager::GetThreadStats(m_Context).ParametricOperations += profiler.Current();
     }
 
     return CK_OK;
@@ -88,6 +126,7 @@ void CKParameterOperation::Update() {
     SetName(pm->OperationGuidToName(m_OperationGuid), TRUE);
 
     m_HasOperationFunction = FALSE;
+    m_OutVersion = 0;
 
     if (m_In1) {
         m_In1->SetOwner(this);
@@ -135,6 +174,9 @@ CKParameterOperation::CKParameterOperation(CKContext *Context, CKSTRING name) :
     m_OperationGuid = CKGUID();
     m_OperationFunction = nullptr;
     m_HasOperationFunction = FALSE;
+    m_In1Version = 0;
+    m_In2Version = 0;
+    m_OutVersion = 0;
 }
 
 CKParameterOperation::CKParameterOperation(CKContext *Context, CKSTRING name, CKGUID OpGuid, CKGUID ResGuid, CKGUID P1Guid, CKGUID P2Guid)
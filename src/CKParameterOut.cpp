@@ -46,13 +46,9 @@ int CKParameterOut::GetStringValue(char *Value, CKBOOL update) {
     return CKParameter::GetStringValue(Value, update);
 }
 
+// Destinations are not written here: they pull the value when they are used
 void CKParameterOut::DataChanged() {
-    for (auto it = m_Destinations.Begin(); it != m_Destinations.End(); ++it) {
-        CKParameter *param = (CKParameter *) *it;
-        if (param) {
-            param->CopyValue(this, FALSE);
-        }
-    }
+    TouchValue();
 }
 
 CKERROR CKParameterOut::AddDestination(CKParameter *param, CKBOOL CheckType) {
@@ -103,11 +99,22 @@ CKERROR CKParameterOut::AddDestination(CKParameter *param, CKBOOL CheckType) {
     if (!m_Destinations.AddIfNotHere(param))
         return CKERR_ALREADYPRESENT;
 
+    // Only changes made from now on reach the new destination
+    param->PullSourceValue();
+    param->TouchValue();
+    param->m_Sources.AddIfNotHere(this);
+
     return CK_OK;
 }
 
 void CKParameterOut::RemoveDestination(CKParameter *param) {
+    if (!param || !m_Destinations.IsHere(param))
+        return;
     m_Destinations.Remove(param);
+
+    // The destination keeps the last value pushed to it
+    param->PullSourceValue();
+    param->m_Sources.Remove(this);
 }
 
 int CKParameterOut::GetDestinationCount() {
@@ -122,6 +129,22 @@ CKParameter *CKParameterOut::GetDestination(int pos) {
 }
 
 void CKParameterOut::RemoveAllDestinations() {
+    for (CKObject **it = m_Destinations.Begin(); it != m_Destinations.End(); ++it) {
+        CKParameter *param = (CKParameter *) *it;
+        if (param) {
+            param->PullSourceValue();
+            param->m_Sources.Remove(this);
+        }
+    }
+    m_Destinations.Clear();
+}
+
+void CKParameterOut::UnlinkDestinations() {
+    for (CKObject **it = m_Destinations.Begin(); it != m_Destinations.End(); ++it) {
+        CKParameter *param = (CKParameter *) *it;
+        if (param)
+            param->m_Sources.Remove(this);
+    }
     m_Destinations.Clear();
 }
 
@@ -179,7 +202,7 @@ CKERROR CKParameterOut::Load(CKStateChunk *chunk, CKFile *file) {
                        CK_PARAMETEROUT_DELETEAFTERUSE);
 
     if (chunk->SeekIdentifier(CK_STATESAVE_PARAMETEROUT_DESTINATIONS)) {
-        m_Destinations.Clear();
+        UnlinkDestinations();
         const int destCount = chunk->ReadInt();
         for (int i = 0; i < destCount; ++i) {
             CKObject *obj = chunk->ReadObject(m_Context);
@@ -197,6 +220,16 @@ CKERROR CKParameterOut::Load(CKStateChunk *chunk, CKFile *file) {
 
 void CKParameterOut::PreDelete() {
     CKObject::PreDelete();
+
+    // Hand the last value to the remaining destinations
+    for (CKObject **it = m_Destinations.Begin(); it != m_Destinations.End(); ++it) {
+        CKParameter *param = (CKParameter *) *it;
+        if (param && !param->IsToBeDeleted()) {
+            param->PullSourceValue();
+            param->m_Sources.Remove(this);
+        }
+    }
+
     CKObject *owner = GetOwner();
     if (!owner)
         return;
@@ -243,7 +276,7 @@ void CKParameterOut::PreDelete() {
 }
 
 void CKParameterOut::CheckPreDeletion() {
-    CKObject::CheckPreDeletion();
+    CKParameter::CheckPreDeletion();
     m_Destinations.Check();
 }
 
@@ -281,7 +314,18 @@ CKERROR CKParameterOut::RemapDependencies(CKDependenciesContext &context) {
         return err;
     }
 
+    // Reverse links follow the remapped destinations
+    for (CKObject **it = m_Destinations.Begin(); it != m_Destinations.End(); ++it) {
+        CKParameter *param = (CKParameter *) *it;
+        if (param)
+            param->m_Sources.Remove(this);
+    }
     m_Destinations.Remap(context);
+    for (CKObject **it = m_Destinations.Begin(); it != m_Destinations.End(); ++it) {
+        CKParameter *param = (CKParameter *) *it;
+        if (param)
+            param->m_Sources.AddIfNotHere(this);
+    }
     return CK_OK;
 }
 
@@ -295,7 +339,7 @@ CKERROR CKParameterOut::Copy(CKObject &o, CKDependenciesContext &context) {
     if (this == pOut)
         return CK_OK;
 
-    m_Destinations.Clear();
+    UnlinkDestinations();
 
     for (CKObject **it = pOut->m_Destinations.Begin(); it != pOut->m_Destinations.End(); ++it) {
         CKParameter *param = (CKParameter *) *it;
@@ -329,7 +373,8 @@ void CKParameterOut::Update() {
         CKObject *owner = GetOwner();
         if (owner && CKIsChildClassOf(owner, CKCID_PARAMETEROPERATION)) {
             CKParameterOperation *op = (CKParameterOperation *)owner;
-            op->DoOperation();
+            if (!op->IsOutputUpToDate())
+                op->DoOperation();
         }
     }
 }
@@ -10,6 +10,7 @@
 #include "CKCamera.h"
 #include "CKPlace.h"
 #include "CKFile.h"
+#include "CKSceneObjectSnapshot.h"
 
 CK_CLASSID CKScene::m_ClassID = CKCID_SCENE;
 
@@ -134,6 +135,7 @@ void CKScene::RemoveObject(CKSceneObject *o) {
 
     desc->Clear();
     m_SceneObjects.Remove(o->GetID());
+    RemoveResetSnapshot(o->GetID());
 
     o->RemoveSceneIn(this);
 
@@ -157,6 +159,7 @@ void CKScene::RemoveAllObjects() {
         desc.Clear();
     }
     m_SceneObjects.Clear();
+    ClearResetSnapshots();
 }
 
 const XObjectPointerArray &CKScene::ComputeObjectList(CK_CLASSID cid, CKBOOL derived) {
@@ -241,11 +244,8 @@ void CKScene::ActivateBeObject(CKBeObject *beo, CKBOOL activate, CKBOOL reset) {
             if (scriptCount > 0 || CKIsChildClassOf(beo, CKCID_CHARACTER))
                 m_Context->GetBehaviorManager()->AddObjectNextFrame(beo);
 
-            if (reset && (desc->m_Flags & CK_SCENEOBJECT_START_RESET)) {
-                CKStateChunk *initialValue = desc->m_InitialValue;
-                if (initialValue)
-                    beo->Load(initialValue, nullptr);
-            }
+            if (reset && (desc->m_Flags & CK_SCENEOBJECT_START_RESET) && desc->m_InitialValue)
+                ResetObject(beo, desc);
 
             for (int i = 0; i < scriptCount; ++i) {
                 CKBehavior *script = beo->GetScript(i);
@@ -345,6 +345,7 @@ CKBOOL CKScene::SetObjectInitialValue(CKSceneObject *o, CKStateChunk *chunk) {
     delete desc->m_InitialValue;
     if (chunk) chunk->CloseChunk();
     desc->m_InitialValue = chunk;
+    RemoveResetSnapshot(desc->m_Object);
     return TRUE;
 }
 
@@ -352,6 +353,8 @@ CKStateChunk *CKScene::GetObjectInitialValue(CKSceneObject *o) {
     CKSceneObjectDesc *desc = GetSceneObjectDesc(o);
     if (!desc)
         return nullptr;
+    // The caller may change the chunk
+    RemoveResetSnapshot(desc->m_Object);
     return desc->m_InitialValue;
 }
 
@@ -593,7 +596,7 @@ void CKScene::Init(XObjectPointerArray &renderContexts, CK_SCENEOBJECTACTIVITY_F
         }
 
         if (reset && desc->m_InitialValue)
-            obj->Load(desc->m_InitialValue, nullptr);
+            ResetObject(obj, desc);
 
         if (!doNothing) {
             if (active) desc->m_Flags |= CK_SCENEOBJECT_ACTIVE;
@@ -697,8 +700,43 @@ void CKScene::Launch() {
         }
 
         if ((desc->m_Flags & CK_SCENEOBJECT_START_RESET) && desc->m_InitialValue)
-            obj->Load(desc->m_InitialValue, nullptr);
+            ResetObject(obj, desc);
+    }
+}
+
+// Objects with a snapshot of their initial value are restored from it, the
+// snapshot is made by the first reset which loads the chunk.
+void CKScene::ResetObject(CKObject *obj, CKSceneObjectDesc *desc) {
+    CKStateChunk *chunk = desc->m_InitialValue;
+    CKSceneObjectSnapshot **entry = m_ResetSnapshots.FindPtr(desc->m_Object);
+    if (entry && !(*entry)->IsSnapshotOf(obj, chunk)) {
+        RemoveResetSnapshot(desc->m_Object);
+        entry = nullptr;
     }
+
+    if (entry && (*entry)->Restore(obj))
+        return;
+
+    obj->Load(chunk, nullptr);
+    if (!entry) {
+        CKSceneObjectSnapshot *snapshot = CKSceneObjectSnapshot::Create(obj, chunk);
+        if (snapshot)
+            m_ResetSnapshots.Insert(desc->m_Object, snapshot);
+    }
+}
+
+void CKScene::RemoveResetSnapshot(CK_ID id) {
+    CKSceneObjectSnapshot **entry = m_ResetSnapshots.FindPtr(id);
+    if (!entry)
+        return;
+    delete *entry;
+    m_ResetSnapshots.Remove(id);
+}
+
+void CKScene::ClearResetSnapshots() {
+    for (CKSceneSnapshotHash::Iterator it = m_ResetSnapshots.Begin(); it != m_ResetSnapshots.End(); ++it)
+        delete *it;
+    m_ResetSnapshots.Clear();
 }
 
 CKScene::CKScene(CKContext *Context, CKSTRING name) : CKBeObject(Context, name) {
@@ -957,6 +995,7 @@ void CKScene::PreDelete() {
         CKSceneObjectDesc &desc = *it;
         desc.Clear();
     }
+    ClearResetSnapshots();
 }
 
 void CKScene::CheckPostDeletion() {
@@ -972,6 +1011,7 @@ void CKScene::CheckPostDeletion() {
 int CKScene::GetMemoryOccupation() {
     int size = CKBeObject::GetMemoryOccupation() + (int) (sizeof(CKScene) - sizeof(CKBeObject));
     size += m_SceneObjects.GetMemoryOccupation(FALSE);
+    size += m_ResetSnapshots.GetMemoryOccupation(FALSE);
     return size;
 }
 
@@ -1005,6 +1045,7 @@ CKERROR CKScene::RemapDependencies(CKDependenciesContext &context) {
     m_StartingCamera = context.RemapID(m_StartingCamera);
 
     CKSODHash remappedSceneObjects;
+    ClearResetSnapshots();
 
     // Clear scene membership bits from currently referenced objects before remapping IDs.
     for (CKSODHashIt it = m_SceneObjects.Begin(); it != m_SceneObjects.End(); ++it) {
@@ -1143,6 +1184,7 @@ void CKScene::CheckSceneObjectList() {
             CKSceneObjectDesc &desc = *it;
             desc.Clear();
             m_SceneObjects.Remove(objID);
+            RemoveResetSnapshot(objID);
         }
     }
 }
@@ -1169,6 +1211,7 @@ CKSceneObjectDesc *CKScene::AddObjectDesc(CKSceneObject *o) {
     desc.Init(o);
     desc.m_Flags &= ~removeFlags;
     CKSODHashIt it = m_SceneObjects.InsertUnique(o->GetID(), desc);
+    RemoveResetSnapshot(o->GetID());
     o->AddSceneIn(this);
     return it;
 }
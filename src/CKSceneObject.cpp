@@ -107,8 +107,11 @@ void CKSceneObject::AddSceneIn(CKScene *scene) {
 }
 
 void CKSceneObject::RemoveSceneIn(CKScene *scene) {
-    if (scene)
-        m_Scenes.TestUnset(scene->m_SceneGlobalIndex);
+    if (!scene)
+        return;
+
+    if (m_Scenes.TestUnset(scene->m_SceneGlobalIndex))
+        m_Context->GetAttributeManager()->RefreshList(this, scene);
 }
 
 void CKSceneObject::RemoveFromAllScenes() {
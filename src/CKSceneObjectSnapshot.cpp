@@ -0,0 +1,371 @@
+#include "CKSceneObjectSnapshot.h"
+
+#include "CKAttributeManager.h"
+#include "CKGroup.h"
+#include "CKParameterOut.h"
+#include "CKStateChunk.h"
+
+#include <string.h>
+
+static const CKDWORD ShowFlags = CK_OBJECT_VISIBLE | CK_OBJECT_HIERACHICALHIDE;
+
+// Object flags set by CKParameterOut::Load
+static const CKDWORD LoadedParameterFlags = ShowFlags |
+    CK_PARAMETEROUT_SETTINGS |
+    CK_PARAMETERIN_DISABLED |
+    CK_PARAMETERIN_THIS |
+    CK_PARAMETERIN_SHARED |
+    CK_PARAMETEROUT_DELETEAFTERUSE;
+
+static CKBOOL SameString(const char *a, const char *b) {
+    if (!a || !b)
+        return a == b;
+    return strcmp(a, b) == 0;
+}
+
+CKSceneObjectSnapshot *CKSceneObjectSnapshot::Create(CKObject *obj, CKStateChunk *chunk) {
+    if (!obj || !chunk)
+        return nullptr;
+
+    const CK_CLASSID cid = obj->GetClassID();
+    if (cid != CKCID_DATAARRAY && cid != CKCID_GROUP)
+        return nullptr;
+
+    CKSceneObjectSnapshot *snapshot = new CKSceneObjectSnapshot();
+    snapshot->m_Chunk = chunk;
+    snapshot->m_ChunkSize = chunk->GetDataSize();
+    snapshot->m_ClassID = cid;
+    snapshot->m_ShowFlags = obj->GetObjectFlags() & ShowFlags;
+
+    CKBOOL exact = snapshot->ReadAttributes(chunk);
+    if (exact) {
+        if (cid == CKCID_DATAARRAY)
+            exact = snapshot->ReadDataArray((CKDataArray *) obj, chunk);
+        else
+            snapshot->ReadGroup(chunk);
+    }
+
+    if (!exact) {
+        delete snapshot;
+        return nullptr;
+    }
+
+    snapshot->RecordAttributes((CKBeObject *) obj);
+    return snapshot;
+}
+
+CKSceneObjectSnapshot::CKSceneObjectSnapshot() {
+    m_Chunk = nullptr;
+    m_ChunkSize = 0;
+    m_ClassID = 0;
+    m_ShowFlags = 0;
+    m_RowCount = 0;
+    m_HasMembers = FALSE;
+    m_HasKeyColumn = FALSE;
+    m_Order = FALSE;
+    m_ColumnIndex = 0;
+    m_KeyColumn = 0;
+}
+
+CKSceneObjectSnapshot::~CKSceneObjectSnapshot() {
+    for (int i = 0; i < m_Attributes.Size(); ++i) {
+        delete m_Attributes[i].Value;
+        delete[] m_Attributes[i].RestoredValue;
+    }
+
+    const int columnCount = m_Columns.Size();
+    for (int c = 0; c < columnCount; ++c) {
+        if (m_Columns[c].Type == CKARRAYTYPE_STRING) {
+            for (int i = c; i < m_Cells.Size(); i += columnCount)
+                delete[] (char *) m_Cells[i];
+        }
+        delete[] m_Columns[c].Name;
+    }
+}
+
+CKBOOL CKSceneObjectSnapshot::IsSnapshotOf(CKObject *obj, CKStateChunk *chunk) {
+    return chunk == m_Chunk && chunk->GetDataSize() == m_ChunkSize && obj->GetClassID() == m_ClassID;
+}
+
+CKBOOL CKSceneObjectSnapshot::Restore(CKObject *obj) {
+    CKDataArray *array = nullptr;
+    if (m_ClassID == CKCID_DATAARRAY) {
+        array = (CKDataArray *) obj;
+        if (!HasDataArrayFormat(array))
+            return FALSE;
+    }
+
+    obj->ModifyObjectFlags(m_ShowFlags, ShowFlags & ~m_ShowFlags);
+    RestoreAttributes((CKBeObject *) obj);
+    if (array)
+        RestoreDataArray(array);
+    else
+        RestoreGroup((CKGroup *) obj);
+    return TRUE;
+}
+
+// Same reads as the CK_STATESAVE_NEWATTRIBUTES part of CKBeObject::Load
+CKBOOL CKSceneObjectSnapshot::ReadAttributes(CKStateChunk *chunk) {
+    chunk->StartRead();
+    if (!chunk->SeekIdentifier(CK_STATESAVE_NEWATTRIBUTES))
+        return !chunk->SeekIdentifier(CK_STATESAVE_ATTRIBUTES);
+
+    // Older chunks are remapped by the attribute manager on each load
+    if (chunk->GetChunkVersion() < 6 && !chunk->GetManagers())
+        return FALSE;
+
+    const int count = chunk->StartReadSequence();
+    m_Attributes.Resize(count);
+    for (int i = 0; i < count; ++i) {
+        Attribute &attribute = m_Attributes[i];
+        attribute.Type = -1;
+        attribute.Parameter = chunk->ReadObjectID();
+        attribute.Value = nullptr;
+        attribute.Linked = FALSE;
+        attribute.RestoredParameter = 0;
+        attribute.RestoredValue = nullptr;
+        attribute.RestoredSize = 0;
+        attribute.RestoredFlags = 0;
+    }
+
+    chunk->StartReadSequence();
+    for (int i = 0; i < count; ++i)
+        m_Attributes[i].Value = chunk->ReadSubChunk();
+
+    CKGUID managerGuid;
+    const int seqCount = chunk->StartManagerReadSequence(&managerGuid);
+    if (managerGuid != ATTRIBUTE_MANAGER_GUID || seqCount != count)
+        return FALSE;
+
+    for (int i = 0; i < count; ++i) {
+        Attribute &attribute = m_Attributes[i];
+        attribute.Type = chunk->ReadDword();
+        if (attribute.Value) {
+            attribute.Value->StartRead();
+            attribute.Linked = attribute.Value->SeekIdentifier(CK_STATESAVE_PARAMETEROUT_DESTINATIONS);
+        }
+    }
+    return TRUE;
+}
+
+void CKSceneObjectSnapshot::RecordAttributes(CKBeObject *beo) {
+    for (int i = 0; i < m_Attributes.Size(); ++i) {
+        Attribute &attribute = m_Attributes[i];
+        RecordAttribute(attribute, beo->GetAttributeParameter(attribute.Type));
+    }
+}
+
+// Keeps the parameter as the load left it: its value bytes are the decoded value
+void CKSceneObjectSnapshot::RecordAttribute(Attribute &attribute, CKParameter *param) {
+    delete[] attribute.RestoredValue;
+    attribute.RestoredValue = nullptr;
+    attribute.RestoredSize = 0;
+    attribute.RestoredParameter = param ? param->GetID() : 0;
+    attribute.RestoredFlags = param ? param->GetObjectFlags() & LoadedParameterFlags : 0;
+
+    const int size = param ? param->GetDataSize() : 0;
+    if (size > 0) {
+        attribute.RestoredValue = new CKBYTE[size];
+        attribute.RestoredSize = size;
+        memcpy(attribute.RestoredValue, param->GetReadDataPtr(FALSE), size);
+    }
+}
+
+// TRUE if the parameter still holds the value and flags recorded at the last reset
+CKBOOL CKSceneObjectSnapshot::HasRestoredValue(const Attribute &attribute, CKParameter *param) {
+    if (param->GetClassID() != CKCID_PARAMETEROUT ||
+        param->GetID() != attribute.RestoredParameter ||
+        (param->GetObjectFlags() & LoadedParameterFlags) != attribute.RestoredFlags ||
+        param->GetDataSize() != attribute.RestoredSize)
+        return FALSE;
+    return attribute.RestoredSize == 0 ||
+           memcmp(param->GetReadDataPtr(FALSE), attribute.RestoredValue, attribute.RestoredSize) == 0;
+}
+
+void CKSceneObjectSnapshot::RestoreAttributes(CKBeObject *beo) {
+    CKContext *context = beo->GetCKContext();
+    CKAttributeManager *am = context->GetAttributeManager();
+
+    for (int i = 0; i < m_Attributes.Size(); ++i) {
+        Attribute &attribute = m_Attributes[i];
+        CKObject *paramObj = context->GetObject(attribute.Parameter);
+        beo->SetAttribute(attribute.Type, paramObj ? paramObj->GetID() : 0);
+
+        CKParameter *param = beo->GetAttributeParameter(attribute.Type);
+        if (!param)
+            continue;
+
+        // Compared with the value it would pull from a source
+        param->PullSourceValue();
+        if (attribute.Value && !attribute.Linked && HasRestoredValue(attribute, param)) {
+            // Same bytes as the decoded value: only the new version of the load
+            param->TouchValue();
+            continue;
+        }
+
+        param->Load(attribute.Value, nullptr);
+        CKParameterType paramType = am->GetAttributeParameterType(attribute.Type);
+        if (param->GetType() != paramType)
+            param->SetType(paramType);
+        RecordAttribute(attribute, param);
+    }
+}
+
+// The array was just loaded from a chunk holding its format: its columns, cells and
+// members are then those of the chunk only, whatever they were before.
+CKBOOL CKSceneObjectSnapshot::ReadDataArray(CKDataArray *array, CKStateChunk *chunk) {
+    if (!chunk->SeekIdentifier(CK_STATESAVE_DATAARRAYFORMAT))
+        return FALSE;
+    m_HasMembers = chunk->SeekIdentifier(CK_STATESAVE_DATAARRAYMEMBERS);
+    m_HasKeyColumn = m_HasMembers && chunk->GetDataVersion() >= 5;
+
+    const int columnCount = array->m_FormatArray.Size();
+    for (int c = 0; c < columnCount; ++c) {
+        if (array->m_FormatArray[c]->m_Type == CKARRAYTYPE_PARAMETER)
+            return FALSE;
+    }
+
+    m_Columns.Resize(columnCount);
+    for (int c = 0; c < columnCount; ++c) {
+        ColumnFormat *fmt = array->m_FormatArray[c];
+        Column &column = m_Columns[c];
+        column.Name = CKStrdup(fmt->m_Name);
+        column.Type = fmt->m_Type;
+        column.ParameterType = fmt->m_ParameterType;
+        column.SortFunction = fmt->m_SortFunction;
+        column.EqualFunction = fmt->m_EqualFunction;
+    }
+
+    m_RowCount = array->m_DataMatrix.Size();
+    m_Cells.Resize(m_RowCount * columnCount);
+    CKUINTPTR *cells = m_Cells.Begin();
+    for (int r = 0; r < m_RowCount; ++r) {
+        CKDataRow *row = array->m_DataMatrix[r];
+        for (int c = 0; c < columnCount; ++c) {
+            CKUINTPTR value = (*row)[c];
+            if (m_Columns[c].Type == CKARRAYTYPE_STRING)
+                value = (CKUINTPTR) CKStrdup((char *) value);
+            *cells++ = value;
+        }
+    }
+
+    m_Order = array->m_Order;
+    m_ColumnIndex = array->m_ColumnIndex;
+    m_KeyColumn = array->m_KeyColumn;
+    return TRUE;
+}
+
+// Columns as created by CKDataArray::Load: not indexed nor packed
+CKBOOL CKSceneObjectSnapshot::HasDataArrayFormat(CKDataArray *array) {
+    const int columnCount = m_Columns.Size();
+    if (array->m_FormatArray.Size() != columnCount)
+        return FALSE;
+
+    for (int c = 0; c < columnCount; ++c) {
+        ColumnFormat *fmt = array->m_FormatArray[c];
+        const Column &column = m_Columns[c];
+        if (fmt->m_Type != column.Type ||
+            fmt->m_ParameterType != column.ParameterType ||
+            fmt->m_SortFunction != column.SortFunction ||
+            fmt->m_EqualFunction != column.EqualFunction ||
+            fmt->m_Index || fmt->m_Store ||
+            !SameString(fmt->m_Name, column.Name))
+            return FALSE;
+    }
+
+    for (int r = 0; r < array->m_DataMatrix.Size(); ++r) {
+        if (array->m_DataMatrix[r]->Size() != columnCount)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void CKSceneObjectSnapshot::RestoreDataArray(CKDataArray *array) {
+    const int columnCount = m_Columns.Size();
+    CKDataMatrix &matrix = array->m_DataMatrix;
+    CKBOOL changed = FALSE;
+
+    while (matrix.Size() > m_RowCount) {
+        CKDataRow *row = matrix.PopBack();
+        for (int c = 0; c < columnCount; ++c) {
+            if (m_Columns[c].Type == CKARRAYTYPE_STRING)
+                delete[] (char *) (*row)[c];
+        }
+        delete row;
+        changed = TRUE;
+    }
+
+    const CKUINTPTR *cells = m_Cells.Begin();
+    for (int r = 0; r < m_RowCount; ++r, cells += columnCount) {
+        CKDataRow *row;
+        if (r < matrix.Size()) {
+            row = matrix[r];
+        } else {
+            row = new CKDataRow();
+            row->Resize(columnCount);
+            for (int c = 0; c < columnCount; ++c)
+                (*row)[c] = 0;
+            matrix.PushBack(row);
+            changed = TRUE;
+        }
+
+        for (int c = 0; c < columnCount; ++c) {
+            CKUINTPTR &element = (*row)[c];
+            if (m_Columns[c].Type == CKARRAYTYPE_STRING) {
+                if (!SameString((char *) element, (char *) cells[c])) {
+                    delete[] (char *) element;
+                    element = (CKUINTPTR) CKStrdup((char *) cells[c]);
+                    changed = TRUE;
+                }
+            } else if (element != cells[c]) {
+                element = cells[c];
+                changed = TRUE;
+            }
+        }
+    }
+
+    if (changed)
+        array->InvalidateColumnIndexes();
+
+    if (m_HasMembers) {
+        array->m_Order = m_Order;
+        array->m_ColumnIndex = m_ColumnIndex;
+        if (m_HasKeyColumn)
+            array->m_KeyColumn = m_KeyColumn;
+    }
+}
+
+void CKSceneObjectSnapshot::ReadGroup(CKStateChunk *chunk) {
+    if (chunk->SeekIdentifier(CK_STATESAVE_GROUPALL))
+        m_Members = chunk->ReadXObjectArray();
+}
+
+// CKGroup::Load keeps the objects of the list that still exist
+void CKSceneObjectSnapshot::RestoreGroup(CKGroup *group) {
+    CKContext *context = group->GetCKContext();
+    XObjectPointerArray &objects = group->m_ObjectArray;
+
+    int count = 0;
+    CKBOOL same = TRUE;
+    for (int i = 0; i < m_Members.Size() && same; ++i) {
+        CKBeObject *o = (CKBeObject *) context->GetObject(m_Members[i]);
+        if (!o)
+            continue;
+        same = count < objects.Size() && objects[count] == o && o->IsInGroup(group);
+        ++count;
+    }
+
+    if (!same || count != objects.Size()) {
+        group->Clear();
+        for (int i = 0; i < m_Members.Size(); ++i) {
+            CKBeObject *o = (CKBeObject *) context->GetObject(m_Members[i]);
+            if (!o)
+                continue;
+            objects.PushBack(o);
+            if (!o->IsInGroup(group))
+                o->AddToGroup(group);
+        }
+    }
+
+    group->m_ClassIdUpdated = FALSE;
+}
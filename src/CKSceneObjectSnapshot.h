@@ -0,0 +1,91 @@
+#ifndef CKSCENEOBJECTSNAPSHOT_H
+#define CKSCENEOBJECTSNAPSHOT_H
+
+#include "CKDataArray.h"
+#include "CKParameter.h"
+
+// Decoded initial value of a scene object (see CKScene::ResetObject).
+//
+// Restore gives the object the state CKObject::Load(chunk, NULL) gives it,
+// without parsing the chunk again. Each part of the state is first compared to
+// the decoded one and only written back if it differs: a data array whose cells
+// were not changed since the last reset is left as it is.
+//
+// Only data arrays and groups have a snapshot, and only when everything their
+// Load reads from the chunk can be restored exactly: data arrays need a format
+// and no parameter column, attributes need the current (version 6) layout.
+// Attribute parameters are compared byte for byte with their decoded value.
+class CKSceneObjectSnapshot
+{
+public:
+    // Returns NULL if the object has no snapshot. Called right after obj was
+    // loaded from chunk, whose state is taken as the decoded one.
+    static CKSceneObjectSnapshot *Create(CKObject *obj, CKStateChunk *chunk);
+    ~CKSceneObjectSnapshot();
+
+    // TRUE if the snapshot was decoded from chunk for an object of this class.
+    CKBOOL IsSnapshotOf(CKObject *obj, CKStateChunk *chunk);
+
+    // Returns FALSE, without changing anything, if the object must be loaded
+    // from its initial value instead (a data array column format was changed).
+    CKBOOL Restore(CKObject *obj);
+
+protected:
+    struct Attribute
+    {
+        CKAttributeType Type;
+        CK_ID Parameter;
+        CKStateChunk *Value;
+        CKBOOL Linked; // The value holds parameter destinations, always loaded
+        // Parameter as left by the last reset
+        CK_ID RestoredParameter;
+        CKBYTE *RestoredValue; // Decoded value bytes, owned
+        int RestoredSize;
+        CKDWORD RestoredFlags;
+    };
+
+    struct Column
+    {
+        char *Name;
+        CK_ARRAYTYPE Type;
+        CKGUID ParameterType;
+        ArraySortFunction SortFunction;
+        ArrayEqualFunction EqualFunction;
+    };
+
+    CKSceneObjectSnapshot();
+
+    CKBOOL ReadAttributes(CKStateChunk *chunk);
+    void RecordAttributes(CKBeObject *beo);
+    void RecordAttribute(Attribute &attribute, CKParameter *param);
+    CKBOOL HasRestoredValue(const Attribute &attribute, CKParameter *param);
+    void RestoreAttributes(CKBeObject *beo);
+
+    CKBOOL ReadDataArray(CKDataArray *array, CKStateChunk *chunk);
+    CKBOOL HasDataArrayFormat(CKDataArray *array);
+    void RestoreDataArray(CKDataArray *array);
+
+    void ReadGroup(CKStateChunk *chunk);
+    void RestoreGroup(CKGroup *group);
+
+    CKStateChunk *m_Chunk;
+    int m_ChunkSize;
+    CK_CLASSID m_ClassID;
+    CKDWORD m_ShowFlags; // CK_OBJECT_VISIBLE and CK_OBJECT_HIERACHICALHIDE
+    XArray<Attribute> m_Attributes;
+
+    // Data array
+    XArray<Column> m_Columns;
+    int m_RowCount;
+    XArray<CKUINTPTR> m_Cells; // Row after row, strings are owned copies
+    CKBOOL m_HasMembers;
+    CKBOOL m_HasKeyColumn;
+    CKBOOL m_Order;
+    int m_ColumnIndex;
+    int m_KeyColumn;
+
+    // Group
+    XObjectArray m_Members;
+};
+
+#endif // CKSCENEOBJECTSNAPSHOT_H
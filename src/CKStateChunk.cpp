@@ -37,6 +37,7 @@ CKStateChunk::CKStateChunk(CKStateChunk *chunk) {
     m_Managers = nullptr;
     m_File = nullptr;
     m_Dynamic = TRUE;
+    m_Options = 0;
     Clone(chunk);
 }
 
@@ -52,6 +53,7 @@ CKStateChunk::CKStateChunk(CK_CLASSID Cid, CKFile *f) {
     m_ChunkClassID = Cid;
     m_File = f;
     m_Dynamic = TRUE;
+    m_Options = 0;
 }
 
 CKStateChunk::~CKStateChunk() {
@@ -62,6 +64,18 @@ void CKStateChunk::Clear() {
     m_ChunkClassID = 0;
     m_ChunkSize = 0;
 
+    if (m_Options & CHNK_DONTDELETE_PTR) {
+        // Buffers belong to the file we were read from
+        m_Data = nullptr;
+        if (m_Ids)
+            m_Ids->Data = nullptr;
+        if (m_Chunks)
+            m_Chunks->Data = nullptr;
+        if (m_Managers)
+            m_Managers->Data = nullptr;
+        m_Options &= ~CHNK_DONTDELETE_PTR;
+    }
+
     delete[] m_Data;
     delete m_ChunkParser;
     if (m_Ids)
@@ -142,6 +156,10 @@ void CKStateChunk::StartRead() {
 }
 
 void CKStateChunk::StartWrite() {
+    if (m_Options & CHNK_DONTDELETE_PTR) {
+        m_Data = nullptr;
+        MakeOwned();
+    }
     delete[] m_Data;
     m_Data = nullptr;
     m_ChunkVersion = CHUNK_VERSION4;
@@ -154,25 +172,47 @@ void CKStateChunk::StartWrite() {
     }
 }
 
+void CKStateChunk::Reallocate(int newSize) {
+    int *data = new int[newSize];
+    if (m_Data) {
+        memcpy(data, m_Data, m_ChunkParser->CurrentPos * sizeof(int));
+        delete[] m_Data;
+    }
+    m_Data = data;
+    m_ChunkParser->DataSize = newSize;
+}
+
 void CKStateChunk::CheckSize(int size) {
     if (!m_ChunkParser)
         return;
 
+    MakeOwned();
+
     int sz = size / sizeof(int);
-    if (sz + m_ChunkParser->CurrentPos > m_ChunkParser->DataSize) {
-        if (sz < 500)
-            sz = 500;
-        int newSize = m_ChunkParser->DataSize + sz;
-        int *data = new int[newSize];
-        if (m_Data) {
-            memcpy(data, m_Data, m_ChunkParser->CurrentPos * sizeof(int));
-            delete[] m_Data;
-        }
-        m_Data = data;
-        m_ChunkParser->DataSize = newSize;
+    int needed = m_ChunkParser->CurrentPos + sz;
+    if (needed > m_ChunkParser->DataSize) {
+        // Grow geometrically so that a long sequence of small writes
+        // costs amortized O(1) copies instead of one copy per 500 dwords.
+        int newSize = m_ChunkParser->DataSize + (m_ChunkParser->DataSize >> 1);
+        if (newSize < m_ChunkParser->DataSize + 500)
+            newSize = m_ChunkParser->DataSize + 500;
+        if (newSize < needed)
+            newSize = needed;
+        Reallocate(newSize);
     }
 }
 
+void CKStateChunk::Reserve(int dwords) {
+    if (!m_ChunkParser || dwords <= 0)
+        return;
+
+    MakeOwned();
+
+    int needed = m_ChunkParser->CurrentPos + dwords;
+    if (needed > m_ChunkParser->DataSize)
+        Reallocate(needed);
+}
+
 void CKStateChunk::CloseChunk() {
     if (!m_ChunkParser)
         return;
@@ -180,8 +220,15 @@ void CKStateChunk::CloseChunk() {
     if (m_ChunkParser->CurrentPos > m_ChunkSize)
         m_ChunkSize = m_ChunkParser->CurrentPos;
 
+    if (m_Options & CHNK_DONTDELETE_PTR) {
+        // Nothing was written: a borrowed view is already exactly sized
+        delete m_ChunkParser;
+        m_ChunkParser = nullptr;
+        return;
+    }
+
     if (m_ChunkSize > 0) {
-        if (m_ChunkSize + 10 < m_ChunkParser->DataSize) {
+        if (m_ChunkSize < m_ChunkParser->DataSize) {
             int *data = new int[m_ChunkSize];
             if (m_Data) {
                 memcpy(data, m_Data, m_ChunkSize * sizeof(int));
@@ -375,19 +422,31 @@ void CKStateChunk::AddChunkAndDelete(CKStateChunk *chunk) {
     if (!m_ChunkParser || !chunk || !chunk->m_Data)
         return;
 
+    // Buffers change hands below, neither side may keep borrowed ones
+    MakeOwned();
+    chunk->MakeOwned();
+
     m_Dynamic = chunk->m_Dynamic;
-    if (m_ChunkParser->DataSize != 0
-        || m_ChunkParser->CurrentPos != 0
+    if (m_ChunkParser->CurrentPos != 0
         || m_ChunkParser->PrevIdentifierPos != 0
         || m_Ids
         || m_Chunks
         || m_Managers) {
         AddChunk(chunk);
     } else {
+        // Nothing was written yet, only a capacity reserved with Reserve():
+        // adopt the sub chunk buffer and re-apply the reservation afterwards.
+        int reserved = m_ChunkParser->DataSize;
+        delete[] m_Data;
+        m_Data = nullptr;
+
         // IDA: Copy ChunkParser contents (not pointer), then zero source
         if (chunk->m_ChunkParser) {
             memcpy(m_ChunkParser, chunk->m_ChunkParser, sizeof(ChunkParser));
             memset(chunk->m_ChunkParser, 0, sizeof(ChunkParser));
+        } else {
+            m_ChunkParser->DataSize = 0;
+            reserved = 0;
         }
         m_ChunkSize = chunk->m_ChunkSize;
         m_Data = chunk->m_Data;
@@ -402,6 +461,9 @@ void CKStateChunk::AddChunkAndDelete(CKStateChunk *chunk) {
         chunk->m_Managers = nullptr;
         chunk->m_Chunks = nullptr;
         chunk->m_Ids = nullptr;
+
+        if (reserved > m_ChunkParser->DataSize)
+            Reserve(reserved - m_ChunkParser->CurrentPos);
     }
 
     delete chunk;
@@ -1411,6 +1473,11 @@ int CKStateChunk::ConvertToBuffer(void *buffer) {
 }
 
 CKBOOL CKStateChunk::ConvertFromBuffer(void *buffer) {
+    return ConvertFromBuffer(buffer, FALSE);
+}
+
+// Borrowing is only done for the VERSION3/4 layout, older layouts are always copied.
+CKBOOL CKStateChunk::ConvertFromBuffer(void *buffer, CKBOOL borrow) {
     if (!buffer)
         return FALSE;
 
@@ -1529,11 +1596,13 @@ CKBOOL CKStateChunk::ConvertFromBuffer(void *buffer) {
 
         m_ChunkSize = buf[pos++];
         if (m_ChunkSize != 0) {
-            m_Data = new int[m_ChunkSize];
-            if (m_Data) {
+            if (borrow) {
+                m_Data = &buf[pos];
+            } else {
+                m_Data = new int[m_ChunkSize];
                 memcpy(m_Data, &buf[pos], m_ChunkSize * sizeof(int));
-                pos += m_ChunkSize;
             }
+            pos += m_ChunkSize;
         }
 
         if ((chunkOptions & CHNK_OPTION_FILE) == 0)
@@ -1545,11 +1614,13 @@ CKBOOL CKStateChunk::ConvertFromBuffer(void *buffer) {
                 m_Ids = new IntListStruct;
                 m_Ids->AllocatedSize = idCount;
                 m_Ids->Size = idCount;
-                m_Ids->Data = new int[idCount];
-                if (m_Ids->Data) {
+                if (borrow) {
+                    m_Ids->Data = &buf[pos];
+                } else {
+                    m_Ids->Data = new int[idCount];
                     memcpy(m_Ids->Data, &buf[pos], idCount * sizeof(int));
-                    pos += idCount;
                 }
+                pos += idCount;
             }
         }
 
@@ -1559,11 +1630,13 @@ CKBOOL CKStateChunk::ConvertFromBuffer(void *buffer) {
                 m_Chunks = new IntListStruct;
                 m_Chunks->AllocatedSize = chunkCount;
                 m_Chunks->Size = chunkCount;
-                m_Chunks->Data = new int[chunkCount];
-                if (m_Chunks->Data) {
+                if (borrow) {
+                    m_Chunks->Data = &buf[pos];
+                } else {
+                    m_Chunks->Data = new int[chunkCount];
                     memcpy(m_Chunks->Data, &buf[pos], chunkCount * sizeof(int));
-                    pos += chunkCount;
                 }
+                pos += chunkCount;
             }
         }
 
@@ -1573,20 +1646,53 @@ CKBOOL CKStateChunk::ConvertFromBuffer(void *buffer) {
                 m_Managers = new IntListStruct;
                 m_Managers->AllocatedSize = managerCount;
                 m_Managers->Size = managerCount;
-                m_Managers->Data = new int[managerCount];
-                if (m_Managers->Data) {
+                if (borrow) {
+                    m_Managers->Data = &buf[pos];
+                } else {
+                    m_Managers->Data = new int[managerCount];
                     memcpy(m_Managers->Data, &buf[pos], managerCount * sizeof(int));
-                    pos += managerCount;
                 }
+                pos += managerCount;
             }
         }
 
+        if (borrow)
+            m_Options |= CHNK_DONTDELETE_PTR;
+
         return TRUE;
     }
 
     return FALSE;
 }
 
+static int *CopyBorrowedInts(const int *data, int count) {
+    if (!data || count <= 0)
+        return nullptr;
+    int *copy = new int[count];
+    memcpy(copy, data, count * sizeof(int));
+    return copy;
+}
+
+void CKStateChunk::MakeOwned() {
+    if ((m_Options & CHNK_DONTDELETE_PTR) == 0)
+        return;
+
+    m_Data = CopyBorrowedInts(m_Data, m_ChunkSize);
+    if (m_Ids) {
+        m_Ids->Data = CopyBorrowedInts(m_Ids->Data, m_Ids->Size);
+        m_Ids->AllocatedSize = m_Ids->Size;
+    }
+    if (m_Chunks) {
+        m_Chunks->Data = CopyBorrowedInts(m_Chunks->Data, m_Chunks->Size);
+        m_Chunks->AllocatedSize = m_Chunks->Size;
+    }
+    if (m_Managers) {
+        m_Managers->Data = CopyBorrowedInts(m_Managers->Data, m_Managers->Size);
+        m_Managers->AllocatedSize = m_Managers->Size;
+    }
+    m_Options &= ~CHNK_DONTDELETE_PTR;
+}
+
 int CKStateChunk::RemapObject(CK_ID old_id, CK_ID new_id) {
     if (old_id == 0 || new_id == 0)
         return 0;
@@ -1604,6 +1710,7 @@ int CKStateChunk::RemapParameterInt(CKGUID ParameterType, int *ConversionTable,
     data.NbEntries = NbEntries;
     data.Guid = ParameterType;
     data.Flag = TRUE;
+    MakeOwned();
     data.ChunkVersion = m_ChunkVersion;
     data.Data = m_Data;
     data.ChunkSize = m_ChunkSize;
@@ -1638,6 +1745,16 @@ int CKStateChunk::RemapManagerInt(CKGUID Manager, int *ConversionTable, int NbEn
         data.Managers = m_Managers->Data;
         data.ManagerCount = m_Managers->Size;
     }
+
+    if (m_Options & CHNK_DONTDELETE_PTR) {
+        // Only copy the borrowed buffers if a value really changes
+        data.DryRun = TRUE;
+        if (IterateAndDo(ManagerRemapper, &data) == 0)
+            return 0;
+        MakeOwned();
+        return RemapManagerInt(Manager, ConversionTable, NbEntries);
+    }
+
     return IterateAndDo(ManagerRemapper, &data);
 }
 
@@ -1657,6 +1774,16 @@ int CKStateChunk::RemapObjects(CKContext *context, CKDependenciesContext *Depcon
         data.Ids = m_Ids->Data;
         data.IdCount = m_Ids->Size;
     }
+
+    if (m_Options & CHNK_DONTDELETE_PTR) {
+        // Only copy the borrowed buffers if an ID really changes
+        data.DryRun = TRUE;
+        if (IterateAndDo(ObjectRemapper, &data) == 0)
+            return 0;
+        MakeOwned();
+        return RemapObjects(context, Depcontext);
+    }
+
     return IterateAndDo(ObjectRemapper, &data);
 }
 
@@ -2469,6 +2596,10 @@ void CKStateChunk::Pack(int CompressionLevel) {
         Bytef *data = new Bytef[destSize];
         if (data) {
             memcpy(data, buf, destSize);
+            if (m_Options & CHNK_DONTDELETE_PTR) {
+                m_Data = nullptr;
+                MakeOwned();
+            }
             delete[] m_Data;
             m_Data = (int *) data;
             // IDA stores raw byte size, not DWORD count
@@ -2504,6 +2635,10 @@ CKBOOL CKStateChunk::UnPack(int DestSize) {
     }
 
     memcpy(data, buf, DestSize);
+    if (m_Options & CHNK_DONTDELETE_PTR) {
+        m_Data = nullptr;
+        MakeOwned();
+    }
     delete[] m_Data;
     m_Data = data;
     m_ChunkSize = newChunkSize;
@@ -2516,6 +2651,8 @@ void CKStateChunk::AttributePatch(CKBOOL preserveData, int *ConversionTable, int
     if (m_Managers)
         return;
 
+    MakeOwned();
+
     const int sequenceCount = StartReadSequence();
     const int attributeSectionStart = GetCurrentPos();
     Skip(sequenceCount);
@@ -2674,17 +2811,21 @@ bool CKStateChunk::RemapObjectId(ChunkIteratorData *it, CK_ID &value) {
     if (!it)
         return false;
 
-    const CK_ID oldValue = value;
+    CK_ID newValue = value;
     if (it->DepContext) {
         const XHashID &mapId = it->DepContext->GetDependenciesMap();
         XHashID::ConstIterator mapIt = mapId.Find(value);
         if (mapIt != mapId.End())
-            value = *mapIt;
+            newValue = *mapIt;
     } else if (it->Context && it->Context->m_ObjectManager) {
-        value = it->Context->m_ObjectManager->RealId(value);
+        newValue = it->Context->m_ObjectManager->RealId(value);
     }
 
-    return value != oldValue;
+    if (newValue == value)
+        return false;
+    if (!it->DryRun)
+        value = newValue;
+    return true;
 }
 
 int CKStateChunk::ObjectRemapper(ChunkIteratorData *it) {
@@ -2789,7 +2930,8 @@ int CKStateChunk::ManagerRemapper(ChunkIteratorData *it) {
                     if (value >= 0 && value < it->NbEntries) {
                         int mapped = it->ConversionTable[value];
                         if (mapped != value) {
-                            value = mapped;
+                            if (!it->DryRun)
+                                value = mapped;
                             ++total;
                         }
                     }
@@ -2825,7 +2967,8 @@ int CKStateChunk::ManagerRemapper(ChunkIteratorData *it) {
                     if (value >= 0 && value < it->NbEntries) {
                         int mapped = it->ConversionTable[value];
                         if (mapped != value) {
-                            value = mapped;
+                            if (!it->DryRun)
+                                value = mapped;
                             ++total;
                         }
                     }
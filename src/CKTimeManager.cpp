@@ -81,6 +81,10 @@ CKERROR CKTimeManager::PreProcess() {
     stats.BehaviorLinksParsed = 0;
     stats.ActiveObjectsExecuted = 0;
     stats.BehaviorDelayedLinks = 0;
+    stats.OperationCacheHits = 0;
+    stats.OperationCacheMisses = 0;
+    stats.MessagesAllocated = 0;
+    stats.MessagePoolHeapAllocations = 0;
     memset(stats.UserProfiles, 0, sizeof(stats.UserProfiles));
     memset(m_Context->m_UserProfileTime, 0, sizeof(m_Context->m_UserProfileTime));
 
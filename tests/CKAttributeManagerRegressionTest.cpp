@@ -0,0 +1,290 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <set>
+
+#include "CKAll.h"
+
+namespace {
+
+class CKRuntimeFixture : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_EQ(CK_OK, CKStartUp());
+        ASSERT_EQ(CK_OK, CKCreateContext(&context_, nullptr, 0, 0));
+        ASSERT_NE(nullptr, context_);
+    }
+
+    static void TearDownTestSuite() {
+        if (context_) {
+            CKCloseContext(context_);
+            context_ = nullptr;
+        }
+        CKShutdown();
+    }
+
+    static CKContext *context_;
+};
+
+CKContext *CKRuntimeFixture::context_ = nullptr;
+
+double ElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The scene list of an attribute holds the objects of its global list that are in the scene
+void ExpectSceneListMatches(CKAttributeManager *am, CKAttributeType type, CKScene *scene) {
+    const XObjectPointerArray &global = am->GetGlobalAttributeListPtr(type);
+    std::set<CK_ID> expected;
+    for (int i = 0; i < global.Size(); ++i) {
+        CKBeObject *beo = (CKBeObject *) global[i];
+        if (beo->IsInScene(scene) || beo->IsPrivate())
+            expected.insert(beo->GetID());
+    }
+
+    const XObjectPointerArray &list = am->GetAttributeListPtr(type);
+    std::set<CK_ID> actual;
+    for (int i = 0; i < list.Size(); ++i)
+        actual.insert(list[i]->GetID());
+    EXPECT_EQ(static_cast<size_t>(list.Size()), actual.size());
+    EXPECT_EQ(expected, actual);
+}
+
+} // namespace
+
+TEST_F(CKRuntimeFixture, AttributeListsStayConsistentWithManyTaggedObjects) {
+    const int objectCount = 40000;
+    CKAttributeManager *am = context_->GetAttributeManager();
+    ASSERT_NE(nullptr, am);
+    const CKAttributeType type = am->RegisterNewAttributeType("IndexedAttributeList", CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+    ASSERT_GE(type, 0);
+
+    XObjectArray objects;
+    for (int i = 0; i < objectCount; ++i) {
+        CKObject *obj = context_->CreateObject(CKCID_DATAARRAY);
+        ASSERT_NE(nullptr, obj);
+        objects.PushBack(obj->GetID());
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < objectCount; ++i)
+        ((CKBeObject *) context_->GetObject(objects[i]))->SetAttribute(type);
+    for (int i = 0; i < objectCount; i += 2)
+        ((CKBeObject *) context_->GetObject(objects[i]))->RemoveAttribute(type);
+    const double tagMs = ElapsedMilliseconds(start);
+
+    RecordProperty("TagMilliseconds", static_cast<int>(tagMs));
+
+    // Setting the attribute again does not add the object twice
+    ((CKBeObject *) context_->GetObject(objects[1]))->SetAttribute(type);
+
+    const XObjectPointerArray &list = am->GetGlobalAttributeListPtr(type);
+    ASSERT_EQ(objectCount / 2, list.Size());
+    std::set<CK_ID> tagged;
+    for (int i = 0; i < list.Size(); ++i) {
+        ASSERT_NE(nullptr, list[i]);
+        tagged.insert(list[i]->GetID());
+    }
+    EXPECT_EQ(static_cast<size_t>(list.Size()), tagged.size());
+    for (int i = 0; i < objectCount; ++i) {
+        CKBeObject *beo = (CKBeObject *) context_->GetObject(objects[i]);
+        EXPECT_EQ((i % 2) != 0, tagged.count(objects[i]) != 0);
+        EXPECT_EQ((i % 2) != 0, beo->HasAttribute(type) != FALSE);
+    }
+
+    // Destroyed objects leave the list
+    context_->DestroyObjects(objects.Begin(), objects.Size() / 2);
+    EXPECT_EQ(objectCount / 4, am->GetGlobalAttributeListPtr(type).Size());
+
+    context_->DestroyObjects(objects.Begin() + objects.Size() / 2, objects.Size() - objects.Size() / 2);
+    EXPECT_EQ(0, am->GetGlobalAttributeListPtr(type).Size());
+    am->UnRegisterAttribute(type);
+}
+
+TEST_F(CKRuntimeFixture, SwitchBetweenTwoLargeScenes) {
+    const int objectsPerScene = 20000;
+    const int sharedCount = 1000;
+    const int switchCount = 200;
+    CKAttributeManager *am = context_->GetAttributeManager();
+    ASSERT_NE(nullptr, am);
+    const CKAttributeType type = am->RegisterNewAttributeType("SceneSwitchAttribute", CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+    ASSERT_GE(type, 0);
+
+    CKScene *sceneA = (CKScene *) context_->CreateObject(CKCID_SCENE, "AttributeSceneA");
+    CKScene *sceneB = (CKScene *) context_->CreateObject(CKCID_SCENE, "AttributeSceneB");
+    ASSERT_NE(nullptr, sceneA);
+    ASSERT_NE(nullptr, sceneB);
+
+    XObjectArray objects;
+    for (int i = 0; i < 2 * objectsPerScene - sharedCount; ++i) {
+        CKBeObject *beo = (CKBeObject *) context_->CreateObject(CKCID_DATAARRAY);
+        ASSERT_NE(nullptr, beo);
+        beo->SetAttribute(type);
+        if (i < objectsPerScene)
+            sceneA->AddObject(beo);
+        if (i >= objectsPerScene - sharedCount)
+            sceneB->AddObject(beo);
+        objects.PushBack(beo->GetID());
+    }
+
+    am->NewActiveScene(sceneA);
+    EXPECT_EQ(objectsPerScene, am->GetAttributeListPtr(type).Size());
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < switchCount; ++i)
+        am->NewActiveScene((i % 2) ? sceneA : sceneB);
+    const double switchMs = ElapsedMilliseconds(start);
+
+    RecordProperty("SwitchMilliseconds", static_cast<int>(switchMs));
+    ExpectSceneListMatches(am, type, sceneA);
+
+    // Changes made while a scene is inactive are visible when it becomes active again
+    CKBeObject *onlyInA = (CKBeObject *) context_->GetObject(objects[0]);
+    CKBeObject *shared = (CKBeObject *) context_->GetObject(objects[objectsPerScene - 1]);
+    CKBeObject *onlyInB = (CKBeObject *) context_->GetObject(objects[objects.Size() - 1]);
+    CKBeObject *added = (CKBeObject *) context_->CreateObject(CKCID_DATAARRAY);
+    ASSERT_NE(nullptr, added);
+    sceneB->AddObject(added);
+    added->SetAttribute(type);
+    sceneB->AddObject(onlyInA);
+    sceneB->RemoveObject(onlyInB);
+    shared->RemoveAttribute(type);
+    ExpectSceneListMatches(am, type, sceneA);
+
+    am->NewActiveScene(sceneB);
+    ExpectSceneListMatches(am, type, sceneB);
+    EXPECT_EQ(objectsPerScene, am->GetAttributeListPtr(type).Size());
+
+    sceneA->RemoveAllObjects();
+    am->NewActiveScene(sceneA);
+    ExpectSceneListMatches(am, type, sceneA);
+    EXPECT_EQ(0, am->GetAttributeListPtr(type).Size());
+
+    // A deleted scene leaves no list behind
+    am->NewActiveScene(sceneB);
+    context_->DestroyObject(sceneA);
+    am->NewActiveScene(nullptr);
+    EXPECT_EQ(0, am->GetAttributeListPtr(type).Size());
+
+    objects.PushBack(added->GetID());
+    context_->DestroyObjects(objects.Begin(), objects.Size());
+    context_->DestroyObject(sceneB);
+    am->UnRegisterAttribute(type);
+}
+
+TEST_F(CKRuntimeFixture, QueryObjectsByAttributeSets) {
+    const int objectCount = 3000;
+    CKAttributeManager *am = context_->GetAttributeManager();
+    ASSERT_NE(nullptr, am);
+    CKAttributeType types[3];
+    types[0] = am->RegisterNewAttributeType("QueryAttributeA", CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+    types[1] = am->RegisterNewAttributeType("QueryAttributeB", CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+    types[2] = am->RegisterNewAttributeType("QueryAttributeC", CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+
+    // Object i has A when i % 2 == 0, B when i % 3 == 0 and C when i % 5 == 0
+    XObjectArray objects;
+    for (int i = 0; i < objectCount; ++i) {
+        CKBeObject *beo = (CKBeObject *) context_->CreateObject((i % 7) ? CKCID_DATAARRAY : CKCID_GROUP);
+        ASSERT_NE(nullptr, beo);
+        if (i % 2 == 0) beo->SetAttribute(types[0]);
+        if (i % 3 == 0) beo->SetAttribute(types[1]);
+        if (i % 5 == 0) beo->SetAttribute(types[2]);
+        objects.PushBack(beo->GetID());
+    }
+
+    XObjectPointerArray any;
+    XObjectPointerArray all;
+    XObjectPointerArray allButC;
+    XObjectPointerArray groups;
+    am->QueryObjectsByAttributes(any, types, 2, CK_ATTRIBUT_QUERY_ANY, nullptr, 0, CKCID_BEOBJECT, TRUE, TRUE);
+    am->QueryObjectsByAttributes(all, types, 2, CK_ATTRIBUT_QUERY_ALL, nullptr, 0, CKCID_BEOBJECT, TRUE, TRUE);
+    am->QueryObjectsByAttributes(allButC, types, 2, CK_ATTRIBUT_QUERY_ALL, &types[2], 1, CKCID_BEOBJECT, TRUE, TRUE);
+    am->QueryObjectsByAttributes(groups, types, 2, CK_ATTRIBUT_QUERY_ANY, nullptr, 0, CKCID_GROUP, FALSE, TRUE);
+
+    std::set<CK_ID> anyIds, allIds, allButCIds, groupIds;
+    for (int i = 0; i < any.Size(); ++i) anyIds.insert(any[i]->GetID());
+    for (int i = 0; i < all.Size(); ++i) allIds.insert(all[i]->GetID());
+    for (int i = 0; i < allButC.Size(); ++i) allButCIds.insert(allButC[i]->GetID());
+    for (int i = 0; i < groups.Size(); ++i) groupIds.insert(groups[i]->GetID());
+
+    // No object is returned twice
+    EXPECT_EQ(static_cast<size_t>(any.Size()), anyIds.size());
+    EXPECT_EQ(static_cast<size_t>(all.Size()), allIds.size());
+    for (int i = 0; i < objectCount; ++i) {
+        const bool a = i % 2 == 0, b = i % 3 == 0, c = i % 5 == 0;
+        EXPECT_EQ(a || b, anyIds.count(objects[i]) != 0);
+        EXPECT_EQ(a && b, allIds.count(objects[i]) != 0);
+        EXPECT_EQ(a && b && !c, allButCIds.count(objects[i]) != 0);
+        EXPECT_EQ((a || b) && i % 7 == 0, groupIds.count(objects[i]) != 0);
+    }
+
+    // An attribute nobody has empties an intersection
+    CKAttributeType missing[2] = {types[0], -1};
+    EXPECT_EQ(0, am->QueryObjectsByAttributes(all, missing, 2, CK_ATTRIBUT_QUERY_ALL));
+    EXPECT_EQ(0, all.Size());
+
+    context_->DestroyObjects(objects.Begin(), objects.Size());
+    EXPECT_EQ(0, am->QueryObjectsByAttributes(any, types, 3, CK_ATTRIBUT_QUERY_ANY, nullptr, 0, CKCID_BEOBJECT, TRUE, TRUE));
+    for (int i = 0; i < 3; ++i)
+        am->UnRegisterAttribute(types[i]);
+}
+
+TEST_F(CKRuntimeFixture, AttributeAndCategoryNamesStayIndexed) {
+    const int typeCount = 300;
+    CKAttributeManager *am = context_->GetAttributeManager();
+    ASSERT_NE(nullptr, am);
+    char name[96];
+
+    XArray<CKAttributeType> types;
+    for (int i = 0; i < typeCount; ++i) {
+        sprintf(name, "NamedAttribute%d", i);
+        CKAttributeType type = am->RegisterNewAttributeType(name, CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+        ASSERT_GE(type, 0);
+        types.PushBack(type);
+    }
+    for (int i = 0; i < typeCount; ++i) {
+        sprintf(name, "NamedAttribute%d", i);
+        EXPECT_EQ(types[i], am->GetAttributeTypeByName(name));
+        EXPECT_EQ(types[i], am->RegisterNewAttributeType(name, CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER));
+    }
+    EXPECT_EQ(-1, am->GetAttributeTypeByName("namedattribute0"));
+
+    // Names are truncated to 63 characters, for registration and lookup alike
+    const char *longName = "NamedAttributeWithAVeryLongNameThatDoesNotFitInTheSixtyThreeCharacters";
+    CKAttributeType longType = am->RegisterNewAttributeType((CKSTRING) longName, CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+    EXPECT_EQ(longType, am->GetAttributeTypeByName((CKSTRING) longName));
+
+    am->SetAttributeNameByType(types[5], "NamedAttributeRenamed");
+    EXPECT_EQ(types[5], am->GetAttributeTypeByName("NamedAttributeRenamed"));
+    EXPECT_EQ(-1, am->GetAttributeTypeByName("NamedAttribute5"));
+
+    // A free slot is reused and found under its new name
+    am->UnRegisterAttribute("NamedAttribute7");
+    EXPECT_EQ(-1, am->GetAttributeTypeByName("NamedAttribute7"));
+    EXPECT_EQ(types[7], am->RegisterNewAttributeType("NamedAttributeReused", CKGUID(), CKCID_BEOBJECT, CK_ATTRIBUT_USER));
+    EXPECT_EQ(types[7], am->GetAttributeTypeByName("NamedAttributeReused"));
+
+    const CKAttributeCategory first = am->AddCategory("NamedCategoryFirst");
+    const CKAttributeCategory second = am->AddCategory("NamedCategorySecond");
+    const CKAttributeCategory third = am->AddCategory("NamedCategoryThird");
+    EXPECT_EQ(second, am->GetCategoryByName("NamedCategorySecond"));
+    EXPECT_EQ(first, am->AddCategory("NamedCategoryFirst"));
+
+    am->SetCategoryName(third, "NamedCategoryRenamed");
+    EXPECT_EQ(third, am->GetCategoryByName("NamedCategoryRenamed"));
+    EXPECT_EQ(-1, am->GetCategoryByName("NamedCategoryThird"));
+
+    // Removing a category moves the following ones down
+    am->RemoveCategory("NamedCategoryFirst");
+    EXPECT_EQ(-1, am->GetCategoryByName("NamedCategoryFirst"));
+    EXPECT_EQ(second - 1, am->GetCategoryByName("NamedCategorySecond"));
+    EXPECT_EQ(third - 1, am->GetCategoryByName("NamedCategoryRenamed"));
+    EXPECT_STREQ("NamedCategoryRenamed", am->GetCategoryName(third - 1));
+
+    am->RemoveCategory("NamedCategorySecond");
+    am->RemoveCategory("NamedCategoryRenamed");
+    am->UnRegisterAttribute(longType);
+    for (int i = 0; i < typeCount; ++i)
+        am->UnRegisterAttribute(types[i]);
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "CKAll.h"
@@ -34,6 +35,9 @@ int gRetryFrames = 0;
 int gHighExecCount = 0;
 int gLowExecCount = 0;
 std::vector<int> gExecutionOrder;
+std::vector<CKBehavior *> gExecutedBehaviors;
+int gMainThreadExecCount = 0;
+std::thread::id gMainThreadId;
 
 int OneShotActivateOutput(const CKBehaviorContext &context) {
     ++gSourceExecCount;
@@ -80,6 +84,54 @@ int RetryThenStop(const CKBehaviorContext &) {
     return CKBR_OK;
 }
 
+int RecordAndRetry(const CKBehaviorContext &context) {
+    gExecutedBehaviors.push_back(context.Behavior);
+    return CKBR_ACTIVATENEXTFRAME;
+}
+
+int RecordOnce(const CKBehaviorContext &context) {
+    gExecutedBehaviors.push_back(context.Behavior);
+    context.Behavior->ActivateInput(0, FALSE);
+    return CKBR_OK;
+}
+
+// Isolated scripts only touch the local parameter of the running behavior
+int AdvanceLocalState(const CKBehaviorContext &context) {
+    int state = 0;
+    context.Behavior->GetLocalParameterValue(0, &state);
+    state = (int) ((CKDWORD) state * 1103515245u + 12345u);
+    context.Behavior->SetLocalParameterValue(0, &state);
+    context.Behavior->ActivateOutput(0, TRUE);
+    return CKBR_ACTIVATENEXTFRAME;
+}
+
+int MixLocalState(const CKBehaviorContext &context) {
+    int state = 0;
+    context.Behavior->GetLocalParameterValue(0, &state);
+    state = (int) ((CKDWORD) state * 31u + 7u);
+    context.Behavior->SetLocalParameterValue(0, &state);
+    return CKBR_OK;
+}
+
+int CountMainThreadExec(const CKBehaviorContext &) {
+    ++gMainThreadExecCount;
+    return CKBR_ACTIVATENEXTFRAME;
+}
+
+// Isolated objects read the count of the regular object, which runs before or
+// after them depending on priorities
+int RecordMainThreadCount(const CKBehaviorContext &context) {
+    int seen = gMainThreadExecCount;
+    context.Behavior->SetLocalParameterValue(0, &seen);
+    return CKBR_ACTIVATENEXTFRAME;
+}
+
+int RecordThread(const CKBehaviorContext &context) {
+    int onMainThread = (std::this_thread::get_id() == gMainThreadId) ? 1 : 0;
+    context.Behavior->SetLocalParameterValue(0, &onMainThread);
+    return CKBR_ACTIVATENEXTFRAME;
+}
+
 CKBehavior *CreateFunctionBehavior(CKContext *ctx, const char *name, CKBEHAVIORFCT fct) {
     CKBehavior *behavior = static_cast<CKBehavior *>(ctx->CreateObject(CKCID_BEHAVIOR, const_cast<char *>(name), CK_OBJECTCREATION_DYNAMIC));
     if (behavior) {
@@ -110,6 +162,109 @@ std::string MakeName(const char *prefix, int index) {
     return std::string(prefix) + std::to_string(index);
 }
 
+// Creates an object whose only script runs fct, and returns the function behavior
+CKBehavior *CreateScriptedObject(CKContext *ctx, const std::string &name, CKBEHAVIORFCT fct, bool isolated, int priority, XObjectArray &created) {
+    CKBeObject *owner = static_cast<CKBeObject *>(ctx->CreateObject(CKCID_DATAARRAY, const_cast<char *>(name.c_str()), CK_OBJECTCREATION_DYNAMIC));
+    CKBehavior *script = static_cast<CKBehavior *>(ctx->CreateObject(CKCID_BEHAVIOR, const_cast<char *>((name + "_script").c_str()), CK_OBJECTCREATION_DYNAMIC));
+    script->UseGraph();
+    script->SetType(CKBEHAVIORTYPE_SCRIPT);
+    if (isolated)
+        script->ModifyFlags(CKBEHAVIOR_ISOLATED, 0);
+
+    CKBehavior *behavior = CreateFunctionBehavior(ctx, (name + "_fct").c_str(), fct);
+    int value = -1;
+    behavior->CreateLocalParameter(const_cast<char *>("value"), CKPGUID_INT)->SetValue(&value);
+    script->AddSubBehavior(behavior);
+    behavior->Activate(TRUE, FALSE);
+
+    owner->SetPriority(priority);
+    owner->AddScript(script);
+    script->Activate(TRUE, FALSE);
+    ctx->GetBehaviorManager()->AddObject(owner);
+
+    created.PushBack(owner->GetID());
+    created.PushBack(script->GetID());
+    created.PushBack(behavior->GetID());
+    return behavior;
+}
+
+int GetLocalValue(CKBehavior *behavior) {
+    int value = 0;
+    behavior->GetLocalParameterValue(0, &value);
+    return value;
+}
+
+struct ParallelFrameResult {
+    std::vector<int> states;
+    int behaviorsExecuted;
+    int mainThreadExecCount;
+};
+
+// Runs frameCount frames of objectCount isolated objects (advance -> mix script)
+// plus one regular object, and returns the final local states.
+ParallelFrameResult RunParallelFrames(CKContext *ctx, int threadCount, int objectCount, int frameCount) {
+    ParallelFrameResult result;
+    CKBehaviorManager *manager = ctx->GetBehaviorManager();
+    manager->SetThreadCount(threadCount);
+    gMainThreadExecCount = 0;
+
+    XObjectArray created;
+    std::vector<CKBehavior *> stateBehaviors;
+    for (int i = 0; i <= objectCount; ++i) {
+        const bool isolated = i < objectCount;
+        CKBeObject *owner = static_cast<CKBeObject *>(ctx->CreateObject(CKCID_DATAARRAY, const_cast<char *>(MakeName("parallelOwner_", i).c_str()), CK_OBJECTCREATION_DYNAMIC));
+        CKBehavior *script = static_cast<CKBehavior *>(ctx->CreateObject(CKCID_BEHAVIOR, const_cast<char *>(MakeName("parallelScript_", i).c_str()), CK_OBJECTCREATION_DYNAMIC));
+        script->UseGraph();
+        script->SetType(CKBEHAVIORTYPE_SCRIPT);
+        created.PushBack(owner->GetID());
+        created.PushBack(script->GetID());
+
+        if (isolated) {
+            script->ModifyFlags(CKBEHAVIOR_ISOLATED, 0);
+            CKBehavior *advance = CreateFunctionBehavior(ctx, MakeName("parallelAdvance_", i).c_str(), AdvanceLocalState);
+            CKBehavior *mix = CreateFunctionBehavior(ctx, MakeName("parallelMix_", i).c_str(), MixLocalState);
+            CKBehaviorLink *link = CreateLink(ctx, advance->CreateOutput(const_cast<char *>("out")), mix->CreateInput(const_cast<char *>("in")), 0);
+            int seed = i;
+            advance->CreateLocalParameter(const_cast<char *>("state"), CKPGUID_INT)->SetValue(&seed);
+            mix->CreateLocalParameter(const_cast<char *>("state"), CKPGUID_INT)->SetValue(&seed);
+            script->AddSubBehavior(advance);
+            script->AddSubBehavior(mix);
+            script->AddSubBehaviorLink(link);
+            advance->Activate(TRUE, FALSE);
+            stateBehaviors.push_back(advance);
+            stateBehaviors.push_back(mix);
+            created.PushBack(advance->GetID());
+            created.PushBack(mix->GetID());
+            created.PushBack(link->GetID());
+        } else {
+            CKBehavior *counter = CreateFunctionBehavior(ctx, "parallelMainThread", CountMainThreadExec);
+            script->AddSubBehavior(counter);
+            counter->Activate(TRUE, FALSE);
+            created.PushBack(counter->GetID());
+        }
+
+        owner->AddScript(script);
+        script->Activate(TRUE, FALSE);
+        manager->AddObject(owner);
+    }
+
+    const int executedBefore = ctx->m_Stats.BehaviorsExecuted;
+    for (int frame = 0; frame < frameCount; ++frame)
+        manager->Execute(0.016f);
+    result.behaviorsExecuted = ctx->m_Stats.BehaviorsExecuted - executedBefore;
+    result.mainThreadExecCount = gMainThreadExecCount;
+
+    for (CKBehavior *beh : stateBehaviors) {
+        int state = 0;
+        beh->GetLocalParameterValue(0, &state);
+        result.states.push_back(state);
+    }
+
+    ctx->DestroyObjects(created.Begin(), created.Size());
+    manager->SetThreadCount(0);
+    return result;
+}
+
 } // namespace
 
 TEST_F(CKRuntimeFixture, DelayedLinkDoesNotDoubleTriggerWhilePending) {
@@ -447,6 +602,134 @@ TEST_F(CKRuntimeFixture, DelayedPropagationStress100Rounds) {
     }
 }
 
+TEST_F(CKRuntimeFixture, ActivationQueueSkipsIdleLinksAndKeepsSubBehaviorOrder) {
+    const int idleCount = 200;
+    gExecutedBehaviors.clear();
+
+    CKBehavior *parent = static_cast<CKBehavior *>(context_->CreateObject(CKCID_BEHAVIOR, "parentQueue", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, parent);
+    parent->UseGraph();
+
+    std::vector<CKBehavior *> idleDestinations;
+    for (int i = 0; i < idleCount; ++i) {
+        CKBehavior *src = CreateFunctionBehavior(context_, MakeName("idleSrc_", i).c_str(), RecordOnce);
+        CKBehavior *dst = CreateFunctionBehavior(context_, MakeName("idleDst_", i).c_str(), RecordOnce);
+        ASSERT_NE(nullptr, src);
+        ASSERT_NE(nullptr, dst);
+        CKBehaviorIO *srcOut = src->CreateOutput(const_cast<char *>(MakeName("idleOut_", i).c_str()));
+        CKBehaviorIO *dstIn = dst->CreateInput(const_cast<char *>(MakeName("idleIn_", i).c_str()));
+        ASSERT_NE(nullptr, srcOut);
+        ASSERT_NE(nullptr, dstIn);
+        CKBehaviorLink *link = CreateLink(context_, srcOut, dstIn, 0);
+        ASSERT_NE(nullptr, link);
+        ASSERT_EQ(CK_OK, parent->AddSubBehavior(src));
+        ASSERT_EQ(CK_OK, parent->AddSubBehavior(dst));
+        ASSERT_EQ(CK_OK, parent->AddSubBehaviorLink(link));
+        idleDestinations.push_back(dst);
+    }
+
+    std::vector<CKBehavior *> tickers;
+    for (int i = 0; i < 3; ++i) {
+        CKBehavior *ticker = CreateFunctionBehavior(context_, MakeName("ticker_", i).c_str(), RecordAndRetry);
+        ASSERT_NE(nullptr, ticker);
+        ASSERT_EQ(CK_OK, parent->AddSubBehavior(ticker));
+        ticker->Activate(TRUE, FALSE);
+        tickers.push_back(ticker);
+    }
+    parent->Activate(TRUE, FALSE);
+
+    // Expected order: the active sub-behaviors in GetSubBehavior order
+    const auto expectedOrder = [&](CKBehavior *extra) -> std::vector<CKBehavior *> {
+        std::vector<CKBehavior *> order;
+        for (int k = 0; k < parent->GetSubBehaviorCount(); ++k) {
+            CKBehavior *sub = parent->GetSubBehavior(k);
+            for (CKBehavior *ticker : tickers) {
+                if (sub == ticker)
+                    order.push_back(sub);
+            }
+            if (sub == extra)
+                order.push_back(sub);
+        }
+        return order;
+    };
+
+    // First frame rescans the freshly built graph
+    parent->Execute(0.016f);
+    EXPECT_EQ(expectedOrder(nullptr), gExecutedBehaviors);
+
+    const int parsedBefore = context_->m_Stats.BehaviorLinksParsed;
+    for (int frame = 0; frame < 10; ++frame) {
+        gExecutedBehaviors.clear();
+        parent->Execute(0.016f);
+        EXPECT_EQ(expectedOrder(nullptr), gExecutedBehaviors) << "frame=" << frame;
+    }
+    EXPECT_EQ(parsedBefore, context_->m_Stats.BehaviorLinksParsed);
+
+    // An input activated from outside the graph joins at its list position
+    CKBehavior *woken = idleDestinations[idleCount / 2];
+    woken->ActivateInput(0, TRUE);
+    woken->Activate(TRUE, FALSE);
+    gExecutedBehaviors.clear();
+    parent->Execute(0.016f);
+    EXPECT_EQ(expectedOrder(woken), gExecutedBehaviors);
+
+    gExecutedBehaviors.clear();
+    parent->Execute(0.016f);
+    EXPECT_EQ(expectedOrder(nullptr), gExecutedBehaviors);
+}
+
+TEST_F(CKRuntimeFixture, ParallelFrameMatchesSerialExecution) {
+    const int objectCount = 64;
+    const int frameCount = 20;
+
+    const ParallelFrameResult serial = RunParallelFrames(context_, 0, objectCount, frameCount);
+    const ParallelFrameResult parallel = RunParallelFrames(context_, 4, objectCount, frameCount);
+
+    ASSERT_EQ(static_cast<size_t>(objectCount * 2), serial.states.size());
+    EXPECT_EQ(serial.states, parallel.states);
+    EXPECT_EQ(serial.behaviorsExecuted, parallel.behaviorsExecuted);
+    EXPECT_EQ(frameCount, serial.mainThreadExecCount);
+    EXPECT_EQ(frameCount, parallel.mainThreadExecCount);
+    EXPECT_EQ(0, context_->GetBehaviorManager()->GetThreadCount());
+}
+
+TEST_F(CKRuntimeFixture, ParallelFrameKeepsPriorityOrderAroundIsolatedObjects) {
+    const int isolatedCount = 16;
+    CKBehaviorManager *manager = context_->GetBehaviorManager();
+    manager->SetThreadCount(4);
+    gMainThreadExecCount = 0;
+    gMainThreadId = std::this_thread::get_id();
+
+    // Isolated objects on both sides of a regular one
+    XObjectArray created;
+    std::vector<CKBehavior *> higher;
+    std::vector<CKBehavior *> lower;
+    for (int i = 0; i < isolatedCount; ++i) {
+        higher.push_back(CreateScriptedObject(context_, MakeName("isolatedHigh_", i), RecordMainThreadCount, true, 20, created));
+        lower.push_back(CreateScriptedObject(context_, MakeName("isolatedLow_", i), RecordMainThreadCount, true, 0, created));
+    }
+    CreateScriptedObject(context_, "regularMiddle", CountMainThreadExec, false, 10, created);
+    CKBehavior *probe = CreateScriptedObject(context_, "threadProbe", RecordThread, true, 0, created);
+
+    for (int frame = 1; frame <= 3; ++frame) {
+        manager->Execute(0.016f);
+        for (CKBehavior *beh : higher)
+            EXPECT_EQ(frame - 1, GetLocalValue(beh)) << "frame=" << frame;
+        for (CKBehavior *beh : lower)
+            EXPECT_EQ(frame, GetLocalValue(beh)) << "frame=" << frame;
+    }
+
+    // Clearing the flag moves the object back to the calling thread
+    probe->GetParent()->ModifyFlags(0, CKBEHAVIOR_ISOLATED);
+    for (int frame = 0; frame < 8; ++frame) {
+        manager->Execute(0.016f);
+        EXPECT_EQ(1, GetLocalValue(probe)) << "frame=" << frame;
+    }
+
+    context_->DestroyObjects(created.Begin(), created.Size());
+    manager->SetThreadCount(0);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
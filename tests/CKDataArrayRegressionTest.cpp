@@ -1,9 +1,18 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
 #include <climits>
+#include <cmath>
 #include <cstdio>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "CKAll.h"
 
@@ -30,6 +39,65 @@ protected:
 
 CKContext *CKRuntimeFixture::context_ = nullptr;
 
+// Reference answers computed row by row with TestRow
+ptrdiff_t ScanRowIndex(CKDataArray *array, int c, CK_COMPOPERATOR op, CKUINTPTR key, int startIndex) {
+    for (int i = startIndex; i < array->GetRowCount(); ++i) {
+        if (array->TestRow(i, c, op, key))
+            return i;
+    }
+    return -1;
+}
+
+int ScanCount(CKDataArray *array, int c, CK_COMPOPERATOR op, CKUINTPTR key) {
+    int count = 0;
+    for (int i = 0; i < array->GetRowCount(); ++i) {
+        if (array->TestRow(i, c, op, key))
+            ++count;
+    }
+    return count;
+}
+
+void ExpectLookupsMatchScan(CKDataArray *array, int c, CKUINTPTR key) {
+    static const CK_COMPOPERATOR ops[] = {CKEQUAL, CKNOTEQUAL, CKLESSER, CKLESSEREQUAL, CKGREATER, CKGREATEREQUAL};
+    for (int o = 0; o < 6; ++o) {
+        const ptrdiff_t first = ScanRowIndex(array, c, ops[o], key, 0);
+        EXPECT_EQ(first, array->FindRowIndex(c, ops[o], key)) << "op " << ops[o];
+        if (first >= 0) {
+            EXPECT_EQ(ScanRowIndex(array, c, ops[o], key, (int) first + 1),
+                      array->FindRowIndex(c, ops[o], key, 0, first + 1)) << "op " << ops[o];
+        }
+        EXPECT_EQ(ScanCount(array, c, ops[o], key), array->GetCount(c, ops[o], key)) << "op " << ops[o];
+    }
+}
+
+// Column scans of a packed array must give the answers of the same array without packing
+void ExpectPackedScansMatch(CKDataArray *packed, CKDataArray *plain, int c, CKUINTPTR key) {
+    EXPECT_EQ(plain->Sum(c), packed->Sum(c)) << "column " << c;
+    EXPECT_EQ(plain->Product(c), packed->Product(c)) << "column " << c;
+
+    int expected = -1;
+    int actual = -1;
+    EXPECT_EQ(plain->GetHighest(c, expected), packed->GetHighest(c, actual));
+    EXPECT_EQ(expected, actual) << "column " << c;
+    EXPECT_EQ(plain->GetLowest(c, expected), packed->GetLowest(c, actual));
+    EXPECT_EQ(expected, actual) << "column " << c;
+    CKDWORD target = (CKDWORD) key;
+    EXPECT_EQ(plain->GetNearest(c, &target, expected), packed->GetNearest(c, &target, actual));
+    EXPECT_EQ(expected, actual) << "column " << c;
+
+    ExpectLookupsMatchScan(packed, c, key);
+}
+
+// Custom equal function: keys match on their last digit
+CKBOOL LastDigitEqual(CKDataRow *row) {
+    const bool equal = ((int) (*row)[CKDataArray::g_ColumnIndex] % 10) == ((int) CKDataArray::g_Value % 10);
+    return (CKDataArray::g_Operator == CKNOTEQUAL) ? !equal : equal;
+}
+
+double ElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 } // namespace
 
 TEST_F(CKRuntimeFixture, SetElementValueFromParameterClearsUpperBitsForObjectColumn) {
@@ -171,6 +239,141 @@ TEST_F(CKRuntimeFixture, SaveLoadInMemoryHandlesNullParameterCell) {
     delete chunk;
 }
 
+TEST_F(CKRuntimeFixture, SaveLoadColumnLayoutAndOldRowLayout) {
+    const int rowCount = 1000;
+    CKObject *target = context_->CreateObject(CKCID_OBJECT, "DataArrayColumnLayoutTarget");
+    ASSERT_NE(nullptr, target);
+    CKDataArray *source = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayColumnLayoutSrc", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, source);
+    source->InsertColumn(-1, CKARRAYTYPE_INT, "Int");
+    source->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Float");
+    source->InsertColumn(-1, CKARRAYTYPE_STRING, "String");
+    source->InsertColumn(-1, CKARRAYTYPE_OBJECT, "Object");
+    source->InsertColumn(-1, CKARRAYTYPE_PARAMETER, "Param", CKPGUID_INT);
+    ASSERT_TRUE(source->SetColumnPacked(0, TRUE));
+
+    // The same cells, row by row as saved before CK_STATESAVE_DATAARRAYCOLUMNS
+    CKStateChunk *oldChunk = CreateCKStateChunk(CKCID_DATAARRAY, nullptr);
+    ASSERT_NE(nullptr, oldChunk);
+    oldChunk->StartWrite();
+    oldChunk->WriteIdentifier(CK_STATESAVE_DATAARRAYFORMAT);
+    oldChunk->WriteInt(4);
+    oldChunk->WriteString((CKSTRING) "Int");
+    oldChunk->WriteDword(CKARRAYTYPE_INT);
+    oldChunk->WriteString((CKSTRING) "Float");
+    oldChunk->WriteDword(CKARRAYTYPE_FLOAT);
+    oldChunk->WriteString((CKSTRING) "String");
+    oldChunk->WriteDword(CKARRAYTYPE_STRING);
+    oldChunk->WriteString((CKSTRING) "Object");
+    oldChunk->WriteDword(CKARRAYTYPE_OBJECT);
+    oldChunk->WriteIdentifier(CK_STATESAVE_DATAARRAYDATA);
+    oldChunk->WriteInt(rowCount);
+
+    char text[32];
+    for (int i = 0; i < rowCount; ++i) {
+        int intValue = i * 7919 - 100000;
+        float floatValue = (float) i / 3.0f;
+        CK_ID id = (i % 5) ? target->GetID() : 0;
+        sprintf(text, "Cell%d", i);
+        source->AddRow();
+        ASSERT_TRUE(source->SetElementValue(i, 0, &intValue));
+        ASSERT_TRUE(source->SetElementValue(i, 1, &floatValue));
+        // Every third string is null
+        if (i % 3)
+            ASSERT_TRUE(source->SetElementStringValue(i, 2, text));
+        ASSERT_TRUE(source->SetElementObject(i, 3, context_->GetObject(id)));
+        CKParameterOut *param = (CKParameterOut *) *source->GetElement(i, 4);
+        ASSERT_NE(nullptr, param);
+        param->SetValue(&intValue);
+
+        oldChunk->WriteInt(intValue);
+        oldChunk->WriteFloat(floatValue);
+        oldChunk->WriteString(text);
+        oldChunk->WriteObject(context_->GetObject(id));
+    }
+    oldChunk->CloseChunk();
+
+    CKStateChunk *chunk = source->Save(nullptr, 0xFFFFFFFFu);
+    ASSERT_NE(nullptr, chunk);
+    CKDataArray *loaded = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayColumnLayoutDst", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, loaded);
+    ASSERT_EQ(CK_OK, loaded->Load(chunk, nullptr));
+    delete chunk;
+
+    CKDataArray *old = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayRowLayoutDst", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, old);
+    ASSERT_EQ(CK_OK, old->Load(oldChunk, nullptr));
+    delete oldChunk;
+
+    ASSERT_EQ(rowCount, loaded->GetRowCount());
+    ASSERT_EQ(5, loaded->GetColumnCount());
+    ASSERT_EQ(rowCount, old->GetRowCount());
+    ASSERT_EQ(4, old->GetColumnCount());
+    for (int i = 0; i < rowCount; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            if (c == 2)
+                continue;
+            ASSERT_EQ(*source->GetElement(i, c), *loaded->GetElement(i, c)) << "row " << i << " column " << c;
+            ASSERT_EQ(*source->GetElement(i, c), *old->GetElement(i, c)) << "row " << i << " column " << c;
+        }
+
+        sprintf(text, "Cell%d", i);
+        const char *str = (const char *) *loaded->GetElement(i, 2);
+        if (i % 3)
+            ASSERT_STREQ(text, str) << "row " << i;
+        else
+            ASSERT_EQ(nullptr, str) << "row " << i;
+        ASSERT_STREQ(text, (const char *) *old->GetElement(i, 2)) << "row " << i;
+
+        int intValue = 0;
+        CKParameterOut *param = (CKParameterOut *) *loaded->GetElement(i, 4);
+        ASSERT_NE(nullptr, param);
+        param->GetValue(&intValue);
+        EXPECT_EQ(i * 7919 - 100000, intValue) << "row " << i;
+    }
+
+    context_->DestroyObject(source);
+    context_->DestroyObject(loaded);
+    context_->DestroyObject(old);
+    context_->DestroyObject(target);
+}
+
+TEST_F(CKRuntimeFixture, LoadRejectsColumnRowCountsTheChunkCannotHold) {
+    const int rowCounts[] = {-1, 1000, 2};
+    for (int pass = 0; pass < 3; ++pass) {
+        CKStateChunk *chunk = CreateCKStateChunk(CKCID_DATAARRAY, nullptr);
+        ASSERT_NE(nullptr, chunk);
+        chunk->StartWrite();
+        chunk->WriteIdentifier(CK_STATESAVE_DATAARRAYFORMAT);
+        chunk->WriteInt(1);
+        chunk->WriteString((CKSTRING) "Int");
+        chunk->WriteDword(CKARRAYTYPE_INT);
+        chunk->WriteIdentifier(CK_STATESAVE_DATAARRAYCOLUMNS);
+        chunk->WriteInt(rowCounts[pass]);
+        const CKDWORD values[] = {7, 11};
+        chunk->WriteBufferNoSize_LEndian(sizeof(values), (void *) values);
+        chunk->CloseChunk();
+
+        CKDataArray *array = static_cast<CKDataArray *>(
+            context_->CreateObject(CKCID_DATAARRAY, "DataArrayBadRowCount", CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_NE(nullptr, array);
+        if (rowCounts[pass] == 2) {
+            ASSERT_EQ(CK_OK, array->Load(chunk, nullptr));
+            ASSERT_EQ(2, array->GetRowCount());
+            EXPECT_EQ((CKUINTPTR) 11, *array->GetElement(1, 0));
+        } else {
+            EXPECT_EQ(CKERR_INVALIDFILE, array->Load(chunk, nullptr)) << "row count " << rowCounts[pass];
+            EXPECT_EQ(0, array->GetRowCount());
+        }
+
+        delete chunk;
+        context_->DestroyObject(array);
+    }
+}
+
 TEST_F(CKRuntimeFixture, SetColumnTypeParameterToParameterKeepsUsableCell) {
     CKDataArray *array = static_cast<CKDataArray *>(
         context_->CreateObject(CKCID_DATAARRAY, "DataArrayParamToParamRegression", CK_OBJECTCREATION_DYNAMIC));
@@ -268,6 +471,546 @@ TEST_F(CKRuntimeFixture, GetElementStringValueRespectsDestinationCapacity) {
     EXPECT_STREQ("ABCDEFG", small);
 }
 
+TEST_F(CKRuntimeFixture, IndexedLookupsMatchScanAcrossEdits) {
+    const int rowCount = 100000;
+    CKDataArray *array = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayIndexedLookup", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, array);
+
+    array->InsertColumn(-1, CKARRAYTYPE_INT, "Key");
+    array->InsertColumn(-1, CKARRAYTYPE_STRING, "Name");
+    array->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Weight");
+    array->InsertColumn(-1, CKARRAYTYPE_PARAMETER, "Param", CKPGUID_INT);
+    EXPECT_TRUE(array->SetColumnIndexed(0, TRUE));
+    EXPECT_TRUE(array->SetColumnIndexed(1, TRUE));
+    EXPECT_TRUE(array->SetColumnIndexed(2, TRUE));
+    EXPECT_FALSE(array->SetColumnIndexed(3, TRUE));
+    EXPECT_FALSE(array->IsColumnIndexed(3));
+
+    char name[32];
+    for (int i = 0; i < rowCount; ++i) {
+        array->AddRow();
+        int key = (i * 7919) % 5000;
+        ASSERT_TRUE(array->SetElementValue(i, 0, &key));
+        sprintf(name, "Name%d", i % 3000);
+        ASSERT_TRUE(array->SetElementStringValue(i, 1, name));
+        float weight = (float) (i % 97) - 48.0f;
+        ASSERT_TRUE(array->SetElementValue(i, 2, &weight));
+    }
+
+    ExpectLookupsMatchScan(array, 0, 1234);
+    ExpectLookupsMatchScan(array, 0, 99999);
+    ExpectLookupsMatchScan(array, 1, (CKUINTPTR) "Name42");
+    float zero = -0.0f;
+    CKDWORD zeroBits;
+    memcpy(&zeroBits, &zero, sizeof(zeroBits));
+    ExpectLookupsMatchScan(array, 2, zeroBits);
+
+    // Edits keep the indexes up to date
+    int key = 1234;
+    ASSERT_TRUE(array->SetElementValue(rowCount / 2, 0, &key));
+    array->InsertRow(10);
+    ASSERT_TRUE(array->SetElementValue(10, 0, &key));
+    array->RemoveRow(3);
+    array->RemoveRow(array->GetRowCount() - 1);
+    ASSERT_TRUE(array->SetElementStringValue(7, 1, "Name42"));
+    ExpectLookupsMatchScan(array, 0, 1234);
+    ExpectLookupsMatchScan(array, 0, 0);
+    ExpectLookupsMatchScan(array, 1, (CKUINTPTR) "Name42");
+
+    // Sorted on the key column: ranges come from the row order
+    array->Sort(0, TRUE);
+    ExpectLookupsMatchScan(array, 0, 1234);
+    ASSERT_TRUE(array->SetElementValue(0, 0, &key));
+    ExpectLookupsMatchScan(array, 0, 1234);
+
+    // Writes through GetElement and GetRow leave the sorted order and the indexes
+    *array->GetElement(1, 0) = 99999;
+    ExpectLookupsMatchScan(array, 0, 1234);
+    ExpectLookupsMatchScan(array, 0, 99999);
+    array->Sort(0, TRUE);
+    (*array->GetRow(2))[0] = 99999;
+    ExpectLookupsMatchScan(array, 0, 99999);
+    ASSERT_TRUE(array->SetElementValue(2, 0, &key));
+    ExpectLookupsMatchScan(array, 0, 1234);
+    ExpectLookupsMatchScan(array, 0, 99999);
+
+    const int lookupCount = 10000;
+    int found = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookupCount; ++i) {
+        sprintf(name, "Name%d", i % 3000);
+        if (array->FindRowIndex(1, CKEQUAL, (CKUINTPTR) name) >= 0)
+            ++found;
+    }
+    const double lookupMs = ElapsedMilliseconds(start);
+    EXPECT_EQ(lookupCount, found);
+
+    RecordProperty("LookupMilliseconds", static_cast<int>(lookupMs));
+
+    context_->DestroyObject(array);
+}
+
+TEST_F(CKRuntimeFixture, PackedColumnScansMatchRowScans) {
+    const int rowCount = 20000;
+    CKDataArray *arrays[2];
+    for (int a = 0; a < 2; ++a) {
+        arrays[a] = static_cast<CKDataArray *>(
+            context_->CreateObject(CKCID_DATAARRAY, "DataArrayPackedColumns", CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_NE(nullptr, arrays[a]);
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_INT, "Int");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Float");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_OBJECT, "Object");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_STRING, "String");
+    }
+    CKDataArray *packed = arrays[0];
+    CKDataArray *plain = arrays[1];
+    EXPECT_TRUE(packed->SetColumnPacked(0, TRUE));
+    EXPECT_TRUE(packed->SetColumnPacked(1, TRUE));
+    EXPECT_TRUE(packed->SetColumnPacked(2, TRUE));
+    EXPECT_FALSE(packed->SetColumnPacked(3, TRUE));
+    EXPECT_FALSE(packed->IsColumnPacked(3));
+
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    for (int i = 0; i < rowCount; ++i) {
+        int value = (i * 7919) % 3001 - 1500;
+        float weight = (i == 77) ? nan : (float) (i % 101) * 0.5f - 20.0f;
+        CK_ID id = (CK_ID) (i % 37);
+        for (int a = 0; a < 2; ++a) {
+            arrays[a]->AddRow();
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 0, &value));
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 1, &weight));
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 2, &id));
+        }
+    }
+
+    float weight = 4.5f;
+    CKDWORD weightBits;
+    memcpy(&weightBits, &weight, sizeof(weightBits));
+    ExpectPackedScansMatch(packed, plain, 0, 1234);
+    ExpectPackedScansMatch(packed, plain, 1, weightBits);
+    ExpectPackedScansMatch(packed, plain, 2, 12);
+
+    // Edits reach the packed copies
+    for (int a = 0; a < 2; ++a) {
+        int value = 5000;
+        ASSERT_TRUE(arrays[a]->SetElementValue(rowCount / 2, 0, &value));
+        arrays[a]->InsertRow(10);
+        ASSERT_TRUE(arrays[a]->SetElementStringValue(10, 0, "-4000"));
+        arrays[a]->RemoveRow(3);
+        arrays[a]->RemoveRow(arrays[a]->GetRowCount() - 1);
+        arrays[a]->AddRow();
+        arrays[a]->SwapRows(0, 5);
+        arrays[a]->ColumnTransform(0, CKMUL, 3);
+        arrays[a]->ColumnTransform(1, CKADD, weightBits);
+        arrays[a]->ColumnsOperate(0, CKADD, 0, 0);
+    }
+    ExpectPackedScansMatch(packed, plain, 0, 1234);
+    ExpectPackedScansMatch(packed, plain, 1, weightBits);
+    ExpectPackedScansMatch(packed, plain, 2, 12);
+    for (int i = 0; i < packed->GetRowCount(); i += 97) {
+        EXPECT_EQ(*plain->GetElement(i, 0), *packed->GetElement(i, 0)) << "row " << i;
+        EXPECT_EQ(*plain->GetElement(i, 1), *packed->GetElement(i, 1)) << "row " << i;
+    }
+
+    const int scanCount = 1000;
+    CKDWORD sum = 0;
+    int matches = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < scanCount; ++i) {
+        sum = packed->Sum(0);
+        matches += packed->GetCount(2, CKEQUAL, i % 37);
+    }
+    const double scanMs = ElapsedMilliseconds(start);
+    EXPECT_EQ(plain->Sum(0), sum);
+    EXPECT_GT(matches, 0);
+
+    RecordProperty("ScanMilliseconds", static_cast<int>(scanMs));
+
+    context_->DestroyObject(packed);
+    context_->DestroyObject(plain);
+}
+
+TEST_F(CKRuntimeFixture, PackedColumnsSeeElementAndRowWrites) {
+    const int rowCount = 100;
+    CKDataArray *source = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayPackedWritesSrc", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, source);
+    source->InsertColumn(-1, CKARRAYTYPE_INT, "Int");
+    source->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Float");
+    ASSERT_TRUE(source->SetColumnPacked(0, TRUE));
+    ASSERT_TRUE(source->SetColumnPacked(1, TRUE));
+    for (int i = 0; i < rowCount; ++i) {
+        float weight = 1.0f;
+        source->AddRow();
+        ASSERT_TRUE(source->SetElementValue(i, 0, &i));
+        ASSERT_TRUE(source->SetElementValue(i, 1, &weight));
+    }
+    EXPECT_EQ((CKDWORD) (rowCount * (rowCount - 1) / 2), source->Sum(0));
+
+    // Written behind the packed copies, which were just filled by Sum
+    CKUINTPTR *element = source->GetElement(5, 0);
+    ASSERT_NE(nullptr, element);
+    *element = 1005;
+    CKDataRow *row = source->GetRow(7);
+    ASSERT_NE(nullptr, row);
+    float weight = 50.0f;
+    CKDWORD weightBits;
+    memcpy(&weightBits, &weight, sizeof(weightBits));
+    (*row)[1] = weightBits;
+
+    EXPECT_EQ((CKDWORD) (rowCount * (rowCount - 1) / 2 + 1000), source->Sum(0));
+    int highest = -1;
+    EXPECT_TRUE(source->GetHighest(0, highest));
+    EXPECT_EQ(5, highest);
+    EXPECT_TRUE(source->GetHighest(1, highest));
+    EXPECT_EQ(7, highest);
+
+    CKStateChunk *chunk = source->Save(nullptr, 0xFFFFFFFFu);
+    ASSERT_NE(nullptr, chunk);
+    CKDataArray *loaded = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayPackedWritesDst", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, loaded);
+    EXPECT_EQ(CK_OK, loaded->Load(chunk, nullptr));
+    ASSERT_EQ(rowCount, loaded->GetRowCount());
+    EXPECT_EQ((CKUINTPTR) 1005, *loaded->GetElement(5, 0));
+    EXPECT_EQ((CKUINTPTR) weightBits, *loaded->GetElement(7, 1));
+
+    delete chunk;
+    context_->DestroyObject(loaded);
+    context_->DestroyObject(source);
+}
+
+TEST_F(CKRuntimeFixture, ParallelSortsMatchSerialOrder) {
+    const int rowCount = 200000;
+    const int arrayCount = 2;
+    CKDataArray *arrays[arrayCount];
+    std::vector<std::pair<int, int> > reference;
+    for (int a = 0; a < arrayCount; ++a) {
+        arrays[a] = static_cast<CKDataArray *>(
+            context_->CreateObject(CKCID_DATAARRAY, "DataArrayParallelSort", CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_NE(nullptr, arrays[a]);
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_INT, "Key");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_INT, "Position");
+        for (int i = 0; i < rowCount; ++i) {
+            arrays[a]->AddRow();
+            int key = (i * 7919 + a) % 1000;
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 0, &key));
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 1, &i));
+            if (a == 0)
+                reference.push_back(std::make_pair(key, i));
+        }
+    }
+
+    // Serial stable order: by key, then by original position
+    std::stable_sort(reference.begin(), reference.end(),
+                     [](const std::pair<int, int> &x, const std::pair<int, int> &y) { return x.first < y.first; });
+
+    // Both arrays sorted at the same time from two threads
+    std::thread other([&]() { arrays[1]->StableSort(0, TRUE); });
+    arrays[0]->StableSort(0, TRUE);
+    other.join();
+
+    int key = 0;
+    int position = 0;
+    for (int i = 0; i < rowCount; ++i) {
+        ASSERT_TRUE(arrays[0]->GetElementValue(i, 0, &key));
+        ASSERT_TRUE(arrays[0]->GetElementValue(i, 1, &position));
+        ASSERT_EQ(reference[i].first, key) << "row " << i;
+        ASSERT_EQ(reference[i].second, position) << "row " << i;
+    }
+    int previous = INT_MIN;
+    for (int i = 0; i < rowCount; ++i) {
+        ASSERT_TRUE(arrays[1]->GetElementValue(i, 0, &key));
+        ASSERT_LE(previous, key) << "row " << i;
+        previous = key;
+    }
+
+    // Descending, unstable: same keys as the serial order, every row kept once
+    arrays[0]->Sort(0, FALSE);
+    std::vector<char> seen(rowCount, 0);
+    for (int i = 0; i < rowCount; ++i) {
+        ASSERT_TRUE(arrays[0]->GetElementValue(i, 0, &key));
+        ASSERT_TRUE(arrays[0]->GetElementValue(i, 1, &position));
+        ASSERT_EQ(reference[rowCount - 1 - i].first, key) << "row " << i;
+        ASSERT_EQ(0, seen[position]) << "row " << i;
+        seen[position] = 1;
+    }
+
+    // Unique keeps one row per key
+    arrays[0]->Unique(0);
+    EXPECT_EQ(1000, arrays[0]->GetRowCount());
+
+    for (int a = 0; a < arrayCount; ++a)
+        context_->DestroyObject(arrays[a]);
+}
+
+TEST_F(CKRuntimeFixture, FloatSortsPlaceNaNAfterNumbers) {
+    const int rowCount = 100000;
+    CKDataArray *array = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayNaNSort", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, array);
+    array->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Weight");
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    int nanCount = 0;
+    for (int i = 0; i < rowCount; ++i) {
+        float weight = (i % 13 == 0) ? nan : (float) ((i * 7919) % 5003) - 2500.0f;
+        if (weight != weight)
+            ++nanCount;
+        array->AddRow();
+        ASSERT_TRUE(array->SetElementValue(i, 0, &weight));
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        const CKBOOL ascending = (pass == 0);
+        array->Sort(0, ascending);
+        // Ascending: numbers, then NaN. Descending: NaN, then numbers.
+        int nanSeen = 0;
+        float previous = ascending ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+        for (int i = 0; i < rowCount; ++i) {
+            float weight = 0.0f;
+            ASSERT_TRUE(array->GetElementValue(i, 0, &weight));
+            const bool isNaN = (weight != weight);
+            if (isNaN) {
+                ++nanSeen;
+                continue;
+            }
+            ASSERT_EQ(ascending ? 0 : nanCount, nanSeen) << "row " << i;
+            if (ascending)
+                ASSERT_LE(previous, weight) << "row " << i;
+            else
+                ASSERT_GE(previous, weight) << "row " << i;
+            previous = weight;
+        }
+        EXPECT_EQ(nanCount, nanSeen);
+    }
+
+    context_->DestroyObject(array);
+}
+
+TEST_F(CKRuntimeFixture, FloatExtremaIgnoreNaN) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float weights[] = {3.0f, nan, 9.0f, -4.0f, nan, 9.0f, 1.0f};
+    const int rowCount = sizeof(weights) / sizeof(weights[0]);
+
+    for (int pass = 0; pass < 2; ++pass) {
+        CKDataArray *array = static_cast<CKDataArray *>(
+            context_->CreateObject(CKCID_DATAARRAY, "DataArrayNaNExtrema", CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_NE(nullptr, array);
+        array->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Weight");
+        if (pass == 1)
+            ASSERT_TRUE(array->SetColumnPacked(0, TRUE));
+        for (int i = 0; i < rowCount; ++i) {
+            float weight = weights[i];
+            array->AddRow();
+            ASSERT_TRUE(array->SetElementValue(i, 0, &weight));
+        }
+
+        int row = -1;
+        ASSERT_TRUE(array->GetHighest(0, row));
+        EXPECT_EQ(2, row) << "pass " << pass;
+        ASSERT_TRUE(array->GetLowest(0, row));
+        EXPECT_EQ(3, row) << "pass " << pass;
+
+        // Nothing compares with a leading NaN
+        float weight = nan;
+        ASSERT_TRUE(array->SetElementValue(0, 0, &weight));
+        ASSERT_TRUE(array->GetHighest(0, row));
+        EXPECT_EQ(0, row) << "pass " << pass;
+        ASSERT_TRUE(array->GetLowest(0, row));
+        EXPECT_EQ(0, row) << "pass " << pass;
+
+        // Sorted ascending, the NaN rows are last but not the highest
+        array->Sort(0, TRUE);
+        ASSERT_TRUE(array->GetHighest(0, row));
+        ASSERT_TRUE(array->GetElementValue(row, 0, &weight));
+        EXPECT_EQ(9.0f, weight) << "pass " << pass;
+        ASSERT_TRUE(array->GetLowest(0, row));
+        EXPECT_EQ(0, row) << "pass " << pass;
+
+        context_->DestroyObject(array);
+    }
+}
+
+TEST_F(CKRuntimeFixture, LookupsUseCustomEqualFunction) {
+    const int rowCount = 100;
+    CKDataArray *array = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayCustomEqual", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, array);
+    array->InsertColumn(-1, CKARRAYTYPE_INT, "Key");
+    for (int i = 0; i < rowCount; ++i) {
+        array->AddRow();
+        ASSERT_TRUE(array->SetElementValue(i, 0, &i));
+    }
+    ASSERT_TRUE(array->SetColumnIndexed(0, TRUE));
+    ASSERT_TRUE(array->SetColumnPacked(0, TRUE));
+    array->m_FormatArray[0]->m_EqualFunction = LastDigitEqual;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        // Sorted on the column, lookups still go through the equal function
+        if (pass == 1)
+            array->Sort(0, TRUE);
+        EXPECT_EQ(3, array->FindRowIndex(0, CKEQUAL, 13));
+        EXPECT_EQ(13, array->FindRowIndex(0, CKEQUAL, 13, 0, 4));
+        EXPECT_EQ(0, array->FindRowIndex(0, CKNOTEQUAL, 13));
+        EXPECT_EQ(10, array->GetCount(0, CKEQUAL, 13));
+        EXPECT_EQ(90, array->GetCount(0, CKNOTEQUAL, 13));
+        EXPECT_TRUE(array->TestRow(23, 0, CKEQUAL, 3));
+        EXPECT_FALSE(array->TestRow(24, 0, CKEQUAL, 3));
+    }
+
+    context_->DestroyObject(array);
+}
+
+TEST_F(CKRuntimeFixture, PackedColumnKernelsMatchRowLoops) {
+    // Not a multiple of the vector width
+    const int rowCount = 4099;
+    CKDataArray *arrays[2];
+    for (int a = 0; a < 2; ++a) {
+        arrays[a] = static_cast<CKDataArray *>(
+            context_->CreateObject(CKCID_DATAARRAY, "DataArrayColumnKernels", CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_NE(nullptr, arrays[a]);
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_INT, "IntA");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_INT, "IntB");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_INT, "IntResult");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_FLOAT, "FloatA");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_FLOAT, "FloatB");
+        arrays[a]->InsertColumn(-1, CKARRAYTYPE_FLOAT, "FloatResult");
+    }
+    CKDataArray *packed = arrays[0];
+    CKDataArray *plain = arrays[1];
+    for (int c = 0; c < 6; ++c)
+        ASSERT_TRUE(packed->SetColumnPacked(c, TRUE));
+
+    srand(1234);
+    float maxFloat = 0.0f;
+    for (int i = 0; i < rowCount; ++i) {
+        int intA = rand() % (1 << 15) - (1 << 14);
+        int intB = rand() % 7 - 3;
+        float floatA = (float) (rand() % (1 << 15) - (1 << 14)) / 64.0f;
+        maxFloat = std::max(maxFloat, fabsf(floatA));
+        float floatB = (i % 13 == 0) ? 0.0f : (float) (rand() % 2001 - 1000) / 64.0f;
+        for (int a = 0; a < 2; ++a) {
+            arrays[a]->AddRow();
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 0, &intA));
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 1, &intB));
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 3, &floatA));
+            ASSERT_TRUE(arrays[a]->SetElementValue(i, 4, &floatB));
+        }
+    }
+
+    static const CK_BINARYOPERATOR ops[] = {CKADD, CKSUB, CKMUL, CKDIV};
+    float operand = 0.75f;
+    CKDWORD operandBits;
+    memcpy(&operandBits, &operand, sizeof(operandBits));
+    for (int o = 0; o < 4; ++o) {
+        for (int a = 0; a < 2; ++a) {
+            arrays[a]->ColumnsOperate(0, ops[o], 1, 2);
+            arrays[a]->ColumnsOperate(3, ops[o], 4, 5);
+            arrays[a]->ColumnTransform(2, ops[o], 3);
+            arrays[a]->ColumnTransform(5, ops[o], operandBits);
+        }
+        // Element operations are bit-exact
+        for (int i = 0; i < rowCount; ++i) {
+            ASSERT_EQ(*plain->GetElement(i, 2), *packed->GetElement(i, 2)) << "op " << ops[o] << " row " << i;
+            ASSERT_EQ(*plain->GetElement(i, 5), *packed->GetElement(i, 5)) << "op " << ops[o] << " row " << i;
+        }
+        EXPECT_EQ(plain->Sum(2), packed->Sum(2)) << "op " << ops[o];
+        EXPECT_EQ(plain->Product(2), packed->Product(2)) << "op " << ops[o];
+
+        int expected = -1;
+        int actual = -1;
+        for (int c = 2; c < 6; c += 3) {
+            plain->GetHighest(c, expected);
+            packed->GetHighest(c, actual);
+            EXPECT_EQ(expected, actual) << "op " << ops[o];
+            plain->GetLowest(c, expected);
+            packed->GetLowest(c, actual);
+            EXPECT_EQ(expected, actual) << "op " << ops[o];
+        }
+    }
+
+    // Float sums are accumulated on four lanes: same value up to rounding
+    CKDWORD plainBits = plain->Sum(3);
+    CKDWORD packedBits = packed->Sum(3);
+    float plainSum;
+    float packedSum;
+    memcpy(&plainSum, &plainBits, sizeof(float));
+    memcpy(&packedSum, &packedBits, sizeof(float));
+    EXPECT_NEAR(plainSum, packedSum, rowCount * maxFloat * 1e-6f);
+
+    context_->DestroyObject(packed);
+    context_->DestroyObject(plain);
+}
+
+TEST_F(CKRuntimeFixture, LoadAndWriteElementsKeepTextValues) {
+    // Enough lines to be parsed on several threads
+    const int rowCount = 40000;
+    CKDataArray *array = static_cast<CKDataArray *>(
+        context_->CreateObject(CKCID_DATAARRAY, "DataArrayTextElements", CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, array);
+    array->InsertColumn(-1, CKARRAYTYPE_INT, "Int");
+    array->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Float");
+    array->InsertColumn(-1, CKARRAYTYPE_STRING, "String");
+    array->InsertColumn(-1, CKARRAYTYPE_OBJECT, "Object");
+    CKObject *target = context_->CreateObject(CKCID_OBJECT, "DataArrayTextTarget");
+    ASSERT_NE(nullptr, target);
+
+    srand(4321);
+    std::vector<int> ints(rowCount);
+    std::vector<float> floats(rowCount);
+    std::string expected;
+    const char *filename = "CKDataArray_TextElements.tmp";
+    FILE *file = fopen(filename, "wb");
+    ASSERT_NE(nullptr, file);
+    char line[256];
+    for (int i = 0; i < rowCount; ++i) {
+        ints[i] = (int) (((unsigned int) rand() << 16) ^ (unsigned int) rand());
+        switch (i % 4) {
+        case 0: floats[i] = (float) (rand() % 2000001 - 1000000) / 1024.0f; break;
+        case 1: floats[i] = (float) rand() * 1e-9f; break;
+        case 2: floats[i] = (float) rand() * 1e7f; break;
+        default: floats[i] = (float) (rand() % 100); break;
+        }
+        sprintf(line, "%d\t%g\tRow%d\t%s", ints[i], floats[i], i, (i % 3) ? target->GetName() : "");
+        expected += line;
+        expected += "\n";
+        // The loader drops the '\r' of text files written on Windows
+        fprintf(file, "%s\r\n", line);
+    }
+    fclose(file);
+
+    ASSERT_TRUE(array->LoadElements(filename, TRUE, 0));
+    ASSERT_EQ(rowCount, array->GetRowCount());
+    char text[64];
+    for (int i = 0; i < rowCount; ++i) {
+        ASSERT_EQ(ints[i], (int) *array->GetElement(i, 0)) << "row " << i;
+        sprintf(text, "%g", floats[i]);
+        const float parsed = (float) atof(text);
+        CKDWORD bits;
+        memcpy(&bits, &parsed, sizeof(bits));
+        ASSERT_EQ(bits, (CKDWORD) *array->GetElement(i, 1)) << "row " << i;
+        sprintf(text, "Row%d", i);
+        ASSERT_STREQ(text, (const char *) *array->GetElement(i, 2)) << "row " << i;
+        ASSERT_EQ((i % 3) ? target->GetID() : 0, (CK_ID) *array->GetElement(i, 3)) << "row " << i;
+    }
+
+    ASSERT_TRUE(array->WriteElements(filename, 0, 4));
+    file = fopen(filename, "rt");
+    ASSERT_NE(nullptr, file);
+    std::string written;
+    char block[4096];
+    size_t readSize;
+    while ((readSize = fread(block, 1, sizeof(block), file)) > 0)
+        written.append(block, readSize);
+    fclose(file);
+    remove(filename);
+    EXPECT_TRUE(expected == written);
+
+    context_->DestroyObject(array);
+    context_->DestroyObject(target);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "CKAll.h"
+
+namespace {
+
+class CKRuntimeFixture : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_EQ(CK_OK, CKStartUp());
+        ASSERT_EQ(CK_OK, CKCreateContext(&context_, nullptr, 0, 0));
+        ASSERT_NE(nullptr, context_);
+    }
+
+    static void TearDownTestSuite() {
+        if (context_) {
+            CKCloseContext(context_);
+            context_ = nullptr;
+        }
+        CKShutdown();
+    }
+
+    static CKContext *context_;
+};
+
+CKContext *CKRuntimeFixture::context_ = nullptr;
+
+std::vector<char> ReadWholeFile(const char *filename) {
+    std::vector<char> bytes;
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        return bytes;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size > 0) {
+        bytes.resize(static_cast<size_t>(size));
+        if (fread(&bytes[0], 1, bytes.size(), fp) != bytes.size()) {
+            bytes.clear();
+        }
+    }
+    fclose(fp);
+    return bytes;
+}
+
+CKERROR SaveWithThreadCount(CKContext *context, const char *filename, XObjectArray &objects, int threadCount) {
+    remove(filename);
+    context->SetSaveThreadCount(threadCount);
+
+    CKFile *file = context->CreateCKFile();
+    if (!file) {
+        return CKERR_OUTOFMEMORY;
+    }
+
+    CKERROR err = file->StartSave(filename);
+    if (err == CK_OK) {
+        file->SaveObjects(objects.Begin(), objects.Size());
+        err = file->EndSave();
+    }
+    context->DeleteCKFile(file);
+    context->SetSaveThreadCount(0);
+    return err;
+}
+
+} // namespace
+
+TEST_F(CKRuntimeFixture, ParallelEndSaveIsByteIdenticalToSerialSave) {
+    XObjectArray objects;
+    char name[64];
+
+    for (int a = 0; a < 16; ++a) {
+        sprintf(name, "ParallelSaveArray%d", a);
+        CKDataArray *array = static_cast<CKDataArray *>(context_->CreateObject(CKCID_DATAARRAY, name));
+        ASSERT_NE(nullptr, array);
+        array->InsertColumn(-1, CKARRAYTYPE_INT, "Id");
+        array->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Score");
+        array->InsertColumn(-1, CKARRAYTYPE_STRING, "Label");
+        for (int r = 0; r < 200; ++r) {
+            array->AddRow();
+            int id = a * 1000 + r;
+            float score = (float) r * 0.25f;
+            sprintf(name, "row_%d_%d", a, r);
+            ASSERT_TRUE(array->SetElementValue(r, 0, &id));
+            ASSERT_TRUE(array->SetElementValue(r, 1, &score));
+            ASSERT_TRUE(array->SetElementStringValue(r, 2, name));
+        }
+        objects.PushBack(array->GetID());
+    }
+
+    CKGroup *group = static_cast<CKGroup *>(context_->CreateObject(CKCID_GROUP, "ParallelSaveGroup"));
+    ASSERT_NE(nullptr, group);
+    for (int i = 0; i < objects.Size(); ++i) {
+        group->AddObject(static_cast<CKBeObject *>(context_->GetObject(objects[i])));
+    }
+    objects.PushBack(group->GetID());
+
+    for (int i = 0; i < 64; ++i) {
+        sprintf(name, "ParallelSavePlainObject%d", i);
+        CKObject *obj = context_->CreateObject(CKCID_OBJECT, name);
+        ASSERT_NE(nullptr, obj);
+        objects.PushBack(obj->GetID());
+    }
+
+    const char *serialFile = "CKFile_ParallelSave_Serial.tmp";
+    const char *parallelFile = "CKFile_ParallelSave_Parallel.tmp";
+
+    ASSERT_EQ(CK_OK, SaveWithThreadCount(context_, serialFile, objects, 0));
+    ASSERT_EQ(CK_OK, SaveWithThreadCount(context_, parallelFile, objects, 4));
+
+    std::vector<char> serialBytes = ReadWholeFile(serialFile);
+    std::vector<char> parallelBytes = ReadWholeFile(parallelFile);
+    ASSERT_FALSE(serialBytes.empty());
+    ASSERT_EQ(serialBytes.size(), parallelBytes.size());
+    EXPECT_EQ(0, memcmp(&serialBytes[0], &parallelBytes[0], serialBytes.size()));
+
+    remove(serialFile);
+    remove(parallelFile);
+
+    context_->DestroyObjects(objects.Begin(), objects.Size());
+}
+
+TEST_F(CKRuntimeFixture, WholeCompressedSaveLoadRoundTrip) {
+    const char *filename = "CKFile_WholeCompressed_RoundTrip.tmp";
+    const int rowCount = 5000;
+
+    CKDataArray *array = static_cast<CKDataArray *>(context_->CreateObject(CKCID_DATAARRAY, "WholeCompressedArray"));
+    ASSERT_NE(nullptr, array);
+    array->InsertColumn(-1, CKARRAYTYPE_INT, "Id");
+    array->InsertColumn(-1, CKARRAYTYPE_STRING, "Label");
+    char label[64];
+    for (int r = 0; r < rowCount; ++r) {
+        array->AddRow();
+        int id = r * 7;
+        sprintf(label, "compressed_row_%d", r);
+        ASSERT_TRUE(array->SetElementValue(r, 0, &id));
+        ASSERT_TRUE(array->SetElementStringValue(r, 1, label));
+    }
+
+    const CK_FILE_WRITEMODE previousMode = context_->GetFileWriteMode();
+    context_->SetFileWriteMode(CKFILE_WHOLECOMPRESSED);
+
+    XObjectArray objects;
+    objects.PushBack(array->GetID());
+    remove(filename);
+    CKFile *file = context_->CreateCKFile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(CK_OK, file->StartSave(filename));
+    file->SaveObjects(objects.Begin(), objects.Size());
+    ASSERT_EQ(CK_OK, file->EndSave());
+    context_->DeleteCKFile(file);
+    context_->SetFileWriteMode(previousMode);
+
+    context_->DestroyObjects(objects.Begin(), objects.Size());
+
+    CKObjectArray *loaded = CreateCKObjectArray();
+    file = context_->CreateCKFile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(CK_OK, file->Load(filename, loaded));
+    EXPECT_TRUE((file->m_FileInfo.FileWriteMode & CKFILE_WHOLECOMPRESSED) != 0);
+    EXPECT_LT(file->m_FileInfo.DataPackSize, file->m_FileInfo.DataUnPackSize);
+    context_->DeleteCKFile(file);
+
+    CKDataArray *result = nullptr;
+    for (loaded->Reset(); !loaded->EndOfList(); loaded->Next()) {
+        CKObject *obj = loaded->GetData(context_);
+        if (obj && obj->GetClassID() == CKCID_DATAARRAY) {
+            result = static_cast<CKDataArray *>(obj);
+        }
+    }
+    DeleteCKObjectArray(loaded);
+    remove(filename);
+
+    ASSERT_NE(nullptr, result);
+    ASSERT_EQ(rowCount, result->GetRowCount());
+    for (int r = 0; r < rowCount; r += 997) {
+        int id = 0;
+        ASSERT_TRUE(result->GetElementValue(r, 0, &id));
+        EXPECT_EQ(r * 7, id);
+        sprintf(label, "compressed_row_%d", r);
+        char buffer[64] = {};
+        result->GetElementStringValue(r, 1, buffer, sizeof(buffer));
+        EXPECT_STREQ(label, buffer);
+    }
+
+    CK_ID resultId = result->GetID();
+    context_->DestroyObjects(&resultId, 1);
+}
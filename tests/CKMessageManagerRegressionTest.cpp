@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <set>
+
+#include "CKAll.h"
+
+namespace {
+
+class CKRuntimeFixture : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_EQ(CK_OK, CKStartUp());
+        ASSERT_EQ(CK_OK, CKCreateContext(&context_, nullptr, 0, 0));
+        ASSERT_NE(nullptr, context_);
+    }
+
+    static void TearDownTestSuite() {
+        if (context_) {
+            CKCloseContext(context_);
+            context_ = nullptr;
+        }
+        CKShutdown();
+    }
+
+    static CKContext *context_;
+};
+
+CKContext *CKRuntimeFixture::context_ = nullptr;
+
+} // namespace
+
+TEST_F(CKRuntimeFixture, PooledMessagesAreReusedAfterPostProcess) {
+    const int messageCount = 1000;
+    CKMessageManager *mm = context_->GetMessageManager();
+    ASSERT_NE(nullptr, mm);
+    const CKMessageType type = mm->AddMessageType("PooledMessage");
+
+    CKBeObject *receiver = (CKBeObject *) context_->CreateObject(CKCID_DATAARRAY, "PooledMessageReceiver");
+    ASSERT_NE(nullptr, receiver);
+    receiver->SetAsWaitingForMessages(TRUE);
+    CKParameterOut *param = context_->CreateCKParameterOut("PooledMessageParam", CKPGUID_INT, TRUE);
+    ASSERT_NE(nullptr, param);
+
+    CKStats &stats = context_->m_Stats;
+    std::set<CKMessage *> firstMessages;
+    for (int i = 0; i < messageCount; ++i) {
+        CKMessage *msg = mm->SendMessageSingle(type, receiver);
+        ASSERT_NE(nullptr, msg);
+        ASSERT_EQ(CK_OK, msg->AddParameter(param));
+        firstMessages.insert(msg);
+    }
+    EXPECT_EQ(messageCount, (int) firstMessages.size());
+
+    mm->PostProcess();
+    ASSERT_EQ(messageCount, receiver->GetLastFrameMessageCount());
+    EXPECT_EQ(param, receiver->GetLastFrameMessage(0)->GetParameter(0));
+    // The receiver drops its messages at the start of the next PostProcess,
+    // they go back to the pool at its end
+    mm->PostProcess();
+    EXPECT_EQ(0, receiver->GetLastFrameMessageCount());
+
+    const int allocated = stats.MessagesAllocated;
+    const int heapAllocations = stats.MessagePoolHeapAllocations;
+    for (int i = 0; i < messageCount; ++i) {
+        CKMessage *msg = mm->SendMessageSingle(type, receiver);
+        ASSERT_NE(nullptr, msg);
+        ASSERT_EQ(CK_OK, msg->AddParameter(param));
+        EXPECT_TRUE(firstMessages.count(msg) == 1);
+        EXPECT_EQ(CKCID_DATAARRAY, msg->GetRecipient()->GetClassID());
+        EXPECT_EQ(1, msg->GetParameterCount());
+    }
+    EXPECT_EQ(allocated + messageCount, stats.MessagesAllocated);
+    EXPECT_EQ(heapAllocations, stats.MessagePoolHeapAllocations);
+
+    mm->PostProcess();
+    EXPECT_EQ(messageCount, receiver->GetLastFrameMessageCount());
+    mm->PostProcess();
+
+    context_->DestroyObject(receiver);
+    context_->DestroyObject(param);
+}
+
+TEST_F(CKRuntimeFixture, MessagesHeldPastTheContextAreReleasedSafely) {
+    CKContext *context = nullptr;
+    ASSERT_EQ(CK_OK, CKCreateContext(&context, nullptr, 0, 0));
+    ASSERT_NE(nullptr, context);
+    CKMessageManager *mm = context->GetMessageManager();
+    const CKMessageType type = mm->AddMessageType("HeldMessage");
+    CKBeObject *receiver = (CKBeObject *) context->CreateObject(CKCID_DATAARRAY, "HeldMessageReceiver");
+    ASSERT_NE(nullptr, receiver);
+
+    CKMessage *pooled = mm->SendMessageSingle(type, receiver);
+    ASSERT_NE(nullptr, pooled);
+    pooled->AddRef();
+    CKMessage *allocated = new CKMessage(context);
+    allocated->SetMsgType(type);
+
+    // The pool storage stays until both messages are released
+    CKCloseContext(context);
+    EXPECT_EQ(type, pooled->GetMsgType());
+    EXPECT_EQ(0, pooled->Release());
+    EXPECT_EQ(0, allocated->Release());
+}
+
+TEST_F(CKRuntimeFixture, BroadcastReachesOnlyWaitingObjectsOfTheClass) {
+    CKMessageManager *mm = context_->GetMessageManager();
+    const CKMessageType first = mm->AddMessageType("BroadcastFirst");
+    const CKMessageType second = mm->AddMessageType("BroadcastSecond");
+
+    CKBeObject *arrays[3];
+    for (int i = 0; i < 3; ++i) {
+        arrays[i] = (CKBeObject *) context_->CreateObject(CKCID_DATAARRAY, "BroadcastArray");
+        ASSERT_NE(nullptr, arrays[i]);
+    }
+    CKBeObject *group = (CKBeObject *) context_->CreateObject(CKCID_GROUP, "BroadcastGroup");
+    ASSERT_NE(nullptr, group);
+    arrays[0]->SetAsWaitingForMessages(TRUE);
+    arrays[1]->SetAsWaitingForMessages(TRUE);
+    group->SetAsWaitingForMessages(TRUE);
+    // Waiting is counted: one call to stop is not enough
+    arrays[1]->SetAsWaitingForMessages(TRUE);
+    arrays[1]->SetAsWaitingForMessages(FALSE);
+
+    mm->SendMessageBroadcast(first, CKCID_DATAARRAY);
+    mm->SendMessageSingle(second, arrays[0]);
+    mm->SendMessageBroadcast(second, CKCID_BEOBJECT);
+    mm->PostProcess();
+
+    // Messages stay in sending order on each receiver
+    ASSERT_EQ(3, arrays[0]->GetLastFrameMessageCount());
+    EXPECT_EQ(first, arrays[0]->GetLastFrameMessage(0)->GetMsgType());
+    EXPECT_EQ(second, arrays[0]->GetLastFrameMessage(1)->GetMsgType());
+    EXPECT_EQ(CK_MESSAGE_SINGLE, arrays[0]->GetLastFrameMessage(1)->GetSendingType());
+    EXPECT_EQ(CK_MESSAGE_BROADCAST, arrays[0]->GetLastFrameMessage(2)->GetSendingType());
+    ASSERT_EQ(2, arrays[1]->GetLastFrameMessageCount());
+    EXPECT_EQ(0, arrays[2]->GetLastFrameMessageCount());
+    ASSERT_EQ(1, group->GetLastFrameMessageCount());
+    EXPECT_EQ(second, group->GetLastFrameMessage(0)->GetMsgType());
+
+    // Stopped and destroyed objects are not visited anymore
+    arrays[1]->SetAsWaitingForMessages(FALSE);
+    context_->DestroyObject(arrays[0]);
+    mm->SendMessageBroadcast(first, CKCID_BEOBJECT);
+    mm->PostProcess();
+    EXPECT_EQ(0, arrays[1]->GetLastFrameMessageCount());
+    EXPECT_EQ(1, group->GetLastFrameMessageCount());
+
+    // Receivers are listed once per frame, whatever their message count
+    mm->SendMessageSingle(first, group);
+    mm->SendMessageSingle(second, group);
+    mm->PostProcess();
+    EXPECT_EQ(2, group->GetLastFrameMessageCount());
+    mm->PostProcess();
+    EXPECT_EQ(0, group->GetLastFrameMessageCount());
+
+    context_->DestroyObject(arrays[1]);
+    context_->DestroyObject(arrays[2]);
+    context_->DestroyObject(group);
+}
+
+TEST_F(CKRuntimeFixture, MessageTypeIdsStayStableAcrossManyTypesAndRenames) {
+    const int typeCount = 500;
+    CKMessageManager *mm = context_->GetMessageManager();
+    ASSERT_NE(nullptr, mm);
+    char name[64];
+
+    const int firstCount = mm->GetMessageTypeCount();
+    for (int i = 0; i < typeCount; ++i) {
+        sprintf(name, "HashedMessageType%d", i);
+        EXPECT_EQ(firstCount + i, mm->AddMessageType(name));
+    }
+    EXPECT_EQ(firstCount + typeCount, mm->GetMessageTypeCount());
+
+    // Names are case sensitive and already registered names keep their type
+    for (int i = 0; i < typeCount; i += 7) {
+        sprintf(name, "HashedMessageType%d", i);
+        EXPECT_EQ(firstCount + i, mm->AddMessageType(name));
+        EXPECT_STREQ(name, mm->GetMessageTypeName(firstCount + i));
+    }
+    EXPECT_EQ(firstCount + typeCount, mm->AddMessageType("hashedmessagetype0"));
+    EXPECT_EQ(-1, mm->AddMessageType(""));
+
+    const CKMessageType renamed = firstCount + 10;
+    mm->RenameMessageType(renamed, "HashedMessageTypeRenamed");
+    EXPECT_EQ(renamed, mm->AddMessageType("HashedMessageTypeRenamed"));
+    EXPECT_STREQ("HashedMessageTypeRenamed", mm->GetMessageTypeName(renamed));
+
+    // A name given to two types resolves to the first one
+    mm->RenameMessageType(firstCount + 20, "HashedMessageType5");
+    EXPECT_EQ(firstCount + 5, mm->AddMessageType("HashedMessageType5"));
+    mm->RenameMessageType(firstCount + 5, "HashedMessageTypeMoved");
+    EXPECT_EQ(firstCount + 20, mm->AddMessageType("HashedMessageType5"));
+
+    // The old name is free again and gets a new type
+    const int count = mm->GetMessageTypeCount();
+    EXPECT_EQ(count, mm->AddMessageType("HashedMessageType10"));
+
+    // Waiting lists of all types are still reachable after the array grew
+    CKBehavior *beh = (CKBehavior *) context_->CreateObject(CKCID_BEHAVIOR, "HashedMessageWaiter");
+    ASSERT_NE(nullptr, beh);
+    CKBeObject *owner = (CKBeObject *) context_->CreateObject(CKCID_DATAARRAY, "HashedMessageOwner");
+    ASSERT_NE(nullptr, owner);
+    beh->CreateOutput("Out");
+    for (int i = 0; i < typeCount; i += 50)
+        EXPECT_EQ(CK_OK, mm->RegisterWait(firstCount + i, beh, 0, owner));
+    for (int i = 0; i < typeCount; i += 50)
+        EXPECT_EQ(CK_OK, mm->UnRegisterWait(firstCount + i, beh, 0));
+
+    context_->DestroyObject(beh);
+    context_->DestroyObject(owner);
+}
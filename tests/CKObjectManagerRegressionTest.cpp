@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "CKAll.h"
+
+namespace {
+
+class CKRuntimeFixture : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        ASSERT_EQ(CK_OK, CKStartUp());
+        ASSERT_EQ(CK_OK, CKCreateContext(&context_, nullptr, 0, 0));
+        ASSERT_NE(nullptr, context_);
+    }
+
+    static void TearDownTestSuite() {
+        if (context_) {
+            CKCloseContext(context_);
+            context_ = nullptr;
+        }
+        CKShutdown();
+    }
+
+    static CKContext *context_;
+};
+
+CKContext *CKRuntimeFixture::context_ = nullptr;
+
+double ElapsedMilliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TEST_F(CKRuntimeFixture, GetObjectByNameCursorFollowsIdAndClassListOrder) {
+    CKObject *a = context_->CreateObject(CKCID_OBJECT, "NameIndexDuplicate");
+    CKObject *b = context_->CreateObject(CKCID_DATAARRAY, "NameIndexDuplicate");
+    CKObject *c = context_->CreateObject(CKCID_OBJECT, "NameIndexDuplicate");
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    ASSERT_NE(nullptr, c);
+    ASSERT_LT(a->GetID(), b->GetID());
+    ASSERT_LT(b->GetID(), c->GetID());
+
+    EXPECT_EQ(a, context_->GetObjectByName("NameIndexDuplicate"));
+    EXPECT_EQ(b, context_->GetObjectByName("NameIndexDuplicate", a));
+    EXPECT_EQ(c, context_->GetObjectByName("NameIndexDuplicate", b));
+    EXPECT_EQ(nullptr, context_->GetObjectByName("NameIndexDuplicate", c));
+
+    EXPECT_EQ(a, context_->GetObjectByNameAndClass("NameIndexDuplicate", CKCID_OBJECT));
+    EXPECT_EQ(c, context_->GetObjectByNameAndClass("NameIndexDuplicate", CKCID_OBJECT, a));
+    EXPECT_EQ(nullptr, context_->GetObjectByNameAndClass("NameIndexDuplicate", CKCID_OBJECT, c));
+    EXPECT_EQ(b, context_->GetObjectByNameAndClass("NameIndexDuplicate", CKCID_DATAARRAY));
+
+    // Class ids are visited in order, CKCID_OBJECT comes before CKCID_DATAARRAY
+    EXPECT_EQ(a, context_->GetObjectByNameAndParentClass("NameIndexDuplicate", CKCID_OBJECT, nullptr));
+    EXPECT_EQ(c, context_->GetObjectByNameAndParentClass("NameIndexDuplicate", CKCID_OBJECT, a));
+    EXPECT_EQ(b, context_->GetObjectByNameAndParentClass("NameIndexDuplicate", CKCID_OBJECT, c));
+    EXPECT_EQ(nullptr, context_->GetObjectByNameAndParentClass("NameIndexDuplicate", CKCID_OBJECT, b));
+
+    a->SetName("NameIndexRenamed");
+    EXPECT_EQ(b, context_->GetObjectByName("NameIndexDuplicate"));
+    EXPECT_EQ(a, context_->GetObjectByName("NameIndexRenamed"));
+
+    CK_ID ids[3] = {a->GetID(), b->GetID(), c->GetID()};
+    context_->DestroyObjects(ids, 3);
+    EXPECT_EQ(nullptr, context_->GetObjectByName("NameIndexDuplicate"));
+    EXPECT_EQ(nullptr, context_->GetObjectByName("NameIndexRenamed"));
+}
+
+TEST_F(CKRuntimeFixture, LoadHundredThousandNamedObjectsWithDuplicateCheck) {
+    const int objectCount = 100000;
+    const char *filename = "CKObjectManager_NamedObjects.tmp";
+    char name[64];
+
+    XObjectArray objects;
+    for (int i = 0; i < objectCount; ++i) {
+        sprintf(name, "NamedObject%d", i);
+        CKObject *obj = context_->CreateObject(CKCID_OBJECT, name);
+        ASSERT_NE(nullptr, obj);
+        objects.PushBack(obj->GetID());
+    }
+
+    remove(filename);
+    CKFile *file = context_->CreateCKFile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(CK_OK, file->StartSave(filename));
+    file->SaveObjects(objects.Begin(), objects.Size());
+    ASSERT_EQ(CK_OK, file->EndSave());
+    context_->DeleteCKFile(file);
+    context_->DestroyObjects(objects.Begin(), objects.Size());
+
+    // Every loaded object goes through LoadVerifyObjectUnicity
+    CKObjectArray *loaded = CreateCKObjectArray();
+    file = context_->CreateCKFile();
+    ASSERT_NE(nullptr, file);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ASSERT_EQ(CK_OK, file->Load(filename, loaded, CK_LOAD_CHECKDUPLICATES));
+    const double loadMs = ElapsedMilliseconds(start);
+    context_->DeleteCKFile(file);
+    remove(filename);
+
+    RecordProperty("LoadMilliseconds", static_cast<int>(loadMs));
+
+    EXPECT_EQ(objectCount, loaded->GetCount());
+    for (int i = 0; i < objectCount; i += 9973) {
+        sprintf(name, "NamedObject%d", i);
+        CKObject *obj = context_->GetObjectByNameAndClass(name, CKCID_OBJECT);
+        ASSERT_NE(nullptr, obj);
+        EXPECT_STREQ(name, obj->GetName());
+    }
+
+    XObjectArray loadedIds;
+    for (loaded->Reset(); !loaded->EndOfList(); loaded->Next()) {
+        loadedIds.PushBack(loaded->GetDataId());
+    }
+    DeleteCKObjectArray(loaded);
+    context_->DestroyObjects(loadedIds.Begin(), loadedIds.Size());
+}
+
+TEST_F(CKRuntimeFixture, ReserveObjectIDsKeepsObjectTableInPlace) {
+    const int objectCount = 20000;
+    CKObjectManager *objectManager = context_->m_ObjectManager;
+
+    objectManager->ReserveObjectIDs(objectCount);
+    CKObject **table = objectManager->m_Objects;
+    EXPECT_GT(objectManager->m_AllocatedObjectCount, objectManager->m_ObjectCount + objectCount);
+
+    XObjectArray objects;
+    for (int i = 0; i < objectCount; ++i) {
+        CKObject *obj = context_->CreateObject(CKCID_OBJECT);
+        ASSERT_NE(nullptr, obj);
+        objects.PushBack(obj->GetID());
+    }
+    EXPECT_EQ(table, objectManager->m_Objects);
+
+    for (int i = 0; i < objectCount; i += 997) {
+        EXPECT_NE(nullptr, context_->GetObject(objects[i]));
+    }
+    context_->DestroyObjects(objects.Begin(), objects.Size());
+}
+
+TEST_F(CKRuntimeFixture, DestroyFewObjectsAmongManyGroupsAndParameters) {
+    const int groupCount = 2000;
+    const int membersPerGroup = 8;
+    const int parameterCount = 20000;
+    const int destroyCount = 1000;
+
+    XObjectArray groups;
+    XObjectArray members;
+    for (int i = 0; i < groupCount; ++i) {
+        CKGroup *group = (CKGroup *) context_->CreateObject(CKCID_GROUP);
+        ASSERT_NE(nullptr, group);
+        groups.PushBack(group->GetID());
+        for (int j = 0; j < membersPerGroup; ++j) {
+            CKBeObject *member = (CKBeObject *) context_->CreateObject(CKCID_DATAARRAY);
+            ASSERT_NE(nullptr, member);
+            ASSERT_EQ(CK_OK, group->AddObject(member));
+            members.PushBack(member->GetID());
+        }
+    }
+
+    XObjectArray parameters;
+    for (int i = 0; i < parameterCount; ++i) {
+        CKParameterOut *param = context_->CreateCKParameterOut(nullptr, CKPGUID_INT);
+        ASSERT_NE(nullptr, param);
+        parameters.PushBack(param->GetID());
+    }
+
+    // One object at a time: each call is a batch of one among M live objects
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < destroyCount; ++i) {
+        CK_ID id = members[i * membersPerGroup];
+        context_->DestroyObjects(&id, 1);
+    }
+    const double destroyMs = ElapsedMilliseconds(start);
+
+    RecordProperty("DestroyMilliseconds", static_cast<int>(destroyMs));
+
+    for (int i = 0; i < groupCount; ++i) {
+        CKGroup *group = (CKGroup *) context_->GetObject(groups[i]);
+        ASSERT_NE(nullptr, group);
+        EXPECT_EQ(i < destroyCount ? membersPerGroup - 1 : membersPerGroup, group->GetObjectCount());
+    }
+
+    XObjectArray remaining;
+    for (int i = 0; i < members.Size(); ++i) {
+        if (context_->GetObject(members[i]))
+            remaining.PushBack(members[i]);
+    }
+    EXPECT_EQ(members.Size() - destroyCount, remaining.Size());
+    context_->DestroyObjects(remaining.Begin(), remaining.Size());
+    context_->DestroyObjects(groups.Begin(), groups.Size());
+    context_->DestroyObjects(parameters.Begin(), parameters.Size());
+}
@@ -424,6 +424,77 @@ TEST_F(CKRuntimeFixture, UpdateFindsSwappedOperationSignatureAndExecutes) {
     EXPECT_EQ(1, gOperationInvocationCount);
 }
 
+TEST_F(CKRuntimeFixture, GetOperationFunctionCachesResolutionUntilRegistrationChanges) {
+    CKParameterManager *pm = context_->GetParameterManager();
+    ASSERT_NE(nullptr, pm);
+
+    CKGUID opGuid(0x1C0F7A21u, 0x5D3E0B94u);
+    ASSERT_GE(pm->RegisterOperationType(opGuid, "CachedResolution"), 0);
+    ASSERT_EQ(CK_OK, pm->RegisterOperationFunction(opGuid, CKPGUID_INT, CKPGUID_INT, CKPGUID_INT, NoInputOperation));
+
+    CKStats &stats = context_->m_Stats;
+    const int hits = stats.OperationCacheHits;
+    const int misses = stats.OperationCacheMisses;
+
+    // Unregistered signatures are cached as failures too
+    EXPECT_EQ(NoInputOperation, pm->GetOperationFunction(opGuid, CKPGUID_INT, CKPGUID_INT, CKPGUID_INT));
+    EXPECT_EQ(nullptr, pm->GetOperationFunction(opGuid, CKPGUID_STRING, CKPGUID_INT, CKPGUID_INT));
+    EXPECT_EQ(misses + 2, stats.OperationCacheMisses);
+    EXPECT_EQ(NoInputOperation, pm->GetOperationFunction(opGuid, CKPGUID_INT, CKPGUID_INT, CKPGUID_INT));
+    EXPECT_EQ(nullptr, pm->GetOperationFunction(opGuid, CKPGUID_STRING, CKPGUID_INT, CKPGUID_INT));
+    EXPECT_EQ(hits + 2, stats.OperationCacheHits);
+    EXPECT_EQ(misses + 2, stats.OperationCacheMisses);
+
+    ASSERT_EQ(CK_OK, pm->RegisterOperationFunction(opGuid, CKPGUID_STRING, CKPGUID_INT, CKPGUID_INT, SwapAwareOperation));
+    EXPECT_EQ(SwapAwareOperation, pm->GetOperationFunction(opGuid, CKPGUID_STRING, CKPGUID_INT, CKPGUID_INT));
+
+    ASSERT_EQ(CK_OK, pm->UnRegisterOperationFunction(opGuid, CKPGUID_STRING, CKPGUID_INT, CKPGUID_INT));
+    EXPECT_EQ(nullptr, pm->GetOperationFunction(opGuid, CKPGUID_STRING, CKPGUID_INT, CKPGUID_INT));
+
+    ASSERT_EQ(CK_OK, pm->UnRegisterOperationType(opGuid));
+    EXPECT_EQ(nullptr, pm->GetOperationFunction(opGuid, CKPGUID_INT, CKPGUID_INT, CKPGUID_INT));
+}
+
+TEST_F(CKRuntimeFixture, DeterministicOperationRunsOnlyWhenAnInputChanged) {
+    CKParameterManager *pm = context_->GetParameterManager();
+    ASSERT_NE(nullptr, pm);
+
+    CKGUID opGuid(0x2A6B1E03u, 0x7F4C9D15u);
+    ASSERT_GE(pm->RegisterOperationType(opGuid, "DeterministicCount"), 0);
+    ASSERT_EQ(CK_OK, pm->RegisterOperationFunction(opGuid, CKPGUID_INT, CKPGUID_INT, CKPGUID_NONE, NoInputOperation));
+
+    CKParameterOperation *operation = context_->CreateCKParameterOperation(
+        "DeterministicOperation", opGuid, CKPGUID_INT, CKPGUID_INT, CKPGUID_NONE);
+    ASSERT_NE(nullptr, operation);
+    CKParameterOut *source = context_->CreateCKParameterOut("deterministicSource", CKPGUID_INT, TRUE);
+    ASSERT_NE(nullptr, source);
+    ASSERT_EQ(CK_OK, operation->GetInParameter1()->SetDirectSource(source));
+
+    int value = 0;
+    gOperationInvocationCount = 0;
+    ASSERT_EQ(CK_OK, operation->GetOutParameter()->GetValue(&value));
+    ASSERT_EQ(CK_OK, operation->GetOutParameter()->GetValue(&value));
+    EXPECT_EQ(2, gOperationInvocationCount);
+
+    ASSERT_EQ(CK_OK, pm->SetOperationTypeDeterministic(opGuid, TRUE));
+    gOperationInvocationCount = 0;
+    ASSERT_EQ(CK_OK, operation->GetOutParameter()->GetValue(&value));
+    ASSERT_EQ(CK_OK, operation->GetOutParameter()->GetValue(&value));
+    EXPECT_EQ(0, gOperationInvocationCount);
+
+    value = 12;
+    ASSERT_EQ(CK_OK, source->SetValue(&value));
+    ASSERT_EQ(CK_OK, operation->GetOutParameter()->GetValue(&value));
+    ASSERT_EQ(CK_OK, operation->GetOutParameter()->GetValue(&value));
+    EXPECT_EQ(1, gOperationInvocationCount);
+
+    // An explicit execution always runs
+    EXPECT_EQ(CK_OK, operation->DoOperation());
+    EXPECT_EQ(2, gOperationInvocationCount);
+
+    ASSERT_EQ(CK_OK, pm->UnRegisterOperationType(opGuid));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
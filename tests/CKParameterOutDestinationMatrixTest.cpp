@@ -160,6 +160,61 @@ TEST_F(CKRuntimeFixture, RemoveDestinationAndClearUpdateCounts) {
     EXPECT_EQ(0, source->GetDestinationCount());
 }
 
+TEST_F(CKRuntimeFixture, DestinationsSeeTheLatestWriteInOrder) {
+    CKParameterOut *sourceA = context_->CreateCKParameterOut("sourceA", CKPGUID_INT, TRUE);
+    CKParameterOut *sourceB = context_->CreateCKParameterOut("sourceB", CKPGUID_INT, TRUE);
+    CKParameterOut *relay = context_->CreateCKParameterOut("relay", CKPGUID_INT, TRUE);
+    CKParameterLocal *local = context_->CreateCKParameterLocal("local", CKPGUID_INT, TRUE);
+    ASSERT_NE(nullptr, sourceA);
+    ASSERT_NE(nullptr, sourceB);
+    ASSERT_NE(nullptr, relay);
+    ASSERT_NE(nullptr, local);
+
+    int value = 5;
+    ASSERT_EQ(CK_OK, sourceA->SetValue(&value));
+    // Values written before the link are not pushed
+    ASSERT_EQ(CK_OK, sourceA->AddDestination(relay, TRUE));
+    ASSERT_EQ(CK_OK, sourceB->AddDestination(relay, TRUE));
+    ASSERT_EQ(CK_OK, relay->AddDestination(local, TRUE));
+    int out = -1;
+    ASSERT_EQ(CK_OK, local->GetValue(&out));
+    EXPECT_EQ(0, out);
+
+    value = 1;
+    ASSERT_EQ(CK_OK, sourceA->SetValue(&value));
+    value = 2;
+    ASSERT_EQ(CK_OK, sourceB->SetValue(&value));
+    ASSERT_EQ(CK_OK, local->GetValue(&out));
+    EXPECT_EQ(2, out);
+
+    // A direct write wins until a source changes again
+    value = 3;
+    ASSERT_EQ(CK_OK, local->SetValue(&value));
+    ASSERT_EQ(CK_OK, local->GetValue(&out));
+    EXPECT_EQ(3, out);
+    *(int *) sourceA->GetWriteDataPtr() = 4;
+    sourceA->DataChanged();
+    ASSERT_EQ(CK_OK, local->GetValue(&out));
+    EXPECT_EQ(4, out);
+    ASSERT_EQ(CK_OK, relay->GetValue(&out));
+    EXPECT_EQ(4, out);
+
+    // Destinations keep the last pushed value once unlinked or deleted
+    value = 6;
+    ASSERT_EQ(CK_OK, sourceB->SetValue(&value));
+    sourceB->RemoveDestination(relay);
+    value = 7;
+    ASSERT_EQ(CK_OK, sourceB->SetValue(&value));
+    ASSERT_EQ(CK_OK, relay->GetValue(&out));
+    EXPECT_EQ(6, out);
+
+    value = 8;
+    ASSERT_EQ(CK_OK, sourceA->SetValue(&value));
+    context_->DestroyObject(sourceA);
+    ASSERT_EQ(CK_OK, local->GetValue(&out));
+    EXPECT_EQ(8, out);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <cstring>
 #include <string>
+#include <vector>
 
 #include "CKAll.h"
 
@@ -35,6 +37,24 @@ std::string MakeUniqueName(const char *prefix) {
     return std::string(buffer);
 }
 
+void ExpectSameDataArray(CKDataArray *expected, CKDataArray *actual) {
+    ASSERT_EQ(expected->GetColumnCount(), actual->GetColumnCount());
+    ASSERT_EQ(expected->GetRowCount(), actual->GetRowCount());
+    for (int c = 0; c < expected->GetColumnCount(); ++c) {
+        EXPECT_EQ(expected->GetColumnType(c), actual->GetColumnType(c));
+        EXPECT_STREQ(expected->GetColumnName(c), actual->GetColumnName(c));
+        EXPECT_FALSE(actual->IsColumnIndexed(c));
+        for (int i = 0; i < expected->GetRowCount(); ++i) {
+            const CKUINTPTR a = *expected->GetElement(i, c);
+            const CKUINTPTR b = *actual->GetElement(i, c);
+            if (expected->GetColumnType(c) == CKARRAYTYPE_STRING)
+                EXPECT_STREQ((const char *) a, (const char *) b);
+            else
+                EXPECT_EQ(a, b);
+        }
+    }
+}
+
 } // namespace
 
 TEST_F(CKRuntimeFixture, RemoveAllObjectsClearsSceneMembership) {
@@ -107,6 +127,107 @@ TEST_F(CKRuntimeFixture, CopySelfKeepsSceneObjects) {
     EXPECT_NE(nullptr, scene->GetSceneObjectDesc(obj));
 }
 
+TEST_F(CKRuntimeFixture, ResetRestoresDataArraysAndGroupsLikeLoad) {
+    ASSERT_EQ(CK_OK, context_->ClearAll());
+    const int arrayCount = 64;
+    const int rowCount = 40;
+
+    CKScene *scene = static_cast<CKScene *>(
+        context_->CreateObject(CKCID_SCENE, MakeUniqueName("SceneReset").c_str(), CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, scene);
+    scene->UseEnvironmentSettings(FALSE);
+
+    CKAttributeManager *am = context_->GetAttributeManager();
+    const CKAttributeType type = am->RegisterNewAttributeType("SceneResetAttribute", CKPGUID_INT, CKCID_BEOBJECT, CK_ATTRIBUT_USER);
+    ASSERT_GE(type, 0);
+
+    std::vector<CKDataArray *> arrays;
+    std::vector<CKDataArray *> references;
+    for (int a = 0; a < arrayCount; ++a) {
+        CKDataArray *array = static_cast<CKDataArray *>(
+            context_->CreateObject(CKCID_DATAARRAY, MakeUniqueName("SceneResetArray").c_str(), CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_NE(nullptr, array);
+        array->InsertColumn(-1, CKARRAYTYPE_INT, "Int");
+        array->InsertColumn(-1, CKARRAYTYPE_FLOAT, "Float");
+        array->InsertColumn(-1, CKARRAYTYPE_STRING, "Text");
+        for (int i = 0; i < rowCount; ++i) {
+            array->AddRow();
+            int value = a * rowCount + i;
+            float f = value * 0.5f;
+            char text[32];
+            sprintf_s(text, "Row%d", value);
+            ASSERT_TRUE(array->SetElementValue(i, 0, &value));
+            ASSERT_TRUE(array->SetElementValue(i, 1, &f));
+            // Every fifth row keeps a null string
+            if (i % 5)
+                ASSERT_TRUE(array->SetElementStringValue(i, 2, text));
+        }
+        if (a % 8 == 0) {
+            ASSERT_TRUE(array->SetAttribute(type));
+            int value = a;
+            array->GetAttributeParameter(type)->SetValue(&value);
+        }
+        scene->AddObject(array);
+        arrays.push_back(array);
+    }
+
+    CKGroup *group = static_cast<CKGroup *>(
+        context_->CreateObject(CKCID_GROUP, MakeUniqueName("SceneResetGroup").c_str(), CK_OBJECTCREATION_DYNAMIC));
+    ASSERT_NE(nullptr, group);
+    for (int a = 0; a < 10; ++a)
+        ASSERT_EQ(CK_OK, group->AddObject(arrays[a]));
+    scene->AddObject(group);
+
+    // References are loaded from the same initial values, as before the snapshots
+    for (int a = 0; a < arrayCount; ++a) {
+        CKStateChunk *chunk = CKSaveObjectState(arrays[a], CK_STATESAVE_ALL);
+        CKDataArray *reference = static_cast<CKDataArray *>(context_->CreateObject(CKCID_DATAARRAY, nullptr, CK_OBJECTCREATION_DYNAMIC));
+        ASSERT_EQ(CK_OK, CKReadObjectState(reference, chunk));
+        references.push_back(reference);
+        ASSERT_TRUE(scene->SetObjectInitialValue(arrays[a], chunk));
+    }
+    ASSERT_TRUE(scene->SetObjectInitialValue(group, CKSaveObjectState(group, CK_STATESAVE_ALL)));
+
+    XObjectPointerArray renderContexts;
+    for (int round = 0; round < 3; ++round) {
+        scene->Init(renderContexts, CK_SCENEOBJECTACTIVITY_SCENEDEFAULT, CK_SCENEOBJECTRESET_RESET);
+
+        for (int a = 0; a < arrayCount; ++a)
+            ExpectSameDataArray(references[a], arrays[a]);
+        for (int a = 0; a < arrayCount; a += 8) {
+            int value = -1;
+            ASSERT_NE(nullptr, arrays[a]->GetAttributeParameter(type));
+            arrays[a]->GetAttributeParameter(type)->GetValue(&value);
+            EXPECT_EQ(a, value);
+        }
+        ASSERT_EQ(10, group->GetObjectCount());
+        for (int a = 0; a < 10; ++a) {
+            EXPECT_EQ(arrays[a], group->GetObject(a));
+            EXPECT_TRUE(arrays[a]->IsInGroup(group));
+        }
+        EXPECT_FALSE(arrays[20]->IsInGroup(group));
+
+        // Changed between the resets
+        int value = -1;
+        ASSERT_TRUE(arrays[1]->SetElementValue(3, 0, &value));
+        ASSERT_TRUE(arrays[1]->SetElementStringValue(4, 2, "Changed"));
+        ASSERT_TRUE(arrays[1]->SetElementStringValue(5, 2, "WasNull"));
+        arrays[1]->AddRow();
+        arrays[2]->RemoveRow(0);
+        ASSERT_TRUE(arrays[3]->SetColumnIndexed(0, TRUE));
+        arrays[4]->SetColumnName(1, "Renamed");
+        arrays[8]->GetAttributeParameter(type)->SetValue(&value);
+        // Written without a new value version
+        *(int *) arrays[24]->GetAttributeParameter(type)->GetReadDataPtr() = value;
+        arrays[16]->RemoveAttribute(type);
+        group->RemoveObject(arrays[0]);
+        ASSERT_EQ(CK_OK, group->AddObject(arrays[20]));
+    }
+
+    for (int a = 0; a < arrayCount; ++a)
+        context_->DestroyObject(references[a]);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -188,6 +188,92 @@ TEST(CKStateChunkRoundTripTest, ReadGuidOutOfDataReturnsZeroGuid) {
     EXPECT_TRUE(guid == CKGUID(0u, 0u));
 }
 
+TEST(CKStateChunkRoundTripTest, BorrowedViewIsCopiedOnlyWhenRemapChangesIds) {
+    CKStateChunkPtr chunk = CreateEmptyChunk();
+    ASSERT_NE(nullptr, chunk.get());
+
+    chunk->StartWrite();
+    chunk->WriteIdentifier(0x10);
+    chunk->WriteInt(42);
+    chunk->WriteObjectID(5);
+    chunk->CloseChunk();
+
+    const int size = chunk->ConvertToBuffer(nullptr);
+    ASSERT_GT(size, 0);
+    std::vector<int> buffer((size + 3) / 4, 0);
+    chunk->ConvertToBuffer(buffer.data());
+    const std::vector<int> original = buffer;
+
+    CKStateChunkPtr view = CreateEmptyChunk();
+    ASSERT_NE(nullptr, view.get());
+    ASSERT_TRUE(view->ConvertFromBuffer(buffer.data(), TRUE));
+    EXPECT_TRUE(view->IsBorrowed());
+
+    view->StartRead();
+    ASSERT_TRUE(view->SeekIdentifier(0x10));
+    EXPECT_EQ(42, view->ReadInt());
+    EXPECT_EQ(5u, view->ReadObjectID());
+
+    EXPECT_EQ(0, view->RemapObject(7, 9));
+    EXPECT_TRUE(view->IsBorrowed());
+
+    EXPECT_EQ(1, view->RemapObject(5, 9));
+    EXPECT_FALSE(view->IsBorrowed());
+    EXPECT_EQ(original, buffer);
+
+    view->StartRead();
+    ASSERT_TRUE(view->SeekIdentifier(0x10));
+    EXPECT_EQ(42, view->ReadInt());
+    EXPECT_EQ(9u, view->ReadObjectID());
+}
+
+TEST(CKStateChunkRoundTripTest, GrowthAndReserveKeepWrittenData) {
+    CKStateChunkPtr chunk = CreateEmptyChunk();
+    ASSERT_NE(nullptr, chunk.get());
+
+    // Many small writes go through several geometric reallocations
+    const int count = 10000;
+    chunk->StartWrite();
+    chunk->WriteInt(-1);
+    chunk->Reserve(16);
+    for (int i = 0; i < count; ++i)
+        chunk->WriteInt(i * 3);
+    chunk->Reserve(count);
+    chunk->WriteInt(-2);
+    chunk->CloseChunk();
+
+    // CloseChunk shrinks the buffer to what was written
+    EXPECT_EQ((count + 2) * (int) sizeof(int), chunk->GetDataSize());
+
+    chunk->StartRead();
+    EXPECT_EQ(-1, chunk->ReadInt());
+    for (int i = 0; i < count; ++i)
+        ASSERT_EQ(i * 3, chunk->ReadInt());
+    EXPECT_EQ(-2, chunk->ReadInt());
+}
+
+TEST(CKStateChunkRoundTripTest, ReserveBeforeSubChunkAdoption) {
+    CKStateChunkPtr sub = CreateEmptyChunk();
+    ASSERT_NE(nullptr, sub.get());
+    sub->StartWrite();
+    sub->WriteInt(7);
+    sub->WriteInt(8);
+    sub->CloseChunk();
+
+    CKStateChunkPtr chunk = CreateEmptyChunk();
+    ASSERT_NE(nullptr, chunk.get());
+    chunk->StartWrite();
+    chunk->Reserve(64);
+    chunk->AddChunkAndDelete(sub.release());
+    chunk->CloseChunk();
+
+    // The reserved buffer is dropped for the adopted one
+    EXPECT_EQ(2 * (int) sizeof(int), chunk->GetDataSize());
+    chunk->StartRead();
+    EXPECT_EQ(7, chunk->ReadInt());
+    EXPECT_EQ(8, chunk->ReadInt());
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();